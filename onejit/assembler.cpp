@@ -13,21 +13,89 @@
  *      Author Massimiliano Ghilardi
  */
 
+#include <onejit/algorithm.hpp>
 #include <onejit/assembler.hpp>
 #include <onejit/error.hpp>
+#include <onejit/flowgraph.hpp>
 
 namespace onejit {
 
 Assembler::~Assembler() noexcept {
 }
 
-Assembler &Assembler::add_relocation(Label l) noexcept {
-  if (l && !relocation_.append(Relocation{size(), l})) {
+void Assembler::clear() noexcept {
+  Base::clear();
+  relocation_.clear();
+  label_.clear();
+  label_align_.clear();
+  error_.clear();
+}
+
+Assembler &Assembler::add_relocation(Label l, bool relative) noexcept {
+  if (l && !relocation_.append(Relocation{size(), size(), l, relative})) {
+    good_ = false;
+  }
+  return *this;
+}
+
+Assembler &Assembler::add_label(Label l) noexcept {
+  if (l && !label_.append(LabelPos{size(), l})) {
     good_ = false;
   }
   return *this;
 }
 
+Assembler &Assembler::align_label(Label l, size_t boundary) noexcept {
+  uint8_t log2 = 0;
+  while (log2 < 12 && (size_t(1) << log2) < boundary) {
+    log2++;
+  }
+  if (!l || boundary == 0 || (size_t(1) << log2) != boundary) {
+    return error(l, "Assembler::align_label: alignment must be a power of two between 1 and 4096");
+  } else if (l.index() >= label_align_.size() && !label_align_.resize(l.index() + 1)) {
+    return out_of_memory(l);
+  }
+  label_align_.set(l.index(), log2);
+  return *this;
+}
+
+Assembler &Assembler::align_loops(const FlowGraph &flowgraph, size_t boundary,
+                                  View<float> block_freq) noexcept {
+  BasicBlocks bbs = flowgraph.view();
+  View<uint32_t> loop_depth = flowgraph.loop_depth();
+  uint32_t max_depth = 0;
+  for (uint32_t header : flowgraph.loop_headers()) {
+    max_depth = max2(max_depth, loop_depth[header]);
+  }
+  for (uint32_t header : flowgraph.loop_headers()) {
+    if (header < block_freq.size() && block_freq[header] >= 0.0f) {
+      if (block_freq[header] < float(HotLoopFreq)) {
+        continue;
+      }
+    } else if (loop_depth[header] != max_depth) {
+      // without a Profile, only innermost loops of the deepest nest are considered hot
+      continue;
+    }
+    const BasicBlock &bb = bbs[header];
+    // a loop header is entered by jumps, so it always starts with a Label.
+    // the only exception is the function entry, which is aligned by Linker
+    if (bb.size() != 0) {
+      if (Label l = bb[0].is<Label>()) {
+        align_label(l, boundary);
+      }
+    }
+  }
+  return *this;
+}
+
+void Assembler::end_relocations(size_t start) noexcept {
+  const size_t end = size();
+  Relocation *data = relocation_.data();
+  for (size_t i = start, n = relocation_.size(); i < n; i++) {
+    data[i].end = end;
+  }
+}
+
 Assembler &Assembler::error(Node where, Chars msg) noexcept {
   good_ = good_ && error_.append(Error{where, msg});
   return *this;
@@ -38,7 +38,6 @@ public:
 
   using Base::operator bool;
   using Base::begin;
-  using Base::clear;
   using Base::data;
   using Base::end;
   using Base::size;
@@ -46,13 +45,21 @@ public:
   using Base::truncate;
   using Base::view;
 
+  // minimum executions per function invocation of loop headers aligned by align_loops():
+  // padding colder loops wastes more cycles and instruction cache than it saves
+  enum : uint32_t { HotLoopFreq = 8 };
+
   /**
    * high-level methods, they assemble symbolic instructions
    */
 
-  // assemble an x86_64 instruction. defined in onejit/x64/asm.cpp
+  // assemble an x86_64 instruction, a Label or a Block of them.
+  // defined in onejit/x64/assembler.cpp
   Assembler &x64(const Node &node) noexcept;
 
+  // remove all bytes, relocations, labels, label alignments and errors
+  void clear() noexcept;
+
   /**
    * low-level methods, they add raw bytes
    */
@@ -77,9 +84,42 @@ public:
     return Bytes{*this};
   }
 
-  // mark last added bytes to be filled with label relative offset
+  // mark last added 4 bytes to be filled with label address:
+  // relative to the end of current instruction if 'relative' is true, otherwise absolute.
   // does nothing if label is invalid i.e. bool(l) == false
-  Assembler &add_relocation(Label l) noexcept;
+  Assembler &add_relocation(Label l, bool relative = true) noexcept;
+
+  // mark current position as the address of label l
+  Assembler &add_label(Label l) noexcept;
+
+  // request that x64() aligns label l to 'boundary' bytes, which must be a power of two
+  // not larger than 4096, by inserting multi-byte NOPs before it.
+  // alignment is relative to the start of assembled code: configure Linker
+  // with a function alignment at least as large.
+  Assembler &align_label(Label l, size_t boundary) noexcept;
+
+  // request that x64() aligns the hot loop headers found by flowgraph to 'boundary' bytes.
+  // a loop header is hot if block_freq shows it executed at least HotLoopFreq times
+  // per function invocation or, if its frequency is unknown, if it has the maximum loop depth.
+  // flowgraph must have been built from the same code later passed to x64().
+  // usually invoked by Compiler::align_loops()
+  Assembler &align_loops(const FlowGraph &flowgraph, size_t boundary,
+                         View<float> block_freq = View<float>{}) noexcept;
+
+  /// @return alignment requested for label l, or 1 if none
+  size_t label_align(Label l) const noexcept {
+    return l && l.index() < label_align_.size() ? size_t(1) << label_align_[l.index()] : 1;
+  }
+
+  /// @return relocations to be filled by Linker
+  constexpr CRange<Relocation> relocations() const noexcept {
+    return CRange<Relocation>{&relocation_};
+  }
+
+  /// @return labels defined by assembled code
+  constexpr CRange<LabelPos> labels() const noexcept {
+    return CRange<LabelPos>{&label_};
+  }
 
   /// @return current assembler errors
   constexpr CRange<Error> errors() const noexcept {
@@ -96,7 +136,12 @@ private:
   // hide Base::append()
   void append(...) noexcept;
 
+  // set the end of relocations added since relocation_[start]
+  void end_relocations(size_t start) noexcept;
+
   Array<Relocation> relocation_;
+  Array<LabelPos> label_;
+  Array<uint8_t> label_align_; // log2 of requested alignment, indexed by Label::index()
   Array<Error> error_;
 
 }; // class Assembler
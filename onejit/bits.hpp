@@ -137,6 +137,8 @@ constexpr const Bits Bits16{eBits16};
 constexpr const Bits Bits32{eBits32};
 constexpr const Bits Bits64{eBits64};
 constexpr const Bits Bits128{eBits128};
+constexpr const Bits Bits256{eBits256};
+constexpr const Bits Bits512{eBits512};
 
 const Fmt &operator<<(const Fmt &fmt, Bits bits);
 
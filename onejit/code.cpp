@@ -62,6 +62,14 @@ uint64_t Code::uint64(Offset byte_offset) const noexcept {
   return x.u64;
 }
 
+Code &Code::set_uint64(Offset byte_offset, uint64_t u64) noexcept {
+  const size_t index = byte_offset / sizeof(T);
+  if (index + 1 < size()) {
+    std::memcpy(Base::data() + index, &u64, sizeof(u64));
+  }
+  return *this;
+}
+
 Code &Code::add_item(const CodeItem item) noexcept {
   return add(CodeItems{&item, 1});
 }
@@ -86,6 +86,9 @@ public:
     return add_uint64(Float64Bits{f64}.bits());
   }
 
+  // overwrite uint64_t at specified byte_offset. does nothing if byte_offset is out of bounds
+  Code &set_uint64(Offset byte_offset, uint64_t u64) noexcept;
+
   Code &add_item(CodeItem data) noexcept; // same as add_uint32()
   Code &add(CodeItems data) noexcept;
   Code &add(Header header) noexcept {
@@ -0,0 +1,285 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * codecache.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/codecache.hpp>
+#include <onejit/config.h> // HAVE_*
+#include <onestl/view.hpp>
+
+#include <cstring> // std::memcpy()
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MPROTECT)
+#define ONEJIT_HAVE_MMAP 1
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYSCONF)
+#include <unistd.h> // sysconf()
+#endif
+
+namespace onejit {
+
+// ===============================  mmap() wrappers  ===========================
+
+static size_t get_page_size() noexcept {
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+  long n = sysconf(_SC_PAGESIZE);
+  if (n > 0 && (n & (n - 1)) == 0) {
+    return size_t(n);
+  }
+#endif
+  return 4096;
+}
+
+static size_t page_size() noexcept {
+  static const size_t size = get_page_size();
+  return size;
+}
+
+static constexpr size_t round_up(size_t size, size_t align) noexcept {
+  return (size + align - 1) & ~(align - 1);
+}
+
+// map read-execute memory. @return nullptr on errors
+static void *map_memory(size_t size) noexcept {
+#ifdef ONEJIT_HAVE_MMAP
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return addr == MAP_FAILED ? nullptr : addr;
+#else
+  (void)size;
+  return nullptr;
+#endif
+}
+
+static void unmap_memory(void *addr, size_t size) noexcept {
+#ifdef ONEJIT_HAVE_MMAP
+  munmap(addr, size);
+#else
+  (void)addr;
+  (void)size;
+#endif
+}
+
+// make memory either read-write or read-execute. @return false on errors
+static bool protect_memory(void *addr, size_t size, bool writable) noexcept {
+#ifdef ONEJIT_HAVE_MMAP
+  return mprotect(addr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#else
+  (void)addr;
+  (void)size;
+  (void)writable;
+  return false;
+#endif
+}
+
+static void flush_icache(uint8_t *addr, size_t size) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin___clear_cache(reinterpret_cast<char *>(addr), reinterpret_cast<char *>(addr + size));
+#else
+  (void)addr;
+  (void)size;
+#endif
+}
+
+// ===============================  CodeCache  =================================
+
+CodeCache::CodeCache() noexcept
+    : chunk_{}, free_{}, bump_{}, used_bytes_{0}, mapped_bytes_{0}, good_{true} {
+}
+
+CodeCache::~CodeCache() noexcept {
+  for (const Chunk &chunk : chunk_) {
+    unmap_memory(chunk.addr, chunk.size);
+  }
+}
+
+size_t CodeCache::sizeclass_of(size_t size) noexcept {
+  size_t sizeclass = 0;
+  for (size_t n = MinSize; n < size; n <<= 1) {
+    if (++sizeclass == SizeClassN) {
+      return NoSizeClass;
+    }
+  }
+  return sizeclass;
+}
+
+void *CodeCache::alloc(size_t size) noexcept {
+  const size_t sizeclass = sizeclass_of(size);
+  if (sizeclass == NoSizeClass) {
+    return alloc_large(size);
+  }
+  return alloc_small(sizeclass);
+}
+
+uint8_t *CodeCache::alloc_small(size_t sizeclass) noexcept {
+  const size_t size = MinSize << sizeclass;
+  Array<uint8_t *> &freelist = free_[sizeclass];
+  uint8_t *addr;
+  if (const size_t n = freelist.size()) {
+    // reuse the most recently freed slot
+    addr = freelist[n - 1];
+    freelist.truncate(n - 1);
+  } else {
+    Bump &bump = bump_[sizeclass];
+    if (bump.next == bump.end) {
+      // size is a power of two, and divides slab size: no space is left over
+      const size_t page = page_size();
+      Chunk *chunk = map_chunk(page > SlabSize ? page : size_t(SlabSize), sizeclass);
+      if (!chunk) {
+        return nullptr;
+      }
+      bump.next = chunk->addr;
+      bump.end = chunk->addr + chunk->size;
+    }
+    addr = bump.next;
+    bump.next += size;
+  }
+  chunk_.data()[find_chunk(addr)].used++;
+  used_bytes_ += size;
+  return addr;
+}
+
+uint8_t *CodeCache::alloc_large(size_t size) noexcept {
+  Chunk *chunk = map_chunk(round_up(size, page_size()), NoSizeClass);
+  if (!chunk) {
+    return nullptr;
+  }
+  chunk->used = 1;
+  used_bytes_ += chunk->size;
+  return chunk->addr;
+}
+
+CodeCache::Chunk *CodeCache::map_chunk(size_t size, size_t sizeclass) noexcept {
+  // reserve space in chunk_ before mapping, to never leak the mapping
+  size_t i = chunk_.size();
+  uint8_t *addr = nullptr;
+  if (!chunk_.reserve(i + 1) || !(addr = static_cast<uint8_t *>(map_memory(size)))) {
+    good_ = false;
+    return nullptr;
+  }
+  chunk_.append(Chunk{});
+  Chunk *data = chunk_.data();
+  // keep chunk_ sorted by address
+  for (; i > 0 && size_t(data[i - 1].addr) > size_t(addr); i--) {
+    data[i] = data[i - 1];
+  }
+  data[i] = Chunk{addr, size, 0, uint8_t(sizeclass)};
+  mapped_bytes_ += size;
+  return &data[i];
+}
+
+size_t CodeCache::find_chunk(const void *addr) const noexcept {
+  const size_t x = size_t(addr);
+  const Chunk *data = chunk_.data();
+  size_t lo = 0, hi = chunk_.size();
+  // find the first chunk starting after addr
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (size_t(data[mid].addr) <= x) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo != 0 && x - size_t(data[lo - 1].addr) < data[lo - 1].size) {
+    return lo - 1;
+  }
+  return chunk_.size();
+}
+
+bool CodeCache::write(void *addr, Bytes code) noexcept {
+  const size_t i = find_chunk(addr);
+  if (i == chunk_.size()) {
+    return false;
+  }
+  const Chunk &chunk = chunk_.data()[i];
+  uint8_t *dst = static_cast<uint8_t *>(addr);
+  const size_t offset = size_t(dst - chunk.addr);
+  size_t avail = chunk.size - offset;
+  if (chunk.sizeclass != NoSizeClass) {
+    const size_t size = MinSize << chunk.sizeclass;
+    avail = size - offset % size;
+  }
+  if (code.size() > avail) {
+    return false;
+  } else if (code.size() == 0) {
+    return true;
+  }
+  // chunk.addr is page-aligned: make writable only the pages touched by code
+  const size_t page = page_size();
+  const size_t start = offset & ~(page - 1);
+  const size_t len = round_up(offset + code.size(), page) - start;
+  if (!protect_memory(chunk.addr + start, len, true)) {
+    return false;
+  }
+  std::memcpy(dst, code.data(), code.size());
+  const bool ok = protect_memory(chunk.addr + start, len, false);
+  flush_icache(dst, code.size());
+  return ok;
+}
+
+void *CodeCache::add(Bytes code) noexcept {
+  void *addr = alloc(code.size());
+  if (addr && !write(addr, code)) {
+    remove(addr);
+    addr = nullptr;
+  }
+  return addr;
+}
+
+bool CodeCache::remove(const void *addr) noexcept {
+  size_t i = find_chunk(addr);
+  if (!addr || i == chunk_.size()) {
+    return false;
+  }
+  Chunk *data = chunk_.data();
+  Chunk &chunk = data[i];
+  uint8_t *ptr = chunk.addr + (static_cast<const uint8_t *>(addr) - chunk.addr);
+  const size_t offset = size_t(ptr - chunk.addr);
+
+  if (chunk.sizeclass == NoSizeClass) {
+    if (offset != 0) {
+      return false;
+    }
+    unmap_memory(chunk.addr, chunk.size);
+    used_bytes_ -= chunk.size;
+    mapped_bytes_ -= chunk.size;
+    // remove chunk from chunk_, keeping it sorted
+    const size_t n = chunk_.size() - 1;
+    for (; i < n; i++) {
+      data[i] = data[i + 1];
+    }
+    chunk_.truncate(n);
+    return true;
+  }
+
+  const size_t sizeclass = chunk.sizeclass;
+  const size_t size = MinSize << sizeclass;
+  const Bump &bump = bump_[sizeclass];
+  if (offset % size != 0 || chunk.used == 0 || (ptr >= bump.next && ptr < bump.end)) {
+    // not the start of an allocated slot
+    return false;
+  } else if (!free_[sizeclass].append(ptr)) {
+    good_ = false;
+    return false;
+  }
+  chunk.used--;
+  used_bytes_ -= size;
+  return true;
+}
+
+} // namespace onejit
@@ -0,0 +1,133 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * codecache.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_CODECACHE_HPP
+#define ONEJIT_CODECACHE_HPP
+
+#include <onejit/fwd.hpp>
+#include <onestl/array.hpp>
+
+#include <cstdint> // uint8_t
+
+namespace onejit {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// executable memory for jit-compiled code.
+//
+// memory is obtained from the operating system with mmap() and is never
+// writable and executable at the same time (W^X): write() makes the affected pages
+// read-write only while copying code into them, then read-execute again.
+//
+// small code is allocated from 64k slabs, each one dedicated to a single size class
+// from 16 to 2048 bytes: freed slots are reused by the same size class,
+// and fragmentation stays low when compiling thousands of small functions.
+// larger code receives its own mapping, returned to the operating system by remove().
+//
+// not thread-safe: the caller must synchronize concurrent accesses to the same CodeCache,
+// and must not execute code while write() is modifying its pages.
+class CodeCache {
+public:
+  CodeCache() noexcept;
+
+  CodeCache(const CodeCache &other) = delete;
+  CodeCache &operator=(const CodeCache &other) = delete;
+
+  // unmaps all memory: code returned by add() or alloc() must not be executed anymore
+  ~CodeCache() noexcept;
+
+  /// @return false if out of memory
+  constexpr explicit operator bool() const noexcept {
+    return good_;
+  }
+
+  // reserve executable memory for 'size' bytes of code, aligned to 16 bytes or more:
+  // size up to 2048 is aligned to size rounded up to a power of two, larger size to page size.
+  // its content must be set with write() before executing it.
+  /// @return reserved address, or nullptr if out of memory
+  void *alloc(size_t size) noexcept;
+
+  // copy code into executable memory previously returned by alloc().
+  /// @return false if code does not fit the reserved memory, or on errors
+  bool write(void *addr, Bytes code) noexcept;
+
+  // alloc() then write().
+  /// @return callable address of copied code, or nullptr if out of memory
+  void *add(Bytes code) noexcept;
+
+  // release code previously returned by add() or alloc(), making its memory reusable.
+  // releasing the same code twice is undefined behavior.
+  /// @return false if addr was not returned by add() or alloc()
+  bool remove(const void *addr) noexcept;
+
+  /// @return number of bytes currently reserved by add() and alloc(),
+  /// rounded up to their size class
+  constexpr size_t used_bytes() const noexcept {
+    return used_bytes_;
+  }
+
+  /// @return number of bytes currently mapped from the operating system
+  constexpr size_t mapped_bytes() const noexcept {
+    return mapped_bytes_;
+  }
+
+private:
+  enum : size_t {
+    MinSize = 16,      // smallest size class, also alignment of all code
+    SizeClassN = 8,    // size classes are MinSize << 0 ... MinSize << (SizeClassN-1)
+    SlabSize = 65536,  // slabs are at least this large
+    NoSizeClass = 255, // Chunk::sizeclass of chunks containing a single large code
+  };
+
+  // memory mapped from the operating system
+  struct Chunk {
+    uint8_t *addr;
+    size_t size;
+    uint32_t used;     // number of allocated slots
+    uint8_t sizeclass; // NoSizeClass if chunk contains a single large code
+  };
+
+  // unused part at the end of the newest slab of each size class
+  struct Bump {
+    uint8_t *next;
+    uint8_t *end;
+  };
+
+  /// @return size class for specified size, or NoSizeClass if too large
+  static size_t sizeclass_of(size_t size) noexcept;
+
+  // allocate a slot from specified size class
+  uint8_t *alloc_small(size_t sizeclass) noexcept;
+
+  // allocate a chunk containing a single large code
+  uint8_t *alloc_large(size_t size) noexcept;
+
+  // mmap() a new chunk and insert it in chunk_
+  Chunk *map_chunk(size_t size, size_t sizeclass) noexcept;
+
+  /// @return index of the chunk containing addr, or chunk_.size() if not found
+  size_t find_chunk(const void *addr) const noexcept;
+
+  Array<Chunk> chunk_; // sorted by address
+  Array<uint8_t *> free_[SizeClassN];
+  Bump bump_[SizeClassN];
+  size_t used_bytes_;
+  size_t mapped_bytes_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace onejit
+
+#endif // ONEJIT_CODECACHE_HPP
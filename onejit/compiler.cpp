@@ -30,6 +30,7 @@
 #include <onejit/ir/stmtn.hpp>
 #include <onejit/ir/unary.hpp>
 #include <onejit/ir/util.hpp>
+#include <onejit/tier.hpp>
 
 namespace onejit {
 
@@ -67,7 +68,8 @@ inline Compiler::Flags &operator^=(Compiler::Flags &a, Compiler::Flags b) noexce
 ////////////////////////////////////////////////////////////////////////////////
 
 Compiler::Compiler() noexcept
-    : optimizer_{}, allocator_{}, func_{}, break_{}, continue_{}, fallthrough_{}, //
+    : optimizer_{}, allocator_{}, liveness_{}, func_{}, opt_{}, counters_{}, profile_{},
+      profile_mode_{ProfileNone}, label_base_{}, break_{}, continue_{}, fallthrough_{}, //
       node_{}, flowgraph_{}, error_{}, good_{true} {
 }
 
@@ -97,6 +99,8 @@ Compiler &Compiler::compile(Func &func, Opt flags) noexcept {
   }
 
   func_ = &func;
+  opt_ = flags;
+  label_base_ = func.labels().size();
   break_.clear();
   continue_.clear();
   fallthrough_.clear();
@@ -108,9 +112,13 @@ Compiler &Compiler::compile(Func &func, Opt flags) noexcept {
 
   Node node = optimizer_.optimize(func, func.get_body(), flags);
 
-  return compile_add(node, SimplifyDefault) //
-      .add_epilogue(func)
-      .finish();
+  compile_add(node, SimplifyDefault).add_epilogue(func);
+  if (profile_mode_ == ProfileCollect) {
+    add_profile_counters();
+  } else if (profile_mode_ == ProfileUse) {
+    layout_cold_blocks();
+  }
+  return finish();
 }
 
 Compiler &Compiler::finish() noexcept {
@@ -449,13 +457,11 @@ static OpStmt3 comparison_to_condjump(Op2 op2, bool is_signed) noexcept {
   return op;
 }
 
-Node Compiler::compile(JumpIf jump_if, Flags) noexcept {
-  Label to = jump_if.to();
-  // preserve any binary comparison, it's optimized below
-  Expr test = compile(jump_if.test(), SimplifyAll & ~SimplifyLandLor);
-  Expr x, y;
+// decompose a compiled boolean test into the comparison (x op y),
+// negated if negate is set to true
+static Op2 test_to_comparison(Expr test, Expr &x, Expr &y, bool &negate) noexcept {
   Op2 op = BAD2;
-  bool negate = false;
+  negate = false;
   while (Unary expr = test.is<Unary>()) {
     if (expr.op() != NOT1) {
       break;
@@ -464,15 +470,27 @@ Node Compiler::compile(JumpIf jump_if, Flags) noexcept {
     test = expr.x();
   }
   if (Binary expr = test.is<Binary>()) {
-    x = expr.x();
-    y = expr.y();
-    op = expr.op();
+    if (is_comparison(expr.op())) {
+      x = expr.x();
+      y = expr.y();
+      op = expr.op();
+    }
   }
   if (op == BAD2) {
     x = test;
     y = Zero(test.kind());
     op = NEQ;
   }
+  return op;
+}
+
+Node Compiler::compile(JumpIf jump_if, Flags) noexcept {
+  Label to = jump_if.to();
+  // preserve any binary comparison, it's optimized below
+  Expr test = compile(jump_if.test(), SimplifyAll & ~SimplifyLandLor);
+  Expr x, y;
+  bool negate;
+  Op2 op = test_to_comparison(test, x, y, negate);
   if (Const cx = x.is<Const>()) {
     if (Const cy = y.is<Const>()) {
       // test is a constant,
@@ -515,10 +533,17 @@ Node Compiler::compile(If st, Flags) noexcept {
     compile_add(ctest.val() ? then : else_, SimplifyCall);
     return VoidConst;
   }
+  // allocate labels even if if-conversion succeeds:
+  // keeps label numbering, and thus Profile keys, independent from it
   bool have_else = else_.type() != CONST;
   Label else_label{*func_};
   Label endif_label = have_else ? Label{*func_} : else_label;
 
+  if ((opt_ & OptIfConversion) && profile_mode_ != ProfileCollect &&
+      !is_biased_if(else_label, have_else) && if_convert(test, then, else_)) {
+    return VoidConst;
+  }
+
   test = Unary{*func_, NOT1, test};
   JumpIf jump_if{*func_, else_label, test};
 
@@ -533,6 +558,163 @@ Node Compiler::compile(If st, Flags) noexcept {
   return VoidConst;
 }
 
+// ===============================  if-conversion  =============================
+
+// maximum number of operations evaluated unconditionally by if-conversion
+enum : uint32_t { if_conversion_budget = 4 };
+
+// if node is an Assign, possibly wrapped in single-statement Blocks, return it
+static Assign single_assign(Node node) noexcept {
+  while (Block block = node.is<Block>()) {
+    if (block.children() != 1) {
+      return Assign{};
+    }
+    node = block.child(0);
+  }
+  Assign assign = node.is<Assign>();
+  if (!assign || assign.op() != ASSIGN || assign.dst().type() != VAR) {
+    return Assign{};
+  }
+  return assign;
+}
+
+// return true if expr has no side effects, cannot fault,
+// and contains at most 'budget' operations
+static bool is_cheap_pure(Expr expr, uint32_t &budget) noexcept {
+  switch (expr.type()) {
+  case VAR:
+  case LABEL:
+  case CONST:
+    return true;
+  case UNARY:
+    if (expr.op() == BITCOPY) {
+      return false;
+    }
+    break;
+  case BINARY:
+    if (!is_comparison(Op2(expr.op())) && Op2(expr.op()) != SUB && Op2(expr.op()) != SHL &&
+        Op2(expr.op()) != SHR) {
+      // QUO and REM may fault, LAND and LOR are compiled to jumps
+      return false;
+    }
+    break;
+  case TUPLE:
+    if (expr.op() < ADD || expr.op() > XOR) {
+      // MAX and MIN are compiled to jumps, CALL may have side effects
+      return false;
+    }
+    break;
+  case MEM: // may fault
+  default:
+    return false;
+  }
+  if (budget == 0) {
+    return false;
+  }
+  budget--;
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    if (!is_cheap_pure(expr.child_is<Expr>(i), budget)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// return true if the If or Cond arms 'then' and 'else_' can be if-converted
+static bool can_if_convert(Node then, Node else_) noexcept {
+  Assign a_then = single_assign(then);
+  if (!a_then) {
+    return false;
+  }
+  uint32_t budget = if_conversion_budget;
+  if (!is_cheap_pure(a_then.src(), budget)) {
+    return false;
+  }
+  if (else_.type() == CONST) {
+    return true; // no else
+  }
+  Assign a_else = single_assign(else_);
+  return a_else && a_else.dst() == a_then.dst() && is_cheap_pure(a_else.src(), budget);
+}
+
+// if-conversion is not worth it if the branch goes the same way
+// more than 15 times out of 16
+enum : uint64_t { if_conversion_bias = 16 };
+
+bool Compiler::is_biased_if(Label else_label, bool have_else) const noexcept {
+  if (profile_mode_ != ProfileUse || profile_->empty()) {
+    return false;
+  }
+  // 'then' block follows the conditional jump to else_label.
+  // Without 'else', the block at else_label is also reached from 'then'
+  const uint64_t then = profile_->count(profile_key(else_label, true));
+  uint64_t taken = profile_->count(profile_key(else_label, false));
+  if (!have_else) {
+    taken = taken > then ? taken - then : 0;
+  }
+  const uint64_t min = then < taken ? then : taken;
+  return min * if_conversion_bias < then + taken;
+}
+
+bool Compiler::if_convert(Expr test, Node then, Node else_) noexcept {
+  if (!can_if_convert(then, else_)) {
+    return false;
+  }
+  Expr x, y;
+  bool negate;
+  Op2 op = test_to_comparison(test, x, y, negate);
+  const Kind xkind = x.kind();
+  if ((!xkind.is_integer_or_ptr() && xkind != Bool) || (x.type() == CONST && y.type() == CONST)) {
+    // floating point comparisons set different flags
+    return false;
+  }
+  if (negate) {
+    op = not_comparison(op);
+  }
+  Assign a_then = single_assign(then);
+  Assign a_else = single_assign(else_);
+  Var dst = a_then.dst().is<Var>();
+  const Kind kind = dst.kind();
+  Expr src_then = a_then.src();
+
+  if (a_else && kind == Bool) {
+    Const c_then = src_then.is<Const>();
+    Const c_else = a_else.src().is<Const>();
+    if (c_then && c_else && bool(c_then.val()) != bool(c_else.val())) {
+      // (if test (= dst true) (= dst false)) => (= dst test)
+      if (!c_then.val()) {
+        op = not_comparison(op);
+      }
+      compile_add(Assign{*func_, ASSIGN, dst, Binary{*func_, op, x, y}}, SimplifyDefault);
+      return true;
+    }
+  }
+  const eBits ebits = kind.ebits();
+  if (!kind.is_integer_or_ptr() || ebits < eBits16 || ebits > eBits64) {
+    // no conditional move for 8-bit and floating point registers
+    return false;
+  }
+  OpStmt4 cmov = condjump_to_condmove(comparison_to_condjump(op, xkind.is_signed()));
+  if (cmov == BAD_ST4) {
+    return false;
+  }
+  // evaluate the comparison and the moved value before the else branch modifies dst
+  Expr args[] = {x, y, compile(src_then, SimplifyAll)};
+  for (Expr &arg : args) {
+    arg = to_var_const(arg);
+    if (a_else && arg == dst) {
+      Var copy{*func_, arg.kind()};
+      add(Assign{*func_, ASSIGN, copy, arg});
+      arg = copy;
+    }
+  }
+  if (a_else) {
+    compile_add(a_else, SimplifyDefault);
+  }
+  add(Stmt4{*func_, cmov, dst, args[2], args[0], args[1]});
+  return true;
+}
+
 // ===============================  compile(Stmt4)  ============================
 
 Node Compiler::compile(Stmt4 st, Flags flags) noexcept {
@@ -566,6 +748,9 @@ Node Compiler::compile(For st, Flags) noexcept {
     add(Goto{*func_, l_continue});
   }
   add(l_loop);
+  if (counters_) {
+    add_counter(&counters_->backedges);
+  }
   enter_loop(l_break, l_continue);
   compile_add(st.body(), SimplifyDefault);
   compile_add(st.post(), SimplifyDefault);
@@ -631,6 +816,11 @@ Node Compiler::compile(Cond st, Flags) noexcept {
   } else if (n & 1) {
     error(st, "unexpected odd number of children in Cond: expecting an even number of them");
     add(st);
+  } else if ((opt_ & OptIfConversion) && (n == 2 || (n == 4 && st.child(2) == TrueExpr)) &&
+             can_if_convert(st.child(1), n == 4 ? st.child(3) : Node{VoidConst})) {
+    // (cond test then) and (cond test then true else) are equivalent to an If
+    compile(If{*func_, st.child_is<Expr>(0), st.child(1), n == 4 ? st.child(3) : Node{VoidConst}},
+            SimplifyDefault);
   } else {
     Label l_end{*func_};
     Goto goto_end = n <= 2 ? Goto{} : Goto{*func_, l_end};
@@ -880,10 +1070,13 @@ Compiler &Compiler::add_prologue(Func &func) noexcept {
   const uint16_t n = func.param_n();
   Vars vars = func.vars();
   add(func.address());
-  if (n == 0 || vars.size() < n) {
-    return *this;
+  if (n != 0 && vars.size() >= n) {
+    add(StmtN{*func_, SET_, Nodes{vars.data(), n}});
+  }
+  if (counters_) {
+    add_counter(&counters_->calls);
   }
-  return add(StmtN{*func_, SET_, Nodes{vars.data(), n}});
+  return *this;
 }
 
 Compiler &Compiler::add_epilogue(Func &func) noexcept {
@@ -895,6 +1088,215 @@ Compiler &Compiler::add_epilogue(Func &func) noexcept {
   return *this;
 }
 
+Compiler &Compiler::add_counter(const void *counter) noexcept {
+  Const address{*func_, Imm{Ptr, uint64_t(size_t(counter))}};
+  return add(Inc{*func_, Mem{*func_, Uint64, {address}}});
+}
+
+size_t Compiler::profile_key(Label label, bool after) const noexcept {
+  if (!label) {
+    return Profile::NoKey;
+  }
+  const size_t index = label.index();
+  size_t rel;
+  if (index == 0) {
+    rel = 0; // function address
+  } else if (index >= label_base_) {
+    rel = index - label_base_ + 1;
+  } else {
+    return Profile::NoKey; // label created by a previous compile
+  }
+  return after ? Profile::key_after(rel) : Profile::key_at(rel);
+}
+
+Compiler &Compiler::profile_keys(Array<size_t> &keys) noexcept {
+  BasicBlocks bbs = flowgraph_.view();
+  const size_t n = bbs.size();
+  const size_t key_n = Profile::key_at(func_->labels().size() - label_base_ + 1);
+  Array<bool> seen;
+  if (!keys.resize(n) || !seen.resize(key_n)) {
+    return out_of_memory(Node{});
+  }
+  for (size_t i = 0; i < n; i++) {
+    const BasicBlock &bb = bbs.data()[i];
+    size_t key = Profile::NoKey;
+    if (bb.size() != 0 && bb[0].type() == LABEL) {
+      key = profile_key(bb[0].is<Label>(), false);
+    } else if (i != 0) {
+      const BasicBlock &prev = bbs.data()[i - 1];
+      Node jump = prev[prev.size() - 1];
+      if (ir::is_cond_jump(jump)) {
+        key = profile_key(ir::jump_label(jump), true);
+      }
+    }
+    if (key < key_n && !seen[key]) {
+      seen.set(key, true);
+    } else {
+      key = Profile::NoKey;
+    }
+    keys.set(i, key);
+  }
+  return *this;
+}
+
+Compiler &Compiler::profile_freq(Array<float> &freq) noexcept {
+  freq.clear();
+  if (!*this || profile_mode_ != ProfileUse || profile_->empty()) {
+    return *this;
+  }
+  Labels labels = func_->labels();
+  if (!freq.resize(labels.size() * 2)) {
+    return out_of_memory(Node{});
+  }
+  const float entry = float(profile_->entry());
+  for (size_t i = 0, n = labels.size(); i < n; i++) {
+    for (size_t after = 0; after < 2; after++) {
+      // labels created after the counters were collected have no counter
+      const size_t key = profile_key(labels[i], after != 0);
+      freq.set(i * 2 + after, key < profile_->counts().size() //
+                                  ? float(profile_->count(key)) / entry
+                                  : -1.0f);
+    }
+  }
+  return *this;
+}
+
+Compiler &Compiler::add_profile_counters() noexcept {
+  if (!*this) {
+    return *this;
+  } else if (!profile_->reset(func_->labels().size() - label_base_ + 1)) {
+    return out_of_memory(Node{});
+  }
+  Array<size_t> keys;
+  if (!flowgraph_.build(node_, error_) || !profile_keys(keys)) {
+    return *this;
+  }
+  // flowgraph_ points into old_node, while node_ receives the instrumented code
+  Array<Node> old_node;
+  old_node.swap(node_);
+  if (!node_.reserve(old_node.size() + keys.size())) {
+    return out_of_memory(Node{});
+  }
+  BasicBlocks bbs = flowgraph_.view();
+  for (size_t i = 0, n = bbs.size(); i < n; i++) {
+    const BasicBlock &bb = bbs.data()[i];
+    size_t j = 0, node_n = bb.size();
+    // skip labels, and the assignment of parameters in the first basic block
+    while (j < node_n && (bb[j].type() == LABEL || (i == 0 && bb[j].op() == SET_))) {
+      add(bb[j++]);
+    }
+    if (keys[i] != Profile::NoKey) {
+      add_counter(profile_->counter(keys[i]));
+    }
+    while (j < node_n) {
+      add(bb[j++]);
+    }
+  }
+  return *this;
+}
+
+// @return true if basic block starts with specified label
+static bool starts_with_label(const BasicBlock &bb, Label label) noexcept {
+  for (Node node : bb) {
+    if (node.type() != LABEL) {
+      break;
+    } else if (node.is<Label>().index() == label.index()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Compiler &Compiler::layout_cold_blocks() noexcept {
+  if (!*this || profile_->empty()) {
+    return *this;
+  }
+  Array<size_t> keys;
+  if (!flowgraph_.build(node_, error_) || !profile_keys(keys)) {
+    return *this;
+  }
+  BasicBlocks bbs = flowgraph_.view();
+  const size_t n = bbs.size();
+  // new order of basic blocks: hot ones first, then cold ones.
+  // The first basic block is the function entry point and must stay first
+  Array<size_t> order;
+  if (!order.reserve(n)) {
+    return out_of_memory(Node{});
+  }
+  for (int cold = 0; cold < 2; cold++) {
+    for (size_t i = 0; i < n; i++) {
+      const bool is_cold = i != 0 && keys[i] != Profile::NoKey && profile_->count(keys[i]) == 0;
+      if (is_cold == bool(cold)) {
+        order.append(i);
+      }
+    }
+  }
+  bool moved = false;
+  for (size_t i = 0; i < n && !moved; i++) {
+    moved = order[i] != i;
+  }
+  if (!moved) {
+    return *this;
+  }
+  // basic blocks that were reached by fallthrough and no longer are,
+  // need a label to jump to. Create it if missing
+  Array<Label> labels;
+  if (!labels.resize(n)) {
+    return out_of_memory(Node{});
+  }
+  for (size_t j = 0; j < n; j++) {
+    const size_t i = order[j];
+    const BasicBlock &bb = bbs.data()[i];
+    if (bb.size() != 0 && bb[0].type() == LABEL) {
+      labels.set(i, bb[0].is<Label>());
+    }
+    const bool fallthrough = i + 1 < n && !ir::is_uncond_jump(bb[bb.size() - 1]);
+    if (fallthrough && (j + 1 == n || order[j + 1] != i + 1) && !labels[i + 1]) {
+      const BasicBlock &next = bbs.data()[i + 1];
+      if (next.size() != 0 && next[0].type() == LABEL) {
+        labels.set(i + 1, next[0].is<Label>());
+      } else {
+        labels.set(i + 1, Label{*func_});
+      }
+    }
+  }
+  // flowgraph_ points into old_node, while node_ receives the new layout
+  Array<Node> old_node;
+  old_node.swap(node_);
+  if (!node_.reserve(old_node.size() + n)) {
+    return out_of_memory(Node{});
+  }
+  for (size_t j = 0; j < n; j++) {
+    const size_t i = order[j];
+    const BasicBlock &bb = bbs.data()[i];
+    const size_t node_n = bb.size();
+    if (labels[i] && !starts_with_label(bb, labels[i])) {
+      add(labels[i]);
+    }
+    for (size_t k = 0; k + 1 < node_n; k++) {
+      add(bb[k]);
+    }
+    Node last = bb[node_n - 1];
+    if (i + 1 == n || ir::is_uncond_jump(last) || (j + 1 < n && order[j + 1] == i + 1)) {
+      // no fallthrough, or fallthrough is preserved
+      add(last);
+      continue;
+    }
+    Label to = labels[i + 1];
+    if (last.type() == STMT_3 && ir::is_cond_jump(last) && j + 1 < n &&
+        starts_with_label(bbs.data()[order[j + 1]], ir::jump_label(last))) {
+      // jump target became the next basic block: invert the conditional jump
+      OpStmt3 op = negate_condjump(OpStmt3(last.op()));
+      if (op != BAD_ST3) {
+        add(Stmt3{*func_, op, to, last.child_is<Expr>(1), last.child_is<Expr>(2)});
+        continue;
+      }
+    }
+    add(last).add(Goto{*func_, to});
+  }
+  return *this;
+}
+
 Compiler &Compiler::add(const Node &node) noexcept {
   if (node != VoidConst) {
     good_ = good_ && node_.append(node);
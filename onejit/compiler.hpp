@@ -22,7 +22,9 @@
 #include <onejit/ir/label.hpp>
 #include <onejit/ir/node.hpp>
 #include <onejit/optimizer.hpp>
+#include <onejit/profile.hpp>
 #include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
 #include <onestl/array.hpp>
 #include <onestl/crange.hpp>
 
@@ -57,12 +59,38 @@ public:
     return *this;
   }
 
+  // configure the counters that compiled code increments at function entry
+  // and at each loop iteration. Used by tiered compilation, see Tiered.
+  // increments are not atomic: counts are approximate if threads share the function.
+  // default is nullptr i.e. no counters
+  Compiler &configure_counters(TierCounters *counters) noexcept {
+    counters_ = counters;
+    return *this;
+  }
+
+  // configure the basic block counters that compiled code increments (ProfileCollect)
+  // or that guide block layout, if-conversion and register spilling (ProfileUse).
+  // The same Profile must be used with the same function and the same Opt flags.
+  // default is nullptr i.e. no profile
+  Compiler &configure_profile(Profile *profile, ProfileMode mode) noexcept {
+    profile_ = mode == ProfileNone ? nullptr : profile;
+    profile_mode_ = profile_ ? mode : ProfileNone;
+    return *this;
+  }
+
   // compile function to portable IR (intermediate representation)
   Compiler &compile(Func &func, Opt flags = OptAll) noexcept;
 
   // compile function to arch-specific assembly. calls compile() if needed
   Compiler &compile_arch(Func &func, ArchId archid, Opt flags = OptAll) noexcept;
 
+  // request that assembler aligns to 'boundary' bytes the hot loop headers
+  // of the code produced by compile_arch(func, X64). Should be invoked before assembler.x64():
+  // loop hotness comes from the Profile if func was the last function compiled
+  // with ProfileUse, otherwise from loop depth. See Assembler::align_loops().
+  // defined in onejit/x64/compiler.cpp
+  Compiler &align_loops(Func &func, Assembler &assembler, size_t boundary = 32) noexcept;
+
   /// @return the configured checks that compiled code must perform at runtime.
   constexpr Check check() const noexcept {
     return optimizer_.check();
@@ -98,6 +126,15 @@ private:
   Expr compile(Unary expr, Flags flags) noexcept;
   Expr compile(Tuple expr, Flags flags) noexcept;
 
+  // if-conversion: replace (if test (= dst a) (= dst b)) and (if test (= dst a))
+  // with conditional moves. test must be already compiled.
+  // @return false if not possible. In such case, nothing is compiled
+  bool if_convert(Expr test, Node then, Node else_) noexcept;
+
+  // @return true if profile shows that the branch of (if test then else_)
+  // is well predictable, i.e. it should not be if-converted.
+  bool is_biased_if(Label else_label, bool have_else) const noexcept;
+
   Expr simplify_boolean(Op2 op, Expr x, Expr y) noexcept;
   Expr simplify_land(Expr x, Expr y) noexcept;
   Expr simplify_lor(Expr x, Expr y) noexcept;
@@ -148,6 +185,29 @@ private:
   Compiler &add_prologue(Func &func) noexcept;
   Compiler &add_epilogue(Func &func) noexcept;
 
+  // add an increment of the uint64_t counter at specified address
+  Compiler &add_counter(const void *counter) noexcept;
+
+  // @return Profile key of basic block starting with label,
+  // or following a conditional jump to label if after = true
+  size_t profile_key(Label label, bool after) const noexcept;
+
+  // compute Profile keys of basic blocks in flowgraph_. Blocks sharing a key with
+  // a previous block, and blocks not reachable by fallthrough or label, get Profile::NoKey
+  Compiler &profile_keys(Array<size_t> &keys) noexcept;
+
+  // add an increment of the Profile counter at the beginning of each basic block
+  Compiler &add_profile_counters() noexcept;
+
+  // with ProfileUse, fill freq with the execution count of basic blocks divided by
+  // the function invocations: freq[2 * i] for the block starting with the i-th Label,
+  // freq[2 * i + 1] for the block following a conditional jump to the i-th Label.
+  // unknown frequencies are -1. Otherwise, or if no counters were collected, clear freq
+  Compiler &profile_freq(Array<float> &freq) noexcept;
+
+  // move basic blocks that the Profile shows as never executed to the end of compiled code
+  Compiler &layout_cold_blocks() noexcept;
+
   // add an already compiled node to compiled list
   Compiler &add(const Node &node) noexcept;
 
@@ -177,7 +237,13 @@ private:
 private:
   Optimizer optimizer_;
   reg::Allocator allocator_;
+  reg::Liveness liveness_;
   Func *func_;
+  Opt opt_; // optimizations requested to compile(Func)
+  TierCounters *counters_;
+  Profile *profile_;
+  ProfileMode profile_mode_;
+  size_t label_base_; // number of func_->labels() before compile(Func)
 
   Array<Label> break_;       // stack of 'break' destination labels
   Array<Label> continue_;    // stack of 'continue' destination labels
@@ -25,7 +25,9 @@
 
 namespace onejit {
 
-FlowGraph::FlowGraph() noexcept : basicblocks_{}, links_{}, error_{}, label_n_{}, link_avail_{} {
+FlowGraph::FlowGraph() noexcept
+    : basicblocks_{}, links_{}, loop_depth_{}, loop_header_{}, error_{}, label_n_{},
+      link_avail_{} {
 }
 
 FlowGraph::~FlowGraph() noexcept {
@@ -34,6 +36,8 @@ FlowGraph::~FlowGraph() noexcept {
 bool FlowGraph::build(Span<Node> nodes, Array<Error> &error) noexcept {
   basicblocks_.clear();
   links_.clear();
+  loop_depth_.clear();
+  loop_header_.clear();
   error_ = &error;
   link_avail_ = label_n_ = 0;
 
@@ -41,7 +45,7 @@ bool FlowGraph::build(Span<Node> nodes, Array<Error> &error) noexcept {
     return true;
   }
   return build_basicblocks(nodes) && resolve_labels() //
-         && resolve_next() && resolve_prev();
+         && resolve_next() && resolve_prev() && resolve_loops();
 }
 
 bool FlowGraph::is_label(Node node) noexcept {
@@ -163,6 +167,146 @@ bool FlowGraph::resolve_prev() noexcept {
   return true;
 }
 
+bool FlowGraph::resolve_loops() noexcept {
+  const size_t n = basicblocks_.size();
+  const size_t none = size_t(-1);
+  const BasicBlock *bbs = basicblocks_.data();
+  Array<size_t> order, number, idom, mark, worklist;
+  if (!loop_depth_.resize(n) || !order.reserve(n) || !number.resize(n) || !idom.resize(n) ||
+      !mark.resize(n) || !worklist.reserve(2 * n)) {
+    return false;
+  }
+  number.fill(none);
+  idom.fill(none);
+  if (n == 0) {
+    return true;
+  }
+  // compute order = reachable basic blocks in postorder. worklist contains pairs (block, next)
+  number.set(0, 0);
+  worklist.append(0) && worklist.append(0); // cannot fail
+  while (!worklist.empty()) {
+    const size_t i = worklist[worklist.size() - 2];
+    const size_t next = worklist[worklist.size() - 1];
+    Span<BasicBlock *> succ = bbs[i].next();
+    if (next < succ.size()) {
+      worklist.set(worklist.size() - 1, next + 1);
+      const size_t j = succ[next] - bbs;
+      if (number[j] == none) {
+        number.set(j, 0); // visited
+        worklist.append(j) && worklist.append(0); // cannot fail
+      }
+    } else {
+      worklist.truncate(worklist.size() - 2);
+      order.append(i); // cannot fail
+    }
+  }
+  for (size_t k = 0; k < order.size(); k++) {
+    number.set(order[k], k);
+  }
+  // compute immediate dominators with the iterative algorithm of Cooper, Harvey and Kennedy,
+  // visiting basic blocks in reverse postorder. the entry block has the highest number
+  auto intersect = [&](size_t a, size_t b) {
+    while (a != b) {
+      while (number[a] < number[b]) {
+        a = idom[a];
+      }
+      while (number[b] < number[a]) {
+        b = idom[b];
+      }
+    }
+    return a;
+  };
+  idom.set(0, 0);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t k = order.size() - 1; k != 0; k--) {
+      const size_t i = order[k - 1];
+      size_t new_idom = none;
+      for (const BasicBlock *from : bbs[i].prev()) {
+        const size_t p = from - bbs;
+        if (idom[p] != none) {
+          new_idom = new_idom == none ? p : intersect(p, new_idom);
+        }
+      }
+      if (idom[i] != new_idom) {
+        idom.set(i, new_idom);
+        changed = true;
+      }
+    }
+  }
+  auto dominates = [&](size_t a, size_t b) {
+    while (number[b] < number[a]) {
+      b = idom[b];
+    }
+    return a == b;
+  };
+  // mark[i] == header + 1 if i-th basic block was already found inside the loop of header
+  for (size_t header = 0; header < n; header++) {
+    if (idom[header] == none) {
+      continue; // unreachable
+    }
+    for (const BasicBlock *from : bbs[header].prev()) {
+      const size_t tail = from - bbs;
+      if (idom[tail] == none || !dominates(header, tail)) {
+        continue;
+      }
+      // back edge tail -> header: the loop body contains header and all basic blocks
+      // that reach tail without passing through header
+      if (mark[header] != header + 1) {
+        mark.set(header, header + 1);
+        loop_depth_.set(header, loop_depth_[header] + 1);
+        if (!loop_header_.append(uint32_t(header))) {
+          return false;
+        }
+      }
+      worklist.clear();
+      worklist.append(tail); // cannot fail
+      while (!worklist.empty()) {
+        const size_t i = worklist[worklist.size() - 1];
+        worklist.truncate(worklist.size() - 1);
+        if (mark[i] == header + 1) {
+          continue;
+        }
+        mark.set(i, header + 1);
+        loop_depth_.set(i, loop_depth_[i] + 1);
+        for (const BasicBlock *prev : bbs[i].prev()) {
+          const size_t p = prev - bbs;
+          if (mark[p] != header + 1 && idom[p] != none && !worklist.append(p)) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool FlowGraph::block_freq(Array<float> &freq, View<float> label_freq) const noexcept {
+  freq.clear();
+  if (label_freq.empty()) {
+    return true;
+  } else if (!freq.resize(basicblocks_.size())) {
+    return false;
+  }
+  const BasicBlock *bbs = basicblocks_.data();
+  for (size_t i = 0, n = basicblocks_.size(); i < n; i++) {
+    const BasicBlock &bb = bbs[i];
+    // index in label_freq of the block, see Compiler::profile_freq()
+    size_t index = label_freq.size();
+    if (bb.size() != 0 && bb[0].type() == LABEL) {
+      index = bb[0].is<Label>().index() * 2;
+    } else if (i != 0 && bbs[i - 1].size() != 0) {
+      Node jump = bbs[i - 1][bbs[i - 1].size() - 1];
+      if (ir::is_cond_jump(jump)) {
+        index = ir::jump_label(jump).index() * 2 + 1;
+      }
+    }
+    // labels created after Compiler::profile_freq() have no frequency
+    freq.set(i, index < label_freq.size() ? label_freq[index] : -1.0f);
+  }
+  return true;
+}
+
 bool FlowGraph::error(Node where, Chars msg) noexcept {
   if (error_) {
     error_->append(Error{where, msg});
@@ -39,6 +39,24 @@ public:
     return basicblocks_;
   }
 
+  // loop nesting depth of each basic block: 0 = not inside any loop.
+  // loops are found from back edges, i.e. jumps to a basic block that dominates the jump
+  constexpr View<uint32_t> loop_depth() const noexcept {
+    return loop_depth_;
+  }
+
+  // indexes of basic blocks that are loop headers, i.e. destination of at least one back edge.
+  // sorted in increasing order
+  constexpr View<uint32_t> loop_headers() const noexcept {
+    return loop_header_;
+  }
+
+  // fill freq with the execution frequency of each basic block, taken from label_freq
+  // as filled by Compiler::profile_freq(), or -1 if unknown.
+  // leave freq empty if label_freq is empty
+  /// @return false if out of memory
+  bool block_freq(Array<float> &freq, View<float> label_freq) const noexcept;
+
   const Fmt &format(const Fmt &fmt) const;
 
 private:
@@ -52,6 +70,8 @@ private:
   bool resolve_next() noexcept;
   // using basicblocks_[*].next_, compute basicblocks_[*].prev_
   bool resolve_prev() noexcept;
+  // compute dominators of each basic block, then find natural loops and fill loop_depth_
+  bool resolve_loops() noexcept;
 
   static bool is_label(Node node) noexcept;
 
@@ -60,6 +80,8 @@ private:
 
   Array<BasicBlock> basicblocks_;
   Array<BasicBlock *> links_;
+  Array<uint32_t> loop_depth_;  // index is basic block
+  Array<uint32_t> loop_header_; // basic block indexes
   Array<Error> *error_;
   size_t label_n_;
   size_t link_avail_;
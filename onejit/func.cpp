@@ -20,13 +20,15 @@
 namespace onejit {
 
 Func::Func() noexcept //
-    : Base{}, holder_{}, body_var_n_{}, vars_{}, labels_{}, body_{} {
+    : Base{}, holder_{}, body_var_n_{}, compiled_var_n_{}, body_label_n_{}, vars_{}, labels_{},
+      body_{} {
 }
 
 Func &Func::reset(Code *holder, Name name, FuncType ftype) noexcept {
   holder_ = holder;
   body_var_n_ = 0;
   compiled_var_n_ = 0;
+  body_label_n_ = 1;
   vars_.clear();
   labels_.clear();
   body_ = Node{};
@@ -77,6 +79,17 @@ Func &Func::set_compiled(ArchId archid, const Node &compiled) noexcept {
   return *this;
 }
 
+Func &Func::clear_compiled() noexcept {
+  for (size_t i = 0; i < ARCHID_N; i++) {
+    compiled_[i] = Node{};
+  }
+  // drop vars and labels created by compile() and compile_arch()
+  vars_.truncate(body_var_n_);
+  labels_.truncate(body_label_n_);
+  compiled_var_n_ = 0;
+  return *this;
+}
+
 Label Func::new_label() noexcept {
   Label l;
   const size_t i = labels_.size();
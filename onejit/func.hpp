@@ -121,6 +121,7 @@ public:
 
   Func &set_body(const Node &body) noexcept {
     body_var_n_ = vars_.size();
+    body_label_n_ = labels_.size();
     body_ = body;
     return *this;
   }
@@ -129,6 +130,11 @@ public:
 
   Func &set_compiled(ArchId archid, const Node &compiled) noexcept;
 
+  // forget compiled code for all archs, allowing to compile the body again
+  // for example with different optimizations.
+  // also drops the local vars and labels created by compile() and compile_arch()
+  Func &clear_compiled() noexcept;
+
 private:
   // create a new local label, used for jumps within the function
   Label new_label() noexcept;
@@ -146,6 +152,7 @@ private:
   Code *holder_;
   uint32_t body_var_n_;     // # local vars used by body_
   uint32_t compiled_var_n_; // # local vars used by compiled_[NOARCH]
+  uint32_t body_label_n_;   // # local labels used by body_
 
   Array<Var> vars_;
   Array<Label> labels_;
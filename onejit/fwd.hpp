@@ -53,6 +53,7 @@ class Bits;
 class BasicBlock;
 enum Check : uint8_t;
 class Code;
+class CodeCache;
 class CodeParser;
 class Compiler;
 union Float32Bits;
@@ -66,6 +67,7 @@ enum Group : uint8_t;
 class Id;
 class Imm;
 class Kind;
+class Linker;
 class Local;
 enum Op1 : uint16_t;
 enum Op2 : uint16_t;
@@ -78,7 +80,12 @@ enum OpStmt4 : uint16_t;
 enum OpStmtN : uint16_t;
 enum Opt : uint16_t;
 class Optimizer;
+class Profile;
 class Test;
+struct TierCounters;
+class TierPolicy;
+class Tiered;
+class TieredFunc;
 class Value;
 
 using CodeItem = uint32_t;
@@ -52,5 +52,11 @@ const Fmt &Label::format(const Fmt &fmt, Syntax /*syntax*/, size_t /*depth*/) co
   return fmt << type() << '_' << index();
 }
 
+void Label::set_address(uint64_t address) noexcept {
+  if (const Code *holder = code()) {
+    const_cast<Code *>(holder)->set_uint64(offset_or_direct() + sizeof(CodeItem), address);
+  }
+}
+
 } // namespace ir
 } // namespace onejit
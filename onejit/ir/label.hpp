@@ -28,6 +28,7 @@ class Label : public Expr {
   using Base = Expr;
   friend class Node;
   friend class ::onejit::Func;
+  friend class ::onejit::Linker;
 
 public:
   /**
@@ -58,7 +59,7 @@ public:
 
   // 0 if not resolved yet
   uint64_t address() const noexcept {
-    return Base::uint64(offset_or_direct() + sizeof(CodeItem));
+    return Base::uint64(sizeof(CodeItem));
   }
 
   const Fmt &format(const Fmt &fmt, Syntax syntax = Syntax::Default, size_t depth = 0) const;
@@ -80,10 +81,21 @@ private:
 
   /* create a new label. address == 0 means label is not resolved yet */
   static Label create(Code *holder, uint64_t address, uint16_t index) noexcept;
+
+  // set absolute destination address. invoked by Linker
+  void set_address(uint64_t address) noexcept;
 };
 
-// position in Assembler that needs to be filled with Label relative address
+// position in Assembler that needs to be filled with Label address
 struct Relocation {
+  size_t pos;    // end of the 32-bit field to fill, which initially contains an offset to add
+  size_t end;    // end of the instruction containing the field
+  Label label;
+  bool relative; // if true, fill with label address minus end address. otherwise absolute
+};
+
+// position in Assembler where a Label is defined
+struct LabelPos {
   size_t pos;
   Label label;
 };
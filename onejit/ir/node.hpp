@@ -23,6 +23,7 @@
 #include <onejit/ir/syntax.hpp>
 #include <onejit/math.hpp>
 #include <onejit/test.hpp>
+#include <onejit/x64/fwd.hpp>
 
 #include <type_traits> // std::is_base_of<>
 
@@ -56,6 +57,7 @@ class Node {
   friend class ::onejit::CodeParser;
   friend class ::onejit::Func;
   friend class ::onejit::Optimizer;
+  friend class ::onejit::x64::Compiler;
 
   template <class T> friend struct ::std NAMESPACE_NDK ::hash;
 
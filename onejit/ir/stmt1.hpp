@@ -34,6 +34,8 @@ class Stmt1 : public Stmt {
   friend class ::onejit::Func;
   friend class ::onejit::Test;
   friend class x64::Compiler;
+  friend class x64::Isel;
+  friend class x64::Peephole;
   friend class mir::Compiler;
 
 public:
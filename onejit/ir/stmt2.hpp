@@ -37,7 +37,10 @@ class Stmt2 : public Stmt {
   friend class Node;
   friend class ::onejit::Compiler;
   friend class ::onejit::Func;
+  friend class ::onejit::Test;
   friend class x64::Compiler;
+  friend class x64::Isel;
+  friend class x64::Peephole;
   friend class mir::Compiler;
 
 public:
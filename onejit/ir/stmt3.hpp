@@ -23,6 +23,7 @@
 #include <onejit/ir/stmt.hpp>
 #include <onejit/mir/fwd.hpp>
 #include <onejit/opstmt3.hpp>
+#include <onejit/x64/fwd.hpp>
 
 namespace onejit {
 namespace ir {
@@ -32,7 +33,9 @@ class Stmt3 : public Stmt {
   using Base = Stmt;
   friend class Node;
   friend class ::onejit::Compiler;
+  friend class ::onejit::Test;
   friend class mir::Compiler;
+  friend class x64::Isel;
 
 public:
   /**
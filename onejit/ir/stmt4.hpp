@@ -21,6 +21,7 @@
 #include <onejit/ir/stmt.hpp>
 #include <onejit/mir/fwd.hpp>
 #include <onejit/opstmt4.hpp>
+#include <onejit/x64/fwd.hpp>
 
 namespace onejit {
 namespace ir {
@@ -29,8 +30,11 @@ namespace ir {
 class Stmt4 : public Stmt {
   using Base = Stmt;
   friend class Node;
+  friend class ::onejit::Compiler;
   friend class ::onejit::Func;
+  friend class ::onejit::Test;
   friend class mir::Compiler;
+  friend class x64::Compiler;
 
 public:
   /**
@@ -67,7 +71,7 @@ protected:
     return t == STMT_4;
   }
 
-  // used by subclasses and by mir::Compiler
+  // used by subclasses and by compilers
   Stmt4(Func &func, OpStmt4 op, const Node &child0, const Node &child1, //
         const Node &child2, const Node &child3) noexcept
       : Base{create(func, op, child0, child1, child2, child3)} {
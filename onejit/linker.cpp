@@ -0,0 +1,226 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * linker.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/assembler.hpp>
+#include <onejit/codecache.hpp>
+#include <onejit/linker.hpp>
+
+#include <cstring> // std::memcpy()
+
+namespace onejit {
+
+// fill the little-endian 32-bit field at 'field', which contains an offset to add,
+// with the address of a label, optionally relative to 'end'.
+/// @return false if the result does not fit 32 bits
+static bool relocate(uint8_t field[4], uint64_t address, uint64_t end, bool relative) noexcept {
+  const int32_t offset = int32_t(uint32_t(field[0]) | uint32_t(field[1]) << 8 | //
+                                 uint32_t(field[2]) << 16 | uint32_t(field[3]) << 24);
+  const int64_t val = int64_t(address + uint64_t(int64_t(offset)) - (relative ? end : 0));
+  if (val != int64_t(int32_t(val))) {
+    return false;
+  }
+  for (size_t i = 0; i < 4; i++) {
+    field[i] = uint8_t(uint64_t(val) >> (i * 8));
+  }
+  return true;
+}
+
+Linker::Linker(CodeCache &cache) noexcept
+    : cache_{&cache}, func_align_{16}, pending_{}, error_{}, good_{true} {
+}
+
+Linker::~Linker() noexcept {
+}
+
+Linker &Linker::configure_align(size_t func_align) noexcept {
+  if (func_align < 16 || func_align > 4096 || (func_align & (func_align - 1)) != 0) {
+    return error(Node{}, "Linker::configure_align: alignment must be a power of two between 16 "
+                         "and 4096");
+  }
+  func_align_ = func_align;
+  return *this;
+}
+
+void *Linker::link(const Assembler &assembler) noexcept {
+  const Assembler *ptr = &assembler;
+  return link(View<const Assembler *>{&ptr, 1});
+}
+
+void *Linker::link(View<const Assembler *> assemblers) noexcept {
+  const size_t n = assemblers.size();
+  Array<size_t> order, offset;
+  Array<uint8_t> image;
+  size_t total = 0;
+  if (!layout(assemblers, order) || !offset.resize(n)) {
+    out_of_memory(Node{});
+    return nullptr;
+  }
+  for (size_t i = 0; i < n; i++) {
+    const size_t j = order[i];
+    if (!*assemblers[j] || assemblers[j]->errors().size() != 0) {
+      error(Node{}, "cannot link code that has assembler errors");
+      return nullptr;
+    }
+    total = (total + func_align_ - 1) & ~(func_align_ - 1);
+    offset.set(j, total);
+    total += assemblers[j]->size();
+  }
+  if (!image.resize(total)) {
+    out_of_memory(Node{});
+    return nullptr;
+  }
+  // pad between functions with int3
+  Span<uint8_t>{image.data(), total}.fill(0xcc);
+  for (size_t i = 0; i < n; i++) {
+    const Bytes bytes = assemblers[i]->bytes();
+    std::memcpy(image.data() + offset[i], bytes.data(), bytes.size());
+  }
+
+  // CodeCache aligns small code to its size rounded up to a power of two,
+  // and large code to page size: reserving at least func_align_ bytes is enough
+  const size_t reserve = total > func_align_ ? total : func_align_;
+  uint8_t *base = static_cast<uint8_t *>(cache_->alloc(reserve));
+  if (!base) {
+    out_of_memory(Node{});
+    return nullptr;
+  }
+  // labels defined by assemblers must be set before filling relocations
+  for (size_t i = 0; i < n; i++) {
+    CRange<LabelPos> labels = assemblers[i]->labels();
+    for (size_t j = 0; j < labels.size(); j++) {
+      LabelPos l = labels[j];
+      l.label.set_address(uint64_t(size_t(base + offset[i] + l.pos)));
+    }
+  }
+  bool ok = true;
+  for (size_t i = 0; i < n && ok; i++) {
+    CRange<Relocation> relocations = assemblers[i]->relocations();
+    for (size_t j = 0; j < relocations.size() && ok; j++) {
+      const Relocation r = relocations[j];
+      const size_t pos = offset[i] + r.pos - 4;
+      const uint64_t end = uint64_t(size_t(base + offset[i] + r.end));
+      if (const uint64_t address = r.label.address()) {
+        if (!relocate(image.data() + pos, address, end, r.relative)) {
+          error(r.label, "relocation out of range, label address does not fit 32 bits");
+          ok = false;
+        }
+      } else if (!pending_.append(Pending{base + pos, end, r.label, r.relative})) {
+        out_of_memory(r.label);
+        ok = false;
+      }
+    }
+  }
+  if (ok && !cache_->write(base, Bytes{image.data(), total})) {
+    error(Node{}, "failed copying code to executable memory");
+    ok = false;
+  }
+  if (!ok) {
+    for (size_t i = 0; i < n; i++) {
+      CRange<LabelPos> labels = assemblers[i]->labels();
+      for (size_t j = 0; j < labels.size(); j++) {
+        labels[j].label.set_address(0);
+      }
+    }
+    // pending relocations may point into base, forget them
+    size_t j = 0;
+    Pending *data = pending_.data();
+    for (size_t i = 0; i < pending_.size(); i++) {
+      if (size_t(data[i].pos - base) >= total) {
+        data[j++] = data[i];
+      }
+    }
+    pending_.truncate(j);
+    cache_->remove(base);
+    return nullptr;
+  }
+  // code linked before may reference the labels just set
+  link_pending();
+  return base;
+}
+
+bool Linker::layout(View<const Assembler *> assemblers, Array<size_t> &order) noexcept {
+  const size_t n = assemblers.size();
+  Array<Label> entry;
+  Array<bool> placed;
+  Array<size_t> stack;
+  if (!entry.resize(n) || !placed.resize(n) || !order.reserve(n)) {
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    CRange<LabelPos> labels = assemblers[i]->labels();
+    if (labels.size() != 0) {
+      entry.set(i, labels[0].label);
+    }
+  }
+  for (size_t root = 0; root < n; root++) {
+    if (placed[root] || !stack.append(root)) {
+      continue;
+    }
+    while (size_t depth = stack.size()) {
+      const size_t i = stack[depth - 1];
+      stack.truncate(depth - 1);
+      if (placed[i]) {
+        continue;
+      }
+      placed.set(i, true);
+      order.append(i);
+      // push callees in reverse order: the first one called is placed next
+      CRange<Relocation> relocations = assemblers[i]->relocations();
+      for (size_t k = relocations.size(); k != 0; k--) {
+        const Label label = relocations[k - 1].label;
+        for (size_t j = 0; j < n; j++) {
+          if (!placed[j] && entry[j] && entry[j] == label && !stack.append(j)) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return order.size() == n;
+}
+
+void Linker::link_pending() noexcept {
+  Pending *data = pending_.data();
+  size_t j = 0;
+  for (size_t i = 0, n = pending_.size(); i < n; i++) {
+    const Pending p = data[i];
+    const uint64_t address = p.label.address();
+    if (!address) {
+      data[j++] = p;
+      continue;
+    }
+    uint8_t field[4];
+    std::memcpy(field, p.pos, 4);
+    if (!relocate(field, address, p.end, p.relative)) {
+      error(p.label, "relocation out of range, label address does not fit 32 bits");
+    } else if (!cache_->write(p.pos, Bytes{field, 4})) {
+      error(p.label, "failed copying relocation to executable memory");
+    }
+  }
+  pending_.truncate(j);
+}
+
+Linker &Linker::error(Node where, Chars msg) noexcept {
+  good_ = good_ && error_.append(Error{where, msg});
+  return *this;
+}
+
+Linker &Linker::out_of_memory(Node where) noexcept {
+  // always set good_ to false
+  good_ = good_ && error_.append(Error{where, "out of memory"}) && false;
+  return *this;
+}
+
+} // namespace onejit
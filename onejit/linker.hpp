@@ -0,0 +1,111 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * linker.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_LINKER_HPP
+#define ONEJIT_LINKER_HPP
+
+#include <onejit/error.hpp>
+#include <onejit/ir/label.hpp>
+#include <onestl/array.hpp>
+#include <onestl/crange.hpp>
+
+namespace onejit {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// in-memory linker: copies assembled code into a CodeCache,
+// sets the address of each Label defined by the code,
+// and fills the Relocations referencing them.
+//
+// calls between functions use the function address() Label: if the called function
+// is not linked yet, the relocation is remembered and filled when the callee is linked.
+class Linker {
+public:
+  explicit Linker(CodeCache &cache) noexcept;
+
+  Linker(const Linker &other) = delete;
+  Linker &operator=(const Linker &other) = delete;
+
+  ~Linker() noexcept;
+
+  /// @return false if out of memory
+  constexpr explicit operator bool() const noexcept {
+    return good_;
+  }
+
+  // configure the alignment of each linked function, which must be a power of two
+  // between 16 and 4096. default is 16.
+  // it must be at least as large as the alignment requested with Assembler::align_label()
+  Linker &configure_align(size_t func_align) noexcept;
+
+  constexpr size_t func_align() const noexcept {
+    return func_align_;
+  }
+
+  // link a single assembled function.
+  /// @return address of linked code, or nullptr on errors
+  void *link(const Assembler &assembler) noexcept;
+
+  // link several assembled functions into a single contiguous region,
+  // each aligned to func_align() bytes.
+  // they are laid out in depth-first call order starting from assemblers[0]:
+  // each function is followed by the functions it calls, if not already placed,
+  // so that callees sit near their callers.
+  // the address of each function is the address of the first Label it defines.
+  /// @return address of linked region, or nullptr on errors
+  void *link(View<const Assembler *> assemblers) noexcept;
+
+  /// @return number of relocations waiting for their Label to be linked
+  constexpr size_t pending() const noexcept {
+    return pending_.size();
+  }
+
+  /// @return current linker errors
+  constexpr CRange<Error> errors() const noexcept {
+    return CRange<Error>{&error_};
+  }
+
+  // add a linker error
+  Linker &error(Node where, Chars msg) noexcept;
+
+  // add an out of memory error
+  Linker &out_of_memory(Node where) noexcept;
+
+private:
+  // a relocation already copied to CodeCache, waiting for its Label to be linked
+  struct Pending {
+    uint8_t *pos; // start of the 32-bit field to fill
+    uint64_t end; // end address of the instruction containing the field
+    Label label;
+    bool relative;
+  };
+
+  // fill in 'order' the indexes of assemblers, in depth-first call order
+  /// @return false if out of memory
+  bool layout(View<const Assembler *> assemblers, Array<size_t> &order) noexcept;
+
+  // fill the pending relocations whose Label was linked
+  void link_pending() noexcept;
+
+  CodeCache *cache_;
+  size_t func_align_;
+  Array<Pending> pending_;
+  Array<Error> error_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace onejit
+
+#endif // ONEJIT_LINKER_HPP
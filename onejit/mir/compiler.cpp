@@ -95,7 +95,7 @@ Compiler &Compiler::compile(Node node) noexcept {
   case STMT_3:
     return compile(node.is<Stmt3>());
   case STMT_4:
-    return error(node, "unexpected Stmt4");
+    return compile(node.is<Stmt4>());
   case STMT_N:
     return compile(node.is<StmtN>());
   default:
@@ -190,6 +190,33 @@ Compiler &Compiler::compile(Stmt3 st) noexcept {
   }
 }
 
+// ===============================  compile(Stmt4)  ============================
+
+Compiler &Compiler::compile(Stmt4 st) noexcept {
+  const OpStmt4 op = st.op();
+  if (op < ASM_CMOVA || op > ASM_CMOVNE) {
+    return error(st, "unexpected Stmt4");
+  }
+  Expr dst = simplify(st.child_is<Expr>(0), toVar);
+  Expr src = simplify(st.child_is<Expr>(1), toVarOrConst);
+  Expr x = simplify(st.child_is<Expr>(2), toVarOrConst);
+  Expr y = simplify(st.child_is<Expr>(3), toVarOrConst);
+  const Kind kind = dst.kind();
+  const OpStmt3 cmp = mir_compare(op, x.kind());
+  if (cmp == BAD_ST3 || !kind.is_integer_or_ptr()) {
+    return error(st, "unsupported conditional move kind");
+  }
+  // MIR has no conditional move: compute branchless
+  // dst ^= (src ^ dst) & -(x OP y)
+  Var mask{f(), kind};
+  Var tmp{f(), kind};
+  add(Stmt3{f(), cmp, mask, x, y});
+  add(Stmt2{f(), mir_neg(kind), mask, mask});
+  add(Stmt3{f(), mir_arith(XOR_ASSIGN, kind), tmp, src, dst});
+  add(Stmt3{f(), mir_arith(AND_ASSIGN, kind), tmp, tmp, mask});
+  return add(Stmt3{f(), mir_arith(XOR_ASSIGN, kind), dst, dst, tmp});
+}
+
 // ===============================  compile(StmtN)  ============================
 
 Compiler &Compiler::compile(StmtN st) noexcept {
@@ -354,7 +381,8 @@ Expr Compiler::simplify(Binary expr, Expr opt_dst) noexcept {
   if (op >= SUB && op <= SHR) {
     mir_op = mir_arith(op, kind);
   } else if (op >= LSS && op <= GEQ) {
-    mir_op = mir_compare(op, kind);
+    // comparison result is Bool: MIR instruction depends on the compared arguments
+    mir_op = mir_compare(op, x.kind());
   } else {
     error(expr, "unexpected Binary expression operand");
     return Expr{};
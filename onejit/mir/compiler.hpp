@@ -78,6 +78,7 @@ private:
   Compiler &compile(Stmt1 stmt) noexcept;
   Compiler &compile(Stmt2 stmt) noexcept;
   Compiler &compile(Stmt3 stmt) noexcept;
+  Compiler &compile(Stmt4 stmt) noexcept;
   Compiler &compile(StmtN stmt) noexcept;
 
   Expr simplify(Expr expr, Mask mask = toAny, Expr opt_dst = Expr{}) noexcept;
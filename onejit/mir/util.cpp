@@ -17,6 +17,7 @@
 #include <onejit/op.hpp>
 #include <onejit/opstmt2.hpp>
 #include <onejit/opstmt3.hpp>
+#include <onejit/opstmt4.hpp>
 
 namespace onejit {
 namespace mir {
@@ -188,6 +189,29 @@ OpStmt3 mir_compare(Op2 op, Kind kind) noexcept {
   return cmp[op - LSS][mir_kind(kind)];
 }
 
+// convert OpStmt4 ASM_CMOV* conditional move to MIR_* comparison
+OpStmt3 mir_compare(OpStmt4 op, Kind kind) noexcept {
+  static const OpStmt3 cmp_int32[] = {MIR_UGTS, MIR_UGES, MIR_ULTS, MIR_ULES, MIR_EQS,
+                                      MIR_GTS,  MIR_GES,  MIR_LTS,  MIR_LES,  MIR_NES};
+  static const OpStmt3 cmp_int64[] = {MIR_UGT, MIR_UGE, MIR_ULT, MIR_ULE, MIR_EQ,
+                                      MIR_GT,  MIR_GE,  MIR_LT,  MIR_LE,  MIR_NE};
+  if (op < ASM_CMOVA || op > ASM_CMOVNE) {
+    return BAD_ST3;
+  }
+  switch (kind.val()) {
+  case eInt64:
+  case eUint64:
+  case ePtr:
+    return cmp_int64[op - ASM_CMOVA];
+  case eFloat32:
+  case eFloat64:
+  case eFloat128:
+    return BAD_ST3; // not produced by onejit::Compiler
+  default:
+    return cmp_int32[op - ASM_CMOVA];
+  }
+}
+
 // convert Op2 comparison instruction to MIR_* conditional jump
 OpStmt3 mir_jump(Op2 op, Kind kind) noexcept {
   static const OpStmt3 cmp[][7] = {
@@ -47,6 +47,10 @@ OpStmt3 mir_arith(OpStmt2 op, Kind kind) noexcept;
 // convert Op2 comparison instruction to MIR_* instruction
 OpStmt3 mir_compare(Op2 op, Kind kind) noexcept;
 
+// convert OpStmt4 ASM_CMOV* conditional move to the MIR_* comparison
+// that computes its condition. kind is the kind of compared arguments
+OpStmt3 mir_compare(OpStmt4 op, Kind kind) noexcept;
+
 // convert Op2 comparison instruction to MIR_* conditional jump
 OpStmt3 mir_jump(Op2 op, Kind kind) noexcept;
 
@@ -18,6 +18,7 @@
 
 #include <onejit/archid.hpp>
 #include <onejit/code.hpp>
+#include <onejit/codecache.hpp>
 #include <onejit/codeparser.hpp>
 #include <onejit/compiler.hpp>
 #include <onejit/endian.hpp>
@@ -28,6 +29,7 @@
 #include <onejit/mem.hpp>
 #include <onejit/ir.hpp>       // includes all onejit/ir/
 #include <onejit/ir/const.hpp> // redundant
+#include <onejit/linker.hpp>
 #include <onejit/test.hpp>
 // #include <onejit/group.hpp>   // redundant
 // #include <onejit/imm.hpp>     // redundant
@@ -208,6 +208,12 @@ OpStmt3 negate_condjump(OpStmt3 op) noexcept {
   case ASM_JGE:
     op = ASM_JL;
     break;
+  case ASM_JL:
+    op = ASM_JGE;
+    break;
+  case ASM_JLE:
+    op = ASM_JG;
+    break;
   case ASM_JNE:
     op = ASM_JE;
     break;
@@ -247,7 +253,24 @@ const Fmt &operator<<(const Fmt &fmt, OpStmt3 op) {
 
 // ============================  OpStmt4  ======================================
 
-static const Chars op_stmt_4_string[] = {"?", "for"};
+OpStmt4 condjump_to_condmove(OpStmt3 op) noexcept {
+  if (op >= ASM_JA && op <= ASM_JNE) {
+    return ASM_CMOVA + (op - ASM_JA);
+  }
+  return BAD_ST4;
+}
+
+static const Chars op_stmt_4_string[] = { //
+    "?", "for",
+
+#define ONEJIT_X(NAME, name) "asm_" #name,
+    ONEJIT_OPSTMT4_ASM(ONEJIT_X)
+#undef ONEJIT_X
+
+#define ONEJIT_X(NAME, name) "x86_" #name,
+        ONEJIT_OPSTMT4_X86(ONEJIT_X)
+#undef ONEJIT_X
+};
 
 const Chars to_string(OpStmt4 op) noexcept {
   size_t i = 0;
@@ -205,7 +205,22 @@ enum OpStmt2 : uint16_t {
       x(POPCNT, popcnt) /* count bits = 1 */                                                       \
       ONEJIT_COMMENT()  /* [CPUID RTM] is required by the following instructions ------------ */   \
       x(XBEGIN, xbegin) /* start TSX transaction. arg is displacement of code to run on abort.     \
-                           writes %rax */
+                           writes %rax */                                                          \
+      ONEJIT_COMMENT() /* --------------------------------------------------------------------- */ \
+      ONEJIT_COMMENT() /* [CPUID AVX] or [CPUID AVX2] is required by the following ------------ */ \
+      ONEJIT_COMMENT() /* instructions. [CPUID AVX512F] if they use %zmm or %xmm16...31 ------- */ \
+      x(VBROADCASTSD, vbroadcastsd) /* broadcast double from %xmm or memory */                     \
+      x(VBROADCASTSS, vbroadcastss) /* broadcast float from %xmm or memory */                      \
+      x(VMOVAPD, vmovapd)           /* move packed double, aligned memory */                       \
+      x(VMOVAPS, vmovaps)           /* move packed float, aligned memory */                        \
+      x(VMOVDQA, vmovdqa)           /* move packed int, aligned. EVEX: vmovdqa32/64 */             \
+      x(VMOVDQU, vmovdqu)           /* move packed int, unaligned. EVEX: vmovdqu8/16/32/64 */      \
+      x(VMOVUPD, vmovupd)           /* move packed double, unaligned memory */                     \
+      x(VMOVUPS, vmovups)           /* move packed float, unaligned memory */                      \
+      x(VPBROADCASTB, vpbroadcastb) /* broadcast 1 byte from %xmm or memory */                     \
+      x(VPBROADCASTD, vpbroadcastd) /* broadcast 4 bytes from %xmm or memory */                    \
+      x(VPBROADCASTQ, vpbroadcastq) /* broadcast 8 bytes from %xmm or memory */                    \
+      x(VPBROADCASTW, vpbroadcastw) /* broadcast 2 bytes from %xmm or memory */
 
 #define ONEJIT_X(NAME, name) MIR_##NAME,
   ONEJIT_OPSTMT2_MIR(ONEJIT_X)
@@ -173,7 +173,50 @@ enum OpStmt3 : uint16_t {
       ONEJIT_COMMENT()  /* [CPUID SSE4.1] is required by the following instructions ----------- */ \
       x(EXTRACTPS, extractps) /* extract one float from packed floats */                           \
       x(INSERTPS, insertps)   /* insert one float into packed floats */                            \
-      x(PINSR, pinsr)         /* insert 1,2,4 or 8 bytes from register or memory to %xmm */
+      x(PINSR, pinsr)         /* insert 1,2,4 or 8 bytes from register or memory to %xmm */        \
+      ONEJIT_COMMENT() /* --------------------------------------------------------------------- */ \
+      ONEJIT_COMMENT() /* [CPUID AVX] or [CPUID AVX2] is required by the following ------------ */ \
+      ONEJIT_COMMENT() /* instructions. [CPUID AVX512F] if they use %zmm or %xmm16...31 ------- */ \
+      x(VADDPD, vaddpd)       /* add packed double */                                              \
+      x(VADDPS, vaddps)       /* add packed float */                                               \
+      x(VANDPD, vandpd)       /* bitwise AND of packed double */                                   \
+      x(VANDPS, vandps)       /* bitwise AND of packed float */                                    \
+      x(VDIVPD, vdivpd)       /* divide packed double */                                           \
+      x(VDIVPS, vdivps)       /* divide packed float */                                            \
+      x(VMAXPD, vmaxpd)       /* maximum of packed double */                                       \
+      x(VMAXPS, vmaxps)       /* maximum of packed float */                                        \
+      x(VMINPD, vminpd)       /* minimum of packed double */                                       \
+      x(VMINPS, vminps)       /* minimum of packed float */                                        \
+      x(VMULPD, vmulpd)       /* multiply packed double */                                         \
+      x(VMULPS, vmulps)       /* multiply packed float */                                          \
+      x(VORPD, vorpd)         /* bitwise OR of packed double */                                    \
+      x(VORPS, vorps)         /* bitwise OR of packed float */                                     \
+      x(VPADDB, vpaddb)       /* add packed 1-byte int */                                          \
+      x(VPADDD, vpaddd)       /* add packed 4-byte int */                                          \
+      x(VPADDQ, vpaddq)       /* add packed 8-byte int */                                          \
+      x(VPADDW, vpaddw)       /* add packed 2-byte int */                                          \
+      x(VPAND, vpand)         /* bitwise AND of packed int. EVEX: vpandd or vpandq */              \
+      x(VPANDN, vpandn)       /* bitwise AND-NOT of packed int. EVEX: vpandnd or vpandnq */        \
+      x(VPCMPEQB, vpcmpeqb)   /* compare packed 1-byte int for equality. VEX only */               \
+      x(VPCMPEQD, vpcmpeqd)   /* compare packed 4-byte int for equality. VEX only */               \
+      x(VPCMPEQQ, vpcmpeqq)   /* compare packed 8-byte int for equality. VEX only */               \
+      x(VPCMPEQW, vpcmpeqw)   /* compare packed 2-byte int for equality. VEX only */               \
+      x(VPCMPGTB, vpcmpgtb)   /* compare packed signed 1-byte int. VEX only */                     \
+      x(VPCMPGTD, vpcmpgtd)   /* compare packed signed 4-byte int. VEX only */                     \
+      x(VPCMPGTQ, vpcmpgtq)   /* compare packed signed 8-byte int. VEX only */                     \
+      x(VPCMPGTW, vpcmpgtw)   /* compare packed signed 2-byte int. VEX only */                     \
+      x(VPMULLD, vpmulld)     /* multiply packed 4-byte int, keep low half */                      \
+      x(VPMULLW, vpmullw)     /* multiply packed 2-byte int, keep low half */                      \
+      x(VPOR, vpor)           /* bitwise OR of packed int. EVEX: vpord or vporq */                 \
+      x(VPSUBB, vpsubb)       /* subtract packed 1-byte int */                                     \
+      x(VPSUBD, vpsubd)       /* subtract packed 4-byte int */                                     \
+      x(VPSUBQ, vpsubq)       /* subtract packed 8-byte int */                                     \
+      x(VPSUBW, vpsubw)       /* subtract packed 2-byte int */                                     \
+      x(VPXOR, vpxor)         /* bitwise XOR of packed int. EVEX: vpxord or vpxorq */              \
+      x(VSUBPD, vsubpd)       /* subtract packed double */                                         \
+      x(VSUBPS, vsubps)       /* subtract packed float */                                          \
+      x(VXORPD, vxorpd)       /* bitwise XOR of packed double */                                   \
+      x(VXORPS, vxorps)       /* bitwise XOR of packed float */
 
 #define ONEJIT_X(NAME, name) ASM_##NAME,
   ONEJIT_OPSTMT3_ASM(ONEJIT_X)
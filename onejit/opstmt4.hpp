@@ -18,6 +18,7 @@
 
 #include <onejit/fmt.hpp>
 #include <onejit/fwd.hpp>
+#include <onejit/opstmt3.hpp>
 
 #include <cstdint> // uint16_t
 
@@ -27,8 +28,35 @@ enum OpStmt4 : uint16_t {
   BAD_ST4 = 0,
   FOR = 1,
 
-  // numeric values of the OpStmt4 enum constants below this line MAY CHANGE WITHOUT WARNING
+// numeric values of the OpStmt4 enum constants below this line MAY CHANGE WITHOUT WARNING
 
+// (asm_cmovXX dst src x y) means: if (x XX y) { dst = src }
+// same order as ASM_JA ... ASM_JNE
+#define ONEJIT_OPSTMT4_ASM(x)                                                                      \
+  x(/**/ CMOVA, cmova)  /* conditional move if above */                                            \
+      x(CMOVAE, cmovae) /* conditional move if above or equal */                                   \
+      x(CMOVB, cmovb)   /* conditional move if below */                                            \
+      x(CMOVBE, cmovbe) /* conditional move if below or equal */                                   \
+      x(CMOVE, cmove)   /* conditional move if equal */                                            \
+      x(CMOVG, cmovg)   /* conditional move if greater */                                          \
+      x(CMOVGE, cmovge) /* conditional move if greater or equal */                                 \
+      x(CMOVL, cmovl)   /* conditional move if less */                                             \
+      x(CMOVLE, cmovle) /* conditional move if less or equal */                                    \
+      x(CMOVNE, cmovne) /* conditional move if not equal */
+
+// (x86_vcmpXX dst src1 src2 imm8) means: dst = compare(src1, src2) with predicate imm8
+#define ONEJIT_OPSTMT4_X86(x)                                                                      \
+  ONEJIT_COMMENT() /* [CPUID AVX] is required by the following instructions --------------- */     \
+      x(VCMPPD, vcmppd) /* compare packed double. VEX only */                                      \
+      x(VCMPPS, vcmpps) /* compare packed float. VEX only */
+
+#define ONEJIT_X(NAME, name) ASM_##NAME,
+  ONEJIT_OPSTMT4_ASM(ONEJIT_X)
+#undef ONEJIT_X
+
+#define ONEJIT_X(NAME, name) X86_##NAME,
+      ONEJIT_OPSTMT4_X86(ONEJIT_X)
+#undef ONEJIT_X
 };
 
 constexpr inline OpStmt4 operator+(OpStmt4 op, int delta) noexcept {
@@ -38,6 +66,14 @@ constexpr inline OpStmt4 operator-(OpStmt4 op, int delta) noexcept {
   return OpStmt4(int(op) - delta);
 }
 
+/*
+ * convert conditional jump ASM_JA ... ASM_JNE
+ * to the conditional move with the same condition ASM_CMOVA ... ASM_CMOVNE
+ *
+ * other values are converted to BAD_ST4
+ */
+OpStmt4 condjump_to_condmove(OpStmt3 op) noexcept;
+
 const Chars to_string(OpStmt4 op) noexcept;
 
 const Fmt &operator<<(const Fmt &fmt, OpStmt4 op);
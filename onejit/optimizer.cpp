@@ -19,6 +19,7 @@
 #include <onejit/ir/const.hpp>
 #include <onejit/ir/stmt1.hpp>
 #include <onejit/ir/stmt2.hpp>
+#include <onejit/ir/stmt4.hpp>
 #include <onejit/ir/tuple.hpp>
 #include <onejit/ir/unary.hpp>
 #include <onejit/optimizer.hpp>
@@ -27,7 +28,9 @@
 
 namespace onejit {
 
-Optimizer::Optimizer() noexcept : func_{}, nodes_{}, check_{CheckNone}, flags_{OptNone} {
+Optimizer::Optimizer() noexcept
+    : func_{}, nodes_{}, root_{}, var_rank_{}, loop_depth_{}, check_{CheckNone},
+      flags_{OptNone} {
 }
 
 Optimizer::~Optimizer() noexcept {
@@ -50,6 +53,9 @@ Node Optimizer::optimize(Func &func, Node node, Opt flags) noexcept {
   if (func && node && flags != OptNone) {
     func_ = &func;
     nodes_.clear();
+    root_ = node;
+    var_rank_.clear();
+    loop_depth_ = 0;
     flags_ = flags;
     node = optimize(node);
   }
@@ -69,6 +75,12 @@ Node Optimizer::optimize(Node node) noexcept {
     return optimize(node.is<Tuple>(), true);
   }
 
+  const bool is_loop = t == STMT_4 && OpStmt4(node.op()) == FOR &&
+                       (flags_ & (OptReassociate | OptStrengthReduce));
+  if (is_loop) {
+    loop_depth_++;
+    rank_assigned_vars(node);
+  }
   size_t orig_n = nodes_.size();
   Node new_node;
   // use a Range<Node> on nodes_ because a span or view would be invalidated
@@ -78,6 +90,7 @@ Node Optimizer::optimize(Node node) noexcept {
 
   if (!children) {
     nodes_.truncate(orig_n);
+    loop_depth_ -= is_loop;
     return node;
   } else if (Unary unary = node.is<Unary>()) {
     new_node = try_optimize(unary, children);
@@ -91,6 +104,17 @@ Node Optimizer::optimize(Node node) noexcept {
   }
   nodes_.truncate(orig_n);
 
+  if (is_loop) {
+    // strength reduction needs loop_depth_ of this loop to tell invariant expressions
+    if (flags_ & OptStrengthReduce) {
+      For loop = (new_node ? new_node : node).is<For>();
+      if (Node reduced = strength_reduce(loop, node)) {
+        new_node = reduced;
+      }
+    }
+    loop_depth_--;
+  }
+
   return new_node ? new_node : node;
 }
 
@@ -18,6 +18,7 @@
 
 #include <onejit/check.hpp>
 #include <onejit/ir/node.hpp>
+#include <onestl/array.hpp>
 #include <onestl/buffer.hpp>
 #include <onestl/crange.hpp>
 
@@ -33,6 +34,21 @@ enum Opt : uint16_t {
   OptRemoveDeadCode = 1 << 2,
   // treat floating point + and * as associative. requires OptSimplifyExpr
   OptFastMath = 1 << 3,
+  // replace small if-then-else with pure arms by conditional moves
+  OptIfConversion = 1 << 4,
+  // rewrite long chains of associative operations as balanced trees,
+  // grouping loop-invariant operands. requires OptSimplifyExpr
+  OptReassociate = 1 << 5,
+  // replace memory addresses computed from loop induction variables
+  // with pointers incremented at each iteration
+  OptStrengthReduce = 1 << 6,
+  // allocate registers with graph coloring instead of linear scan:
+  // slower, but produces fewer spills
+  OptRegColoring = 1 << 7,
+  // after register allocation, rewrite short sequences of instructions into cheaper ones
+  OptPeephole = 1 << 8,
+  // reorder instructions inside each basic block to hide the latency of loads and multiplications
+  OptSchedule = 1 << 9,
   OptAll = 0xffff,
 };
 
@@ -98,6 +114,27 @@ private:
 
   Expr simplify_comma(Span<Expr> args) noexcept;
 
+  // record in var_rank_ the variables assigned by loop body
+  void rank_assigned_vars(Node node) noexcept;
+  void rank_assigned_var(Expr expr) noexcept;
+  // @return the loop depth where expr value may change, or 0 if loop invariant
+  uint32_t rank(Expr expr) const noexcept;
+  // rewrite associative and commutative Tuple as a balanced tree of binary Tuples.
+  // @return Expr{} if not worth it
+  Expr reassociate(Kind kind, OpN op, Nodes children) noexcept;
+  Expr make_balanced_tuple(Kind kind, OpN op, Nodes children) noexcept;
+
+  // loop strength reduction and linear function test replacement.
+  // defined in optimizer_loop.cpp
+  struct IvAddress;
+  // @return Node{} if loop cannot be optimized
+  Node strength_reduce(For loop, Node orig_loop) noexcept;
+  // find Mem nodes whose address is (+ invariant... iv) or (+ invariant... (* iv scale))
+  bool collect_iv_addresses(Node node, Var iv, Array<IvAddress> &addrs) noexcept;
+  bool match_iv_address(Mem mem, Var iv, IvAddress &addr) noexcept;
+  // replace Mem nodes found by collect_iv_addresses() with (mem ptr offset)
+  Node replace_iv_addresses(Node node, Var iv, const Array<IvAddress> &addrs) noexcept;
+
   // convert configured Check:s to an Allow mask
   // that ignores expressions with side effects
   constexpr Allow allow_mask_pure() const noexcept {
@@ -107,6 +144,9 @@ private:
 private:
   Func *func_;
   Buffer<Node> nodes_;
+  Node root_;                // node passed to optimize(Func, Node)
+  Array<uint32_t> var_rank_; // Var index -> deepest loop assigning it
+  uint32_t loop_depth_;
   Check check_;
   Opt flags_;
 };
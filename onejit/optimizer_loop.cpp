@@ -0,0 +1,294 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * optimizer_loop.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/func.hpp>
+#include <onejit/ir/binary.hpp>
+#include <onejit/ir/const.hpp>
+#include <onejit/ir/mem.hpp>
+#include <onejit/ir/stmt1.hpp>
+#include <onejit/ir/stmt2.hpp>
+#include <onejit/ir/stmt4.hpp>
+#include <onejit/ir/stmtn.hpp>
+#include <onejit/ir/tuple.hpp>
+#include <onejit/ir/var.hpp>
+#include <onejit/optimizer.hpp>
+
+namespace onejit {
+
+// memory address that depends linearly on a loop induction variable
+struct Optimizer::IvAddress {
+  Expr base;     // sum of loop-invariant, non-constant address terms
+  Expr term;     // induction variable term: iv or (* iv scale)
+  int64_t scale; // iv multiplier
+  Var ptr;       // replacement pointer, always equal to base + term
+  size_t uses;   // number of Mem nodes with this address
+  bool costly;   // true if address does not fit x86_64 addressing modes
+};
+
+// if node is (++ iv) or (+= iv step) where iv is a 64-bit integer Var
+// and step is a constant, set iv and step and return true
+static bool basic_induction_var(Node node, Var &iv, int64_t &step) noexcept {
+  while (Block block = node.is<Block>()) {
+    if (block.children() != 1) {
+      return false;
+    }
+    node = block.child(0);
+  }
+  if (Inc inc = node.is<Inc>()) {
+    iv = inc.arg().is<Var>();
+    step = 1;
+  } else if (Assign assign = node.is<Assign>()) {
+    Const c = assign.src().is<Const>();
+    if (assign.op() != ADD_ASSIGN || !c) {
+      return false;
+    }
+    iv = assign.dst().is<Var>();
+    step = c.val().int64();
+  } else {
+    return false;
+  }
+  return iv && (iv.kind() == Int64 || iv.kind() == Uint64) && step > 0;
+}
+
+// return true if node modifies var
+static bool assigns(Node node, Var var) noexcept {
+  const uint32_t n = node.children();
+  switch (node.type()) {
+  case STMT_1:
+    if ((OpStmt1(node.op()) == INC || OpStmt1(node.op()) == DEC) && node.child(0) == var) {
+      return true;
+    }
+    break;
+  case STMT_2:
+    if (node.is<Assign>() && node.child(0) == var) {
+      return true;
+    }
+    break;
+  case STMT_N:
+    if (OpStmtN(node.op()) == ASSIGN_CALL) {
+      for (uint32_t i = 0; i + 1 < n; i++) {
+        if (node.child(i) == var) {
+          return true;
+        }
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = node.child(i);
+    if (child.type() <= STMT_N && assigns(child, var)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// return how many times var appears in node
+static size_t count_uses(Node node, Var var) noexcept {
+  if (node.type() == VAR) {
+    return node == var ? 1 : 0;
+  }
+  size_t count = 0;
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    count += count_uses(node.child(i), var);
+  }
+  return count;
+}
+
+// if expr is iv or (* iv scale) with constant scale, set scale and return true
+static bool is_iv_term(Expr expr, Var iv, int64_t &scale) noexcept {
+  if (expr == iv) {
+    scale = 1;
+    return true;
+  }
+  Tuple tuple = expr.is<Tuple>();
+  if (!tuple || tuple.op() != MUL || tuple.children() != 2 || tuple.arg(0) != iv) {
+    return false;
+  }
+  Const c = tuple.arg(1).is<Const>();
+  if (!c || c.kind().is_float()) {
+    return false;
+  }
+  scale = c.val().int64();
+  return scale > 0;
+}
+
+// replace iv with x in iv term
+static Expr replace_iv(Func &func, Expr term, Expr x) noexcept {
+  if (Tuple tuple = term.is<Tuple>()) {
+    return Tuple{func, tuple.kind(), MUL, {x, tuple.arg(1)}};
+  }
+  return x;
+}
+
+bool Optimizer::match_iv_address(Mem mem, Var iv, IvAddress &addr) noexcept {
+  const uint32_t n = mem.children();
+  Expr bases[2];
+  uint32_t base_n = 0;
+  addr.term = Expr{};
+  addr.uses = 1;
+  addr.costly = false;
+  for (uint32_t i = 0; i < n; i++) {
+    Expr arg = mem.arg(i);
+    int64_t scale;
+    if (arg.type() == CONST) {
+      continue;
+    } else if (!addr.term && is_iv_term(arg, iv, scale)) {
+      addr.term = arg;
+      addr.scale = scale;
+      // x86_64 addressing modes support scale 1, 2, 4, 8
+      addr.costly = addr.costly || (scale != 1 && scale != 2 && scale != 4 && scale != 8);
+    } else if (rank(arg) < loop_depth_ && base_n < 2) {
+      // loop invariant. Anything except a Var must be recomputed at each iteration
+      bases[base_n++] = arg;
+      addr.costly = addr.costly || arg.type() != VAR;
+    } else {
+      return false;
+    }
+  }
+  if (!addr.term || base_n == 0) {
+    return false;
+  }
+  // x86_64 addressing modes support a single base register plus the index
+  addr.costly = addr.costly || base_n > 1;
+  addr.base = base_n == 1 ? bases[0] : Tuple{*func_, Ptr, ADD, {bases[0], bases[1]}};
+  return true;
+}
+
+bool Optimizer::collect_iv_addresses(Node node, Var iv, Array<IvAddress> &addrs) noexcept {
+  if (Mem mem = node.is<Mem>()) {
+    IvAddress addr;
+    if (match_iv_address(mem, iv, addr)) {
+      for (IvAddress &other : addrs) {
+        if (other.scale == addr.scale && other.base.deep_compare(addr.base) == 0) {
+          other.uses++;
+          other.costly = other.costly || addr.costly;
+          return true;
+        }
+      }
+      return addrs.append(addr);
+    }
+  }
+  bool ok = true;
+  for (uint32_t i = 0, n = node.children(); ok && i < n; i++) {
+    ok = collect_iv_addresses(node.child(i), iv, addrs);
+  }
+  return ok;
+}
+
+Node Optimizer::replace_iv_addresses(Node node, Var iv, const Array<IvAddress> &addrs) noexcept {
+  if (Mem mem = node.is<Mem>()) {
+    IvAddress addr;
+    if (match_iv_address(mem, iv, addr)) {
+      for (const IvAddress &other : addrs) {
+        if (other.ptr && other.scale == addr.scale && other.base.deep_compare(addr.base) == 0) {
+          // keep constant offsets: they fold into x86_64 addressing modes
+          Array<Expr> args;
+          bool ok = args.append(other.ptr);
+          for (uint32_t i = 0, n = mem.children(); ok && i < n; i++) {
+            if (mem.arg(i).type() == CONST) {
+              ok = args.append(mem.arg(i));
+            }
+          }
+          return ok ? Mem{*func_, mem.kind(), args} : node;
+        }
+      }
+    }
+  }
+  const uint32_t n = node.children();
+  if (n == 0 || node.type() == VAR) {
+    return node;
+  }
+  Array<Node> children;
+  if (!children.resize(n)) {
+    return node;
+  }
+  bool changed = false;
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = node.child(i);
+    Node new_child = replace_iv_addresses(child, iv, addrs);
+    children.set(i, new_child);
+    changed = changed || child != new_child;
+  }
+  return changed ? Node::create_indirect(*func_, node.header(), children) : node;
+}
+
+Node Optimizer::strength_reduce(For loop, Node orig_loop) noexcept {
+  Var iv;
+  int64_t step;
+  if (!loop || !basic_induction_var(loop.post(), iv, step) || assigns(loop.body(), iv)) {
+    return Node{};
+  }
+  Array<IvAddress> addrs;
+  if (!collect_iv_addresses(loop.body(), iv, addrs) || addrs.size() == 0) {
+    return Node{};
+  }
+  // linear function test replacement: if iv is only used to compute addresses,
+  // compare the first replacement pointer against its final value and remove iv increments
+  size_t mem_n = 0;
+  for (const IvAddress &addr : addrs) {
+    mem_n += addr.uses;
+  }
+  Expr test = loop.test();
+  Binary cmp = test.is<Binary>();
+  const bool lftr = cmp && (cmp.op() == LSS || cmp.op() == LEQ || cmp.op() == NEQ) &&
+                    cmp.x() == iv && rank(cmp.y()) < loop_depth_ &&
+                    count_uses(loop.body(), iv) == mem_n &&
+                    count_uses(root_, iv) == count_uses(orig_loop, iv);
+  bool any = false;
+  for (IvAddress &addr : addrs) {
+    if (lftr || addr.costly) {
+      addr.ptr = Var{*func_, Ptr};
+      any = true;
+      // ptr is modified at each iteration of this loop
+      rank_assigned_var(addr.ptr);
+    }
+  }
+  if (!any) {
+    // addresses already fit x86_64 addressing modes, and iv cannot be removed
+    return Node{};
+  }
+  Node body = replace_iv_addresses(loop.body(), iv, addrs);
+  Array<Node> init, post;
+  bool ok = init.append(loop.init());
+  if (!lftr) {
+    ok = ok && post.append(loop.post());
+  }
+  Var limit;
+  for (const IvAddress &addr : addrs) {
+    if (!addr.ptr) {
+      continue;
+    }
+    ok = ok && init.append(Assign{*func_, ASSIGN, addr.ptr,
+                                  Tuple{*func_, Ptr, ADD, {addr.base, addr.term}}});
+    ok = ok && post.append(Assign{*func_, ADD_ASSIGN, addr.ptr,
+                                  Const{*func_, Value{uint64_t(step * addr.scale)}}});
+    if (lftr && !limit) {
+      limit = Var{*func_, Ptr};
+      Expr end = replace_iv(*func_, addr.term, cmp.y());
+      ok = ok && init.append(
+                     Assign{*func_, ASSIGN, limit, Tuple{*func_, Ptr, ADD, {addr.base, end}}});
+      test = Binary{*func_, cmp.op(), addr.ptr, limit};
+    }
+  }
+  if (!ok) {
+    return Node{};
+  }
+  return For{*func_, Block{*func_, init}, test, Block{*func_, post}, body};
+}
+
+} // namespace onejit
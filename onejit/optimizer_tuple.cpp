@@ -15,6 +15,9 @@
 
 #include <onejit/eval.hpp>
 #include <onejit/ir/const.hpp>
+#include <onejit/ir/stmt1.hpp>
+#include <onejit/ir/stmt2.hpp>
+#include <onejit/ir/stmtn.hpp>
 #include <onejit/ir/tuple.hpp>
 #include <onejit/ir/var.hpp>
 #include <onejit/optimizer.hpp>
@@ -110,6 +113,11 @@ Expr Optimizer::partial_eval_tuple(Tuple expr, Range<Node> &noderange) noexcept
     default:
       break;
     }
+    if ((flags_ & OptReassociate) && n > 2 && op >= ADD && op <= XOR) {
+      if (Expr ret = reassociate(kind, op, children.view(0, n))) {
+        return ret;
+      }
+    }
   }
   if (same_children(expr, children)) {
     return expr;
@@ -117,4 +125,135 @@ Expr Optimizer::partial_eval_tuple(Tuple expr, Range<Node> &noderange) noexcept
   return Tuple{*func_, kind, op, children};
 }
 
+// ===============================  reassociation  =============================
+
+void Optimizer::rank_assigned_var(Expr expr) noexcept {
+  Var var = expr.is<Var>();
+  if (!var || var.id().val() < Id::FIRST) {
+    return;
+  }
+  const size_t index = var.id().val() - Id::FIRST;
+  if (index >= var_rank_.size() && !var_rank_.resize(index + 1)) {
+    return; // out of memory, only affects reassociation quality
+  }
+  if (var_rank_[index] < loop_depth_) {
+    var_rank_.set(index, loop_depth_);
+  }
+}
+
+void Optimizer::rank_assigned_vars(Node node) noexcept {
+  const uint32_t n = node.children();
+  switch (node.type()) {
+  case STMT_1:
+    if (OpStmt1(node.op()) == INC || OpStmt1(node.op()) == DEC) {
+      rank_assigned_var(node.child_is<Expr>(0));
+    }
+    break;
+  case STMT_2:
+    if (Assign assign = node.is<Assign>()) {
+      rank_assigned_var(assign.dst());
+    }
+    break;
+  case STMT_N:
+    if (OpStmtN(node.op()) == ASSIGN_CALL) {
+      // last child is the Call, the others are the assigned places
+      for (uint32_t i = 0; i + 1 < n; i++) {
+        rank_assigned_var(node.child_is<Expr>(i));
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = node.child(i);
+    if (child.type() <= STMT_N) {
+      rank_assigned_vars(child);
+    }
+  }
+}
+
+uint32_t Optimizer::rank(Expr expr) const noexcept {
+  switch (expr.type()) {
+  case VAR: {
+    const uint32_t id = expr.is<Var>().id().val();
+    return id >= Id::FIRST ? var_rank_[id - Id::FIRST] : loop_depth_;
+  }
+  case LABEL:
+  case CONST:
+    return 0;
+  case MEM:
+  case TUPLE:
+    if (expr.type() == MEM || expr.op() == CALL) {
+      // memory contents and function results may change at each loop iteration
+      return loop_depth_;
+    }
+    break;
+  default:
+    break;
+  }
+  uint32_t ret = 0;
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    const uint32_t child_rank = rank(expr.child_is<Expr>(i));
+    ret = child_rank > ret ? child_rank : ret;
+  }
+  return ret;
+}
+
+// children must be sorted as partial_eval_tuple() does, with the optional constant as last
+Expr Optimizer::reassociate(Kind kind, OpN op, Nodes children) noexcept {
+  struct Ranked {
+    uint32_t rank;
+    Node node;
+  };
+  const size_t n = children.size();
+  Array<Ranked> ranked;
+  if (!ranked.resize(n)) {
+    return Expr{};
+  }
+  // the constant is loop invariant: move it first, before the other operands with rank 0
+  size_t start = 0;
+  if (children[n - 1].type() == CONST) {
+    ranked.set(start++, Ranked{0, children[n - 1]});
+  }
+  bool same_rank = true;
+  for (size_t i = 0; start < n; i++) {
+    const uint32_t r = rank(children[i].is<Expr>());
+    same_rank = same_rank && (i == 0 || r == ranked[start - 1].rank);
+    ranked.set(start++, Ranked{r, children[i]});
+  }
+  if (n < 4 && same_rank) {
+    // a balanced tree would have the same depth as the chain
+    return Expr{};
+  }
+  // group operands with the same rank: their partial result is invariant in the inner loops
+  std::stable_sort(ranked.begin(), ranked.end(), //
+                   [](const Ranked &lhs, const Ranked &rhs) { return lhs.rank < rhs.rank; });
+  Array<Node> nodes;
+  if (!nodes.resize(n)) {
+    return Expr{};
+  }
+  for (size_t i = 0; i < n; i++) {
+    nodes.set(i, ranked[i].node);
+  }
+  return make_balanced_tuple(kind, op, nodes);
+}
+
+Expr Optimizer::make_balanced_tuple(Kind kind, OpN op, Nodes children) noexcept {
+  const size_t n = children.size();
+  if (n == 1) {
+    return children[0].is<Expr>();
+  } else if (n == 2) {
+    // put constants as last
+    if (children[0].type() == CONST) {
+      return Tuple{*func_, kind, op, {children[1], children[0]}};
+    }
+    return Tuple{*func_, kind, op, children};
+  }
+  const size_t half = (n + 1) / 2;
+  return Tuple{*func_, kind, op,
+               {make_balanced_tuple(kind, op, children.view(0, half)),
+                make_balanced_tuple(kind, op, children.view(half, n))}};
+}
+
 } // namespace onejit
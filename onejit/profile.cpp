@@ -0,0 +1,39 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * profile.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/profile.hpp>
+
+namespace onejit {
+
+Profile::Profile() noexcept : counts_{}, good_{true} {
+}
+
+Profile::~Profile() noexcept {
+}
+
+Profile &Profile::clear() noexcept {
+  for (size_t i = 0, n = counts_.size(); i < n; i++) {
+    counts_.set(i, 0);
+  }
+  return *this;
+}
+
+bool Profile::reset(size_t label_n) noexcept {
+  counts_.clear();
+  good_ = counts_.resize(key_at(label_n));
+  return good_;
+}
+
+} // namespace onejit
@@ -0,0 +1,114 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * profile.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_PROFILE_HPP
+#define ONEJIT_PROFILE_HPP
+
+#include <onejit/fwd.hpp>
+#include <onestl/array.hpp>
+
+namespace onejit {
+
+enum ProfileMode : uint8_t {
+  ProfileNone = 0,
+  // compiled code increments the execution counter of each basic block
+  ProfileCollect = 1,
+  // previously collected counters guide the optimizations
+  ProfileUse = 2,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// execution counters of the basic blocks of a function.
+//
+// Filled by code compiled after Compiler::configure_profile(&profile, ProfileCollect),
+// then used by the next compile of the same function, after
+// Compiler::configure_profile(&profile, ProfileUse), to tune block layout,
+// if-conversion and register allocation.
+//
+// Each basic block is identified by the Label it starts with or, if it has none,
+// by the Label targeted by the conditional jump that precedes it.
+// Labels are numbered relative to the first Label created by each compile:
+// a Profile remains valid across compiles of the same function body.
+class Profile {
+  friend class Compiler;
+  friend class Test;
+
+public:
+  Profile() noexcept;
+
+  Profile(Profile &&other) noexcept = default;
+  Profile &operator=(Profile &&other) noexcept = default;
+
+  ~Profile() noexcept;
+
+  /// @return false if out of memory
+  explicit operator bool() const noexcept {
+    return good_;
+  }
+
+  /// @return false if no counters were collected yet
+  bool empty() const noexcept {
+    return entry() == 0;
+  }
+
+  /// @return how many times the function was invoked
+  uint64_t entry() const noexcept {
+    return counts_.size() != 0 ? counts_[0] : 0;
+  }
+
+  /// @return raw counters. They are incremented by jit-compiled code,
+  /// thus they must not be resized while such code may run.
+  constexpr View<uint64_t> counts() const noexcept {
+    return counts_;
+  }
+
+  // set all counters to zero
+  Profile &clear() noexcept;
+
+private:
+  enum : size_t { NoKey = ~size_t(0) };
+
+  // resize counters to accommodate 'label_n' labels
+  // and set them to zero. @return false if out of memory
+  bool reset(size_t label_n) noexcept;
+
+  /// @return key of basic block starting with label having relative index 'label_rel'
+  static constexpr size_t key_at(size_t label_rel) noexcept {
+    return label_rel * 2;
+  }
+
+  /// @return key of label-less basic block following
+  /// a conditional jump to label having relative index 'label_rel'
+  static constexpr size_t key_after(size_t label_rel) noexcept {
+    return label_rel * 2 + 1;
+  }
+
+  /// @return counter with specified key, or 0 if key is out of range
+  uint64_t count(size_t key) const noexcept {
+    return key < counts_.size() ? counts_[key] : 0;
+  }
+
+  // address of counter with specified key
+  uint64_t *counter(size_t key) noexcept {
+    return key < counts_.size() ? &counts_.data()[key] : nullptr;
+  }
+
+  Array<uint64_t> counts_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace onejit
+
+#endif // ONEJIT_PROFILE_HPP
@@ -13,17 +13,30 @@
  *      Author Massimiliano Ghilardi
  */
 
+#include <onejit/algorithm.hpp>
+#include <onejit/mem.hpp>
 #include <onejit/reg/allocator.hpp>
 
+#include <algorithm>
+#include <cstring>    // std::memcpy
+#include <functional> // std::greater
+#include <limits>
+
 namespace onejit {
 namespace reg {
 
-Allocator::Allocator() noexcept : g_{}, g2_{}, stack_{}, colors_{} {
+Allocator::Allocator() noexcept
+    : g_{}, degree_{}, stack_{}, weights_{}, active_{}, intervals_{}, moves_{}, alias_{},
+      partner_{}, slot_end_{}, hints_{}, classes_{}, forbidden_{}, num_colors_{}, colors_{} {
 }
 
-Allocator::Allocator(Size num_regs) noexcept         //
-    : g_{num_regs}, g2_{num_regs}, stack_{num_regs}, //
-      hints_{}, colors_{num_regs}, avail_colors_{num_regs} {
+Allocator::Allocator(Size num_regs) noexcept                                      //
+    : g_{num_regs}, degree_{num_regs}, stack_{num_regs}, weights_{}, active_{}, //
+      intervals_{}, moves_{}, alias_{num_regs}, partner_{num_regs}, slot_end_{},  //
+      hints_{}, classes_{}, forbidden_{}, num_colors_{}, colors_{num_regs},          //
+      avail_colors_{num_regs} {
+  active_.reserve(num_regs);
+  slot_end_.reserve(num_regs);
   hints_.reserve(num_regs);
 }
 
@@ -32,8 +45,14 @@ Allocator::~Allocator() noexcept {
 
 bool Allocator::reset(Size num_regs) noexcept {
   hints_.clear();
-  return g_.reset(num_regs) && g2_.reset(num_regs)              //
-         && stack_.resize(num_regs) && hints_.reserve(num_regs) //
+  moves_.clear();
+  weights_.clear();
+  classes_.clear();
+  forbidden_.clear();
+  return g_.reset(num_regs) && degree_.resize(num_regs)             //
+         && alias_.resize(num_regs) && partner_.resize(num_regs)    //
+         && stack_.resize(num_regs) && active_.reserve(num_regs)    //
+         && slot_end_.reserve(num_regs) && hints_.reserve(num_regs) //
          && colors_.resize(num_regs) && avail_colors_.resize(num_regs);
 }
 
@@ -45,85 +64,340 @@ void Allocator::add_hint(Reg reg, Color color) noexcept {
   hints_.set(reg, color);
 }
 
-void Allocator::allocate_regs(Color num_colors) noexcept {
-  init();
+void Allocator::set_class(Reg reg, RegClass cls) noexcept {
+  if (!classes_) {
+    if (cls == 0) {
+      return;
+    }
+    classes_.resize(size()); // cannot fail
+    classes_.fill(0);
+  }
+  classes_.set(reg, cls);
+}
+
+void Allocator::forbid_colors(Reg reg, uint64_t colors) noexcept {
+  if (!forbidden_) {
+    if (colors == 0) {
+      return;
+    }
+    forbidden_.resize(size()); // cannot fail
+    forbidden_.fill(0);
+  }
+  forbidden_.set(reg, forbidden_[reg] | colors);
+}
+
+static inline bool is_forbidden(uint64_t forbidden, Color color) noexcept {
+  return color < 64 && ((forbidden >> color) & 1) != 0;
+}
+
+// return the number of colors in the bitmask 'colors'
+static inline Color count_colors(uint64_t colors) noexcept {
+  Color count = 0;
+  for (; colors != 0; colors &= colors - 1) {
+    count++;
+  }
+  return count;
+}
+
+Color Allocator::available_colors(Reg reg) const noexcept {
+  const Color n = num_colors(reg);
+  return n - min2(n, count_colors(forbidden_colors(reg)));
+}
+
+void Allocator::add_move(Reg dst, Reg src) noexcept {
+  if (dst != src && dst < size() && src < size()) {
+    moves_.append(dst) && moves_.append(src);
+  }
+}
+
+Degree Allocator::degree(Reg reg) const noexcept {
+  // self-connections count as two edges
+  return g_.degree(reg) - (g_(reg, reg) ? 2 : 0);
+}
+
+Reg Allocator::find(Reg reg) noexcept {
+  Reg *alias = alias_.data();
+  while (alias[reg] != reg) {
+    // path halving
+    reg = alias[reg] = alias[alias[reg]];
+  }
+  return reg;
+}
+
+void Allocator::init_moves() noexcept {
+  for (Reg reg = 0, n = size(); reg < n; ++reg) {
+    alias_.set(reg, reg);
+    partner_.set(reg, NoReg);
+  }
+}
+
+void Allocator::coalesce() noexcept {
+  for (size_t i = 0, n = moves_.size(); i + 1 < n; i += 2) {
+    Reg a = find(moves_[i]), b = find(moves_[i + 1]);
+    if (a == b || g_(a, b) || get_class(a) != get_class(b)) {
+      continue;
+    } else if (hints_ && hints_[a] != NoColor && hints_[b] != NoColor && hints_[a] != hints_[b]) {
+      // cannot satisfy both hints
+      continue;
+    } else if (forbidden_colors(a) != forbidden_colors(b)) {
+      // a and b were probably split around a call on purpose: keep them separate
+      continue;
+    } else if (a > b) {
+      mem::swap(a, b);
+    }
+    if (briggs(a, b) || george(a, b) || george(b, a)) {
+      merge(a, b);
+    }
+  }
+}
+
+void Allocator::link_partners() noexcept {
+  for (size_t i = 0, n = moves_.size(); i + 1 < n; i += 2) {
+    Reg a = find(moves_[i]), b = find(moves_[i + 1]);
+    if (a != b && get_class(a) == get_class(b)) {
+      if (partner_[a] == NoReg) {
+        partner_.set(a, b);
+      }
+      if (partner_[b] == NoReg) {
+        partner_.set(b, a);
+      }
+    }
+  }
+}
+
+bool Allocator::briggs(Reg a, Reg b) const noexcept {
+  Size significant = 0;
+  for (Reg t : g_.neighbors(a)) {
+    if (t != a) {
+      // neighbors of both a and b lose one edge after merging
+      significant += degree(t) - Degree(g_(t, b)) >= available_colors(t);
+    }
+  }
+  for (Reg t : g_.neighbors(b)) {
+    if (t != b && !g_(t, a)) {
+      significant += degree(t) >= available_colors(t);
+    }
+  }
+  // the merged register cannot use the colors forbidden to either a or b
+  return significant + count_colors(forbidden_colors(a) | forbidden_colors(b)) < num_colors(a);
+}
+
+bool Allocator::george(Reg a, Reg b) const noexcept {
+  for (Reg t : g_.neighbors(b)) {
+    if (t != b && !g_(t, a) && degree(t) >= available_colors(t)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Allocator::merge(Reg a, Reg b) noexcept {
+  // copy neighbors of b: g_.set() invalidates g_.neighbors()
+  // stack_ is free to be used as buffer until init() is called
+  stack_.clear();
+  for (Reg t : g_.neighbors(b)) {
+    if (t != b) {
+      stack_.append(t); // cannot fail
+    }
+  }
+  for (Reg t : stack_) {
+    g_.set(a, t, true);
+  }
+  g_.remove(b);
+  alias_.set(b, a);
+  if (hints_ && hints_[a] == NoColor) {
+    hints_.set(a, hints_[b]);
+  }
+  if (forbidden_) {
+    forbidden_.set(a, forbidden_[a] | forbidden_[b]);
+  }
+  if (weights_.size() == size()) {
+    // spilling a also spills every read and write of b
+    weights_.set(a, weights_[a] + weights_[b]);
+  }
+}
+
+Color Allocator::partner_color(Reg reg) const noexcept {
+  Reg partner = moves_ ? partner_[reg] : NoReg;
+  return partner != NoReg ? colors_[partner] : NoColor;
+}
+
+void Allocator::split_classes() noexcept {
+  // stack_ is free to be used as buffer until init() is called
+  for (Reg reg = 0, n = size(); reg < n; ++reg) {
+    stack_.clear();
+    for (Reg t : g_.neighbors(reg)) {
+      if (get_class(t) != get_class(reg)) {
+        stack_.append(t); // cannot fail
+      }
+    }
+    for (Reg t : stack_) {
+      g_.set(reg, t, false);
+    }
+  }
+}
+
+bool Allocator::allocate_regs(Color num_colors) noexcept {
+  return allocate_regs(View<Color>{&num_colors, 1});
+}
+
+bool Allocator::allocate_regs(View<Color> num_colors) noexcept {
+  num_colors_ = num_colors.data();
+  init_moves();
+  if (classes_) {
+    split_classes();
+  }
+  if (moves_) {
+    coalesce();
+    link_partners();
+  }
+  if (!init()) {
+    return false;
+  }
   for (;;) {
     Reg reg;
-    while ((reg = find_degree_less_than(num_colors)) != NoReg) {
-      stack_.append(reg); // cannot fail
-      g_.remove(reg);
+    while ((reg = find_degree_less_than()) != NoReg) {
+      remove(reg);
     }
     if ((reg = pick()) == NoReg) {
       break;
     }
-    stack_.append(reg); // cannot fail
-    g_.remove(reg);
+    remove(reg);
   }
-  assign_colors(num_colors);
+  assign_colors();
+  avail_colors_.truncate(size());
+  for (Reg reg = 0, n = size(); reg < n; ++reg) {
+    if (alias_[reg] != reg) {
+      colors_.set(reg, colors_[find(reg)]);
+    }
+  }
+  return true;
+}
+
+uint64_t Allocator::high_key(Reg reg, Degree degree) const noexcept {
+  // spill cost is weight / degree: store its inverse degree / weight,
+  // because high_ is a max-heap. Without weights, it reduces to the degree.
+  // non-negative floats have the same ordering as their bit patterns
+  float inverse_cost = float(degree);
+  if (weights_.size() == size()) {
+    const float weight = weights_[reg];
+    inverse_cost = weight > 0.0f ? inverse_cost / weight : std::numeric_limits<float>::infinity();
+  }
+  uint32_t bits;
+  std::memcpy(&bits, &inverse_cost, sizeof(bits));
+  return uint64_t(bits) << 32 | ~reg;
 }
 
-void Allocator::init() noexcept {
+bool Allocator::init() noexcept {
   stack_.clear();
+  low_.clear();
+  high_.clear();
+  // each reg enters high_ at most once per degree it has while >= its num_colors,
+  // and removing a reg decrements the degree of each remaining neighbor:
+  // high_ never contains more than num_regs + num_edges entries
+  size_t degrees = 0;
   for (Reg reg = 0, n = size(); reg < n; ++reg) {
-    // add self-connections: needed to have g_.degree(reg) != 0
-    // even after removing all other regs from g_
-    g_.set(reg, reg, true);
+    // coalesced registers are not colored: they copy the color of their alias
+    Degree deg = alias_[reg] == reg ? degree(reg) : NoDegree;
+    degree_.set(reg, deg);
     colors_.set(reg, NoColor);
+    degrees += alias_[reg] == reg ? deg : 0;
+  }
+  if (!low_.reserve(size()) || !high_.reserve(size() + degrees / 2)) {
+    return false;
+  }
+  // a reg may have up to 64 forbidden colors in addition to its neighbors' colors:
+  // make room for a spill color above both
+  if (forbidden_ && !avail_colors_.resize(size() + 64)) {
+    return false;
+  }
+  for (Reg reg = 0, n = size(); reg < n; ++reg) {
+    if (alias_[reg] == reg) {
+      push(reg);
+    }
   }
-  g2_.dup(g_); // cannot fail
+  return true;
 }
 
-Reg Allocator::find_degree_less_than(Degree degree) const noexcept {
-  for (Reg i = 0, n = size(); i < n; i++) {
-    Degree deg_i = g_.degree(i);
-    // deg_i is increased by 2 due to self-connections
-    if (deg_i >= 2 && deg_i < 2 + Degree(degree)) {
-      return Reg(i);
-    }
+void Allocator::push(Reg reg) noexcept {
+  Degree degree = degree_[reg];
+  if (degree < available_colors(reg)) {
+    low_.append(reg); // cannot fail
+    std::push_heap(low_.begin(), low_.end(), std::greater<Reg>());
+  } else {
+    high_.append(high_key(reg, degree)); // cannot fail
+    std::push_heap(high_.begin(), high_.end());
   }
-  return NoReg;
 }
 
-// pick a register in g_ to be spilled. currently picks the register with highest degree
-Reg Allocator::pick() const noexcept {
-  Reg reg = NoReg;
-  Degree deg = 0;
-  for (Reg i = 0, n = size(); i < n; i++) {
-    Degree deg_i = g_.degree(i);
-    if (deg_i > deg) {
-      reg = i;
-      deg = deg_i;
+void Allocator::remove(Reg reg) noexcept {
+  stack_.append(reg); // cannot fail
+  degree_.set(reg, NoDegree);
+  for (Reg neighbor : g_.neighbors(reg)) {
+    Degree degree = degree_[neighbor];
+    if (degree != NoDegree) {
+      degree_.set(neighbor, --degree);
+      // a neighbor with degree < num_colors - 1 is already in low_
+      if (degree + 1 >= available_colors(neighbor)) {
+        push(neighbor);
+      }
     }
   }
+}
+
+Reg Allocator::find_degree_less_than() noexcept {
+  // registers in low_ are never removed by pick(): it is called only when low_ is empty
+  if (low_.empty()) {
+    return NoReg;
+  }
+  std::pop_heap(low_.begin(), low_.end(), std::greater<Reg>());
+  Reg reg = low_[low_.size() - 1];
+  low_.truncate(low_.size() - 1);
   return reg;
 }
 
-void Allocator::assign_colors(Color num_colors) noexcept {
+Reg Allocator::pick() noexcept {
+  while (!high_.empty()) {
+    std::pop_heap(high_.begin(), high_.end());
+    uint64_t key = high_[high_.size() - 1];
+    high_.truncate(high_.size() - 1);
+    Reg reg = ~Reg(key);
+    // skip stale entries, left behind when the degree of reg changed
+    const Degree degree = degree_[reg];
+    if (degree != NoDegree && high_key(reg, degree) == key) {
+      return reg;
+    }
+  }
+  return NoReg;
+}
+
+void Allocator::assign_colors() noexcept {
   for (Size n = stack_.size(), i = n; i != 0; i--) {
     Reg reg = stack_[i - 1];
+    const Color num_colors = this->num_colors(reg);
 
     // initialize the list of available colors
     avail_colors_.fill(true);
 
-    // add back reg i.e. check which neighbors have been added already
-    // and connect reg to them
-    Reg neighbor = 0;
-    while ((neighbor = g2_.first_set(reg, neighbor)) != NoReg) {
-      // if neighbor is already in g_, reconnect it to reg
-      // and mark its color as occupied
-      if (g_.degree(neighbor) != 0) {
-        g_.set(reg, neighbor, true);
-        avail_colors_.set(colors_[neighbor], false);
+    // neighbors popped from stack_ before reg are exactly the colored ones:
+    // mark their colors as occupied
+    for (Reg neighbor : g_.neighbors(reg)) {
+      Color neighbor_color = colors_[neighbor];
+      if (neighbor_color != NoColor) {
+        avail_colors_.set(neighbor_color, false);
+      }
+    }
+    if (const uint64_t forbidden = forbidden_colors(reg)) {
+      for (Color c = 0, end = min2(Color(64), Color(avail_colors_.size())); c < end; c++) {
+        if (is_forbidden(forbidden, c)) {
+          avail_colors_.set(c, false);
+        }
       }
-      ++neighbor;
     }
-    // add self-connection: needed to guarantee degree(reg) != 0
-    // which is used in the while() above to check whether reg is present in g_
-    g_.set(reg, reg, true);
 
     // use lowest available color. it may be >= num_colors i.e. spilled
     Color color = avail_colors_.find(true);
-    if (hints_) {
+    if (hints_ || moves_) {
       Color alt_color = try_satisfy_hints(reg);
       if (alt_color != NoColor && (alt_color < num_colors || color >= num_colors)) {
         color = alt_color;
@@ -134,25 +408,147 @@ void Allocator::assign_colors(Color num_colors) noexcept {
 }
 
 Color Allocator::try_satisfy_hints(Reg reg) noexcept {
-  Color hint_color = hints_[reg];
+  Color hint_color = hints_ ? hints_[reg] : NoColor;
   // if a hint for this reg is present, try to honor it
   if (hint_color != NoColor && avail_colors_[hint_color]) {
     return hint_color;
   }
+  // if reg is copied from or to an already colored reg, try to use the same color:
+  // the move will become redundant
+  Color move_color = partner_color(reg);
+  if (move_color != NoColor && avail_colors_[move_color]) {
+    return move_color;
+  } else if (!hints_) {
+    return avail_colors_.find(true);
+  }
 
   // if a hint for a connected reg is present, try not to clobber it
-  Reg neighbor = 0;
-  while ((neighbor = g2_.first_set(reg, neighbor)) != NoReg) {
+  for (Reg neighbor : g_.neighbors(reg)) {
     if (colors_[neighbor] == NoColor) {
       Color hint_neighbor_color = hints_[neighbor];
       if (hint_neighbor_color != NoColor) {
         avail_colors_.set(hint_neighbor_color, false);
       }
     }
-    ++neighbor;
   }
   return avail_colors_.find(true);
 }
 
+void Allocator::linear_scan(Color num_colors) noexcept {
+  linear_scan(View<Color>{&num_colors, 1});
+}
+
+void Allocator::linear_scan(View<Color> num_colors) noexcept {
+  num_colors_ = num_colors.data();
+  init_moves();
+  link_partners();
+  for (Reg reg = 0, n = size(); reg < n; reg++) {
+    if (reg < intervals_.size() && intervals_[reg].start < intervals_[reg].end) {
+      colors_.set(reg, NoColor);
+    } else {
+      // reg is never live: any color will do
+      Color hint = hints_ ? hints_[reg] : NoColor;
+      colors_.set(reg, hint < this->num_colors(reg) ? hint : 0);
+    }
+  }
+  for (RegClass cls = 0; cls < num_colors.size(); cls++) {
+    linear_scan_class(cls, num_colors[cls]);
+  }
+}
+
+void Allocator::linear_scan_class(RegClass cls, Color num_colors) noexcept {
+  const Interval *intervals = intervals_.data();
+  stack_.clear();
+  active_.clear();
+  slot_end_.clear();
+  avail_colors_.fill(true);
+  for (Reg reg = 0, n = size(); reg < n; reg++) {
+    if (colors_[reg] == NoColor && get_class(reg) == cls) {
+      stack_.append(reg); // cannot fail
+    }
+  }
+  std::sort(stack_.begin(), stack_.end(), [intervals](Reg a, Reg b) {
+    return intervals[a].start < intervals[b].start ||
+           (intervals[a].start == intervals[b].start && a < b);
+  });
+  for (Reg reg : stack_) {
+    const Interval &interval = intervals[reg];
+    // expire intervals that end before reg starts, and release their colors
+    Size i = active_.size();
+    while (i != 0 && intervals[active_[i - 1]].end <= interval.start) {
+      Color color = colors_[active_[--i]];
+      if (color < num_colors) {
+        avail_colors_.set(color, true);
+      }
+    }
+    active_.truncate(i);
+
+    Color color = linear_scan_color(reg, num_colors);
+    if (color < num_colors) {
+      avail_colors_.set(color, false);
+    }
+    colors_.set(reg, color);
+
+    // insert reg into active_, keeping it sorted by decreasing interval end
+    active_.append(reg); // cannot fail
+    Reg *active = active_.data();
+    for (i = active_.size() - 1; i != 0 && intervals[active[i - 1]].end < interval.end; i--) {
+      active[i] = active[i - 1];
+    }
+    active[i] = reg;
+  }
+}
+
+Color Allocator::linear_scan_color(Reg reg, Color num_colors) noexcept {
+  const uint64_t forbidden = forbidden_colors(reg);
+  auto usable = [&](Color color) {
+    return color < num_colors && avail_colors_[color] && !is_forbidden(forbidden, color);
+  };
+  if (hints_ && usable(hints_[reg])) {
+    return hints_[reg];
+  }
+  Color move_color = partner_color(reg);
+  if (usable(move_color)) {
+    return move_color;
+  }
+  for (Color color = 0; color < num_colors; color++) {
+    if (usable(color)) {
+      return color;
+    }
+  }
+  // no free color: spill the register whose interval ends last,
+  // either reg itself or the first active one not already spilled
+  // and whose color is not forbidden to reg
+  const Interval *intervals = intervals_.data();
+  for (Reg other : active_) {
+    if (intervals[other].end <= intervals[reg].end) {
+      break;
+    }
+    Color other_color = colors_[other];
+    if (other_color < num_colors && !is_forbidden(forbidden, other_color)) {
+      // steal the color of other
+      colors_.set(other, spill_color(other, num_colors));
+      return other_color;
+    }
+  }
+  return spill_color(reg, num_colors);
+}
+
+Color Allocator::spill_color(Reg reg, Color num_colors) noexcept {
+  // spilled registers keep their color for their whole interval,
+  // thus the color must be free since the interval start, not only from now on
+  const Interval &interval = intervals_[reg];
+  Size i = 0, n = slot_end_.size();
+  while (i < n && slot_end_[i] > interval.start) {
+    i++;
+  }
+  if (i == n) {
+    slot_end_.append(interval.end); // cannot fail
+  } else {
+    slot_end_.set(i, interval.end);
+  }
+  return Color(num_colors + i);
+}
+
 } // namespace reg
 } // namespace onejit
@@ -24,7 +24,8 @@
 namespace onejit {
 namespace reg {
 
-// register allocator. uses register interference graph and Chaitin algorithm.
+// register allocator. uses either register interference graph and Chaitin algorithm,
+// or live intervals and linear scan algorithm.
 class Allocator {
 
 public:
@@ -57,16 +58,78 @@ public:
     return g_;
   }
 
+  // live intervals used by linear_scan(), index is reg.
+  // usually filled by Liveness::fill_intervals()
+  Array<Interval> &intervals() {
+    return intervals_;
+  }
+
+  constexpr View<Interval> intervals() const {
+    return intervals_;
+  }
+
+  // spill weights used by allocate_regs(), index is reg.
+  // usually filled by Liveness::fill_weights(). If empty, all registers weigh the same.
+  // reset() clears them.
+  Array<float> &weights() {
+    return weights_;
+  }
+
+  constexpr View<float> weights() const {
+    return weights_;
+  }
+
+  // set the register class of reg. registers of different classes never share colors
+  // even if they interfere, and each class has its own number of colors.
+  // all registers are in class 0 in newly-constructed instances, and reset() restores it.
+  void set_class(Reg reg, RegClass cls) noexcept;
+
+  /// @return register class of reg
+  RegClass get_class(Reg reg) const noexcept {
+    return classes_ ? classes_[reg] : 0;
+  }
+
   // enable hints and store preferred Reg->Color into them.
+  // each hint must be a color of the register class
   // Note: hints are disabled in newly-constructed instances,
   // and reset() disables them too.
   void add_hint(Reg reg, Color color) noexcept;
 
-  // choose a color for each Reg present in graph()
-  void allocate_regs(Color num_colors) noexcept;
+  // forbid reg from receiving the colors whose bit is set in 'colors',
+  // for example because reg is live across a call that clobbers them.
+  // only colors < 64 can be forbidden. reset() clears all forbidden colors.
+  void forbid_colors(Reg reg, uint64_t colors) noexcept;
+
+  /// @return colors that reg cannot receive, as a bitmask
+  uint64_t forbidden_colors(Reg reg) const noexcept {
+    return forbidden_ ? forbidden_[reg] : 0;
+  }
+
+  // record that a move copies src into dst.
+  // allocate_regs() coalesces dst and src if it can do so conservatively,
+  // i.e. merges them into a single node of graph(), otherwise both allocate_regs()
+  // and linear_scan() try to assign them the same color. reset() forgets all moves.
+  void add_move(Reg dst, Reg src) noexcept;
+
+  // choose a color for each Reg present in graph(), all registers being in class 0
+  /// @return false if out of memory
+  bool allocate_regs(Color num_colors) noexcept;
+
+  // choose a color for each Reg present in graph().
+  // registers of class cls receive colors < num_colors[cls], unless spilled
+  /// @return false if out of memory
+  bool allocate_regs(View<Color> num_colors) noexcept;
+
+  // choose a color for each Reg, using intervals() instead of graph().
+  // faster than allocate_regs(), because it visits each interval once,
+  // but intervals overestimate liveness and may cause more spills.
+  void linear_scan(Color num_colors) noexcept;
+
+  // same as linear_scan(Color), with num_colors[cls] colors for registers of class cls
+  void linear_scan(View<Color> num_colors) noexcept;
 
   /// @return colors chosen by allocate_regs()
-  // spilled Regs will have color >= num_colors
+  // spilled Regs will have color >= num_colors of their class
   constexpr View<Color> get_colors() const noexcept {
     return colors_;
   }
@@ -79,27 +142,102 @@ public:
   }
 
 private:
-  // called by allocate_regs()
-  void init() noexcept;
+  /// @return degree of reg in g_, ignoring self-connections
+  Degree degree(Reg reg) const noexcept;
 
-  // find a register in g_ with degree less than specified degree
-  Reg find_degree_less_than(Degree degree) const noexcept;
+  /// @return number of colors available to reg, depending on its class
+  Color num_colors(Reg reg) const noexcept {
+    return num_colors_[get_class(reg)];
+  }
+
+  /// @return num_colors(reg) minus the colors forbidden to reg
+  Color available_colors(Reg reg) const noexcept;
+
+  // remove from g_ the edges between registers of different classes
+  void split_classes() noexcept;
+
+  /// @return the register reg was coalesced into, or reg itself
+  Reg find(Reg reg) noexcept;
+
+  // reset alias_ and partner_
+  void init_moves() noexcept;
+
+  // called by allocate_regs(): merge move-related registers that do not interfere,
+  // if Briggs or George conservative tests guarantee colorability is preserved
+  void coalesce() noexcept;
+
+  // Briggs test: merging a and b creates a node with less than num_colors
+  // neighbors of significant degree
+  bool briggs(Reg a, Reg b) const noexcept;
+
+  // George test: each neighbor of b either interferes with a
+  // or has insignificant degree
+  bool george(Reg a, Reg b) const noexcept;
+
+  // merge b into a
+  void merge(Reg a, Reg b) noexcept;
 
-  // pick a register in g_ to be spilled
-  Reg pick() const noexcept;
+  // fill partner_ with the registers connected by moves not coalesced
+  void link_partners() noexcept;
+
+  /// @return color of the register connected to reg by a non-coalesced move,
+  /// or NoColor if there is no such register or it is not colored yet
+  Color partner_color(Reg reg) const noexcept;
+
+  // called by allocate_regs(): compute degree_ and fill low_ and high_
+  bool init() noexcept;
+
+  // add reg to low_ if its degree is less than available_colors(reg), otherwise to high_
+  void push(Reg reg) noexcept;
+
+  // pop from low_ the lowest register with degree less than its num_colors
+  Reg find_degree_less_than() noexcept;
+
+  /// @return key of reg inside high_: lower spill cost first, then lower reg
+  uint64_t high_key(Reg reg, Degree degree) const noexcept;
+
+  // pop from high_ the register with lowest spill cost, i.e. weight / degree
+  Reg pick() noexcept;
+
+  // push reg to stack_ and decrement the degree of its neighbors,
+  // moving them to low_ or updating them in high_. does not modify g_
+  void remove(Reg reg) noexcept;
 
   // pop registers from stack_ and color them
   // in the lowest color not used by some neighbor
-  void assign_colors(Color num_colors) noexcept;
+  void assign_colors() noexcept;
+
+  // called by linear_scan(): color the registers of class cls
+  void linear_scan_class(RegClass cls, Color num_colors) noexcept;
 
-  // try to find an alternate color for Reg that satisfies hints
+  // try to find an alternate color for Reg that satisfies hints or moves
   Color try_satisfy_hints(Reg reg) noexcept;
 
-  Graph g_;  // index is reg
-  Graph g2_; // index is reg
-  Array<Reg> stack_;
-  Array<Color> hints_;  // index is reg
-  Array<Color> colors_; // index is reg
+  // called by linear_scan(): choose a color for reg,
+  // which starts after all intervals in active_ have been expired
+  Color linear_scan_color(Reg reg, Color num_colors) noexcept;
+
+  // called by linear_scan(): choose a color >= num_colors for reg
+  Color spill_color(Reg reg, Color num_colors) noexcept;
+
+  Graph g_;                   // index is reg
+  Array<Degree> degree_;      // index is reg. NoDegree if reg was removed
+  Array<Reg> stack_;          // also used by linear_scan(), sorted by increasing interval start
+  Array<Reg> low_;            // min-heap of regs with degree < num_colors
+  Array<uint64_t> high_;      // max-heap of high_key(reg, degree), may contain stale entries
+  Array<float> weights_;      // index is reg
+  Array<Reg> active_;         // used by linear_scan(), sorted by decreasing interval end
+  Array<Interval> intervals_; // index is reg
+  Array<Reg> moves_;          // pairs (dst, src) recorded by add_move()
+  Array<Reg> alias_;          // index is reg. register it was coalesced into, or itself
+  Array<Reg> partner_;        // index is reg. register connected by a non-coalesced move
+  Array<uint32_t> slot_end_;  // used by linear_scan(), index is spilled color - num_colors
+  Array<Color> hints_;        // index is reg
+  Array<RegClass> classes_;   // index is reg. empty if all registers are in class 0
+  Array<uint64_t> forbidden_; // index is reg. empty if no color is forbidden
+  const Color *num_colors_;   // index is register class. set only inside allocate_regs()
+                              // and linear_scan()
+  Array<Color> colors_;       // index is reg
   BitSet avail_colors_;
 
 }; // class Allocator
@@ -25,10 +25,26 @@ using Degree = ::onestl::graph::Degree;
 using Reg = ::onestl::graph::Node;
 using Size = ::onestl::graph::Size;
 using Color = Reg;
+using RegClass = uint8_t;
 
 enum : Size { NoPos = ::onestl::graph::NoPos };
 enum : Reg { NoReg = NoPos };
 enum : Color { NoColor = NoPos };
+enum : Degree { NoDegree = NoPos };
+
+// range of positions [start, end) where a register is live,
+// computed by Liveness::fill_intervals(). Empty if start >= end
+struct Interval {
+  uint32_t start;
+  uint32_t end;
+};
+
+// a register live across a call, i.e. live immediately after the call and not written by it.
+// computed by Liveness::fill_live_across()
+struct LiveAcross {
+  uint32_t node; // index of the call in the nodes passed to FlowGraph::build()
+  Reg reg;
+};
 
 class Allocator;
 class Liveness;
@@ -0,0 +1,375 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * liveness.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/algorithm.hpp>
+#include <onejit/basicblock.hpp>
+#include <onejit/reg/liveness.hpp>
+#include <onestl/graph.hpp>
+
+#include <algorithm> // std::reverse
+
+namespace onejit {
+namespace reg {
+
+enum : size_t { bitsPerWord = sizeof(size_t) * 8 };
+
+Liveness::Liveness() noexcept
+    : bb_{}, bb_n_{}, def_use_{}, gen_{}, kill_{}, in_{}, out_{}, live_{}, order_{}, worklist_{},
+      queued_{}, defs_{}, uses_{}, num_regs_{}, stride_{} {
+}
+
+Liveness::~Liveness() noexcept {
+}
+
+bool Liveness::get(const Word *row, Reg reg) noexcept {
+  return bool(1 & (row[reg / bitsPerWord] >> (reg % bitsPerWord)));
+}
+
+void Liveness::set(Word *row, Reg reg, bool value) noexcept {
+  const Word mask = Word(1) << (reg % bitsPerWord);
+  if (value) {
+    row[reg / bitsPerWord] |= mask;
+  } else {
+    row[reg / bitsPerWord] &= ~mask;
+  }
+}
+
+bool Liveness::live_in(size_t block, Reg reg) const noexcept {
+  return block < bb_n_ && reg < num_regs_ && get(in_.data() + block * stride_, reg);
+}
+
+bool Liveness::live_out(size_t block, Reg reg) const noexcept {
+  return block < bb_n_ && reg < num_regs_ && get(out_.data() + block * stride_, reg);
+}
+
+bool Liveness::compute(BasicBlocks bbs, Size num_regs, DefUse def_use) noexcept {
+  const size_t n = bbs.size();
+  bb_ = bbs.data();
+  bb_n_ = n;
+  def_use_ = def_use;
+  num_regs_ = num_regs;
+  stride_ = (num_regs + bitsPerWord - 1) / bitsPerWord;
+
+  // resize() zero-fills only the elements it adds
+  gen_.clear();
+  kill_.clear();
+  in_.clear();
+  out_.clear();
+  queued_.clear();
+  if (!gen_.resize(n * stride_) || !kill_.resize(n * stride_) || //
+      !in_.resize(n * stride_) || !out_.resize(n * stride_) ||   //
+      !live_.resize(stride_) || !queued_.resize(n) || !init_order()) {
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    init_block(i);
+  }
+  // worklist_ is a stack: push blocks in reverse postorder,
+  // so that they are popped in postorder
+  worklist_.clear();
+  for (size_t i = order_.size(); i != 0; i--) {
+    worklist_.append(order_[i - 1]); // cannot fail, capacity reserved by init_order()
+    queued_.set(order_[i - 1], true);
+  }
+  while (const size_t size = worklist_.size()) {
+    const size_t block = worklist_[size - 1];
+    worklist_.truncate(size - 1);
+    queued_.set(block, false);
+    if (!update_block(block)) {
+      continue;
+    }
+    for (const BasicBlock *prev : bb_[block].prev()) {
+      const size_t prev_block = prev - bb_;
+      if (!queued_[prev_block]) {
+        queued_.set(prev_block, true);
+        if (!worklist_.append(prev_block)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void Liveness::collect(Node node) noexcept {
+  defs_.clear();
+  uses_.clear();
+  def_use_(node, defs_, uses_);
+}
+
+void Liveness::init_block(size_t block) noexcept {
+  Word *gen = row(gen_, block);
+  Word *kill = row(kill_, block);
+  const BasicBlock &bb = bb_[block];
+  // walk backward: registers read by a node are live before it,
+  // unless an earlier node in the same basic block writes them
+  for (size_t i = bb.size(); i != 0; i--) {
+    collect(bb[i - 1]);
+    for (Reg reg : defs_) {
+      if (reg < num_regs_) {
+        set(gen, reg, false);
+        set(kill, reg, true);
+      }
+    }
+    for (Reg reg : uses_) {
+      if (reg < num_regs_) {
+        set(gen, reg, true);
+      }
+    }
+  }
+}
+
+bool Liveness::init_order() noexcept {
+  const size_t n = bb_n_;
+  order_.clear();
+  worklist_.clear();
+  if (!order_.reserve(n) || !worklist_.reserve(n)) {
+    return false;
+  }
+  // iterative depth-first search from the entry block.
+  // queued_[i] == true means i-th block was already visited.
+  // worklist_ contains the current path, and order_ receives the blocks
+  // after all their successors
+  Array<size_t> next_index; // index of next successor to visit, for each block in worklist_
+  if (!next_index.reserve(n)) {
+    return false;
+  }
+  for (size_t root = 0; root < n; root++) {
+    // visit unreachable blocks too
+    if (queued_[root]) {
+      continue;
+    }
+    queued_.set(root, true);
+    worklist_.append(root);
+    next_index.append(0);
+    while (const size_t depth = worklist_.size()) {
+      const size_t block = worklist_[depth - 1];
+      const size_t j = next_index[depth - 1];
+      Span<BasicBlock *> next = bb_[block].next();
+      if (j < next.size()) {
+        next_index.set(depth - 1, j + 1);
+        const size_t next_block = next[j] - bb_;
+        if (!queued_[next_block]) {
+          queued_.set(next_block, true);
+          worklist_.append(next_block);
+          next_index.append(0);
+        }
+      } else {
+        worklist_.truncate(depth - 1);
+        next_index.truncate(depth - 1);
+        order_.append(block);
+      }
+    }
+  }
+  queued_.fill(false);
+  return true;
+}
+
+bool Liveness::update_block(size_t block) noexcept {
+  Word *out = row(out_, block);
+  for (size_t i = 0; i < stride_; i++) {
+    out[i] = 0;
+  }
+  for (const BasicBlock *next : bb_[block].next()) {
+    const Word *next_in = row(in_, next - bb_);
+    for (size_t i = 0; i < stride_; i++) {
+      out[i] |= next_in[i];
+    }
+  }
+  // live-in = gen | (live-out & ~kill)
+  const Word *gen = row(gen_, block);
+  const Word *kill = row(kill_, block);
+  Word *in = row(in_, block);
+  bool changed = false;
+  for (size_t i = 0; i < stride_; i++) {
+    const Word word = gen[i] | (out[i] & ~kill[i]);
+    changed = changed || word != in[i];
+    in[i] = word;
+  }
+  return changed;
+}
+
+void Liveness::fill_interference_graph(Graph &graph) noexcept {
+  Word *live = live_.data();
+  for (size_t block = 0, n = bb_n_; block < n; block++) {
+    const Word *out = row(out_, block);
+    for (size_t i = 0; i < stride_; i++) {
+      live[i] = out[i];
+    }
+    const BasicBlock &bb = bb_[block];
+    for (size_t i = bb.size(); i != 0; i--) {
+      collect(bb[i - 1]);
+      for (Reg def : defs_) {
+        if (def >= num_regs_) {
+          continue;
+        }
+        // registers written by the same node interfere with each other
+        for (Reg other : defs_) {
+          if (other != def && other < num_regs_) {
+            graph.set(def, other, true);
+          }
+        }
+        for (size_t w = 0; w < stride_; w++) {
+          Reg reg = Reg(w * bitsPerWord);
+          for (Word bits = live[w]; bits != 0; bits >>= 1, reg++) {
+            if ((bits & 1) && reg != def) {
+              graph.set(def, reg, true);
+            }
+          }
+        }
+      }
+      for (Reg reg : defs_) {
+        if (reg < num_regs_) {
+          set(live, reg, false);
+        }
+      }
+      for (Reg reg : uses_) {
+        if (reg < num_regs_) {
+          set(live, reg, true);
+        }
+      }
+    }
+  }
+}
+
+bool Liveness::fill_live_across(IsCall is_call, Array<LiveAcross> &across) noexcept {
+  across.clear();
+  if (bb_n_ == 0) {
+    return true;
+  }
+  const Node *first = bb_[0].data();
+  Word *live = live_.data();
+  for (size_t block = 0, n = bb_n_; block < n; block++) {
+    const Word *out = row(out_, block);
+    for (size_t i = 0; i < stride_; i++) {
+      live[i] = out[i];
+    }
+    const BasicBlock &bb = bb_[block];
+    // walk backward, collecting the entries of this basic block in reverse order
+    const size_t start = across.size();
+    for (size_t i = bb.size(); i != 0; i--) {
+      Node node = bb[i - 1];
+      collect(node);
+      for (Reg reg : defs_) {
+        if (reg < num_regs_) {
+          set(live, reg, false);
+        }
+      }
+      if (is_call(node)) {
+        const uint32_t index = uint32_t(bb.data() + (i - 1) - first);
+        for (size_t w = stride_; w != 0; w--) {
+          Reg reg = Reg(w * bitsPerWord);
+          for (Word bits = live[w - 1]; bits != 0; bits <<= 1) {
+            reg--;
+            if ((bits >> (bitsPerWord - 1)) && !across.append(LiveAcross{index, reg})) {
+              return false;
+            }
+          }
+        }
+      }
+      for (Reg reg : uses_) {
+        if (reg < num_regs_) {
+          set(live, reg, true);
+        }
+      }
+    }
+    std::reverse(across.begin() + start, across.end());
+  }
+  return true;
+}
+
+static void extend_interval(Interval &interval, uint32_t pos) noexcept {
+  interval.start = min2(interval.start, pos);
+  interval.end = max2(interval.end, pos + 1);
+}
+
+void Liveness::extend_intervals(Interval *intervals, const Word *row, uint32_t pos) noexcept {
+  for (size_t w = 0; w < stride_; w++) {
+    Reg reg = Reg(w * bitsPerWord);
+    for (Word bits = row[w]; bits != 0; bits >>= 1, reg++) {
+      if (bits & 1) {
+        extend_interval(intervals[reg], pos);
+      }
+    }
+  }
+}
+
+bool Liveness::fill_intervals(Array<Interval> &intervals) noexcept {
+  if (!intervals.resize(num_regs_)) {
+    return false;
+  }
+  // mark all intervals as empty
+  intervals.fill(Interval{uint32_t(-1), 0});
+  Interval *data = intervals.data();
+  uint32_t pos = 0;
+  for (size_t block = 0, n = bb_n_; block < n; block++) {
+    extend_intervals(data, row(in_, block), pos);
+    for (Node node : bb_[block]) {
+      collect(node);
+      for (Reg reg : uses_) {
+        if (reg < num_regs_) {
+          extend_interval(data[reg], pos);
+        }
+      }
+      for (Reg reg : defs_) {
+        if (reg < num_regs_) {
+          extend_interval(data[reg], pos + 1);
+        }
+      }
+      pos += 2;
+    }
+    if (pos != 0) {
+      extend_intervals(data, row(out_, block), pos - 1);
+    }
+  }
+  return true;
+}
+
+bool Liveness::fill_weights(Array<float> &weights, View<uint32_t> loop_depth,
+                            View<float> block_freq) noexcept {
+  if (!weights.resize(num_regs_)) {
+    return false;
+  }
+  weights.fill(0.0f);
+  float *data = weights.data();
+  for (size_t block = 0, n = bb_n_; block < n; block++) {
+    float weight = 1.0f;
+    if (block < block_freq.size() && block_freq[block] >= 0.0f) {
+      weight = block_freq[block];
+    } else if (block < loop_depth.size()) {
+      // limit depth to keep weights finite
+      for (uint32_t i = 0, depth = min2(loop_depth[block], 30u); i < depth; i++) {
+        weight *= 10.0f;
+      }
+    }
+    for (Node node : bb_[block]) {
+      collect(node);
+      for (Reg reg : uses_) {
+        if (reg < num_regs_) {
+          data[reg] += weight;
+        }
+      }
+      for (Reg reg : defs_) {
+        if (reg < num_regs_) {
+          data[reg] += weight;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace reg
+} // namespace onejit
@@ -17,15 +17,25 @@
 #define ONEJIT_REG_LIVENESS_HPP
 
 #include <onejit/fwd.hpp>
-#include <onestl/bitset.hpp>
+#include <onejit/reg/fwd.hpp>
+#include <onestl/array.hpp>
 
 namespace onejit {
 namespace reg {
 
-// perform register liveness analysis
+// perform register liveness analysis.
+// uses iterative backward dataflow on the basic blocks of a FlowGraph
 class Liveness {
 
 public:
+  // arch-specific callback: append to 'defs' the registers written by node,
+  // and to 'uses' the registers read by node.
+  // A register both read and written must be appended to both.
+  typedef void (*DefUse)(Node node, Array<Reg> &defs, Array<Reg> &uses);
+
+  // arch-specific callback: return true if node calls a function
+  typedef bool (*IsCall)(Node node);
+
   Liveness() noexcept;
 
   Liveness(Liveness &&) noexcept = default;
@@ -36,6 +46,94 @@ public:
   Liveness &operator=(Liveness &&) noexcept = default;
   Liveness &operator=(const Liveness &) noexcept = delete;
 
+  // compute live-in and live-out registers of each basic block.
+  // registers are numbered 0 ... num_regs-1, and basic blocks must not change
+  // until Liveness is no longer used.
+  /// @return false if out of memory
+  bool compute(BasicBlocks bbs, Size num_regs, DefUse def_use) noexcept;
+
+  /// @return number of registers passed to compute()
+  constexpr Size size() const noexcept {
+    return num_regs_;
+  }
+
+  /// @return true if reg is live at the beginning of i-th basic block
+  bool live_in(size_t block, Reg reg) const noexcept;
+
+  /// @return true if reg is live at the end of i-th basic block
+  bool live_out(size_t block, Reg reg) const noexcept;
+
+  // for each node, connect the registers it writes
+  // to all registers live immediately after it.
+  // graph must have size() >= num_regs passed to compute()
+  void fill_interference_graph(Graph &graph) noexcept;
+
+  // compute the live interval of each register, numbering nodes in basic block order:
+  // the k-th node reads registers at position 2k and writes them at position 2k+1.
+  // Intervals have no holes, thus they overestimate liveness.
+  /// @return false if out of memory
+  bool fill_intervals(Array<Interval> &intervals) noexcept;
+
+  // for each node where is_call(node) returns true, append to 'across'
+  // the registers live immediately after it and not written by it.
+  // entries are sorted by increasing node index.
+  /// @return false if out of memory
+  bool fill_live_across(IsCall is_call, Array<LiveAcross> &across) noexcept;
+
+  // compute the spill weight of each register: every read or write of it
+  // adds 10^loop_depth[block], where block is the basic block containing the node.
+  // loop_depth is usually FlowGraph::loop_depth()
+  //
+  // if block_freq[block] is present and >= 0, it replaces 10^loop_depth[block]:
+  // it should be the measured execution count of block divided by the function invocations
+  /// @return false if out of memory
+  bool fill_weights(Array<float> &weights, View<uint32_t> loop_depth,
+                    View<float> block_freq = View<float>{}) noexcept;
+
+private:
+  typedef size_t Word;
+
+  // compute gen_ and kill_ of i-th basic block
+  void init_block(size_t block) noexcept;
+
+  // compute order_ i.e. basic blocks in postorder:
+  // successors are visited before their predecessors
+  bool init_order() noexcept;
+
+  // recompute live-out and live-in of i-th basic block.
+  /// @return true if live-in changed
+  bool update_block(size_t block) noexcept;
+
+  // call def_use_(node, defs_, uses_) after clearing defs_ and uses_
+  void collect(Node node) noexcept;
+
+  Word *row(Array<Word> &array, size_t block) noexcept {
+    return array.data() + block * stride_;
+  }
+
+  static bool get(const Word *row, Reg reg) noexcept;
+  // extend to position pos the interval of each register present in row
+  void extend_intervals(Interval *intervals, const Word *row, uint32_t pos) noexcept;
+  static void set(Word *row, Reg reg, bool value) noexcept;
+
+  const BasicBlock *bb_; // basic blocks passed to compute()
+  size_t bb_n_;
+  DefUse def_use_;
+  // each of gen_, kill_, in_, out_ contains one row per basic block,
+  // and each row contains one bit per register
+  Array<Word> gen_;  // registers read by basic block before being written
+  Array<Word> kill_; // registers written by basic block
+  Array<Word> in_;   // registers live at the beginning of basic block
+  Array<Word> out_;  // registers live at the end of basic block
+  Array<Word> live_; // single row, used as buffer
+  Array<size_t> order_;
+  Array<size_t> worklist_;
+  Array<bool> queued_;
+  Array<Reg> defs_;
+  Array<Reg> uses_;
+  Size num_regs_;
+  size_t stride_; // number of Words in each row
+
 }; // class Liveness
 
 } // namespace reg
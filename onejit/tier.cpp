@@ -0,0 +1,104 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * tier.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/func.hpp>
+#include <onejit/ir/const.hpp>
+#include <onejit/ir/mem.hpp>
+#include <onejit/tier.hpp>
+
+#include <new> // std::nothrow
+
+namespace onejit {
+
+// ===============================  TierPolicy  ================================
+
+bool TierPolicy::is_hot(const TierCounters &counters) const noexcept {
+  return counters.calls.load(std::memory_order_relaxed) >= calls_ ||
+         counters.backedges.load(std::memory_order_relaxed) >= backedges_;
+}
+
+// ===============================  TieredFunc  ================================
+
+Expr TieredFunc::call_address(Func &caller) const noexcept {
+  Const slot{caller, Imm{Ptr, uint64_t(size_t(entry_slot()))}};
+  return Mem{caller, Ptr, {slot}};
+}
+
+// ===============================  Tiered  ====================================
+
+Tiered::Tiered(ArchId archid, Backend backend, void *backend_ctx, TierPolicy policy) noexcept
+    : comp_{}, funcs_{}, error_{}, backend_{backend}, backend_ctx_{backend_ctx}, //
+      policy_{policy}, archid_{archid}, good_{true} {
+}
+
+Tiered::~Tiered() noexcept {
+  for (TieredFunc *tfunc : funcs_) {
+    delete tfunc;
+  }
+}
+
+Tiered::operator bool() const noexcept {
+  return good_ && bool(comp_);
+}
+
+TieredFunc *Tiered::add(Func &func) noexcept {
+  TieredFunc *tfunc = new (std::nothrow) TieredFunc{func};
+  if (!tfunc || !funcs_.append(tfunc)) {
+    delete tfunc;
+    good_ = false;
+    return nullptr;
+  }
+  if (!compile(*tfunc, policy_.baseline(), &tfunc->counters_)) {
+    funcs_.truncate(funcs_.size() - 1);
+    delete tfunc;
+    return nullptr;
+  }
+  return tfunc;
+}
+
+size_t Tiered::poll() noexcept {
+  size_t n = 0;
+  for (TieredFunc *tfunc : funcs_) {
+    if (tfunc->tier() == 0 && policy_.is_hot(tfunc->counters_)) {
+      // promote even if compile() fails: do not retry it at each poll()
+      tfunc->tier_.store(1, std::memory_order_release);
+      n += compile(*tfunc, policy_.optimized(), nullptr);
+    }
+  }
+  return n;
+}
+
+bool Tiered::compile(TieredFunc &tfunc, Opt flags, TierCounters *counters) noexcept {
+  Func &func = tfunc.func();
+  func.clear_compiled();
+  comp_.configure_counters(counters).compile_arch(func, archid_, flags);
+  comp_.configure_counters(nullptr);
+
+  CRange<Error> errors = comp_.errors();
+  good_ = good_ && error_.append(errors.view());
+  if (!comp_ || !errors.empty() || !func.get_compiled(archid_)) {
+    return false;
+  }
+  void *entry = backend_ ? backend_(backend_ctx_, func) : nullptr;
+  if (!entry) {
+    good_ = good_ && error_.append(Error{func.get_compiled(archid_), "tier backend failed"});
+    return false;
+  }
+  // release: the new entry point must be visible only after its code
+  tfunc.entry_.store(entry, std::memory_order_release);
+  return true;
+}
+
+} // namespace onejit
@@ -0,0 +1,187 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * tier.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_TIER_HPP
+#define ONEJIT_TIER_HPP
+
+#include <onejit/archid.hpp>
+#include <onejit/compiler.hpp>
+#include <onejit/optimizer.hpp>
+#include <onestl/array.hpp>
+#include <onestl/crange.hpp>
+
+#include <atomic>
+
+namespace onejit {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// hotness counters of a function compiled with the baseline tier.
+// incremented by the compiled code itself, see Compiler::configure_counters().
+// compiled code uses plain, non-atomic increments: if several threads execute
+// the same function, some increments may be lost and counts are approximate.
+// std::atomic only makes reading them from another thread well-defined
+struct TierCounters {
+  std::atomic<uint64_t> calls;     // incremented at each function entry
+  std::atomic<uint64_t> backedges; // incremented at each loop iteration
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// decides when a function compiled with the baseline tier
+// is hot enough to be recompiled with the optimizing tier
+class TierPolicy {
+public:
+  constexpr TierPolicy() noexcept //
+      : calls_{1000}, backedges_{100000}, baseline_{OptNone}, optimized_{OptAll} {
+  }
+
+  constexpr TierPolicy(uint64_t calls, uint64_t backedges, //
+                       Opt baseline = OptNone, Opt optimized = OptAll) noexcept
+      : calls_{calls}, backedges_{backedges}, baseline_{baseline}, optimized_{optimized} {
+  }
+
+  /// @return optimizations used by the baseline tier
+  constexpr Opt baseline() const noexcept {
+    return baseline_;
+  }
+
+  /// @return optimizations used by the optimizing tier
+  constexpr Opt optimized() const noexcept {
+    return optimized_;
+  }
+
+  /// @return true if a function should be promoted to the optimizing tier
+  bool is_hot(const TierCounters &counters) const noexcept;
+
+private:
+  uint64_t calls_;     // promote after this many calls
+  uint64_t backedges_; // or after this many loop iterations
+  Opt baseline_;
+  Opt optimized_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// a function managed by Tiered.
+// Its address never changes, and contains the slot with current entry point
+class TieredFunc {
+  friend class Tiered;
+
+public:
+  constexpr Func &func() const noexcept {
+    return *func_;
+  }
+
+  /// @return 0 for baseline tier, 1 for optimizing tier
+  uint8_t tier() const noexcept {
+    return tier_.load(std::memory_order_acquire);
+  }
+
+  /// @return current entry point of jit-compiled function
+  void *entry() const noexcept {
+    return entry_.load(std::memory_order_acquire);
+  }
+
+  /// @return address of the slot containing current entry point.
+  /// jit-compiled callers should load it and call the loaded address,
+  /// see call_address()
+  const void *entry_slot() const noexcept {
+    return &entry_;
+  }
+
+  /// @return an Expr to be used as address in Call{caller, ...}:
+  /// it loads the current entry point, thus following promotions
+  Expr call_address(Func &caller) const noexcept;
+
+  constexpr const TierCounters &counters() const noexcept {
+    return counters_;
+  }
+
+private:
+  explicit TieredFunc(Func &func) noexcept
+      : func_{&func}, entry_{nullptr}, tier_{0}, counters_{{0}, {0}} {
+  }
+
+  Func *func_;
+  std::atomic<void *> entry_;
+  std::atomic<uint8_t> tier_;
+  TierCounters counters_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// tiered compilation:
+// functions are first compiled quickly with TierPolicy::baseline() optimizations,
+// and instrumented with TierCounters.
+// poll() recompiles the hot ones with TierPolicy::optimized() optimizations
+// and atomically swaps their entry point.
+//
+// poll() may be called from a background thread, provided that
+// no other thread uses the same Code or Func at the same time:
+// jit-compiled code can keep running and calling tiered functions.
+class Tiered {
+public:
+  // convert a Func already compiled for some ArchId into executable code.
+  // @return address of executable code, or nullptr on error.
+  // example: a wrapper around mir::Assembler::assemble()
+  typedef void *(*Backend)(void *ctx, Func &func);
+
+  Tiered(ArchId archid, Backend backend, void *backend_ctx,
+         TierPolicy policy = TierPolicy{}) noexcept;
+
+  Tiered(Tiered &&other) noexcept = default;
+  Tiered &operator=(Tiered &&other) noexcept = default;
+
+  ~Tiered() noexcept;
+
+  /// @return false if out of memory
+  explicit operator bool() const noexcept;
+
+  constexpr const TierPolicy &policy() const noexcept {
+    return policy_;
+  }
+
+  // compile func with the baseline tier, and start tracking its hotness.
+  // @return the TieredFunc, or nullptr on errors
+  TieredFunc *add(Func &func) noexcept;
+
+  // recompile with the optimizing tier all functions that became hot.
+  // @return number of functions promoted
+  size_t poll() noexcept;
+
+  /// @return compile and backend errors
+  constexpr CRange<Error> errors() const noexcept {
+    return CRange<Error>{&error_};
+  }
+
+private:
+  // compile tfunc with specified optimizations and instrumentation,
+  // then swap its entry point. @return false on errors
+  bool compile(TieredFunc &tfunc, Opt flags, TierCounters *counters) noexcept;
+
+  Compiler comp_;
+  Array<TieredFunc *> funcs_;
+  Array<Error> error_;
+  Backend backend_;
+  void *backend_ctx_;
+  TierPolicy policy_;
+  ArchId archid_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace onejit
+
+#endif // ONEJIT_TIER_HPP
@@ -110,13 +110,30 @@ Arg3 to_arg(const Node &node1, const Node &node2, const Node &node3) noexcept {
   Arg1 arg1 = to_arg(node1);
   Arg1 arg2 = to_arg(node2);
   Arg1 arg3 = to_arg(node3);
+  if ((arg3 & Arg1::Val) == Arg1::None) {
+    return Arg3::None;
+  }
   if ((arg1 & Arg1::Reg) != Arg1::None) {
-    if ((arg3 & Arg1::Val) != Arg1::None) {
-      if ((arg2 & Arg1::Reg) != Arg1::None) {
-        return Arg3::Reg_Reg_Val;
-      } else if ((arg2 & Arg1::Mem) != Arg1::None) {
-        return Arg3::Reg_Mem_Val;
-      }
+    if ((arg2 & Arg1::Reg) != Arg1::None) {
+      return Arg3::Reg_Reg_Val;
+    } else if ((arg2 & Arg1::Mem) != Arg1::None) {
+      return Arg3::Reg_Mem_Val;
+    } else if ((arg2 & Arg1::Xmm) != Arg1::None) {
+      return Arg3::Reg_Xmm_Val;
+    }
+  } else if ((arg1 & Arg1::Mem) != Arg1::None) {
+    if ((arg2 & Arg1::Reg) != Arg1::None) {
+      return Arg3::Mem_Reg_Val;
+    } else if ((arg2 & Arg1::Xmm) != Arg1::None) {
+      return Arg3::Mem_Xmm_Val;
+    }
+  } else if ((arg1 & Arg1::Xmm) != Arg1::None) {
+    if ((arg2 & Arg1::Reg) != Arg1::None) {
+      return Arg3::Xmm_Reg_Val;
+    } else if ((arg2 & Arg1::Xmm) != Arg1::None) {
+      return Arg3::Xmm_Xmm_Val;
+    } else if ((arg2 & Arg1::Mem) != Arg1::None) {
+      return Arg3::Xmm_Mem_Val;
     }
   }
   return Arg3::None;
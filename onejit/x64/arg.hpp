@@ -93,6 +93,12 @@ enum class Arg3 : uint8_t {
   None = 0,
   Reg_Reg_Val = 1 << 0, // register = register OP immediate
   Reg_Mem_Val = 1 << 1, // register = memory OP immediate
+  Mem_Reg_Val = 1 << 2, // memory = memory OP register OP immediate. only used by SHLD, SHRD
+  Reg_Xmm_Val = 1 << 3, // register = %xmm OP immediate
+  Mem_Xmm_Val = 1 << 4, // memory = %xmm OP immediate
+  Xmm_Reg_Val = 1 << 5, // %xmm = %xmm OP register OP immediate
+  Xmm_Xmm_Val = 1 << 6, // %xmm = %xmm OP %xmm OP immediate
+  Xmm_Mem_Val = 1 << 7, // %xmm = %xmm OP memory OP immediate
 };
 
 ////////////////////////////////////////////////////////////////////////////////
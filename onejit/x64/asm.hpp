@@ -24,26 +24,34 @@ namespace x64 {
 ////////////////////////////////////////////////////////////////////////////////
 class Asm0 {
   friend class onejit::Assembler;
+  friend class Flags;
 
 private:
   static Assembler &emit(Assembler &dst, const Stmt0 &st) noexcept;
   static Assembler &emit(Assembler &dst, const Inst0 &inst) noexcept;
+  // emit n bytes of multi-byte NOPs
+  static Assembler &emit_nops(Assembler &dst, size_t n) noexcept;
   static const Inst0 &find(OpStmt0 op) noexcept;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 class Asm1 {
   friend class onejit::Assembler;
+  friend class Flags;
+  friend class Relax;
 
 private:
   static Assembler &emit(Assembler &dst, const Stmt1 &st) noexcept;
   static Assembler &emit(Assembler &dst, const Stmt1 &st, const Inst1 &inst) noexcept;
+  // emit a jmp or jcc with 8-bit relative offset
+  static Assembler &emit_rel8(Assembler &dst, OpStmt1 op, int8_t offset) noexcept;
   static const Inst1 &find(OpStmt1 op) noexcept;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 class Asm2 {
   friend class onejit::Assembler;
+  friend class Flags;
 
 private:
   static Assembler &emit(Assembler &dst, const Stmt2 &st) noexcept;
@@ -54,6 +62,7 @@ private:
 ////////////////////////////////////////////////////////////////////////////////
 class Asm3 {
   friend class onejit::Assembler;
+  friend class Flags;
 
 private:
   static Assembler &emit(Assembler &dst, const Stmt3 &st) noexcept;
@@ -71,6 +80,36 @@ private:
   static const InstN &find(OpStmtN op) noexcept;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// AVX, AVX2 and AVX-512 instructions on %xmm, %ymm and %zmm registers.
+// uses the shorter VEX encoding when possible, and EVEX encoding
+// for %zmm and %xmm16...%xmm31 registers
+class AsmV {
+  friend class onejit::Assembler;
+  friend class Asm2;
+  friend class Asm3;
+
+private:
+  static Assembler &emit(Assembler &dst, const Stmt2 &st) noexcept;
+  static Assembler &emit(Assembler &dst, const Stmt3 &st) noexcept;
+  static Assembler &emit(Assembler &dst, const Stmt4 &st) noexcept;
+  static const InstV &find(OpStmt2 op) noexcept;
+  static const InstV &find(OpStmt3 op) noexcept;
+  static const InstV &find(OpStmt4 op) noexcept;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// branch relaxation: assemble a Block choosing, for each jmp and jcc to a Label
+// defined in the same Block, the 2-byte rel8 encoding if the Label is near enough,
+// and the 5 or 6 bytes rel32 encoding otherwise.
+// also accounts for the NOP padding inserted before aligned Labels.
+class Relax {
+  friend class onejit::Assembler;
+
+private:
+  static Assembler &emit(Assembler &dst, const StmtN &block) noexcept;
+};
+
 } // namespace x64
 } // namespace onejit
 
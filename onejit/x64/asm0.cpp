@@ -70,5 +70,29 @@ Assembler &Asm0::emit(Assembler &dst, const Stmt0 &st) noexcept {
   return emit(dst, find(st.op()));
 }
 
+// multi-byte NOPs recommended by Intel and AMD optimization manuals: nop_vec[i] is i+1 bytes long
+static const uint8_t nop_vec[9][9] = {
+    {0x90},                                           /* nop                      */
+    {0x66, 0x90},                                     /* xchg %ax,%ax             */
+    {0x0f, 0x1f, 0x00},                               /* nopl (%rax)              */
+    {0x0f, 0x1f, 0x40, 0x00},                         /* nopl 0x0(%rax)           */
+    {0x0f, 0x1f, 0x44, 0x00, 0x00},                   /* nopl 0x0(%rax,%rax,1)    */
+    {0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00},             /* nopw 0x0(%rax,%rax,1)    */
+    {0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00},       /* nopl 0x0(%rax)           */
+    {0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}, /* nopl 0x0(%rax,%rax,1)    */
+    {0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}, /* nopw 0x0(%rax,%rax,1) */
+};
+
+Assembler &Asm0::emit_nops(Assembler &dst, size_t n) noexcept {
+  const size_t max = sizeof(nop_vec) / sizeof(nop_vec[0]);
+  // prefer the longest NOPs: fewer instructions to decode
+  while (n != 0 && dst) {
+    const size_t len = n < max ? n : max;
+    dst.add(Bytes{nop_vec[len - 1], len});
+    n -= len;
+  }
+  return dst;
+}
+
 } // namespace x64
 } // namespace onejit
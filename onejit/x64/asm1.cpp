@@ -63,7 +63,7 @@ static const Inst1 inst1_vec[] = {
     /*     reg/mem     imm8    imm32                                              */ /*-------- */
     Inst1{"\xff\x20", "\xeb", "\xe9", Arg1::Reg | Arg1::Mem | Arg1::Val, B64, B8 | B32}, /* jmp */
     Inst1{"\xf6\x18", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* neg */
-    Inst1{"\xf6\x10", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* not */
+    Inst1{"\xf6\x10", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0},          /* not */
     /* ---------------------------------------------------------------------------*/ /*-------- */
     Inst1{"\x8f\x00", "", "", Arg1::Reg | Arg1::Mem, B16 | B64},                     /* pop     */
     /*        mem      imm8   imm32                                              */  /* push    */
@@ -150,7 +150,8 @@ static Assembler &asm1_emit_addr(Assembler &dst, //
   }
   dst.add(onestl::Bytes{buf, len});
   if (auto label = mem.label()) {
-    dst.add_relocation(label);
+    // label address is relative only if base register is RIP
+    dst.add_relocation(label, base.reg_id() == RIP);
   }
   return dst;
 }
@@ -308,5 +309,12 @@ Assembler &Asm1::emit(Assembler &dst, const Stmt1 &st) noexcept {
   return emit(dst, st, find(st.op()));
 }
 
+Assembler &Asm1::emit_rel8(Assembler &dst, OpStmt1 op, int8_t offset) noexcept {
+  const Bytes bytes = find(op).imm8_bytes();
+  // only jmp and jcc have a single-byte imm8 opcode with relative destination
+  const uint8_t buf[2] = {bytes[0], uint8_t(offset)};
+  return dst.add(Bytes{buf, 2});
+}
+
 } // namespace x64
 } // namespace onejit
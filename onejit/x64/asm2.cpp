@@ -14,23 +14,429 @@
  */
 
 #include <onejit/assembler.hpp>
+#include <onejit/bits.hpp> // Bits
+#include <onejit/ir/const.hpp>
+#include <onejit/ir/label.hpp>
 #include <onejit/ir/stmt2.hpp>
 #include <onejit/x64/asm.hpp>
 #include <onejit/x64/inst.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/util.hpp>
 
 namespace onejit {
 namespace x64 {
 
 using namespace onejit;
 
+// shortcuts for the most common argument combinations
+static constexpr Arg2 RegMem_RegMem = Arg2::Reg_Reg | Arg2::Reg_Mem | Arg2::Mem_Reg;
+static constexpr Arg2 RegMem_All = RegMem_RegMem | Arg2::Reg_Val | Arg2::Mem_Val;
+static constexpr Arg2 Shift = Arg2::Reg_Rcx | Arg2::Reg_Val | Arg2::Mem_Reg | Arg2::Mem_Val;
+static constexpr Arg2 Xmm_XmmMem = Arg2::Xmm_Xmm | Arg2::Xmm_Mem;
+static constexpr Arg2 XmmMem_XmmMem = Arg2::Xmm_Xmm | Arg2::Xmm_Mem | Arg2::Mem_Xmm;
+static constexpr BitSize B8_64 = B8 | B16 | B32 | B64;
+static constexpr BitSize B16_64 = B16 | B32 | B64;
+
 static const Inst2 inst2_vec[] = {
-    Inst2{Arg2::None}, /* bad instruction */
+    /*    reg,rm      rm,reg      rm,imm8       rm,imm32                          */ /*-------- */
+    Inst2{"", "", "", "", Arg2::None, B0}, /*                                       bad instr.  */
+    Inst2{"\x02", "\x00", "\x83\x00", "\x80\x00", RegMem_All, B8_64, B8 | B32, EFwrite}, /* add */
+    Inst2{"\x12", "\x10", "\x83\x10", "\x80\x10", RegMem_All, B8_64, B8 | B32, EFrw},    /* adc */
+    Inst2{"\x22", "\x20", "\x83\x20", "\x80\x20", RegMem_All, B8_64, B8 | B32, EFwrite}, /* and */
+    Inst2{"\x0f\xbc", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFwrite},   /* bsf */
+    Inst2{"\x0f\xbd", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFwrite},   /* bsr */
+    /*    reg,rm    rm,reg      rm,imm8                                           */ /*-------- */
+    Inst2{"", "\x0f\xa3", "\x0f\xba\x20", "", RegMem_All, B16_64, B8, EFwrite}, /*          bt  */
+    Inst2{"", "\x0f\xbb", "\x0f\xba\x38", "", RegMem_All, B16_64, B8, EFwrite}, /*          btc */
+    Inst2{"", "\x0f\xb3", "\x0f\xba\x30", "", RegMem_All, B16_64, B8, EFwrite}, /*          btr */
+    Inst2{"", "\x0f\xab", "\x0f\xba\x28", "", RegMem_All, B16_64, B8, EFwrite}, /*          bts */
+    /*    reg,rm                                                                  */ /*-------- */
+    Inst2{"\x0f\x47", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmova   */
+    Inst2{"\x0f\x43", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovae  */
+    Inst2{"\x0f\x42", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovb   */
+    Inst2{"\x0f\x46", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovbe  */
+    Inst2{"\x0f\x44", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmove   */
+    Inst2{"\x0f\x4f", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovg   */
+    Inst2{"\x0f\x4d", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovge  */
+    Inst2{"\x0f\x4c", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovl   */
+    Inst2{"\x0f\x4e", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovle  */
+    Inst2{"\x0f\x45", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovne  */
+    Inst2{"\x0f\x41", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovno  */
+    Inst2{"\x0f\x4b", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovnp  */
+    Inst2{"\x0f\x49", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovns  */
+    Inst2{"\x0f\x40", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovo   */
+    Inst2{"\x0f\x4a", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovp   */
+    Inst2{"\x0f\x48", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFread}, /* cmovs   */
+    /*    reg,rm      rm,reg      rm,imm8       rm,imm32                          */ /*-------- */
+    Inst2{"\x3a", "\x38", "\x83\x38", "\x80\x38", RegMem_All, B8_64, B8 | B32, EFwrite}, /* cmp */
+    Inst2{"", "\x0f\xb0", "", "", Arg2::Reg_Reg | Arg2::Mem_Reg, B8_64, B0, EFwrite}, /* cmpxchg */
+    Inst2{"", "", "", "", Arg2::None, B0}, /*                                   TODO cmpxchg8b  */
+    Inst2{"", "", "", "", Arg2::None, B0}, /*                                   TODO cmpxchg16b */
+    /*    rax,rm: last byte of imm32 opcode is the ModRM byte for the argument    */ /*-------- */
+    Inst2{"", "", "", "\xf6\x30", Arg2::Rax_Reg | Arg2::Rax_Mem, B8_64, B0, EFwrite}, /* div    */
+    Inst2{"", "", "", "\xf6\x38", Arg2::Rax_Reg | Arg2::Rax_Mem, B8_64, B0, EFwrite}, /* idiv   */
+    Inst2{"\x0f\xaf", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFwrite}, /* imul  */
+    Inst2{"\x8d", "", "", "", Arg2::Reg_Mem, B16_64}, /*                                   lea  */
+    Inst2{"", "", "", "", Arg2::None, B0},            /*                              TODO lods */
+    /*    reg,rm      rm,reg      rm,imm32                                        */ /*-------- */
+    Inst2{"\x8a", "\x88", "", "\xc6\x00", RegMem_All, B8_64, B8 | B16 | B32 | B64}, /*     mov  */
+    Inst2{"", "\x0f\xc3", "", "", Arg2::Mem_Reg, B32 | B64},            /*               movnti */
+    Inst2{"", "", "", "", Arg2::None, B0},                              /*          TODO movs   */
+    Inst2{"\x0f\xbe", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64}, /*             movsx  */
+    Inst2{"\x0f\xb6", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64}, /*             movzx  */
+    Inst2{"", "", "", "\xf6\x20", Arg2::Rax_Reg | Arg2::Rax_Mem, B8_64, B0, EFwrite}, /* mul    */
+    Inst2{"\x0a", "\x08", "\x83\x08", "\x80\x08", RegMem_All, B8_64, B8 | B32, EFwrite}, /* or  */
+    /*          rm,imm8. rm,1 and rm,%cl are derived from it                      */ /*-------- */
+    Inst2{"", "", "\xc0\x10", "", Shift, B8_64, B8, EFrw},    /*                            rcl */
+    Inst2{"", "", "\xc0\x18", "", Shift, B8_64, B8, EFrw},    /*                            rcr */
+    Inst2{"", "", "\xc0\x00", "", Shift, B8_64, B8, EFwrite}, /*                            rol */
+    Inst2{"", "", "\xc0\x08", "", Shift, B8_64, B8, EFwrite}, /*                            ror */
+    Inst2{"", "", "\xc0\x38", "", Shift, B8_64, B8, EFwrite}, /*                            sar */
+    Inst2{"", "", "\xc0\x20", "", Shift, B8_64, B8, EFwrite}, /*                            shl */
+    Inst2{"", "", "\xc0\x28", "", Shift, B8_64, B8, EFwrite}, /*                            shr */
+    /*    reg,rm      rm,reg      rm,imm8       rm,imm32                          */ /*-------- */
+    Inst2{"\x1a", "\x18", "\x83\x18", "\x80\x18", RegMem_All, B8_64, B8 | B32, EFrw},    /* sbb */
+    Inst2{"\x2a", "\x28", "\x83\x28", "\x80\x28", RegMem_All, B8_64, B8 | B32, EFwrite}, /* sub */
+    Inst2{"", "\x84", "", "\xf6\x00",                                         /*           test */
+          Arg2::Reg_Reg | Arg2::Mem_Reg | Arg2::Reg_Val | Arg2::Mem_Val, B8_64, B8 | B32, EFwrite},
+    Inst2{"", "\x0f\xc0", "", "", Arg2::Reg_Reg | Arg2::Mem_Reg, B8_64, B0, EFwrite}, /* xadd   */
+    Inst2{"", "\x86", "", "", Arg2::Reg_Reg | Arg2::Mem_Reg, B8_64},                  /* xchg   */
+    Inst2{"\x32", "\x30", "\x83\x30", "\x80\x30", RegMem_All, B8_64, B8 | B32, EFwrite}, /* xor */
+    ONEJIT_COMMENT() /* [CPUID SSE] is required by the following instructions ---------------- */
+    Inst2{"", "", "", "", Arg2::None, B0}, /*                             no such instr. movhlpd */
+    Inst2{"\x66\x0f\x16", "\x66\x0f\x17", "", "", Arg2::Xmm_Mem | Arg2::Mem_Xmm, B0}, /* movhpd */
+    Inst2{"", "", "", "", Arg2::None, B0}, /*                             no such instr. movlhpd */
+    Inst2{"\x66\x0f\x12", "\x66\x0f\x13", "", "", Arg2::Xmm_Mem | Arg2::Mem_Xmm, B0}, /* movlpd */
+    Inst2{"\x0f\x12", "", "", "", Arg2::Xmm_Xmm, B0},                              /* movhlps   */
+    Inst2{"\x0f\x16", "\x0f\x17", "", "", Arg2::Xmm_Mem | Arg2::Mem_Xmm, B0},      /* movhps    */
+    Inst2{"\x0f\x16", "", "", "", Arg2::Xmm_Xmm, B0},                              /* movlhps   */
+    Inst2{"\x0f\x12", "\x0f\x13", "", "", Arg2::Xmm_Mem | Arg2::Mem_Xmm, B0},      /* movlps    */
+    ONEJIT_COMMENT() /* [CPUID SSE2] is required by the following instructions --------------- */
+    Inst2{"\xf2\x0f\x2d", "", "", "", Arg2::Reg_Xmm | Arg2::Reg_Mem, B32 | B64}, /*    cvtsd2si  */
+    Inst2{"\xf2\x0f\x5a", "", "", "", Xmm_XmmMem, B0},                           /*    cvtsd2ss  */
+    Inst2{"\xf2\x0f\x2a", "", "", "", Arg2::Xmm_Reg | Arg2::Xmm_Mem, B32 | B64}, /*    cvtsi2sd  */
+    Inst2{"\xf3\x0f\x2a", "", "", "", Arg2::Xmm_Reg | Arg2::Xmm_Mem, B32 | B64}, /*    cvtsi2ss  */
+    Inst2{"\xf3\x0f\x5a", "", "", "", Xmm_XmmMem, B0},                           /*    cvtss2sd  */
+    Inst2{"\xf3\x0f\x2d", "", "", "", Arg2::Reg_Xmm | Arg2::Reg_Mem, B32 | B64}, /*    cvtss2si  */
+    Inst2{"\xf2\x0f\x5e", "", "", "", Xmm_XmmMem, B0},                           /*    divsd     */
+    Inst2{"\xf3\x0f\x5e", "", "", "", Xmm_XmmMem, B0},                           /*    divss     */
+    Inst2{"\x66\x0f\x5f", "", "", "", Xmm_XmmMem, B0},                           /*    maxpd     */
+    Inst2{"\x0f\x5f", "", "", "", Xmm_XmmMem, B0},                               /*    maxps     */
+    Inst2{"\xf2\x0f\x5f", "", "", "", Xmm_XmmMem, B0},                           /*    maxsd     */
+    Inst2{"\xf3\x0f\x5f", "", "", "", Xmm_XmmMem, B0},                           /*    maxss     */
+    Inst2{"\x66\x0f\x5d", "", "", "", Xmm_XmmMem, B0},                           /*    minpd     */
+    Inst2{"\x0f\x5d", "", "", "", Xmm_XmmMem, B0},                               /*    minps     */
+    Inst2{"\xf2\x0f\x5d", "", "", "", Xmm_XmmMem, B0},                           /*    minsd     */
+    Inst2{"\xf3\x0f\x5d", "", "", "", Xmm_XmmMem, B0},                           /*    minss     */
+    Inst2{"\x66\x0f\x28", "\x66\x0f\x29", "", "", XmmMem_XmmMem, B0},            /*    movapd    */
+    Inst2{"\x0f\x28", "\x0f\x29", "", "", XmmMem_XmmMem, B0},                    /*    movaps    */
+    Inst2{"\x66\x0f\x6e", "\x66\x0f\x7e", "", "",                                /*    movd      */
+          Arg2::Xmm_Reg | Arg2::Xmm_Mem | Arg2::Reg_Xmm | Arg2::Mem_Xmm, B32},
+    Inst2{"\x66\x0f\x6f", "\x66\x0f\x7f", "", "", XmmMem_XmmMem, B0}, /*               movdqa    */
+    Inst2{"\xf3\x0f\x6f", "\xf3\x0f\x7f", "", "", XmmMem_XmmMem, B0}, /*               movdqu    */
+    Inst2{"\x66\x0f\x50", "", "", "", Arg2::Reg_Xmm, B32 | B64},      /*               movmskpd  */
+    Inst2{"\x0f\x50", "", "", "", Arg2::Reg_Xmm, B32 | B64},          /*               movmskps  */
+    Inst2{"", "\x66\x0f\xe7", "", "", Arg2::Mem_Xmm, B0},             /*               movntdq   */
+    Inst2{"", "\x66\x0f\x2b", "", "", Arg2::Mem_Xmm, B0},             /*               movntpd   */
+    Inst2{"", "\x0f\x2b", "", "", Arg2::Mem_Xmm, B0},                 /*               movntps   */
+    /*    xmm,xmm/mem   mem,xmm. xmm,reg and reg,xmm are encoded as 64-bit movd   */ /*-------- */
+    Inst2{"\xf3\x0f\x7e", "\x66\x0f\xd6", "", "", /*                                   movq      */
+          XmmMem_XmmMem | Arg2::Xmm_Reg | Arg2::Reg_Xmm, B0},
+    Inst2{"\xf2\x0f\x10", "\xf2\x0f\x11", "", "", XmmMem_XmmMem, B0}, /*               movsd     */
+    Inst2{"\xf3\x0f\x10", "\xf3\x0f\x11", "", "", XmmMem_XmmMem, B0}, /*               movss     */
+    Inst2{"\x66\x0f\x10", "\x66\x0f\x11", "", "", XmmMem_XmmMem, B0}, /*               movupd    */
+    Inst2{"\x0f\x10", "\x0f\x11", "", "", XmmMem_XmmMem, B0},         /*               movups    */
+    Inst2{"\x66\x0f\x59", "", "", "", Xmm_XmmMem, B0},                /*               mulpd     */
+    Inst2{"\x0f\x59", "", "", "", Xmm_XmmMem, B0},                    /*               mulps     */
+    Inst2{"\x66\x0f\xdb", "", "", "", Xmm_XmmMem, B0},                /*               pand      */
+    Inst2{"\x66\x0f\xdf", "", "", "", Xmm_XmmMem, B0},                /*               pandn     */
+    Inst2{"\x66\x0f\xeb", "", "", "", Xmm_XmmMem, B0},                /*               por       */
+    Inst2{"\x66\x0f\xef", "", "", "", Xmm_XmmMem, B0},                /*               pxor      */
+    ONEJIT_COMMENT() /* [CPUID SSE3] is required by the following instructions --------------- */
+    Inst2{"\xf2\x0f\xf0", "", "", "", Arg2::Xmm_Mem, B0}, /*                           lddqu     */
+    ONEJIT_COMMENT() /* [CPUID SSE4.1] is required by the following instructions ------------- */
+    Inst2{"\x66\x0f\x38\x2a", "", "", "", Arg2::Xmm_Mem, B0}, /*                       movntdqa  */
+    ONEJIT_COMMENT() /* [CPUID SSE4.2] is required by the following instructions ------------- */
+    Inst2{"\xf2\x0f\x38\xf0", "", "", "", Arg2::Reg_Reg | Arg2::Reg_Mem, B32 | B64}, /* crc32    */
+    ONEJIT_COMMENT() /* [CPUID LZCNT] is required by the following instructions -------------- */
+    Inst2{"\xf3\x0f\xbd", "", "", "", /*                                               lzcnt */
+          Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFwrite},
+    ONEJIT_COMMENT() /* [CPUID MOVBE] is required by the following instructions -------------- */
+    Inst2{"\x0f\x38\xf0", "\x0f\x38\xf1", "", "", /*                                   movbe */
+          Arg2::Reg_Mem | Arg2::Mem_Reg, B16_64},
+    ONEJIT_COMMENT() /* [CPUID POPCNT] is required by the following instructions ------------- */
+    Inst2{"\xf3\x0f\xb8", "", "", "", /*                                               popcnt */
+          Arg2::Reg_Reg | Arg2::Reg_Mem, B16_64, B0, EFwrite},
+    ONEJIT_COMMENT() /* [CPUID RTM] is required by the following instructions ---------------- */
+    Inst2{"", "", "", "", Arg2::None, B0}, /*                                      TODO xbegin */
 };
 
 const Inst2 &Asm2::find(OpStmt2 op) noexcept {
-  /// TODO: implement
-  (void)op;
-  return inst2_vec[0];
+  size_t i = 0;
+  if (op >= X86_ADD && op <= X86_XBEGIN) {
+    i = size_t(op) - X86_ADD + 1;
+  }
+  return inst2_vec[i];
+}
+
+static Reg to_reg(const Node &node) noexcept {
+  if (Var v = node.is<Var>()) {
+    return Reg{v.local()};
+  }
+  return Reg{};
+}
+
+static bool is_gpr(Reg reg) noexcept {
+  return reg && reg.reg_id() >= RAX && reg.reg_id() <= R15;
+}
+
+static bool is_xmm(Reg reg) noexcept {
+  return reg.reg_id() >= XMM0 && reg.reg_id() <= XMM31;
+}
+
+// return the width of a register or memory argument
+static Bits width_of(const Node &node) noexcept {
+  if (Mem mem = node.is<Mem>()) {
+    return mem.kind().bits();
+  }
+  return to_reg(node).kind().bits();
+}
+
+static bool is_alu(OpStmt2 op) noexcept {
+  switch (op) {
+  case X86_ADD:
+  case X86_ADC:
+  case X86_AND:
+  case X86_CMP:
+  case X86_OR:
+  case X86_SBB:
+  case X86_SUB:
+  case X86_XOR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool is_shift(OpStmt2 op) noexcept {
+  return op >= X86_RCL && op <= X86_SHR;
+}
+
+// return true if op has arguments of different width
+static bool is_widening(OpStmt2 op) noexcept {
+  return is_shift(op) || op == X86_CRC32 || op == X86_LEA || op == X86_MOVSX || op == X86_MOVZX;
+}
+
+// return the width used to choose operand-size prefix and REX.W:
+// the width of the first general register argument, or of the memory argument
+static Bits asm2_size(const Inst2 &inst, OpStmt2 op, const Node &arg0, const Node &arg1) noexcept {
+  if (inst.arg_size() == B0) {
+    return Bits0;
+  } else if (is_shift(op) || is_gpr(to_reg(arg0))) {
+    return width_of(arg0);
+  } else if (is_gpr(to_reg(arg1))) {
+    return width_of(arg1);
+  } else if (arg0.type() == MEM) {
+    return width_of(arg0);
+  }
+  return width_of(arg1);
+}
+
+// copy bytes to buf, and if instruction also supports 8-bit arguments
+// but requested size is wider, set the lowest bit of opcode at position pos
+static Bytes asm2_opcode(uint8_t buf[4], Bytes bytes, size_t pos, const Inst2 &inst,
+                         Bits size) noexcept {
+  std::memcpy(buf, bytes.data(), bytes.size());
+  if ((inst.arg_size() & B8) != 0 && size != Bits8 && pos < bytes.size()) {
+    buf[pos] |= 1;
+  }
+  return Bytes{buf, bytes.size()};
+}
+
+static Assembler &asm2_add_imm(Assembler &dst, size_t imm_bytes, int64_t val) noexcept {
+  uint8_t buf[8] = {};
+  size_t len = Util::insert_offset_or_imm(buf, 0, imm_bytes, int32_t(val));
+  return dst.add(Bytes{buf, len});
+}
+
+// encode 'mov reg, imm' as the shortest among B0+r, B8+r and C7 /0
+static Assembler &asm2_emit_mov_reg_imm(Assembler &dst, Bits size, Reg reg, int64_t val) noexcept {
+  uint8_t buf[16] = {};
+  size_t len = 0;
+  if (size == Bits64 && val == int64_t(int32_t(val))) {
+    Bytes opcode{reinterpret_cast<const uint8_t *>("\xc7\x00"), 2};
+    Util::emit_modrm(dst, opcode, size, Reg{}, Var{reg});
+    return asm2_add_imm(dst, 4, val);
+  }
+  if (size == Bits16) {
+    buf[len++] = 0x66;
+  }
+  if (size == Bits64 || rhi(reg) || (size == Bits8 && reg.reg_id() >= RSP)) {
+    buf[len++] = 0x40 | (size == Bits64 ? 0x08 : 0) | rhi(reg);
+  }
+  buf[len++] = (size == Bits8 ? 0xb0 : 0xb8) | rlo(reg);
+  if (size == Bits64) {
+    const uint64_t uval = uint64_t(val);
+    len = Util::insert_offset_or_imm(buf, len, 4, int32_t(uval));
+    len = Util::insert_offset_or_imm(buf, len, 4, int32_t(uval >> 32));
+  } else {
+    len = Util::insert_offset_or_imm(buf, len, size == Bits8 ? 1 : size == Bits16 ? 2 : 4,
+                                     int32_t(val));
+  }
+  return dst.add(Bytes{buf, len});
+}
+
+static ONEJIT_NOINLINE Assembler &asm2_emit_const(Assembler &dst, const Stmt2 &st,
+                                                  const Inst2 &inst, Bits size,
+                                                  Value value) noexcept {
+  const OpStmt2 op = st.op();
+  Node arg0 = st.child(0);
+  Reg reg = to_reg(arg0);
+  const int64_t val = value.int64();
+  const bool fits_imm8 = val == int64_t(int8_t(val));
+  uint8_t buf[4];
+
+  if (op == X86_MOV && reg) {
+    return asm2_emit_mov_reg_imm(dst, size, reg, val);
+  } else if (is_shift(op)) {
+    // shift by 1 has its own shorter opcode
+    Bytes opcode = asm2_opcode(buf, inst.imm8_bytes(), 0, inst, size);
+    if (val == 1) {
+      buf[0] += 0x10;
+      return Util::emit_modrm(dst, opcode, size, Reg{}, arg0);
+    }
+    Util::emit_modrm(dst, opcode, size, Reg{}, arg0);
+    return asm2_add_imm(dst, 1, val);
+  }
+  const size_t imm_bytes = size == Bits8 ? 1 : size == Bits16 ? 2 : 4;
+  if (size == Bits64 && !inst.imm32_bytes().empty() && val != int64_t(int32_t(val))) {
+    return dst.error(st, "x64::Asm2::emit: immediate does not fit 32 bits");
+  }
+  if ((is_alu(op) || op == X86_TEST) && reg.reg_id() == RAX &&
+      (size == Bits8 || !fits_imm8 || op == X86_TEST)) {
+    // %al, %ax, %eax or %rax OP= imm has its own shorter opcode, without ModRM byte
+    size_t len = 0;
+    if (size == Bits16) {
+      buf[len++] = 0x66;
+    } else if (size == Bits64) {
+      buf[len++] = 0x48;
+    }
+    buf[len++] = uint8_t((op == X86_TEST ? 0xa8 : inst.mr_bytes()[0] + 4) | (size != Bits8));
+    dst.add(Bytes{buf, len});
+    return asm2_add_imm(dst, imm_bytes, val);
+  }
+  Bytes bytes = inst.imm32_bytes();
+  if (bytes.empty() || (size != Bits8 && fits_imm8 && !inst.imm8_bytes().empty())) {
+    // instruction only supports 8-bit immediates, or 8-bit immediate is sign-extended
+    Bytes opcode = asm2_opcode(buf, inst.imm8_bytes(), inst.imm8_bytes().size() - 2, inst, size);
+    Util::emit_modrm(dst, opcode, size, Reg{}, arg0);
+    return asm2_add_imm(dst, 1, val);
+  }
+  Bytes opcode = asm2_opcode(buf, bytes, bytes.size() - 2, inst, size);
+  Util::emit_modrm(dst, opcode, size, Reg{}, arg0);
+  return asm2_add_imm(dst, imm_bytes, val);
+}
+
+static ONEJIT_NOINLINE Assembler &asm2_emit_label(Assembler &dst, const Stmt2 &st, Bits size,
+                                                  Label l) noexcept {
+  Reg reg = to_reg(st.child(0));
+  if (st.op() != X86_MOV || size != Bits64) {
+    return dst.error(st, "x64::Asm2::emit: instruction does not support labels");
+  }
+  // load label address with 'lea reg, [rip + label]'
+  uint8_t buf[8] = {};
+  size_t len = 0;
+  buf[len++] = 0x48 | rhi(reg) << 2;
+  buf[len++] = 0x8d;
+  buf[len++] = rlo(reg) << 3 | 0x5;
+  dst.add(Bytes{buf, len + 4});
+  return dst.add_relocation(l);
+}
+
+static ONEJIT_NOINLINE Assembler &asm2_emit_regmem(Assembler &dst, const Stmt2 &st,
+                                                   const Inst2 &inst, Bits size) noexcept {
+  const OpStmt2 op = st.op();
+  Node arg0 = st.child(0), arg1 = st.child(1);
+  Reg reg0 = to_reg(arg0), reg1 = to_reg(arg1);
+  uint8_t buf[4];
+
+  if (is_shift(op)) {
+    if (reg1.reg_id() != RCX) {
+      return dst.error(st, "x64::Asm2::emit: shift count must be %cl");
+    }
+    // shift by %cl is encoded as shift by immediate, with opcode + 0x12
+    Bytes opcode = asm2_opcode(buf, inst.imm8_bytes(), 0, inst, size);
+    buf[0] += 0x12;
+    return Util::emit_modrm(dst, opcode, size, Reg{}, arg0);
+  } else if (op == X86_DIV || op == X86_IDIV || op == X86_MUL) {
+    if (reg0.reg_id() != RAX) {
+      return dst.error(st, "x64::Asm2::emit: first argument must be %rax");
+    }
+    Bytes opcode = asm2_opcode(buf, inst.imm32_bytes(), 0, inst, size);
+    return Util::emit_modrm(dst, opcode, size, Reg{}, arg1);
+  } else if (op == X86_MOVSX || op == X86_MOVZX || op == X86_CRC32) {
+    const Bits src_size = width_of(arg1);
+    const bool crc32 = op == X86_CRC32;
+    if (crc32 ? (size == Bits64 && src_size != Bits8 && src_size != Bits64) ||
+                    (size == Bits32 && src_size == Bits64)
+              : src_size >= size || (op == X86_MOVZX && src_size == Bits32)) {
+      return dst.error(st, "x64::Asm2::emit: unsupported combination of argument widths");
+    } else if (op == X86_MOVSX && src_size == Bits32) {
+      // movsxd
+      Bytes opcode{reinterpret_cast<const uint8_t *>("\x63"), 1};
+      return Util::emit_modrm(dst, opcode, size, reg0, arg1);
+    }
+    Bytes bytes = inst.rm_bytes();
+    std::memcpy(buf, bytes.data(), bytes.size());
+    // lowest opcode bit selects 8-bit or wider source
+    buf[bytes.size() - 1] |= uint8_t(src_size != Bits8);
+    Bytes opcode{buf, bytes.size()};
+    if (crc32) {
+      // operand-size prefix and REX.W depend on source width,
+      // except that 8-bit source with 64-bit destination requires REX.W
+      return Util::emit_modrm(dst, opcode, src_size == Bits8 ? size : src_size, reg0, arg1);
+    }
+    return Util::emit_modrm(dst, opcode, size, reg0, arg1);
+  }
+
+  const Inst2 *enc = &inst;
+  if (op == X86_MOVQ && (is_gpr(reg0) || is_gpr(reg1))) {
+    // movq between %xmm and general register is encoded as movd with REX.W
+    if (width_of(is_gpr(reg0) ? arg0 : arg1) != Bits64) {
+      return dst.error(st, "x64::Asm2::emit: instruction does not support specified width");
+    }
+    enc = &inst2_vec[X86_MOVD - X86_ADD + 1];
+    size = Bits64;
+  }
+  Bytes rm = enc->rm_bytes(), mr = enc->mr_bytes();
+  bool use_mr;
+  if (arg0.type() == MEM) {
+    use_mr = true;
+  } else if (arg1.type() == MEM) {
+    use_mr = false;
+  } else if (is_gpr(reg0)) {
+    // as GNU assembler does, prefer encoding 'reg OP= reg' as MR
+    use_mr = !mr.empty();
+  } else {
+    // and encoding '%xmm OP= ...' as RM
+    use_mr = rm.empty();
+  }
+  Bytes bytes = use_mr ? mr : rm;
+  if (bytes.empty()) {
+    return dst.error(st, "x64::Asm2::emit: unimplemented instruction");
+  }
+  Bytes opcode = asm2_opcode(buf, bytes, bytes.size() - 1, inst, size);
+  if (use_mr) {
+    return Util::emit_modrm(dst, opcode, size, reg1, arg0);
+  }
+  return Util::emit_modrm(dst, opcode, size, reg0, arg1);
+}
+
+// return false if node is a register not supported by x64::Asm2
+static bool is_valid_reg(const Node &node) noexcept {
+  Reg reg = to_reg(node);
+  return !reg || is_gpr(reg) || reg.reg_id() == RIP || (is_xmm(reg) && reg.reg_id() <= XMM15);
 }
 
 Assembler &Asm2::emit(Assembler &dst, const Stmt2 &st, const Inst2 &inst) noexcept {
@@ -38,13 +444,35 @@ Assembler &Asm2::emit(Assembler &dst, const Stmt2 &st, const Inst2 &inst) noexce
   Node arg1 = st.child(1);
   if (!is_compatible(arg0, arg1, inst.arg())) {
     return dst.error(st, "x64::Asm2::emit: instruction does not support specified argument types");
+  } else if (!is_valid_reg(arg0) || !is_valid_reg(arg1)) {
+    return dst.error(st, "x64::Asm2::emit: unsupported register, %xmm16...%xmm31 require EVEX");
   }
-
-  return dst.error(st, "unimplemented x64::Asm2::emit");
+  const OpStmt2 op = st.op();
+  const Bits size = asm2_size(inst, op, arg0, arg1);
+  if (inst.arg_size() != B0 && !is_compatible(size, inst.arg_size())) {
+    return dst.error(st, "x64::Asm2::emit: instruction does not support specified argument width");
+  }
+  switch (arg1.type()) {
+  case CONST:
+    return asm2_emit_const(dst, st, inst, size, arg1.is<Const>().val());
+  case LABEL:
+    return asm2_emit_label(dst, st, size, arg1.is<Label>());
+  default:
+    break;
+  }
+  if (inst.arg_size() != B0 && !is_widening(op) && !is_xmm(to_reg(arg0)) &&
+      !is_xmm(to_reg(arg1)) && width_of(arg0) != width_of(arg1)) {
+    return dst.error(st, "x64::Asm2::emit: arguments have different width");
+  }
+  return asm2_emit_regmem(dst, st, inst, size);
 }
 
 Assembler &Asm2::emit(Assembler &dst, const Stmt2 &st) noexcept {
-  return emit(dst, st, find(st.op()));
+  const OpStmt2 op = st.op();
+  if (op >= X86_VBROADCASTSD && op <= X86_VPBROADCASTW) {
+    return AsmV::emit(dst, st);
+  }
+  return emit(dst, st, find(op));
 }
 
 } // namespace x64
@@ -14,9 +14,14 @@
  */
 
 #include <onejit/assembler.hpp>
+#include <onejit/bits.hpp> // Bits
+#include <onejit/ir/const.hpp>
 #include <onejit/ir/stmt3.hpp>
 #include <onejit/x64/asm.hpp>
 #include <onejit/x64/inst.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/util.hpp>
 
 namespace onejit {
 namespace x64 {
@@ -24,13 +29,80 @@ namespace x64 {
 using namespace onejit;
 
 static const Inst3 inst3_vec[] = {
-    Inst3{Arg3::None}, /* bad instruction */
+    /*    imm8                imm32                                               */ /*-------- */
+    Inst3{"", "", Arg3::None, B0}, /*                                               bad instr.  */
+    Inst3{"\x6b", "\x69", Arg3::Reg_Reg_Val | Arg3::Reg_Mem_Val, /*                     imul3   */
+          B16 | B32 | B64, B8 | B32, EFwrite},
+    Inst3{"\x0f\xa4", "", Arg3::Reg_Reg_Val | Arg3::Mem_Reg_Val, /*                     shld    */
+          B16 | B32 | B64, B8, EFwrite},
+    Inst3{"\x0f\xac", "", Arg3::Reg_Reg_Val | Arg3::Mem_Reg_Val, /*                     shrd    */
+          B16 | B32 | B64, B8, EFwrite},
+    ONEJIT_COMMENT() /* [CPUID SSE2] is required by the following instructions --------------- */
+    Inst3{"\x66\x0f\xc5", "", Arg3::Reg_Xmm_Val, B32, B8}, /*                           pextrw  */
+    ONEJIT_COMMENT() /* [CPUID SSE4.1] is required by the following instructions ------------- */
+    Inst3{"\x66\x0f\x3a\x17", "", Arg3::Reg_Xmm_Val | Arg3::Mem_Xmm_Val, B32, B8}, /*   extractps */
+    Inst3{"\x66\x0f\x3a\x21", "", Arg3::Xmm_Xmm_Val | Arg3::Xmm_Mem_Val, B0, B8},  /*   insertps  */
+    /*    pinsrd, pinsrq. pinsrb and pinsrw are derived from it                   */ /*-------- */
+    Inst3{"\x66\x0f\x3a\x22", "", Arg3::Xmm_Reg_Val | Arg3::Xmm_Mem_Val, /*             pinsr   */
+          B8 | B16 | B32 | B64, B8},
 };
 
 const Inst3 &Asm3::find(OpStmt3 op) noexcept {
-  /// TODO: implement
-  (void)op;
-  return inst3_vec[0];
+  size_t i = 0;
+  if (op >= X86_IMUL3 && op <= X86_PINSR) {
+    i = size_t(op) - X86_IMUL3 + 1;
+  }
+  return inst3_vec[i];
+}
+
+static Reg to_reg(const Node &node) noexcept {
+  if (Var v = node.is<Var>()) {
+    return Reg{v.local()};
+  }
+  return Reg{};
+}
+
+static bool is_xmm(Reg reg) noexcept {
+  return reg.reg_id() >= XMM0 && reg.reg_id() <= XMM31;
+}
+
+// return the width of a register or memory argument
+static Bits width_of(const Node &node) noexcept {
+  if (Mem mem = node.is<Mem>()) {
+    return mem.kind().bits();
+  }
+  return to_reg(node).kind().bits();
+}
+
+// return false if node is a register not supported by x64::Asm3
+static bool is_valid_reg(const Node &node) noexcept {
+  Reg reg = to_reg(node);
+  return !reg || !is_xmm(reg) || reg.reg_id() <= XMM15;
+}
+
+static Assembler &asm3_add_imm(Assembler &dst, size_t imm_bytes, int64_t val) noexcept {
+  uint8_t buf[4] = {};
+  size_t len = Util::insert_offset_or_imm(buf, 0, imm_bytes, int32_t(val));
+  return dst.add(Bytes{buf, len});
+}
+
+static ONEJIT_NOINLINE Assembler &asm3_emit_pinsr(Assembler &dst, const Stmt3 &st,
+                                                  const Inst3 &inst, int64_t val) noexcept {
+  Node arg0 = st.child(0), arg1 = st.child(1);
+  const Bits src_size = width_of(arg1);
+  // pinsrb and pinsrw have different opcodes than pinsrd and pinsrq
+  static const Opcode pinsrb{"\x66\x0f\x3a\x20"}, pinsrw{"\x66\x0f\xc4"};
+  Bytes opcode = src_size == Bits8    ? pinsrb.bytes()
+                 : src_size == Bits16 ? pinsrw.bytes()
+                                      : inst.imm8_bytes();
+  if (Reg reg = to_reg(arg1)) {
+    // narrower general registers are encoded as 32-bit registers
+    if (src_size < Bits32) {
+      arg1 = Var{Reg{Uint32, reg.reg_id()}};
+    }
+  }
+  Util::emit_modrm(dst, opcode, src_size == Bits64 ? Bits64 : Bits0, to_reg(arg0), arg1);
+  return asm3_add_imm(dst, 1, val);
 }
 
 Assembler &Asm3::emit(Assembler &dst, const Stmt3 &st, const Inst3 &inst) noexcept {
@@ -39,13 +111,60 @@ Assembler &Asm3::emit(Assembler &dst, const Stmt3 &st, const Inst3 &inst) noexce
   Node arg2 = st.child(2);
   if (!is_compatible(arg0, arg1, arg2, inst.arg())) {
     return dst.error(st, "x64::Asm3::emit: instruction does not support specified argument types");
+  } else if (!is_valid_reg(arg0) || !is_valid_reg(arg1)) {
+    return dst.error(st, "x64::Asm3::emit: unsupported register, %xmm16...%xmm31 require EVEX");
   }
-
-  return dst.error(st, "unimplemented x64::Asm3::emit");
+  Const c = arg2.is<Const>();
+  if (!c) {
+    return dst.error(st, "x64::Asm3::emit: instruction does not support labels");
+  }
+  const OpStmt3 op = st.op();
+  const int64_t val = c.val().int64();
+  // the argument that determines operand-size prefix and REX.W
+  const Bits size = is_xmm(to_reg(arg0)) ? width_of(arg1) : width_of(arg0);
+  if (inst.arg_size() != B0 && !is_compatible(size, inst.arg_size())) {
+    return dst.error(st, "x64::Asm3::emit: instruction does not support specified argument width");
+  }
+  switch (op) {
+  case X86_IMUL3: {
+    if (width_of(arg1) != size) {
+      return dst.error(st, "x64::Asm3::emit: arguments have different width");
+    } else if (val == int64_t(int8_t(val))) {
+      Util::emit_modrm(dst, inst.imm8_bytes(), size, to_reg(arg0), arg1);
+      return asm3_add_imm(dst, 1, val);
+    } else if (size == Bits64 && val != int64_t(int32_t(val))) {
+      return dst.error(st, "x64::Asm3::emit: immediate does not fit 32 bits");
+    }
+    Util::emit_modrm(dst, inst.imm32_bytes(), size, to_reg(arg0), arg1);
+    return asm3_add_imm(dst, size == Bits16 ? 2 : 4, val);
+  }
+  case X86_SHLD:
+  case X86_SHRD:
+    if (width_of(arg1) != size) {
+      return dst.error(st, "x64::Asm3::emit: arguments have different width");
+    }
+    // first argument is stored in ModRM.rm
+    Util::emit_modrm(dst, inst.imm8_bytes(), size, to_reg(arg1), arg0);
+    break;
+  case X86_EXTRACTPS:
+    // first argument is stored in ModRM.rm
+    Util::emit_modrm(dst, inst.imm8_bytes(), Bits0, to_reg(arg1), arg0);
+    break;
+  case X86_PINSR:
+    return asm3_emit_pinsr(dst, st, inst, val);
+  default:
+    Util::emit_modrm(dst, inst.imm8_bytes(), Bits0, to_reg(arg0), arg1);
+    break;
+  }
+  return asm3_add_imm(dst, 1, val);
 }
 
 Assembler &Asm3::emit(Assembler &dst, const Stmt3 &st) noexcept {
-  return emit(dst, st, find(st.op()));
+  const OpStmt3 op = st.op();
+  if (op >= X86_VADDPD && op <= X86_VXORPS) {
+    return AsmV::emit(dst, st);
+  }
+  return emit(dst, st, find(op));
 }
 
 } // namespace x64
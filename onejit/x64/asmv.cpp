@@ -0,0 +1,357 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * asmv.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/assembler.hpp>
+#include <onejit/bits.hpp> // Bits
+#include <onejit/ir/const.hpp>
+#include <onejit/ir/stmt2.hpp>
+#include <onejit/ir/stmt3.hpp>
+#include <onejit/ir/stmt4.hpp>
+#include <onejit/x64/asm.hpp>
+#include <onejit/x64/inst.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/scale.hpp>
+#include <onejit/x64/util.hpp>
+
+namespace onejit {
+namespace x64 {
+
+using namespace onejit;
+
+// shortcuts for implied prefix and opcode map
+enum : uint8_t { NP = 0, P66 = 1, PF3 = 2, PF2 = 3 };
+enum : uint8_t { M0F = 1, M0F38 = 2 };
+
+static constexpr uint8_t KindElem = InstV::KindElem;
+static constexpr uint8_t VexOnly = InstV::VexOnly;
+
+static const InstV instv2_vec[] = {
+    /*    pp  map   load  store elem flags                                          */ /*-------- */
+    InstV{NP, 0, 0, 0, 0}, /*                                                       bad instr.  */
+    InstV{P66, M0F38, 0x19, 0, 8, InstV::Broadcast | InstV::Wide},  /* vbroadcastsd */
+    InstV{P66, M0F38, 0x18, 0, 4, InstV::Broadcast},                /* vbroadcastss */
+    InstV{P66, M0F, 0x28, 0x29, 8},                                 /* vmovapd      */
+    InstV{NP, M0F, 0x28, 0x29, 4},                                  /* vmovaps      */
+    InstV{P66, M0F, 0x6f, 0x7f, 0, KindElem},                       /* vmovdqa      */
+    InstV{PF3, M0F, 0x6f, 0x7f, 0, KindElem | InstV::ByteWord},     /* vmovdqu      */
+    InstV{P66, M0F, 0x10, 0x11, 8},                                 /* vmovupd      */
+    InstV{NP, M0F, 0x10, 0x11, 4},                                  /* vmovups      */
+    InstV{P66, M0F38, 0x78, 0, 1, InstV::Broadcast},                /* vpbroadcastb */
+    InstV{P66, M0F38, 0x58, 0, 4, InstV::Broadcast},                /* vpbroadcastd */
+    InstV{P66, M0F38, 0x59, 0, 8, InstV::Broadcast},                /* vpbroadcastq */
+    InstV{P66, M0F38, 0x79, 0, 2, InstV::Broadcast},                /* vpbroadcastw */
+};
+
+static const InstV instv3_vec[] = {
+    /*    pp  map   load  store elem flags                                          */ /*-------- */
+    InstV{NP, 0, 0, 0, 0}, /*                                                       bad instr.  */
+    InstV{P66, M0F, 0x58, 0, 8},                                    /* vaddpd       */
+    InstV{NP, M0F, 0x58, 0, 4},                                     /* vaddps       */
+    InstV{P66, M0F, 0x54, 0, 8},                                    /* vandpd       */
+    InstV{NP, M0F, 0x54, 0, 4},                                     /* vandps       */
+    InstV{P66, M0F, 0x5e, 0, 8},                                    /* vdivpd       */
+    InstV{NP, M0F, 0x5e, 0, 4},                                     /* vdivps       */
+    InstV{P66, M0F, 0x5f, 0, 8},                                    /* vmaxpd       */
+    InstV{NP, M0F, 0x5f, 0, 4},                                     /* vmaxps       */
+    InstV{P66, M0F, 0x5d, 0, 8},                                    /* vminpd       */
+    InstV{NP, M0F, 0x5d, 0, 4},                                     /* vminps       */
+    InstV{P66, M0F, 0x59, 0, 8},                                    /* vmulpd       */
+    InstV{NP, M0F, 0x59, 0, 4},                                     /* vmulps       */
+    InstV{P66, M0F, 0x56, 0, 8},                                    /* vorpd        */
+    InstV{NP, M0F, 0x56, 0, 4},                                     /* vorps        */
+    InstV{P66, M0F, 0xfc, 0, 1},                                    /* vpaddb       */
+    InstV{P66, M0F, 0xfe, 0, 4},                                    /* vpaddd       */
+    InstV{P66, M0F, 0xd4, 0, 8},                                    /* vpaddq       */
+    InstV{P66, M0F, 0xfd, 0, 2},                                    /* vpaddw       */
+    InstV{P66, M0F, 0xdb, 0, 0, KindElem},                          /* vpand        */
+    InstV{P66, M0F, 0xdf, 0, 0, KindElem},                          /* vpandn       */
+    InstV{P66, M0F, 0x74, 0, 1, VexOnly},                           /* vpcmpeqb     */
+    InstV{P66, M0F, 0x76, 0, 4, VexOnly},                           /* vpcmpeqd     */
+    InstV{P66, M0F38, 0x29, 0, 8, VexOnly},                         /* vpcmpeqq     */
+    InstV{P66, M0F, 0x75, 0, 2, VexOnly},                           /* vpcmpeqw     */
+    InstV{P66, M0F, 0x64, 0, 1, VexOnly},                           /* vpcmpgtb     */
+    InstV{P66, M0F, 0x66, 0, 4, VexOnly},                           /* vpcmpgtd     */
+    InstV{P66, M0F38, 0x37, 0, 8, VexOnly},                         /* vpcmpgtq     */
+    InstV{P66, M0F, 0x65, 0, 2, VexOnly},                           /* vpcmpgtw     */
+    InstV{P66, M0F38, 0x40, 0, 4},                                  /* vpmulld      */
+    InstV{P66, M0F, 0xd5, 0, 2},                                    /* vpmullw      */
+    InstV{P66, M0F, 0xeb, 0, 0, KindElem},                          /* vpor         */
+    InstV{P66, M0F, 0xf8, 0, 1},                                    /* vpsubb       */
+    InstV{P66, M0F, 0xfa, 0, 4},                                    /* vpsubd       */
+    InstV{P66, M0F, 0xfb, 0, 8},                                    /* vpsubq       */
+    InstV{P66, M0F, 0xf9, 0, 2},                                    /* vpsubw       */
+    InstV{P66, M0F, 0xef, 0, 0, KindElem},                          /* vpxor        */
+    InstV{P66, M0F, 0x5c, 0, 8},                                    /* vsubpd       */
+    InstV{NP, M0F, 0x5c, 0, 4},                                     /* vsubps       */
+    InstV{P66, M0F, 0x57, 0, 8},                                    /* vxorpd       */
+    InstV{NP, M0F, 0x57, 0, 4},                                     /* vxorps       */
+};
+
+static const InstV instv4_vec[] = {
+    /*    pp  map   load  store elem flags                                          */ /*-------- */
+    InstV{NP, 0, 0, 0, 0}, /*                                                       bad instr.  */
+    InstV{P66, M0F, 0xc2, 0, 8, VexOnly},                           /* vcmppd       */
+    InstV{NP, M0F, 0xc2, 0, 4, VexOnly},                            /* vcmpps       */
+};
+
+const InstV &AsmV::find(OpStmt2 op) noexcept {
+  size_t i = 0;
+  if (op >= X86_VBROADCASTSD && op <= X86_VPBROADCASTW) {
+    i = size_t(op) - X86_VBROADCASTSD + 1;
+  }
+  return instv2_vec[i];
+}
+
+const InstV &AsmV::find(OpStmt3 op) noexcept {
+  size_t i = 0;
+  if (op >= X86_VADDPD && op <= X86_VXORPS) {
+    i = size_t(op) - X86_VADDPD + 1;
+  }
+  return instv3_vec[i];
+}
+
+const InstV &AsmV::find(OpStmt4 op) noexcept {
+  size_t i = 0;
+  if (op >= X86_VCMPPD && op <= X86_VCMPPS) {
+    i = size_t(op) - X86_VCMPPD + 1;
+  }
+  return instv4_vec[i];
+}
+
+static Reg to_reg(const Node &node) noexcept {
+  if (Var v = node.is<Var>()) {
+    return Reg{v.local()};
+  }
+  return Reg{};
+}
+
+static bool is_vreg(Reg reg) noexcept {
+  return reg.reg_id() >= XMM0 && reg.reg_id() <= XMM31;
+}
+
+// return the number 0...31 of a %xmm, %ymm or %zmm register
+static uint8_t vnum(Reg reg) noexcept {
+  return is_vreg(reg) ? uint8_t(uint32_t(reg.reg_id()) - XMM0) : 0;
+}
+
+// return the vector length of a %xmm, %ymm or %zmm register, or Bits0 if not supported.
+// registers containing a scalar are %xmm
+static Bits vlen_of(Reg reg) noexcept {
+  if (!is_vreg(reg)) {
+    return Bits0;
+  }
+  const Bits bits = reg.kind().bits();
+  if (bits.val() <= 128) {
+    return Bits128;
+  }
+  return bits == Bits256 || bits == Bits512 ? bits : Bits0;
+}
+
+// return element width in bytes, which determines EVEX.W and disp8*N compression
+static uint8_t elem_bytes(const InstV &inst, Reg reg) noexcept {
+  if (!inst.is(InstV::KindElem)) {
+    return inst.elem_bytes();
+  }
+  const size_t bytes = reg.kind().nosimd().bits().val() / 8;
+  if (inst.is(InstV::ByteWord) && (bytes == 1 || bytes == 2)) {
+    return uint8_t(bytes);
+  }
+  return bytes == 8 ? 8 : 4;
+}
+
+// return true if instruction needs EVEX encoding
+static bool is_evex(Bits vlen, Reg reg, Reg vvvv, const Node &rm) noexcept {
+  return vlen == Bits512 || vnum(reg) >= 16 || vnum(vvvv) >= 16 || vnum(to_reg(rm)) >= 16;
+}
+
+// add to dst the VEX or EVEX prefix, the opcode, the ModRM byte followed by SIB byte
+// and displacement if 'rm' is a Mem, and the imm8 if 'imm8' >= 0.
+//
+// ModRM.reg field is set to 'reg', VEX.vvvv to 'vvvv' if valid,
+// and ModRM.rm field to 'rm', which must be a Var containing a Reg or a Mem.
+static ONEJIT_NOINLINE Assembler &asmv_emit(Assembler &dst, const Node &st, const InstV &inst,
+                                            uint8_t opcode, Bits vlen, Reg reg, Reg vvvv,
+                                            const Node &rm, int imm8) noexcept {
+  const bool evex = is_evex(vlen, reg, vvvv, rm);
+  if (evex && inst.is(InstV::VexOnly)) {
+    return dst.error(st, "x64::AsmV::emit: instruction has no EVEX encoding, "
+                         "%zmm and %xmm16...%xmm31 are not supported");
+  }
+  Mem mem = rm.is<Mem>();
+  Reg base, index;
+  Scale scale;
+  uint8_t x = 0, b = 0;
+  if (mem) {
+    if (!Util::validate_mem(dst, mem)) {
+      return dst;
+    }
+    base = Reg{mem.base()};
+    index = Reg{mem.index()};
+    scale = mem.scale();
+    if (scale == Scale0 || !index) {
+      // either scale or index is not set. clear both.
+      index = Reg{};
+      scale = Scale0;
+    }
+    if (!base && !index) {
+      // use RSP as index, it is interpreted as zero
+      index = Reg{Uint64, RSP};
+      scale = Scale1;
+    }
+    x = rhi(index);
+    b = rhi(base);
+  } else {
+    const uint8_t n = vnum(to_reg(rm));
+    x = n >> 4;
+    b = (n >> 3) & 1;
+  }
+  const uint8_t elem = elem_bytes(inst, reg);
+  const uint8_t r = vnum(reg), v = vnum(vvvv);
+  const uint8_t l = vlen == Bits512 ? 2 : vlen == Bits256 ? 1 : 0;
+  uint8_t pp = inst.pp();
+  uint8_t w = 0;
+
+  uint8_t buf[24] = {};
+  size_t len = 0;
+  if (evex) {
+    if (inst.is(InstV::ByteWord) && elem <= 2) {
+      pp = PF2;
+    }
+    w = elem == 8 || (inst.is(InstV::ByteWord) && elem == 2);
+    buf[len++] = 0x62;
+    buf[len++] = uint8_t((~r & 8) << 4 | (~x & 1) << 6 | (~b & 1) << 5 | (~r & 16) | inst.map());
+    buf[len++] = uint8_t(w << 7 | (~v & 15) << 3 | 4 | pp);
+    buf[len++] = uint8_t(l << 5 | (~v & 16) >> 1);
+  } else if (!x && !b && inst.map() == M0F) {
+    buf[len++] = 0xc5;
+    buf[len++] = uint8_t((~r & 8) << 4 | (~v & 15) << 3 | l << 2 | pp);
+  } else {
+    buf[len++] = 0xc4;
+    buf[len++] = uint8_t((~r & 8) << 4 | (~x & 1) << 6 | (~b & 1) << 5 | inst.map());
+    buf[len++] = uint8_t((~v & 15) << 3 | l << 2 | pp);
+  }
+  buf[len++] = opcode;
+  buf[len] = (r & 7) << 3;
+  if (!mem) {
+    buf[len++] |= 0xc0 | (vnum(to_reg(rm)) & 7);
+  } else {
+    size_t offset_bytes = Util::get_offset_minbytes(mem, base, index);
+    int32_t offset = mem.offset();
+    if (evex && offset_bytes != 0 && base && base.reg_id() != RIP && !mem.label()) {
+      // EVEX 8-bit displacement is scaled by memory operand width
+      const int32_t n = inst.is(InstV::Broadcast) ? elem : int32_t(vlen.val() / 8);
+      if (offset % n == 0 && offset / n == int32_t(int8_t(offset / n))) {
+        offset /= n;
+        offset_bytes = 1;
+      } else {
+        offset_bytes = 4;
+      }
+    }
+    len = Util::insert_modrm_sib(buf, len, offset_bytes, base, index, scale);
+    if (offset_bytes != 0) {
+      len = Util::insert_offset_or_imm(buf, len, offset_bytes, offset);
+    }
+  }
+  dst.add(Bytes{buf, len});
+  if (Label label = mem ? mem.label() : Label{}) {
+    // label address is relative only if base register is RIP
+    dst.add_relocation(label, base.reg_id() == RIP);
+  }
+  if (imm8 >= 0) {
+    buf[0] = uint8_t(imm8);
+    dst.add(Bytes{buf, 1});
+  }
+  return dst;
+}
+
+// check that node is a vector register with specified length,
+// or memory with specified width
+static bool is_vreg_or_mem(const Node &node, Bits vlen) noexcept {
+  if (Mem mem = node.is<Mem>()) {
+    return mem.kind().bits() == vlen;
+  }
+  return vlen_of(to_reg(node)) == vlen;
+}
+
+Assembler &AsmV::emit(Assembler &dst, const Stmt2 &st) noexcept {
+  const InstV &inst = find(st.op());
+  if (!inst.opcode()) {
+    return dst.error(st, "x64::AsmV::emit: unimplemented instruction");
+  }
+  Node arg0 = st.child(0), arg1 = st.child(1);
+  Reg reg0 = to_reg(arg0), reg1 = to_reg(arg1);
+  if (arg0.type() == MEM) {
+    // store vector register to memory
+    const Bits vlen = vlen_of(reg1);
+    if (!inst.store_opcode()) {
+      return dst.error(st, "x64::AsmV::emit: instruction does not support memory destination");
+    } else if (vlen == Bits0 || !is_vreg_or_mem(arg0, vlen)) {
+      return dst.error(st, "x64::AsmV::emit: instruction does not support specified arguments");
+    }
+    return asmv_emit(dst, st, inst, inst.store_opcode(), vlen, reg1, Reg{}, arg0, -1);
+  }
+  const Bits vlen = vlen_of(reg0);
+  if (vlen == Bits0) {
+    return dst.error(st, "x64::AsmV::emit: destination must be %xmm, %ymm or %zmm register");
+  } else if (inst.is(InstV::Wide) && vlen == Bits128) {
+    return dst.error(st, "x64::AsmV::emit: instruction requires %ymm or %zmm destination");
+  } else if (inst.is(InstV::Broadcast)) {
+    // source is %xmm register, or memory containing a single element
+    Mem mem = arg1.is<Mem>();
+    if (mem ? mem.kind().bits().val() != inst.elem_bytes() * 8u : vlen_of(reg1) != Bits128) {
+      return dst.error(st, "x64::AsmV::emit: instruction does not support specified arguments");
+    }
+  } else if (!is_vreg_or_mem(arg1, vlen)) {
+    return dst.error(st, "x64::AsmV::emit: arguments have different width");
+  }
+  return asmv_emit(dst, st, inst, inst.opcode(), vlen, reg0, Reg{}, arg1, -1);
+}
+
+Assembler &AsmV::emit(Assembler &dst, const Stmt3 &st) noexcept {
+  const InstV &inst = find(st.op());
+  if (!inst.opcode()) {
+    return dst.error(st, "x64::AsmV::emit: unimplemented instruction");
+  }
+  Node arg2 = st.child(2);
+  Reg reg0 = to_reg(st.child(0)), reg1 = to_reg(st.child(1));
+  const Bits vlen = vlen_of(reg0);
+  if (vlen == Bits0 || vlen_of(reg1) != vlen || !is_vreg_or_mem(arg2, vlen)) {
+    return dst.error(st, "x64::AsmV::emit: arguments must be %xmm, %ymm or %zmm registers "
+                         "or memory with the same width");
+  }
+  return asmv_emit(dst, st, inst, inst.opcode(), vlen, reg0, reg1, arg2, -1);
+}
+
+Assembler &AsmV::emit(Assembler &dst, const Stmt4 &st) noexcept {
+  const InstV &inst = find(st.op());
+  if (!inst.opcode()) {
+    return dst.error(st, "x64::AsmV::emit: unimplemented instruction");
+  }
+  Node arg2 = st.child(2);
+  Reg reg0 = to_reg(st.child(0)), reg1 = to_reg(st.child(1));
+  Const c = st.child(3).is<Const>();
+  const Bits vlen = vlen_of(reg0);
+  if (vlen == Bits0 || vlen_of(reg1) != vlen || !is_vreg_or_mem(arg2, vlen)) {
+    return dst.error(st, "x64::AsmV::emit: arguments must be %xmm, %ymm or %zmm registers "
+                         "or memory with the same width");
+  } else if (!c || c.val().uint64() > 0xff) {
+    return dst.error(st, "x64::AsmV::emit: last argument must be a constant between 0 and 255");
+  }
+  return asmv_emit(dst, st, inst, inst.opcode(), vlen, reg0, reg1, arg2, int(c.val().uint64()));
+}
+
+} // namespace x64
+} // namespace onejit
@@ -18,6 +18,7 @@
 #include <onejit/ir/stmt1.hpp>
 #include <onejit/ir/stmt2.hpp>
 #include <onejit/ir/stmt3.hpp>
+#include <onejit/ir/stmt4.hpp>
 #include <onejit/ir/stmtn.hpp>
 #include <onejit/x64/asm.hpp>
 
@@ -25,20 +26,43 @@ namespace onejit {
 
 // declared in onejit/assembler.hpp
 Assembler &Assembler::x64(const Node &node) noexcept {
+  const size_t start = relocation_.size();
   switch (node.type()) {
+  case LABEL:
+    if (Label l = node.is<Label>()) {
+      const size_t align = label_align(l);
+      onejit::x64::Asm0::emit_nops(*this, (align - size() % align) % align);
+      return add_label(l);
+    }
+    break;
   case STMT_0:
-    return onejit::x64::Asm0::emit(*this, node.is<Stmt0>());
+    onejit::x64::Asm0::emit(*this, node.is<Stmt0>());
+    break;
   case STMT_1:
-    return onejit::x64::Asm1::emit(*this, node.is<Stmt1>());
+    onejit::x64::Asm1::emit(*this, node.is<Stmt1>());
+    break;
   case STMT_2:
-    return onejit::x64::Asm2::emit(*this, node.is<Stmt2>());
+    onejit::x64::Asm2::emit(*this, node.is<Stmt2>());
+    break;
   case STMT_3:
-    return onejit::x64::Asm3::emit(*this, node.is<Stmt3>());
+    onejit::x64::Asm3::emit(*this, node.is<Stmt3>());
+    break;
+  case STMT_4:
+    onejit::x64::AsmV::emit(*this, node.is<Stmt4>());
+    break;
   case STMT_N:
-    return onejit::x64::AsmN::emit(*this, node.is<StmtN>());
+    if (OpStmtN(node.op()) == BLOCK) {
+      return onejit::x64::Relax::emit(*this, node.is<StmtN>());
+    }
+    onejit::x64::AsmN::emit(*this, node.is<StmtN>());
+    break;
   default:
-    return error(node, "unexpected node type in Assembler::x64, expecting Stmt[0123N]");
+    return error(node, "unexpected node type in Assembler::x64, expecting Label or Stmt[01234N]");
   }
+  // relative addresses are computed from the end of the instruction,
+  // which may contain an immediate after the relocated field
+  end_relocations(start);
+  return *this;
 }
 
 } // namespace onejit
@@ -13,22 +13,60 @@
  *      Author Massimiliano Ghilardi
  */
 
+#include <onejit/algorithm.hpp>
+#include <onejit/assembler.hpp>
 #include <onejit/compiler.hpp>
 #include <onejit/func.hpp>
 #include <onejit/ir.hpp>
 #include <onejit/x64/address.hpp>
 #include <onejit/x64/compiler.hpp>
+#include <onejit/x64/isel.hpp>
 #include <onejit/x64/mem.hpp>
+#include <onejit/x64/peephole.hpp>
+#include <onejit/x64/scheduler.hpp>
+#include <onejit/x64/reg.hpp>
+
+#include <algorithm> // std::stable_sort, std::swap
+#include <limits>
 
 namespace onejit {
 
 Compiler &Compiler::compile_x64(Func &func, Opt flags) noexcept {
   compile(func, flags);
-  if (*this && error_.empty()) {
+  Array<float> label_freq;
+  if (*this && error_.empty() && profile_freq(label_freq)) {
     // pass our internal buffers node_ and error_ to x64::Compiler
-    onejit::x64::Compiler{}.compile(func, allocator_, node_, flowgraph_, error_, //
-                                    flags, abi_autodetect(abi_));
+    onejit::x64::Compiler{}.compile(func, allocator_, liveness_, node_, flowgraph_, error_, //
+                                    flags, abi_autodetect(abi_), label_freq);
+  }
+  return *this;
+}
+
+Compiler &Compiler::align_loops(Func &func, Assembler &assembler, size_t boundary) noexcept {
+  Node compiled = func.get_compiled(X64);
+  if (!*this || !compiled) {
+    return *this;
+  }
+  // build flowgraph_ from the final x86_64 code, after scheduling and peephole
+  node_.clear();
+  if (compiled.type() == STMT_N && OpStmtN(compiled.op()) == BLOCK) {
+    for (uint32_t i = 0, n = compiled.children(); i < n; i++) {
+      if (!node_.append(compiled.child(i))) {
+        return out_of_memory(compiled);
+      }
+    }
+  } else if (!node_.append(compiled)) {
+    return out_of_memory(compiled);
+  }
+  Array<float> label_freq, block_freq;
+  if (&func == func_ && !profile_freq(label_freq)) {
+    return *this;
+  } else if (!flowgraph_.build(node_, error_)) {
+    return *this;
+  } else if (!flowgraph_.block_freq(block_freq, label_freq)) {
+    return out_of_memory(compiled);
   }
+  assembler.align_loops(flowgraph_, boundary, block_freq);
   return *this;
 }
 
@@ -40,9 +78,9 @@ Compiler::operator bool() const noexcept {
   return good_ && func_ && *func_;
 }
 
-Compiler &Compiler::compile(Func &func, reg::Allocator &allocator, Array<Node> &node_vec,
-                            FlowGraph &flowgraph, Array<Error> &error_vec, Opt flags,
-                            Abi abi) noexcept {
+Compiler &Compiler::compile(Func &func, reg::Allocator &allocator, reg::Liveness &liveness,
+                            Array<Node> &node_vec, FlowGraph &flowgraph, Array<Error> &error_vec,
+                            Opt flags, Abi abi, const Array<float> &label_freq) noexcept {
   if (func.get_compiled(X64)) {
     // already compiled for x86_64
     return *this;
@@ -56,42 +94,984 @@ Compiler &Compiler::compile(Func &func, reg::Allocator &allocator, Array<Node> &
   node_vec.clear();
   func_ = &func;
   allocator_ = &allocator;
+  liveness_ = &liveness;
   node_ = &node_vec;
   flowgraph_ = &flowgraph;
   error_ = &error_vec;
+  label_freq_ = &label_freq;
   flags_ = flags;
   good_ = bool(func);
 
-  return compile(node).allocate_regs(abi).finish();
+  var_uses_.clear();
+  if (!count_vars(node)) {
+    return out_of_memory(node);
+  }
+  return compile(node)
+      .remove_tests()
+      .schedule(false)
+      .allocate_regs(abi)
+      .peephole()
+      .schedule(true)
+      .finish();
+}
+
+// register classes allocated separately: general purpose registers and XMM registers
+enum : reg::RegClass { GprClass = 0, XmmClass = 1, NumRegClasses = 2 };
+
+// x86_64 has 16 general registers, we reserve RSP and RBX.
+// it also has 16 XMM registers (32 with AVX-512, not used yet)
+static const reg::Color NumColors[NumRegClasses] = {14, 16};
+
+// return the register class of a Var with specified Kind
+static reg::RegClass reg_class(Kind kind) noexcept {
+  return kind.is_float() || kind.nosimd() != kind ? XmmClass : GprClass;
+}
+
+// color i of GprClass is register GprColors[i]: caller-saved registers first
+static const RegId GprColors[] = {RAX, RCX, RDX, RSI, RDI, R8,  R9,
+                                  R10, R11, RBP, R12, R13, R14, R15};
+
+// return the register of class cls that stands for color
+static RegId class_reg(reg::RegClass cls, reg::Color color) noexcept {
+  return cls == GprClass ? GprColors[color] : RegId(uint32_t(XMM0) + color);
+}
+
+RegId color_reg(Kind kind, reg::Color color) noexcept {
+  const reg::RegClass cls = reg_class(kind);
+  return color < NumColors[cls] ? class_reg(cls, color) : RegId(0);
+}
+
+// return true if register id is clobbered by a function call according to abi
+static bool is_caller_saved(Abi abi, RegId id) noexcept {
+  switch (id) {
+  case RAX:
+  case RCX:
+  case RDX:
+  case R8:
+  case R9:
+  case R10:
+  case R11:
+    return true;
+  case RSI:
+  case RDI:
+    return abi != Abi_x64_windows;
+  default:
+    if (id >= XMM0) {
+      // Windows preserves XMM6...XMM15
+      return abi != Abi_x64_windows || id <= XMM5;
+    }
+    // go1 preserves no register
+    return abi == Abi_x64_go1;
+  }
+}
+
+// return the colors of register class cls clobbered by a function call,
+// i.e. the caller-saved registers according to abi
+static uint64_t clobbered_colors(Abi abi, reg::RegClass cls) noexcept {
+  uint64_t colors = 0;
+  for (reg::Color color = 0; color < NumColors[cls]; color++) {
+    if (is_caller_saved(abi, class_reg(cls, color))) {
+      colors |= uint64_t(1) << color;
+    }
+  }
+  return colors;
+}
+
+// return the instruction that copies a Var of specified Kind
+// to another Var (if mem is false) or to a stack slot and back (if mem is true)
+static OpStmt2 move_op(Kind kind, bool mem) noexcept {
+  if (reg_class(kind) == GprClass) {
+    return X86_MOV;
+  } else if (!mem) {
+    // copy the whole XMM register
+    return X86_MOVAPS;
+  }
+  switch (kind.bitsize()) {
+  case 32:
+    return X86_MOVSS;
+  case 64:
+    return X86_MOVSD;
+  case 128:
+    return X86_MOVDQU;
+  default:
+    return X86_VMOVDQU;
+  }
+}
+
+// return true if op is returned by move_op()
+static bool is_move_op(OpStmt2 op) noexcept {
+  switch (op) {
+  case X86_MOV:
+  case X86_MOVAPS:
+  case X86_MOVDQU:
+  case X86_MOVSD:
+  case X86_MOVSS:
+  case X86_VMOVDQU:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// return true if node is a function call
+static bool is_call(Node node) noexcept {
+  return (node.type() == STMT_1 && OpStmt1(node.op()) == X86_CALL) ||
+         (node.type() == STMT_N && OpStmtN(node.op()) == X86_CALL_);
+}
+
+// return true if node copies a Var into another Var with the same Kind,
+// and store the register of each Var into dst and src
+static bool is_move(Node node, reg::Reg &dst, reg::Reg &src) noexcept {
+  const OpStmt2 op = OpStmt2(node.op());
+  if (node.type() != STMT_2 || (op != ASSIGN && op != X86_MOV && op != X86_MOVAPS)) {
+    return false;
+  }
+  Var x = node.child_is<Expr>(0).is<Var>();
+  Var y = node.child_is<Expr>(1).is<Var>();
+  if (!x || !y || x.kind() != y.kind() || x.id().val() < Id::FIRST || y.id().val() < Id::FIRST) {
+    return false;
+  }
+  dst = reg::Reg(x.id().val() - Id::FIRST);
+  src = reg::Reg(y.id().val() - Id::FIRST);
+  return true;
 }
 
+// maximum number of times allocate_regs() inserts spill code and reruns register allocation
+static const uint32_t MaxSpillRounds = 8;
+
+// distance in bytes between stack slots created by spill_regs().
+// pack_slots() later assigns their final offsets
+static const uint32_t SlotSize = 8;
+
+// x86_64 SysV ABI allows leaf functions to use 128 bytes below RSP without adjusting it
+static const uint32_t RedZoneSize = 128;
+
 Compiler &Compiler::allocate_regs(Abi abi) noexcept {
+  if (!split_around_calls(abi)) {
+    return *this;
+  }
+  // Vars created by spill_regs() have short live ranges: they are never spilled again
+  const reg::Reg first_tmp = func_->vars().size();
+  Array<Node> remat;
+  uint32_t slots = 0;
+  for (uint32_t round = 0; round < MaxSpillRounds; round++) {
+    uint32_t n = 0;
+    if (!assign_regs(abi, first_tmp, remat)) {
+      return *this;
+    } else if (!spill_regs(slots, remat, n)) {
+      return *this ? remove_moves().pack_slots(abi, slots) : *this;
+    }
+    slots += n;
+  }
+  return error(Node{}, "register allocation failed: too many spilled registers");
+}
+
+bool Compiler::assign_regs(Abi abi, reg::Reg first_tmp, Array<Node> &remat) noexcept {
   Vars vars = func_->vars();
-  if (allocator_->reset(vars.size())) {
-    fill_interference_graph();
-    set_reg_hints(abi);
-    // x86_64 has 16 general registers, we reserve RSP and RBX
-    allocator_->allocate_regs(14);
+  if (!allocator_->reset(vars.size())) {
+    out_of_memory(Node{});
+    return false;
+  } else if (!compute_liveness()) {
+    return false;
+  } else if (!find_remat(remat)) {
+    out_of_memory(Node{});
+    return false;
+  }
+  const bool coloring = (flags_ & OptRegColoring) != 0;
+  if (coloring) {
+    liveness_->fill_interference_graph(allocator_->graph());
+    Array<float> freq;
+    if (!flowgraph_->block_freq(freq, *label_freq_) ||
+        !liveness_->fill_weights(allocator_->weights(), flowgraph_->loop_depth(), freq)) {
+      out_of_memory(Node{});
+      return false;
+    }
+    Array<float> &weights = allocator_->weights();
+    for (reg::Reg reg = 0, n = weights.size(); reg < n; reg++) {
+      if (reg >= first_tmp) {
+        weights.set(reg, std::numeric_limits<float>::infinity());
+      } else if (remat[reg]) {
+        // spilling a rematerializable Var costs no store and a cheap recomputation per read
+        weights.set(reg, weights[reg] * 0.5f);
+      }
+    }
+  } else if (!liveness_->fill_intervals(allocator_->intervals())) {
+    out_of_memory(Node{});
+    return false;
+  }
+  for (reg::Reg reg = 0, n = vars.size(); reg < n; reg++) {
+    allocator_->set_class(reg, reg_class(vars[reg].kind()));
+  }
+  // registers live across a call cannot use the registers it clobbers
+  Array<reg::LiveAcross> across;
+  if (!liveness_->fill_live_across(is_call, across)) {
+    out_of_memory(Node{});
+    return false;
+  }
+  for (const reg::LiveAcross &entry : across) {
+    allocator_->forbid_colors(entry.reg, clobbered_colors(abi, allocator_->get_class(entry.reg)));
+  }
+  set_reg_hints(abi);
+  add_moves();
+  const View<reg::Color> num_colors{NumColors, NumRegClasses};
+  if (coloring) {
+    if (!allocator_->allocate_regs(num_colors)) {
+      out_of_memory(Node{});
+    }
+  } else {
+    allocator_->linear_scan(num_colors);
+  }
+  return good_;
+}
+
+// return true if evaluating expr reads no Var, i.e. it only contains Consts and Labels
+static bool is_var_free(Expr expr) noexcept {
+  if (expr.type() == VAR) {
+    return false;
+  }
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    Expr child = expr.child_is<Expr>(i);
+    if (child && !is_var_free(child)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// return true if node writes a Var with a value that can be recomputed anywhere
+static bool is_remat(Node node) noexcept {
+  if (node.type() != STMT_2 || !node.child_is<Expr>(0).is<Var>()) {
+    return false;
+  }
+  Expr src = node.child_is<Expr>(1);
+  switch (OpStmt2(node.op())) {
+  case ASSIGN:
+  case X86_MOV:
+    return src.type() == CONST || src.type() == LABEL;
+  case X86_LEA:
+    return is_var_free(src);
+  default:
+    return false;
+  }
+}
+
+bool Compiler::find_remat(Array<Node> &remat) noexcept {
+  const reg::Reg n = func_->vars().size();
+  if (!remat.resize(n)) {
+    return false;
+  }
+  std::fill(remat.begin(), remat.end(), Node{});
+  // VoidConst marks registers already known not to be rematerializable
+  for (reg::Reg reg = 0; reg < n; reg++) {
+    if (liveness_->live_in(0, reg)) {
+      // function parameters and Vars read before being written
+      remat.set(reg, VoidConst);
+    }
+  }
+  Array<reg::Reg> defs, uses;
+  for (Node node : *node_) {
+    defs.clear();
+    uses.clear();
+    defs_uses(node, defs, uses);
+    for (reg::Reg reg : defs) {
+      if (reg < n) {
+        remat.set(reg, !remat[reg] && is_remat(node) ? node : Node{VoidConst});
+      }
+    }
+  }
+  for (reg::Reg reg = 0; reg < n; reg++) {
+    if (remat[reg] == VoidConst) {
+      remat.set(reg, Node{});
+    }
+  }
+  return true;
+}
+
+bool Compiler::split_around_calls(Abi abi) noexcept {
+  Array<reg::LiveAcross> across;
+  if (!allocator_->reset(func_->vars().size())) {
+    out_of_memory(Node{});
+    return false;
+  } else if (!compute_liveness()) {
+    return false;
+  } else if (!liveness_->fill_live_across(is_call, across)) {
+    out_of_memory(Node{});
+    return false;
+  } else if (!across) {
+    return true;
+  }
+  Array<Node> nodes;
+  Array<Var> saved; // pairs (Var, new Var) to restore after current call
+  if (!nodes.reserve(node_->size() + across.size() * 2)) {
+    out_of_memory(Node{});
+    return false;
+  }
+  bool ok = true;
+  size_t k = 0;
+  for (size_t i = 0, n = node_->size(); ok && i < n; i++) {
+    Node node = (*node_)[i];
+    size_t end = k;
+    uint32_t count[NumRegClasses] = {};
+    while (end < across.size() && across[end].node == i) {
+      count[reg_class(func_->vars()[across[end++].reg].kind())]++;
+    }
+    // if a call has more live registers than callee-saved registers of the same class,
+    // copy each of them to a new Var live only across the call, and back after the call:
+    // spilling the new Var costs a single store and load
+    saved.clear();
+    for (; ok && k < end; k++) {
+      const reg::Reg reg = across[k].reg;
+      const reg::RegClass cls = reg_class(func_->vars()[reg].kind());
+      const uint64_t clobbered = clobbered_colors(abi, cls);
+      uint32_t callee_saved = 0;
+      for (reg::Color color = 0; color < NumColors[cls]; color++) {
+        callee_saved += ((clobbered >> color) & 1) == 0;
+      }
+      if (count[cls] > callee_saved) {
+        const Var var = func_->vars()[reg];
+        const Var tmp{*func_, var.kind()};
+        ok = nodes.append(Stmt2{*func_, move_op(var.kind(), false), tmp, var}) &&
+             saved.append(var) && saved.append(tmp);
+      }
+    }
+    ok = ok && nodes.append(node);
+    for (size_t j = 0; ok && j < saved.size(); j += 2) {
+      const Var var = saved[j];
+      ok = nodes.append(Stmt2{*func_, move_op(var.kind(), false), var, saved[j + 1]});
+    }
+  }
+  if (!ok) {
+    out_of_memory(Node{});
+    return false;
+  }
+  node_->swap(nodes);
+  return true;
+}
+
+bool Compiler::spill_regs(uint32_t first_slot, View<Node> remat, uint32_t &slots) noexcept {
+  View<reg::Color> colors = allocator_->get_colors();
+  const reg::Reg n = colors.size();
+  auto spilled = [&](reg::Reg reg) {
+    return reg < n && colors[reg] != reg::NoColor &&
+           colors[reg] >= NumColors[allocator_->get_class(reg)];
+  };
+  // spilled Vars with the same class and color use the same stack slot,
+  // because they never interfere
+  auto slot_index = [&](reg::Reg reg) {
+    const reg::RegClass cls = allocator_->get_class(reg);
+    return uint32_t(colors[reg] - NumColors[cls]) * NumRegClasses + cls;
+  };
+  bool any_spilled = false;
+  slots = 0;
+  for (reg::Reg reg = 0; reg < n; reg++) {
+    if (spilled(reg)) {
+      any_spilled = true;
+      if (!remat[reg]) {
+        slots = max2(slots, slot_index(reg) + 1);
+      }
+    }
+  }
+  if (!any_spilled) {
+    return false;
+  }
+  Array<reg::Reg> alias, defs, uses;
+  Array<Node> nodes;
+  if (!alias.resize(n) || !nodes.reserve(node_->size())) {
+    out_of_memory(Node{});
+    return false;
+  }
+  for (reg::Reg reg = 0; reg < n; reg++) {
+    alias.set(reg, reg);
+  }
+  auto slot = [&](reg::Reg reg) {
+    return spill_slot(func_->vars()[reg].kind(), slot_index(reg) + first_slot);
+  };
+  // load or store reg from or to its stack slot
+  auto load = [&](Var dst, reg::Reg reg) {
+    return Stmt2{*func_, move_op(dst.kind(), true), dst, slot(reg)};
+  };
+  auto store = [&](reg::Reg reg, Var src) {
+    return Stmt2{*func_, move_op(src.kind(), true), slot(reg), src};
+  };
+  // recompute the value of rematerializable reg into dst
+  auto recompute = [&](Expr dst, reg::Reg reg) {
+    Node def = remat[reg];
+    return Stmt2{*func_, OpStmt2(def.op()), dst, def.child_is<Expr>(1)};
+  };
+
+  bool ok = true;
+  reg::Reg dst, src;
+  for (Node node : *node_) {
+    if (is_move(node, dst, src) && spilled(src) && remat[src] && !spilled(dst)) {
+      // copy from a rematerializable spilled Var: recompute it directly
+      if (!nodes.append(recompute(func_->vars()[dst], src))) {
+        out_of_memory(node);
+        return false;
+      }
+      continue;
+    } else if (is_move(node, dst, src) && (spilled(dst) != spilled(src)) && !remat[dst] &&
+               !remat[src]) {
+      // copy between a spilled Var and a Var in a register: load or store directly
+      Node copy = spilled(dst) ? store(dst, func_->vars()[src]) : load(func_->vars()[dst], src);
+      if (!nodes.append(copy)) {
+        out_of_memory(node);
+        return false;
+      }
+      continue;
+    } else if (is_move(node, dst, src) && spilled(dst) && spilled(src) && !remat[dst] &&
+               !remat[src] && slot_index(dst) == slot_index(src)) {
+      // copy between Vars spilled to the same stack slot: nothing to do
+      continue;
+    }
+    defs.clear();
+    uses.clear();
+    defs_uses(node, defs, uses);
+    if (defs.size() == 1 && spilled(defs[0]) && remat[defs[0]] == node) {
+      // definition of a rematerializable spilled Var: it is recomputed before each read
+      continue;
+    }
+    bool any = false;
+    // replace each spilled Var read or written by node with a new Var.
+    // reads are preceded by a load from the stack slot, or by a recomputation
+    for (size_t i = 0, m = uses.size() + defs.size(); ok && i < m; i++) {
+      const bool is_use = i < uses.size();
+      const reg::Reg reg = is_use ? uses[i] : defs[i - uses.size()];
+      if (!spilled(reg) || alias[reg] != reg) {
+        continue;
+      }
+      const Var tmp{*func_, func_->vars()[reg].kind()};
+      alias.set(reg, reg::Reg(tmp.id().val() - Id::FIRST));
+      any = true;
+      if (is_use) {
+        ok = nodes.append(remat[reg] ? recompute(tmp, reg) : load(tmp, reg));
+      }
+    }
+    ok = ok && nodes.append(any ? rename_vars(node, alias) : node);
+    // writes are followed by a store to the stack slot
+    for (reg::Reg reg : defs) {
+      if (ok && spilled(reg) && alias[reg] != reg) {
+        ok = nodes.append(store(reg, func_->vars()[alias[reg]]));
+        alias.set(reg, reg);
+      }
+    }
+    for (reg::Reg reg : uses) {
+      if (reg < n) {
+        alias.set(reg, reg);
+      }
+    }
+    if (!ok) {
+      out_of_memory(node);
+      return false;
+    }
+  }
+  node_->swap(nodes);
+  return true;
+}
+
+Mem Compiler::spill_slot(Kind kind, uint32_t slot) noexcept {
+  return stack_mem(kind, int32_t(slot * SlotSize));
+}
+
+Mem Compiler::stack_mem(Kind kind, int32_t offset) noexcept {
+  Var rsp{Reg{Uint64, RSP}};
+  return Mem{*func_, kind, Address{offset, rsp}};
+}
+
+// return the stack slot accessed by expr, or NoSlot if expr is not a stack slot
+static const uint32_t NoSlot = ~uint32_t(0);
+
+static uint32_t slot_of(Expr expr) noexcept {
+  Mem mem = expr.is<Mem>();
+  if (!mem || mem.label() || mem.index() || Reg{mem.base()}.reg_id() != RSP) {
+    return NoSlot;
+  }
+  return uint32_t(mem.offset()) / SlotSize;
+}
+
+void Compiler::slot_defs_uses(Node node, Array<reg::Reg> &defs, Array<reg::Reg> &uses) noexcept {
+  // spill_regs() only accesses stack slots with (move slot var) and (move var slot),
+  // where move is one of the instructions returned by move_op()
+  if (node.type() == STMT_2 && is_move_op(OpStmt2(node.op()))) {
+    uint32_t slot = slot_of(node.child_is<Expr>(0));
+    if (slot != NoSlot) {
+      defs.append(slot);
+    } else if ((slot = slot_of(node.child_is<Expr>(1))) != NoSlot) {
+      uses.append(slot);
+    }
+  }
+}
+
+// return true if nodes contain no function calls
+static bool is_leaf(View<Node> nodes) noexcept {
+  for (Node node : nodes) {
+    if (is_call(node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// return the smallest frame size >= bytes that keeps RSP aligned to 16 bytes after
+// pushing 'pushes' registers: the caller's CALL pushed the 8-byte return address,
+// thus frame + 8 * pushes must be 8 (mod 16)
+static uint32_t align_frame(uint32_t bytes, uint32_t pushes) noexcept {
+  const uint32_t pushed = pushes * 8;
+  return ((bytes + pushed + 7) & ~uint32_t(15)) + 8 - pushed;
+}
+
+void Compiler::mark_colors(Node node, uint64_t used[]) const noexcept {
+  if (Var var = node.is<Var>()) {
+    View<reg::Color> colors = allocator_->get_colors();
+    const uint32_t id = var.id().val();
+    if (id >= Id::FIRST && id - Id::FIRST < colors.size()) {
+      const reg::Color color = colors[id - Id::FIRST];
+      if (color < NumColors[reg_class(var.kind())]) {
+        used[reg_class(var.kind())] |= uint64_t(1) << color;
+      }
+    }
+  } else if (node.type() != LABEL) {
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      mark_colors(node.child(i), used);
+    }
+  }
+}
+
+bool Compiler::saved_regs(Abi abi, Array<RegId> &saved) noexcept {
+  uint64_t used[NumRegClasses] = {};
+  for (Node node : *node_) {
+    mark_colors(node, used);
+  }
+  saved.clear();
+  for (reg::RegClass cls = 0; cls < NumRegClasses; cls++) {
+    // a register that is not clobbered by calls must be preserved for our caller
+    const uint64_t callee_saved = used[cls] & ~clobbered_colors(abi, cls);
+    for (reg::Color color = 0; color < NumColors[cls]; color++) {
+      if (((callee_saved >> color) & 1) != 0 && !saved.append(class_reg(cls, color))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+Compiler &Compiler::pack_slots(Abi abi, uint32_t slots) noexcept {
+  const bool leaf = is_leaf(*node_);
+  // callee-saved registers written by the function: general registers are pushed,
+  // XMM registers are stored in the frame above the stack slots
+  Array<RegId> saved;
+  if (!saved_regs(abi, saved)) {
+    return out_of_memory(Node{});
+  }
+  uint32_t pushes = 0;
+  while (pushes < saved.size() && saved[pushes] < XMM0) {
+    pushes++;
+  }
+  const uint32_t xmm_saved = saved.size() - pushes;
+
+  // stack slots that are live at the same time interfere: color them as registers
+  reg::Allocator packer;
+  Array<uint32_t> size, offset;
+  Array<reg::Color> order;
+  uint32_t frame = 0;
+  if (slots != 0) {
+    if (!packer.reset(slots)) {
+      return out_of_memory(Node{});
+    } else if (!flowgraph_->build(*node_, *error_)) {
+      good_ = false;
+      return *this;
+    } else if (!liveness_->compute(flowgraph_->view(), slots, slot_defs_uses)) {
+      return out_of_memory(Node{});
+    }
+    liveness_->fill_interference_graph(packer.graph());
+    // with one color per stack slot, nothing is spilled
+    if (!packer.allocate_regs(slots)) {
+      return out_of_memory(Node{});
+    }
+  }
+  View<reg::Color> colors = packer.get_colors();
+
+  // size of each color is the largest Kind stored in its stack slots
+  if (!size.resize(slots) || !offset.resize(slots) || !order.resize(slots)) {
+    return out_of_memory(Node{});
+  }
+  for (Node node : *node_) {
+    if (slots != 0 && node.type() == STMT_2 && is_move_op(OpStmt2(node.op()))) {
+      for (uint32_t i = 0; i < 2; i++) {
+        Expr expr = node.child_is<Expr>(i);
+        const uint32_t slot = slot_of(expr);
+        if (slot < slots) {
+          const reg::Color color = colors[slot];
+          size.set(color, max2(size[color], uint32_t(max2(expr.kind().bitsize() / 8, size_t(1)))));
+        }
+      }
+    }
+  }
+  // place larger colors first: Kind sizes are powers of two,
+  // thus each stack slot is aligned to its size (up to 16 bytes)
+  for (reg::Color color = 0; color < slots; color++) {
+    order.set(color, color);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&size](reg::Color a, reg::Color b) { return size[a] > size[b]; });
+  for (reg::Color color : order) {
+    offset.set(color, frame);
+    frame += size[color];
+  }
+  // saved XMM registers need 16 bytes each, aligned to 16 bytes
+  const uint32_t xmm_offset = (frame + 15) & ~uint32_t(15);
+  if (xmm_saved != 0) {
+    frame = xmm_offset + xmm_saved * 16;
+  }
+  // the lowest slot address, either RSP after add_frame() or RSP - frame in the red zone,
+  // is then aligned to 16 bytes, and so are 16-byte slots.
+  // functions that call others must align RSP before the calls
+  if (frame != 0 || !leaf) {
+    frame = align_frame(frame, pushes);
+  }
+
+  // leaf functions can place stack slots in the red zone below RSP
+  const bool red_zone = leaf && abi == Abi_x64_sysv && xmm_saved == 0 && frame <= RedZoneSize;
+  const int32_t base = red_zone ? -int32_t(frame) : 0;
+
+  Array<Node> &nodes = *node_;
+  for (size_t i = 0, n = slots != 0 ? nodes.size() : 0; i < n; i++) {
+    Node node = nodes[i];
+    if (node.type() != STMT_2 || !is_move_op(OpStmt2(node.op()))) {
+      continue;
+    }
+    Expr dst = node.child_is<Expr>(0), src = node.child_is<Expr>(1);
+    uint32_t slot;
+    if ((slot = slot_of(dst)) < slots) {
+      dst = stack_mem(dst.kind(), base + int32_t(offset[colors[slot]]));
+    } else if ((slot = slot_of(src)) < slots) {
+      src = stack_mem(src.kind(), base + int32_t(offset[colors[slot]]));
+    } else {
+      continue;
+    }
+    nodes.set(i, Stmt2{*func_, OpStmt2(node.op()), dst, src});
+  }
+  return add_frame(red_zone ? 0 : frame, saved, xmm_offset);
+}
+
+Compiler &Compiler::add_frame(uint32_t frame, View<RegId> saved, uint32_t xmm_offset) noexcept {
+  if (frame == 0 && saved.empty()) {
+    return *this;
   }
+  Var rsp{Reg{Uint64, RSP}};
+  Const bytes{*func_, uint64_t(frame)};
+  Array<Node> prologue, epilogue, nodes;
+  bool ok = true;
+  const size_t n = saved.size();
+  for (size_t i = 0; ok && i < n; i++) {
+    if (saved[i] < XMM0) {
+      ok = prologue.append(Stmt1{*func_, Var{Reg{Uint64, saved[i]}}, X86_PUSH});
+    }
+  }
+  if (ok && frame != 0) {
+    ok = prologue.append(Stmt2{*func_, X86_SUB, rsp, bytes});
+  }
+  // the epilogue restores registers in reverse order
+  for (size_t i = 0, k = 0; ok && i < n; i++) {
+    if (saved[i] >= XMM0) {
+      // save the whole 128 bits
+      const Kind kind = Uint64.simdn(2);
+      Var xmm{Reg{kind, saved[i]}};
+      Mem mem = stack_mem(kind, int32_t(xmm_offset + k++ * 16));
+      ok = prologue.append(Stmt2{*func_, X86_MOVDQU, mem, xmm}) &&
+           epilogue.append(Stmt2{*func_, X86_MOVDQU, xmm, mem});
+    }
+  }
+  if (ok && frame != 0) {
+    ok = epilogue.append(Stmt2{*func_, X86_ADD, rsp, bytes});
+  }
+  for (size_t i = n; ok && i != 0; i--) {
+    if (saved[i - 1] < XMM0) {
+      ok = epilogue.append(Stmt1{*func_, Var{Reg{Uint64, saved[i - 1]}}, X86_POP});
+    }
+  }
+  ok = ok && nodes.reserve(node_->size() + prologue.size());
+  bool prologue_done = false;
+  for (Node node : *node_) {
+    if (!prologue_done && node.type() != LABEL) {
+      // save registers and allocate the stack frame after the initial labels
+      ok = ok && nodes.append(prologue);
+      prologue_done = true;
+    }
+    if (node.type() == STMT_N && OpStmtN(node.op()) == X86_RET) {
+      ok = ok && nodes.append(epilogue);
+    }
+    ok = ok && nodes.append(node);
+  }
+  if (!ok) {
+    return out_of_memory(Node{});
+  }
+  node_->swap(nodes);
   return *this;
 }
 
-Compiler &Compiler::fill_interference_graph() noexcept {
-  if (!flowgraph_->build(*node_, *error_)) {
-    good_ = false;
+Compiler &Compiler::add_moves() noexcept {
+  reg::Reg dst, src;
+  for (Node node : *node_) {
+    if (is_move(node, dst, src)) {
+      allocator_->add_move(dst, src);
+    }
+  }
+  return *this;
+}
+
+static reg::Reg find(Array<reg::Reg> &alias, reg::Reg reg) noexcept {
+  while (alias[reg] != reg) {
+    reg = alias[reg];
+  }
+  return reg;
+}
+
+Compiler &Compiler::remove_moves() noexcept {
+  View<reg::Color> colors = allocator_->get_colors();
+  Array<reg::Reg> alias;
+  if (!alias.resize(colors.size())) {
+    return out_of_memory(Node{});
+  }
+  for (reg::Reg reg = 0, n = colors.size(); reg < n; reg++) {
+    alias.set(reg, reg);
+  }
+  // registers connected by a move and with the same color are the same register:
+  // replace each of them with the lowest one
+  reg::Reg dst, src;
+  bool any = false;
+  for (Node node : *node_) {
+    if (is_move(node, dst, src) && colors[dst] == colors[src]) {
+      dst = find(alias, dst);
+      src = find(alias, src);
+      if (dst != src) {
+        alias.set(max2(dst, src), min2(dst, src));
+      }
+      any = true;
+    }
+  }
+  if (!any) {
     return *this;
   }
-  BitSet &live = allocator_->get_bitset();
-  live.fill(false);
-  // TODO propagate liveness analysis across jumps
-  for (size_t i = node_->size(); i > 0; i--) {
-    Node node = (*node_)[i - 1];
-    update_live_regs(live, node);
+  for (reg::Reg reg = 0, n = alias.size(); reg < n; reg++) {
+    alias.set(reg, find(alias, reg));
+  }
+  Array<Node> &nodes = *node_;
+  size_t j = 0;
+  for (size_t i = 0, n = nodes.size(); i < n; i++) {
+    Node node = rename_vars(nodes[i], alias);
+    if (!is_move(node, dst, src) || dst != src) {
+      nodes.set(j++, node);
+    }
+  }
+  nodes.truncate(j);
+  return *this;
+}
+
+Node Compiler::rename_vars(Node node, View<reg::Reg> alias) noexcept {
+  if (Var var = node.is<Var>()) {
+    const uint32_t id = var.id().val();
+    if (id >= Id::FIRST && alias[id - Id::FIRST] != id - Id::FIRST) {
+      return func_->vars()[alias[id - Id::FIRST]];
+    }
+    return node;
+  }
+  const uint32_t n = node.children();
+  if (n == 0 || node.type() == LABEL) {
+    return node;
+  }
+  Array<Node> children;
+  if (!children.resize(n)) {
+    out_of_memory(node);
+    return node;
+  }
+  bool changed = false;
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = node.child(i);
+    Node new_child = rename_vars(child, alias);
+    children.set(i, new_child);
+    changed = changed || child != new_child;
+  }
+  return changed ? Node::create_indirect(*func_, node.header(), children) : node;
+}
+
+Compiler &Compiler::peephole() noexcept {
+  if (*this && (flags_ & OptPeephole)) {
+    Peephole{*this}.run();
+  }
+  return *this;
+}
+
+Compiler &Compiler::schedule(bool after_regs) noexcept {
+  if (*this && (flags_ & OptSchedule)) {
+    Scheduler{*this, after_regs}.run();
   }
   return *this;
 }
 
-void Compiler::update_live_regs(BitSet & /*live*/, Node /*node*/) noexcept {
+bool Compiler::compute_liveness() noexcept {
+  if (!flowgraph_->build(*node_, *error_)) {
+    good_ = false;
+  } else if (!liveness_->compute(flowgraph_->view(), allocator_->size(), defs_uses)) {
+    out_of_memory(Node{});
+  }
+  return good_;
+}
+
+// append to 'regs' the register of each Var contained in expr
+static void add_regs(Expr expr, Array<reg::Reg> &regs) noexcept {
+  if (Var var = expr.is<Var>()) {
+    const uint32_t id = var.id().val();
+    if (id >= Id::FIRST) {
+      regs.append(reg::Reg(id - Id::FIRST));
+    }
+    return;
+  }
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    add_regs(expr.child_is<Expr>(i), regs);
+  }
+}
+
+// append to 'defs' the register of dst if it's a Var.
+// otherwise dst is a Mem and its address registers are appended to 'uses'
+static void add_dst_regs(Expr dst, bool read_dst, Array<reg::Reg> &defs,
+                         Array<reg::Reg> &uses) noexcept {
+  if (dst.type() == VAR) {
+    add_regs(dst, defs);
+    if (!read_dst) {
+      return;
+    }
+  }
+  add_regs(dst, uses);
+}
+
+// return true if x86_64 instruction writes its first operand without reading it
+static bool is_write_only(OpStmt1 op) noexcept {
+  return (op >= X86_SETA && op <= X86_SETS) || op == X86_POP;
+}
+
+static bool is_write_only(OpStmt2 op) noexcept {
+  switch (op) {
+  case ASSIGN:
+  case X86_BSF:
+  case X86_BSR:
+  case X86_CVTSD2SI:
+  case X86_CVTSD2SS:
+  case X86_CVTSI2SD:
+  case X86_CVTSI2SS:
+  case X86_CVTSS2SD:
+  case X86_CVTSS2SI:
+  case X86_LDDQU:
+  case X86_LEA:
+  case X86_LZCNT:
+  case X86_MOV:
+  case X86_MOVAPD:
+  case X86_MOVAPS:
+  case X86_MOVD:
+  case X86_MOVDQA:
+  case X86_MOVDQU:
+  case X86_MOVQ:
+  case X86_MOVSX:
+  case X86_MOVUPD:
+  case X86_MOVUPS:
+  case X86_MOVZX:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// return true if x86_64 instruction reads its first operand without writing it
+static bool is_read_only(OpStmt1 op) noexcept {
+  switch (op) {
+  case X86_BSWAP:
+  case X86_DEC:
+  case X86_INC:
+  case X86_NEG:
+  case X86_NOT:
+  case INC:
+  case DEC:
+    return false;
+  default:
+    return !is_write_only(op);
+  }
+}
+
+static bool is_read_only(OpStmt2 op) noexcept {
+  return op == X86_BT || op == X86_CMP || op == X86_TEST;
+}
+
+void Compiler::defs_uses(Node node, Array<reg::Reg> &defs, Array<reg::Reg> &uses) noexcept {
+  switch (node.type()) {
+  case STMT_1: {
+    const OpStmt1 op = OpStmt1(node.op());
+    Expr arg = node.child_is<Expr>(0);
+    if (is_read_only(op)) {
+      add_regs(arg, uses);
+    } else {
+      add_dst_regs(arg, !is_write_only(op), defs, uses);
+    }
+    break;
+  }
+  case STMT_2: {
+    const OpStmt2 op = OpStmt2(node.op());
+    Expr dst = node.child_is<Expr>(0);
+    Expr src = node.child_is<Expr>(1);
+    if (is_read_only(op)) {
+      add_regs(dst, uses);
+    } else if (op == X86_XOR && dst.type() == VAR && dst == src) {
+      // xor r, r ignores the value of r
+      add_regs(dst, defs);
+      break;
+    } else if ((op == X86_MOVSD || op == X86_MOVSS) && src.type() == MEM) {
+      // loading a scalar clears the rest of the XMM register
+      add_dst_regs(dst, false, defs, uses);
+    } else {
+      add_dst_regs(dst, !is_write_only(op), defs, uses);
+    }
+    if (op == X86_XCHG || op == X86_XADD) {
+      // both operands are written
+      add_dst_regs(src, true, defs, uses);
+    } else {
+      add_regs(src, uses);
+    }
+    break;
+  }
+  case STMT_3:
+    if (OpStmt3(node.op()) == X86_IMUL3) {
+      // three-operand imul writes its first operand without reading it
+      add_dst_regs(node.child_is<Expr>(0), false, defs, uses);
+      add_regs(node.child_is<Expr>(1), uses);
+      break;
+    }
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      if (Expr expr = node.child_is<Expr>(i)) {
+        add_regs(expr, uses);
+      }
+    }
+    break;
+  case STMT_N:
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      Node child = node.child(i);
+      if (OpStmtN(node.op()) == SET_) {
+        // function prologue: parameters are written
+        add_regs(child.is<Expr>(), defs);
+      } else if (child.type() <= STMT_N) {
+        // for example (set_ dst) inside (x86_call_ ...)
+        defs_uses(child, defs, uses);
+      } else if (Expr expr = child.is<Expr>()) {
+        add_regs(expr, uses);
+      }
+    }
+    break;
+  default:
+    // Label, or other statements. Assume they read all registers they contain
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      if (Expr expr = node.child_is<Expr>(i)) {
+        add_regs(expr, uses);
+      }
+    }
+    break;
+  }
 }
 
 Compiler &Compiler::set_reg_hints(Abi abi) noexcept {
@@ -132,7 +1112,7 @@ Compiler &Compiler::compile(Node node) noexcept {
   case STMT_3:
     return compile(node.is<Stmt3>());
   case STMT_4:
-    return error(node, "unexpected Stmt4");
+    return compile(node.is<Stmt4>());
   case STMT_N:
     return compile(node.is<StmtN>());
   default:
@@ -171,6 +1151,9 @@ Expr Compiler::simplify(Expr expr) noexcept {
 
 // convert onejit::Mem to onejit::x64::Mem
 Expr Compiler::simplify(onejit::Mem expr) noexcept {
+  if (Mem mem = Isel{*this}.select(expr)) {
+    return mem;
+  }
   const uint32_t n = expr.children();
   Array<Expr> children;
   if (!children.resize(n)) {
@@ -220,6 +1203,45 @@ Expr Compiler::simplify(Binary expr) noexcept {
   return expr;
 }
 
+// condition tested by comparison op, in the same order as LSS ... GEQ
+static const Cond cond_signed[] = {CondL, CondLE, CondNE, CondE, CondG, CondGE};
+static const Cond cond_unsigned[] = {CondB, CondBE, CondNE, CondE, CondA, CondAE};
+
+// condition to test after swapping the compared operands
+static const Cond cond_swap[] = {CondB, CondBE, CondA, CondAE, CondE,
+                                 CondL, CondLE, CondG, CondGE, CondNE};
+
+// store in cond the condition tested by (x op y), where xkind is the Kind of x.
+/// @return false if op is not a comparison or xkind is not supported
+static bool to_cond(Op2 op, Kind xkind, Cond &cond) noexcept {
+  if (!is_comparison(op) || !(xkind.is_integer_or_ptr() || xkind == Bool)) {
+    return false;
+  }
+  cond = (xkind.is_signed() ? cond_signed : cond_unsigned)[op - LSS];
+  return true;
+}
+
+Cond Compiler::compare(Expr x, Expr y, Cond cond) noexcept {
+  simplify_binary(x, y);
+  if (x.type() == CONST) {
+    if (y.type() == CONST) {
+      x = to_var(x);
+    } else {
+      // CMP first operand cannot be an immediate
+      std::swap(x, y);
+      cond = cond_swap[cond];
+    }
+  }
+  Const cy = y.is<Const>();
+  if (x.type() == VAR && cy && cy.imm().is_zero()) {
+    // sets eflags exactly as CMP x, 0 and is shorter
+    add(Stmt2{*func_, X86_TEST, x, x});
+  } else {
+    add(Stmt2{*func_, X86_CMP, x, y});
+  }
+  return cond;
+}
+
 void Compiler::simplify_binary(Expr &x, Expr &y) noexcept {
   Expr simpl_x = to_var_mem_const(simplify(x));
   Expr simpl_y = to_var_mem_const(simplify(y));
@@ -260,6 +1282,9 @@ Compiler &Compiler::compile(Stmt2 st) noexcept {
 }
 
 Compiler &Compiler::compile(Assign st) noexcept {
+  if (Isel{*this}.select(st)) {
+    return *this;
+  }
   Expr src = st.src(), dst = st.dst();
   // simplify src first: its side effects, if any, must be applied before dst
   //
@@ -288,6 +1313,9 @@ Node Compiler::simplify_assign(Assign st, Expr dst, Expr src) noexcept {
     switch (src.type()) {
     case VAR:
     case MEM:
+      // XMM registers are copied with SSE instructions
+      op = move_op(dst.kind(), src.type() == MEM || dst.type() == MEM);
+      break;
     case CONST:
     case LABEL:
       op = X86_MOV;
@@ -338,32 +1366,60 @@ Node Compiler::simplify_assign(Assign st, Expr dst, Tuple src) noexcept {
 }
 
 Node Compiler::simplify_assign(Assign st, Expr dst, Binary src) noexcept {
+  Cond cond;
+  if ((dst.kind() == Bool || dst.kind().ebits() == eBits8) &&
+      to_cond(src.op(), src.x().kind(), cond)) {
+    // SETcc writes a single byte
+    cond = compare(src.x(), src.y(), cond);
+    return Stmt1{*func_, dst, OpStmt1(X86_SETA + cond)};
+  }
   // TODO
-  (void)dst;
-  (void)src;
   return st;
 }
 
 // ===============================  compile(Stmt3)  ============================
 
 Compiler &Compiler::compile(Stmt3 st) noexcept {
-  static const OpStmt1 cond_jump[] = {X86_JA, X86_JAE, X86_JB, X86_JBE, X86_JE,
-                                      X86_JG, X86_JGE, X86_JL, X86_JLE, X86_JNE};
   const OpStmt3 op3 = st.op();
   if (op3 >= ASM_JA && op3 <= ASM_JNE) {
-    const OpStmt1 op1 = cond_jump[op3 - ASM_JA];
-
-    Label to = st.child_is<Label>(0);
-    Expr x = st.child_is<Expr>(1);
-    Expr y = st.child_is<Expr>(2);
-    simplify_binary(x, y);
-    add(Stmt2{*func_, X86_CMP, x, y});
-    return add(Stmt1{*func_, to, op1});
+    return compile_cond(st, st.child_is<Expr>(1), st.child_is<Expr>(2), Cond(op3 - ASM_JA));
   } else {
     return error(st, "unexpected Stmt3");
   }
 }
 
+// ===============================  compile(Stmt4)  ============================
+
+Compiler &Compiler::compile(Stmt4 st) noexcept {
+  const OpStmt4 op4 = st.op();
+  if (op4 >= ASM_CMOVA && op4 <= ASM_CMOVNE) {
+    return compile_cond(st, st.child_is<Expr>(2), st.child_is<Expr>(3), Cond(op4 - ASM_CMOVA));
+  } else {
+    return error(st, "unexpected Stmt4");
+  }
+}
+
+Compiler &Compiler::compile_cond(Node st, Expr x, Expr y, Cond cond) noexcept {
+  if (st.type() == STMT_3) {
+    // emitted right before the jump, so that the CPU can fuse them
+    cond = compare(x, y, cond);
+    return add(Stmt1{*func_, st.child_is<Label>(0), OpStmt1(X86_JA + cond)});
+  }
+  Var dst = simplify(st.child_is<Expr>(0)).is<Var>();
+  if (!dst) {
+    return error(st, "unexpected conditional move destination, expecting Var");
+  }
+  // CMOVcc source cannot be an immediate: copy it to a register before CMP
+  Expr src = simplify(st.child_is<Expr>(1));
+  if (src.type() != VAR && src.type() != MEM) {
+    Var v{*func_, src.kind()};
+    add(Stmt2{*func_, X86_MOV, v, src});
+    src = v;
+  }
+  cond = compare(x, y, cond);
+  return add(Stmt2{*func_, OpStmt2(X86_CMOVA + cond), dst, src});
+}
+
 // ===============================  compile(StmtN)  ============================
 
 Compiler &Compiler::compile(StmtN st) noexcept {
@@ -382,12 +1438,122 @@ Compiler &Compiler::compile(StmtN st) noexcept {
 }
 
 Compiler &Compiler::compile(Block st) noexcept {
-  for (size_t i = 0, n = st.children(); i < n; i++) {
-    compile(st.child(i));
+  Array<Assign> defs;
+  for (uint32_t i = 0, n = st.children(); i < n; i++) {
+    Node node = st.child(i);
+    Assign def = forwardable(node);
+    if (def && i + 1 < n && fuse_compare(def, st.child(i + 1))) {
+      i++;
+      continue;
+    }
+    // collect def and the single-use definitions following it
+    defs.clear();
+    for (uint32_t j = i; def && j < n && defs.size() < Isel::MaxFwd; j++) {
+      Assign next = forwardable(st.child(j));
+      if (!next) {
+        break;
+      } else if (!defs.append(next)) {
+        return out_of_memory(node);
+      }
+    }
+    // try to substitute the longest chain of definitions starting with def
+    // into the statement after them, which must be the only one reading the chain
+    bool done = false;
+    for (uint32_t count = defs.size(); count != 0 && !done; count--) {
+      Assign next = i + count < n ? st.child(i + count).is<Assign>() : Assign{};
+      done = next && Isel{*this, View<Assign>{defs.data(), count}}.select(next);
+      if (done) {
+        i += count;
+      }
+    }
+    if (!done) {
+      compile(node);
+    }
   }
   return *this;
 }
 
+// return true if expr contains a function call
+static bool has_call(Expr expr) noexcept {
+  if (expr.type() == TUPLE && OpN(expr.op()) == CALL) {
+    return true;
+  } else if (expr.type() == VAR || expr.type() == LABEL) {
+    return false;
+  }
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    Expr child = expr.child_is<Expr>(i);
+    if (child && has_call(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Compiler::count_vars(Node node) noexcept {
+  if (Var var = node.is<Var>()) {
+    const uint32_t id = var.id().val();
+    if (id >= Id::FIRST) {
+      const uint32_t i = id - Id::FIRST;
+      if (i >= var_uses_.size() && !var_uses_.resize(i + 1)) {
+        return false;
+      }
+      var_uses_.set(i, uint8_t(min2(var_uses_[i] + 1, 0xff)));
+    }
+    return true;
+  } else if (node.type() == LABEL) {
+    return true;
+  }
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    if (!count_vars(node.child(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Assign Compiler::forwardable(Node node) const noexcept {
+  Assign st = node.is<Assign>();
+  Var var = st && st.op() == ASSIGN ? st.dst().is<Var>() : Var{};
+  const uint32_t id = var ? var.id().val() : 0;
+  // var is written once by st and read once
+  if (id < Id::FIRST || id - Id::FIRST >= var_uses_.size() || var_uses_[id - Id::FIRST] != 2 ||
+      has_call(st.src())) {
+    return Assign{};
+  }
+  return st;
+}
+
+bool Compiler::fuse_compare(Assign def, Node next) noexcept {
+  Binary src = def.src().is<Binary>();
+  Var var = def.dst().is<Var>();
+  Cond cond;
+  if (!src || var.kind() != Bool || !to_cond(src.op(), src.x().kind(), cond)) {
+    return false;
+  }
+  // index of the first compared operand in next
+  uint32_t i;
+  Cond test;
+  if (next.type() == STMT_3 && next.op() >= ASM_JA && next.op() <= ASM_JNE) {
+    i = 1;
+    test = Cond(next.op() - ASM_JA);
+  } else if (next.type() == STMT_4 && next.op() >= ASM_CMOVA && next.op() <= ASM_CMOVNE) {
+    i = 2;
+    test = Cond(next.op() - ASM_CMOVA);
+  } else {
+    return false;
+  }
+  // next must test either (var != 0) or (var == 0)
+  Const zero = next.child_is<Expr>(i + 1).is<Const>();
+  if (next.child_is<Expr>(i) != var || !zero || !zero.imm().is_zero() ||
+      (test != CondNE && test != CondE)) {
+    return false;
+  } else if (test == CondE) {
+    cond = Cond(negate_condjump(OpStmt3(ASM_JA + cond)) - ASM_JA);
+  }
+  compile_cond(next, src.x(), src.y(), cond);
+  return true;
+}
+
 Compiler &Compiler::compile(AssignCall st) noexcept {
   return add(st); // TODO
 }
@@ -397,6 +1563,84 @@ Compiler &Compiler::compile(Return st) noexcept {
   return add(Return{*func_, X86_RET, ChildRanges{&children, 1}});
 }
 
+// ===============================  remove_tests()  ============================
+
+// store in cond the condition tested by node.
+/// @return false if node is not a conditional jump, set or move
+static bool to_cond(Node node, Cond &cond) noexcept {
+  const uint16_t op = node.op();
+  if (node.type() == STMT_1 && op >= X86_JA && op <= X86_JNE) {
+    cond = Cond(op - X86_JA);
+  } else if (node.type() == STMT_1 && op >= X86_SETA && op <= X86_SETNE) {
+    cond = Cond(op - X86_SETA);
+  } else if (node.type() == STMT_2 && op >= X86_CMOVA && op <= X86_CMOVNE) {
+    cond = Cond(op - X86_CMOVA);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// return the eflags that node leaves set exactly as TEST x, x would set them
+static EflagsMask flags_like_test(Node node, Var x) noexcept {
+  const EflagsMask none = EflagsMask(0);
+  if (node.type() == STMT_1 && node.child_is<Expr>(0) == x) {
+    switch (OpStmt1(node.op())) {
+    case X86_DEC:
+    case X86_INC:
+    case X86_NEG:
+      return ZF | SF;
+    default:
+      return none;
+    }
+  } else if (node.type() == STMT_2 && node.child_is<Expr>(0) == x) {
+    switch (OpStmt2(node.op())) {
+    case X86_AND:
+    case X86_OR:
+    case X86_XOR:
+      // they also clear CF and OF, as TEST does
+      return Flags::all();
+    case X86_ADD:
+    case X86_SUB:
+      return ZF | SF;
+    case X86_SAR:
+    case X86_SHL:
+    case X86_SHR: {
+      // shift by zero leaves eflags unchanged
+      Const count = node.child_is<Expr>(1).is<Const>();
+      return count && (count.val().uint64() & 0x1f) != 0 ? ZF | SF : none;
+    }
+    default:
+      return none;
+    }
+  }
+  return none;
+}
+
+Compiler &Compiler::remove_tests() noexcept {
+  if (!*this) {
+    return *this;
+  }
+  Node *data = node_->data();
+  const size_t n = node_->size();
+  size_t j = 0;
+  for (size_t i = 0; i < n; i++) {
+    const Node node = data[i];
+    Var x = node.type() == STMT_2 && OpStmt2(node.op()) == X86_TEST ? node.child_is<Var>(0)
+                                                                     : Var{};
+    Cond cond;
+    if (x && node.child_is<Expr>(1) == x && j != 0 && i + 1 < n && to_cond(data[i + 1], cond)) {
+      const EflagsMask need = Flags::read(cond);
+      if ((flags_like_test(data[j - 1], x) & need) == need) {
+        continue;
+      }
+    }
+    data[j++] = node;
+  }
+  node_->truncate(j);
+  return *this;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 Var Compiler::to_var(Expr expr) noexcept {
@@ -17,6 +17,8 @@
 
 #include <onejit/error.hpp>
 #include <onejit/reg/fwd.hpp>
+#include <onejit/x64/flags.hpp>
+#include <onejit/x64/regid.hpp>
 #include <onestl/array.hpp>
 
 namespace onejit {
@@ -30,11 +32,15 @@ namespace x64 {
 class Compiler {
   friend class ::onejit::Compiler;
   friend class Address;
+  friend class Isel;
   friend class Mem;
+  friend class Peephole;
+  friend class Scheduler;
 
 public:
   constexpr Compiler() noexcept //
-      : func_{}, allocator_{}, node_{}, flowgraph_{}, error_{}, flags_{}, good_{true} {
+      : func_{}, allocator_{}, liveness_{}, node_{}, flowgraph_{}, error_{}, var_uses_{},
+        label_freq_{}, flags_{}, good_{true} {
   }
 
   Compiler(Compiler &&other) noexcept = default;
@@ -46,10 +52,11 @@ public:
   explicit operator bool() const noexcept;
 
 private:
-  // private, use onejit::Compiler::compile_x64() instead
-  Compiler &compile(Func &func, reg::Allocator &allocator, Array<Node> &node,      //
-                    FlowGraph &flowgraph, Array<Error> &error, Opt flags, Abi abi) //
-      noexcept;
+  // private, use onejit::Compiler::compile_x64() instead.
+  // label_freq is filled by onejit::Compiler::profile_freq()
+  Compiler &compile(Func &func, reg::Allocator &allocator, reg::Liveness &liveness,
+                    Array<Node> &node, FlowGraph &flowgraph, Array<Error> &error, Opt flags,
+                    Abi abi, const Array<float> &label_freq) noexcept;
 
   Compiler &compile(Assign stmt) noexcept;
   Compiler &compile(AssignCall stmt) noexcept;
@@ -60,8 +67,12 @@ private:
   Compiler &compile(Stmt1 stmt) noexcept;
   Compiler &compile(Stmt2 stmt) noexcept;
   Compiler &compile(Stmt3 stmt) noexcept;
+  Compiler &compile(Stmt4 stmt) noexcept;
   Compiler &compile(StmtN stmt) noexcept;
 
+  // emit conditional jump or move st, testing (x cond y) instead of its own condition
+  Compiler &compile_cond(Node st, Expr x, Expr y, Cond cond) noexcept;
+
   Expr simplify(Binary expr) noexcept;
   Expr simplify(Expr expr) noexcept;
   Expr simplify(onejit::Mem expr) noexcept;
@@ -75,6 +86,29 @@ private:
 
   void simplify_binary(Expr &x, Expr &y) noexcept;
 
+  // emit the comparison between x and y needed by a conditional instruction:
+  // TEST if y is zero, otherwise CMP, swapping x and y if x is a constant.
+  /// @return the condition to test after the comparison
+  Cond compare(Expr x, Expr y, Cond cond) noexcept;
+
+  // if def assigns a comparison to a Bool Var, and next is a conditional jump or move
+  // testing such Var against zero, emit the comparison directly followed by the jump or move.
+  /// @return false if not possible. In such case nothing is emitted
+  bool fuse_compare(Assign def, Node next) noexcept;
+
+  // remove each TEST x, x whose result is already set in eflags
+  // by the arithmetic instruction that writes x immediately before it
+  Compiler &remove_tests() noexcept;
+
+  // count in var_uses_ the occurrences of each local Var in node
+  /// @return false if out of memory
+  bool count_vars(Node node) noexcept;
+
+  // return node if it's an Assign (= var expr) whose var is only read once,
+  // so that expr can be substituted into the statement reading var.
+  // otherwise return invalid Assign
+  Assign forwardable(Node node) const noexcept;
+
   constexpr Func *func() const noexcept {
     return func_;
   }
@@ -94,16 +128,94 @@ private:
   // add an already compiled node to compiled list
   Compiler &add(Node node) noexcept;
 
-  // perform register allocation
+  // perform register allocation, using graph coloring if flags_ contain OptRegColoring,
+  // otherwise linear scan. Spilled Vars are moved to stack slots, and allocation is repeated
   Compiler &allocate_regs(Abi abi) noexcept;
 
-  Compiler &fill_interference_graph() noexcept;
+  // called by allocate_regs(): compute liveness and run the register allocator once.
+  // Vars live across a call cannot receive the registers clobbered by the call.
+  // Vars >= first_tmp were created by spill_regs() and get infinite spill weight.
+  // also fills 'remat' by calling find_remat()
+  /// @return false on error
+  bool assign_regs(Abi abi, reg::Reg first_tmp, Array<Node> &remat) noexcept;
+
+  // set remat[reg] to the instruction defining reg, if it is the only definition of reg
+  // and it can be repeated anywhere: a move of a Const or Label, or a LEA without Vars.
+  // otherwise set remat[reg] to Node{}. requires liveness_ to be up to date
+  /// @return false if out of memory
+  bool find_remat(Array<Node> &remat) noexcept;
+
+  // split the live range of Vars live across a call, if the call has more live Vars
+  // than registers it preserves: copy them to new Vars before the call and back after it
+  /// @return false on error
+  bool split_around_calls(Abi abi) noexcept;
+
+  // rewrite each read of a spilled Var as a load from its stack slot into a new Var,
+  // and each write as a store from a new Var into its stack slot.
+  // spilled Vars with a remat[] instruction are instead recomputed before each read,
+  // and need no stack slot.
+  // stack slots used by this call are numbered starting from first_slot,
+  // their count is stored in 'slots'
+  /// @return false if no Var was spilled, or on error
+  bool spill_regs(uint32_t first_slot, View<Node> remat, uint32_t &slots) noexcept;
+
+  /// @return memory of the specified stack slot, before pack_slots() assigns its final offset
+  Mem spill_slot(Kind kind, uint32_t slot) noexcept;
+
+  /// @return memory at specified offset from RSP
+  Mem stack_mem(Kind kind, int32_t offset) noexcept;
+
+  // after spill_regs(), let stack slots never live at the same time share the same offset,
+  // align each one to the size of its Kind, and allocate the stack frame.
+  // small frames of leaf functions are placed in the red zone, if abi has one
+  Compiler &pack_slots(Abi abi, uint32_t slots) noexcept;
+
+  // append to 'defs' the stack slots written by node, and to 'uses' the stack slots read by node.
+  // used as reg::Liveness::DefUse callback by pack_slots()
+  static void slot_defs_uses(Node node, Array<reg::Reg> &defs, Array<reg::Reg> &uses) noexcept;
+
+  // mark in used[cls] the colors assigned to the Vars in node
+  void mark_colors(Node node, uint64_t used[]) const noexcept;
+  // fill 'saved' with the callee-saved registers used by the function, which must be
+  // preserved for the caller according to abi: general registers first, then XMM registers
+  /// @return false if out of memory
+  bool saved_regs(Abi abi, Array<RegId> &saved) noexcept;
+
+  // after the initial labels, push the general registers in 'saved', allocate
+  // a stack frame of specified bytes and store the XMM registers in 'saved' at RSP + xmm_offset.
+  // undo everything before each return
+  Compiler &add_frame(uint32_t frame, View<RegId> saved, uint32_t xmm_offset) noexcept;
+
+  // build flowgraph_ and compute liveness_.
+  /// @return false on error
+  bool compute_liveness() noexcept;
 
-  static void update_live_regs(BitSet &live, Node node) noexcept;
+  // append to 'defs' the registers written by node, and to 'uses' the registers read by node.
+  // used as reg::Liveness::DefUse callback
+  static void defs_uses(Node node, Array<reg::Reg> &defs, Array<reg::Reg> &uses) noexcept;
 
   // set ABI register hints for function params and results
   Compiler &set_reg_hints(Abi abi) noexcept;
 
+  // pass to allocator_ each move between Vars
+  Compiler &add_moves() noexcept;
+
+  // after register allocation, merge the Vars connected by a move that received the same color
+  // and remove the moves that became redundant
+  Compiler &remove_moves() noexcept;
+
+  // replace each Var with the Var of register alias[reg]
+  Node rename_vars(Node node, View<reg::Reg> alias) noexcept;
+
+  // if flags_ contain OptPeephole, rewrite short sequences of instructions
+  // into cheaper ones. See Peephole for details
+  Compiler &peephole() noexcept;
+
+  // if flags_ contain OptSchedule, reorder instructions inside each basic block
+  // to hide latencies. after_regs tells whether registers are already allocated.
+  // See Scheduler for details
+  Compiler &schedule(bool after_regs) noexcept;
+
   // store compiled code into function.set_compiled(X64)
   // invoked by compile(Func)
   Compiler &finish() noexcept;
@@ -116,13 +228,20 @@ private:
 
   Func *func_;
   reg::Allocator *allocator_;
+  reg::Liveness *liveness_;
   Array<Node> *node_;
   FlowGraph *flowgraph_;
   Array<Error> *error_;
+  Array<uint8_t> var_uses_; // occurrences of each local Var, saturated at 255
+  const Array<float> *label_freq_; // see onejit::Compiler::profile_freq()
   Opt flags_;
   bool good_; // !good_ means out of memory
 };
 
+// return the register that stands for the color assigned by x64::Compiler to a Var
+// of specified Kind, or RegId(0) if color means the Var was spilled to the stack
+RegId color_reg(Kind kind, reg::Color color) noexcept;
+
 } // namespace x64
 } // namespace onejit
 
@@ -0,0 +1,164 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * flags.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/ir.hpp>
+#include <onejit/x64/asm.hpp>
+#include <onejit/x64/flags.hpp>
+#include <onejit/x64/inst.hpp>
+
+namespace onejit {
+namespace x64 {
+
+// eflags read by each condition
+static const EflagsMask cond_flags[] = {
+    CF | ZF,      // CondA
+    CF,           // CondAE
+    CF,           // CondB
+    CF | ZF,      // CondBE
+    ZF,           // CondE
+    ZF | SF | OF, // CondG
+    SF | OF,      // CondGE
+    SF | OF,      // CondL
+    ZF | SF | OF, // CondLE
+    ZF,           // CondNE
+};
+
+// return true if the shift or rotate count of node is a non-zero constant
+static bool nonzero_count(Node node, uint32_t i) noexcept {
+  Const count = node.child_is<Expr>(i).is<Const>();
+  // x86_64 masks the count to 5 bits, or 6 bits for 64-bit operands
+  return count && (count.val().uint64() & 0x1f) != 0;
+}
+
+EflagsMask Flags::read(Cond cond) noexcept {
+  return cond_flags[cond];
+}
+
+EflagsMask Flags::read(Node node) noexcept {
+  const EflagsMask none = EflagsMask(0);
+  Eflags eflags = EFread;
+  switch (node.type()) {
+  case STMT_0:
+    eflags = Asm0::find(OpStmt0(node.op())).eflags();
+    break;
+  case STMT_1: {
+    const OpStmt1 op = OpStmt1(node.op());
+    if (op >= X86_JA && op <= X86_JNE) {
+      return read(Cond(op - X86_JA));
+    } else if (op >= X86_SETA && op <= X86_SETNE) {
+      return read(Cond(op - X86_SETA));
+    } else if (op == X86_CALL || op == X86_JMP) {
+      return none;
+    }
+    eflags = Asm1::find(op).eflags();
+    break;
+  }
+  case STMT_2: {
+    const OpStmt2 op = OpStmt2(node.op());
+    if (op >= X86_CMOVA && op <= X86_CMOVNE) {
+      return read(Cond(op - X86_CMOVA));
+    } else if (op == X86_RCL || op == X86_RCR) {
+      return CF;
+    }
+    eflags = Asm2::find(op).eflags();
+    break;
+  }
+  case STMT_3:
+    eflags = Asm3::find(OpStmt3(node.op())).eflags();
+    break;
+  case STMT_N:
+    switch (OpStmtN(node.op())) {
+    case X86_CALL_:
+    case X86_RET:
+    case SET_:
+      return none;
+    default:
+      break;
+    }
+    break;
+  default:
+    if (node.type() == LABEL) {
+      return none;
+    }
+    break;
+  }
+  return (eflags & EFread) ? all() : none;
+}
+
+EflagsMask Flags::written(Node node) noexcept {
+  const EflagsMask none = EflagsMask(0);
+  Eflags eflags = EFnone;
+  switch (node.type()) {
+  case STMT_1: {
+    const OpStmt1 op = OpStmt1(node.op());
+    switch (op) {
+    case X86_CALL:
+      // callee does not preserve eflags
+      return all();
+    case X86_DEC:
+    case X86_INC:
+      // preserve CF
+      return all() ^ CF;
+    default:
+      eflags = Asm1::find(op).eflags();
+      break;
+    }
+    break;
+  }
+  case STMT_2: {
+    const OpStmt2 op = OpStmt2(node.op());
+    switch (op) {
+    case X86_BT:
+    case X86_BTC:
+    case X86_BTR:
+    case X86_BTS:
+      // preserve ZF
+      return CF;
+    case X86_RCL:
+    case X86_RCR:
+    case X86_ROL:
+    case X86_ROR:
+      return nonzero_count(node, 1) ? CF | OF : none;
+    case X86_SAR:
+    case X86_SHL:
+    case X86_SHR:
+      // shift by zero preserves all eflags
+      return nonzero_count(node, 1) ? all() : none;
+    default:
+      eflags = Asm2::find(op).eflags();
+      break;
+    }
+    break;
+  }
+  case STMT_3: {
+    const OpStmt3 op = OpStmt3(node.op());
+    if (op == X86_SHLD || op == X86_SHRD) {
+      return nonzero_count(node, 2) ? all() : none;
+    }
+    eflags = Asm3::find(op).eflags();
+    break;
+  }
+  case STMT_N:
+    // callee does not preserve eflags, and they are not live after return
+    return OpStmtN(node.op()) == X86_CALL_ || OpStmtN(node.op()) == X86_RET ? all() : none;
+  default:
+    // including STMT_0: clc, stc... write a single flag
+    break;
+  }
+  return (eflags & EFwrite) ? all() : none;
+}
+
+} // namespace x64
+} // namespace onejit
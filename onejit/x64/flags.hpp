@@ -0,0 +1,66 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * flags.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_X64_FLAGS_HPP
+#define ONEJIT_X64_FLAGS_HPP
+
+#include <onejit/fwd.hpp>
+#include <onejit/x64/arg.hpp>
+
+namespace onejit {
+namespace x64 {
+
+// conditions tested by conditional instructions, in the same order as
+// ASM_JA ... ASM_JNE, X86_JA ... X86_JNE, X86_SETA ... X86_SETNE and X86_CMOVA ... X86_CMOVNE
+enum Cond : uint8_t {
+  CondA = 0,
+  CondAE = 1,
+  CondB = 2,
+  CondBE = 3,
+  CondE = 4,
+  CondG = 5,
+  CondGE = 6,
+  CondL = 7,
+  CondLE = 8,
+  CondNE = 9,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// eflags read and written by x86_64 instructions,
+// used by passes that reorder or rewrite instructions after lowering
+class Flags {
+public:
+  // all status flags modeled by EflagsMask: CF, PF, ZF, SF and OF
+  static constexpr EflagsMask all() noexcept {
+    return CF | PF | ZF | SF | OF;
+  }
+
+  /// @return the eflags read by condition
+  static EflagsMask read(Cond cond) noexcept;
+
+  /// @return the eflags read by x86_64 instruction node.
+  // instructions not known to the assembler are assumed to read all eflags
+  static EflagsMask read(Node node) noexcept;
+
+  /// @return the eflags surely overwritten by x86_64 instruction node.
+  // eflags left undefined by node are considered overwritten,
+  // while eflags that node may leave unchanged are not
+  static EflagsMask written(Node node) noexcept;
+};
+
+} // namespace x64
+} // namespace onejit
+
+#endif // ONEJIT_X64_FLAGS_HPP
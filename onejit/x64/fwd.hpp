@@ -22,14 +22,20 @@ namespace x64 {
 class Address;
 class Compiler;
 class Emit;
+class Flags;
 class Inst;
 class Inst0;
 class Inst1;
 class Inst2;
 class Inst3;
 class InstN;
+class InstV;
+class Isel;
 class Mem;
+class Opcode;
+class Peephole;
 class Reg;
+class Scheduler;
 
 } // namespace x64
 } // namespace onejit
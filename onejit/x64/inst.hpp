@@ -136,40 +136,124 @@ private:
   BitSize arg_size_; // allowed argument sizes
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// up to 4 bytes of x86 opcode. may start with a mandatory prefix 0x66, 0xf2 or 0xf3
+class Opcode {
+public:
+  template <size_t N>
+  constexpr Opcode(const char (&chars)[N]) noexcept //
+      : len_{uint8_t(N - 1)},                        //
+        bytes_{
+            uint8_t(chars[0]),                //
+            uint8_t(N > 1 ? chars[1] : '\0'), //
+            uint8_t(N > 2 ? chars[2] : '\0'), //
+            uint8_t(N > 3 ? chars[3] : '\0'), //
+        } {
+  }
+
+  constexpr Bytes bytes() const noexcept {
+    return Bytes{bytes_, len_};
+  }
+
+private:
+  uint8_t len_;
+  uint8_t bytes_[4];
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // two-arguments x86 instruction
 class Inst2 : public Inst {
   using Base = Inst;
 
 public:
-  constexpr explicit Inst2(Arg2 arg, BitSize imm_size = B0, Eflags eflags = EFnone) noexcept
-      : Base{imm_size, eflags}, arg_{arg} {
+  constexpr Inst2(Opcode rm, Opcode mr, Opcode imm8, Opcode imm32, //
+                  Arg2 arg,                                         //
+                  BitSize arg_size,                                 //
+                  BitSize imm_size = B0,                            //
+                  Eflags eflags = EFnone) noexcept
+      : Base{imm_size, eflags}, rm_{rm}, mr_{mr}, imm8_{imm8}, imm32_{imm32}, //
+        arg_{arg}, arg_size_{arg_size} {
+  }
+
+  /// @return opcode to use when first argument is a register
+  /// and second argument is a register or memory
+  constexpr Bytes rm_bytes() const noexcept {
+    return rm_.bytes();
+  }
+
+  /// @return opcode to use when first argument is a register or memory
+  /// and second argument is a register
+  constexpr Bytes mr_bytes() const noexcept {
+    return mr_.bytes();
+  }
+
+  /// @return opcode to use when second argument is 8-bit immediate.
+  /// last byte is the ModRM byte, containing the opcode extension
+  constexpr Bytes imm8_bytes() const noexcept {
+    return imm8_.bytes();
+  }
+
+  /// @return opcode to use when second argument is 16-bit or 32-bit immediate,
+  /// or 8-bit immediate with 8-bit first argument.
+  /// last byte is the ModRM byte, containing the opcode extension
+  constexpr Bytes imm32_bytes() const noexcept {
+    return imm32_.bytes();
   }
 
   constexpr Arg2 arg() const noexcept {
     return arg_;
   }
 
+  constexpr BitSize arg_size() const noexcept {
+    return arg_size_;
+  }
+
 private:
-  Arg2 arg_; // allowed argument combinations
+  Opcode rm_;
+  Opcode mr_;
+  Opcode imm8_;
+  Opcode imm32_;
+  Arg2 arg_;         // allowed argument combinations
+  BitSize arg_size_; // allowed argument sizes. B0 means size is implied by the instruction
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-// three-arguments x86 instruction
+// three-arguments x86 instruction. last argument is always an immediate
 class Inst3 : public Inst {
   using Base = Inst;
 
 public:
-  constexpr explicit Inst3(Arg3 arg, BitSize imm_size = B0, Eflags eflags = EFnone) noexcept
-      : Base{imm_size, eflags}, arg_{arg} {
+  constexpr Inst3(Opcode imm8, Opcode imm32, //
+                  Arg3 arg,                  //
+                  BitSize arg_size,          //
+                  BitSize imm_size = B0,     //
+                  Eflags eflags = EFnone) noexcept
+      : Base{imm_size, eflags}, imm8_{imm8}, imm32_{imm32}, arg_{arg}, arg_size_{arg_size} {
+  }
+
+  /// @return opcode to use when third argument is 8-bit immediate
+  constexpr Bytes imm8_bytes() const noexcept {
+    return imm8_.bytes();
+  }
+
+  /// @return opcode to use when third argument is 16-bit or 32-bit immediate
+  constexpr Bytes imm32_bytes() const noexcept {
+    return imm32_.bytes();
   }
 
   constexpr Arg3 arg() const noexcept {
     return arg_;
   }
 
+  constexpr BitSize arg_size() const noexcept {
+    return arg_size_;
+  }
+
 private:
-  Arg3 arg_; // allowed argument combinations
+  Opcode imm8_;
+  Opcode imm32_;
+  Arg3 arg_;         // allowed argument combinations
+  BitSize arg_size_; // allowed argument sizes. B0 means size is implied by the instruction
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -199,6 +283,64 @@ private:
   uint8_t bytes_[3];
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// VEX or EVEX encoded x86 vector instruction
+class InstV {
+public:
+  enum Flags : uint8_t {
+    None = 0,
+    VexOnly = 1 << 0,   // no EVEX encoding: %zmm and %xmm16...%xmm31 are not supported
+    KindElem = 1 << 1,  // element width is the Kind of the vector register
+    ByteWord = 1 << 2,  // EVEX with 8-bit or 16-bit elements uses prefix F2 instead of F3
+    Broadcast = 1 << 3, // source is a scalar in %xmm or memory, copied to each element
+    Wide = 1 << 4,      // requires %ymm or %zmm destination
+  };
+
+  // pp: implied prefix. 0 = none, 1 = 0x66, 2 = 0xF3, 3 = 0xF2
+  // map: opcode map. 1 = 0x0F, 2 = 0x0F 0x38, 3 = 0x0F 0x3A
+  // elem_bytes: width of each element. EVEX.W is set if 8
+  constexpr InstV(uint8_t pp, uint8_t map, uint8_t opcode, uint8_t store_opcode,
+                  uint8_t elem_bytes, uint8_t flags = None) noexcept
+      : pp_{pp}, map_{map}, opcode_{opcode}, store_opcode_{store_opcode},
+        elem_bytes_{elem_bytes}, flags_{flags} {
+  }
+
+  constexpr uint8_t pp() const noexcept {
+    return pp_;
+  }
+
+  constexpr uint8_t map() const noexcept {
+    return map_;
+  }
+
+  // opcode for 'reg = reg/mem'. 0 means invalid instruction
+  constexpr uint8_t opcode() const noexcept {
+    return opcode_;
+  }
+
+  // opcode for 'mem = reg'. 0 means not supported
+  constexpr uint8_t store_opcode() const noexcept {
+    return store_opcode_;
+  }
+
+  // 0 if element width is the Kind of the vector register
+  constexpr uint8_t elem_bytes() const noexcept {
+    return elem_bytes_;
+  }
+
+  constexpr bool is(Flags flag) const noexcept {
+    return (flags_ & flag) != 0;
+  }
+
+private:
+  uint8_t pp_;
+  uint8_t map_;
+  uint8_t opcode_;
+  uint8_t store_opcode_;
+  uint8_t elem_bytes_;
+  uint8_t flags_;
+};
+
 } // namespace x64
 } // namespace onejit
 
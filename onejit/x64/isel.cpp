@@ -0,0 +1,739 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * isel.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/algorithm.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/x64/address.hpp>
+#include <onejit/x64/compiler.hpp>
+#include <onejit/x64/isel.hpp>
+#include <onejit/x64/mem.hpp>
+
+#include <cstring> // std::memset
+
+namespace onejit {
+namespace x64 {
+
+enum : uint32_t {
+  NoCost = 0x10000, // nonterminal cannot be obtained
+  ImulCost = 3,     // imul has higher latency than other integer instructions
+  MaxSum = 8,       // maximum number of children of AddrSum and MemAddr
+};
+
+static uint32_t add_cost(uint32_t a, uint32_t b) noexcept {
+  return min2(a + b, uint32_t(NoCost));
+}
+
+static bool fits_int32(int64_t val) noexcept {
+  return val == int64_t(int32_t(val));
+}
+
+// return true if kind fits a general purpose register
+static bool is_gpr_kind(Kind kind) noexcept {
+  const Bits bits = kind.bits();
+  return kind.is_integer_or_ptr() && kind.nosimd() == kind &&
+         (bits == Bits8 || bits == Bits16 || bits == Bits32 || bits == Bits64);
+}
+
+// return true if expr is the same Var as v
+static bool is_var(Expr expr, Var v) noexcept {
+  Var x = expr.is<Var>();
+  return x && v && x.id().val() == v.id().val();
+}
+
+// return true if expr reads Var v
+static bool reads_var(Expr expr, Var v) noexcept {
+  if (expr.type() == VAR) {
+    return is_var(expr, v);
+  } else if (expr.type() == LABEL) {
+    return false;
+  }
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    Expr child = expr.child_is<Expr>(i);
+    if (child && reads_var(child, v)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// x86_64 instruction that applies the operation of expr to a register
+static OpStmt2 alu_op(Expr expr) noexcept {
+  if (Tuple tuple = expr.is<Tuple>()) {
+    switch (tuple.op()) {
+    case ADD:
+      return X86_ADD;
+    case MUL:
+      return X86_IMUL;
+    case AND:
+      return X86_AND;
+    case OR:
+      return X86_OR;
+    case XOR:
+      return X86_XOR;
+    default:
+      break;
+    }
+  } else if (Binary binary = expr.is<Binary>()) {
+    switch (binary.op()) {
+    case SUB:
+      return X86_SUB;
+    case SHL:
+      return X86_SHL;
+    case SHR:
+      return expr.kind().is_signed() ? X86_SAR : X86_SHR;
+    default:
+      break;
+    }
+  }
+  return BAD_ST2;
+}
+
+// return true if expr has an operation supported by Isel
+static bool is_supported(Expr expr) noexcept {
+  switch (expr.type()) {
+  case VAR:
+  case CONST:
+  case LABEL:
+    return true;
+  case MEM:
+    return OpN(expr.op()) == MEM_OP;
+  case UNARY:
+    return Op1(expr.op()) == NEG1 || Op1(expr.op()) == XOR1;
+  case BINARY:
+  case TUPLE:
+    return alu_op(expr) != BAD_ST2;
+  default:
+    return false;
+  }
+}
+
+// add a register to address: as base if scale is 1 and base is free, otherwise as index
+static void add_reg(Address &address, Var reg, Scale scale) noexcept {
+  if (scale == Scale1 && !address.base) {
+    address.base = reg;
+  } else {
+    address.index = reg;
+    address.scale = scale;
+  }
+}
+
+// without base register, an index scaled by 1 or 2 has a longer encoding than a base
+static void normalize(Address &address) noexcept {
+  if (!address.base && address.index && (address.scale == Scale1 || address.scale == Scale2)) {
+    address.base = address.index;
+    if (address.scale == Scale1) {
+      address.index = Var{};
+    }
+    address.scale = Scale1;
+  }
+}
+
+bool Isel::Shape::valid() const noexcept {
+  return nindex <= 1 && nbase + nindex <= 2 && nlabel <= 1 && fits_int32(offset);
+}
+
+Isel::Shape Isel::Shape::operator+(const Shape &other) const noexcept {
+  return Shape{int64_t(uint64_t(offset) + uint64_t(other.offset)), uint8_t(nbase + other.nbase),
+               uint8_t(nindex + other.nindex), nindex ? scale : other.scale,
+               uint8_t(nlabel + other.nlabel)};
+}
+
+Isel::Isel(Compiler &comp) noexcept
+    : comp_{&comp}, func_{comp.func()}, fwd_{}, fwd_uses_{}, states_{}, kids_{}, good_{true} {
+}
+
+Isel::Isel(Compiler &comp, View<Assign> fwd) noexcept
+    : comp_{&comp}, func_{comp.func()}, fwd_{fwd.size() <= MaxFwd ? fwd : View<Assign>{}},
+      fwd_uses_{}, states_{}, kids_{}, good_{fwd.size() <= MaxFwd} {
+}
+
+uint32_t Isel::find_fwd(Var var) const noexcept {
+  const uint32_t n = fwd_.size();
+  for (uint32_t i = 0; i < n; i++) {
+    if (is_var(fwd_[i].dst(), var)) {
+      return i;
+    }
+  }
+  return n;
+}
+
+bool Isel::start() noexcept {
+  // states_[0] is returned by label() for unsupported expressions
+  State unsupported = {};
+  for (uint32_t nt = 0; nt < NtN; nt++) {
+    unsupported.cost[nt] = NoCost;
+  }
+  states_.clear();
+  kids_.clear();
+  std::memset(fwd_uses_, 0, sizeof(fwd_uses_));
+  good_ = good_ && func_ && states_.append(unsupported);
+  return good_;
+}
+
+bool Isel::select(Assign st) noexcept {
+  const Var dst = st.dst().is<Var>();
+  const Expr src = st.src();
+  const OpStmt2 op = st.op();
+  if (onejit::Mem mem = st.dst().is<onejit::Mem>()) {
+    return op == ASSIGN && select_store(mem, src);
+  } else if (!dst || !is_gpr_kind(dst.kind()) || find_fwd(dst) < fwd_.size() ||
+      (op != SHL_ASSIGN && op != SHR_ASSIGN && src.kind().bits() != dst.kind().bits()) ||
+      !start()) {
+    return false;
+  }
+  const uint32_t index = label(src, true);
+  if (!good_ || index == 0 || !fwd_used_once()) {
+    return false;
+  } else if (op != ASSIGN) {
+    return select_op(st, dst, index);
+  }
+  label_reg(index, dst);
+  if (state(index).cost[NtReg] >= NoCost) {
+    return false;
+  }
+  reduce_reg(index, dst);
+  return true;
+}
+
+bool Isel::select_op(Assign st, Var dst, uint32_t index) noexcept {
+  static const OpStmt2 xop[] = {X86_ADD, X86_SUB, X86_IMUL, BAD_ST2, BAD_ST2,
+                                X86_AND, X86_OR,  X86_XOR,  X86_SHL, X86_SHR};
+  const OpStmt2 op = st.op();
+  if (op < ADD_ASSIGN || op > SHR_ASSIGN) {
+    return false;
+  }
+  OpStmt2 xop2 = xop[op - ADD_ASSIGN];
+  const State &s = state(index);
+  const Kind kind = dst.kind();
+  if (xop2 == X86_SHL || xop2 == X86_SHR) {
+    // shift by a variable number of bits requires %cl, not supported yet
+    Const count = s.expr.is<Const>();
+    if (!count || count.val().uint64() >= kind.bitsize()) {
+      return false;
+    } else if (xop2 == X86_SHR && kind.is_signed()) {
+      xop2 = X86_SAR;
+    }
+    add(Stmt2{*func_, xop2, dst, count});
+    return true;
+  } else if (xop2 == BAD_ST2 || (xop2 == X86_IMUL && kind.bits() == Bits8)) {
+    return false;
+  } else if (xop2 == X86_IMUL && s.rule[NtImm] == ImmConst) {
+    add(Stmt3{*func_, X86_IMUL3, dst, dst, s.expr});
+    return true;
+  }
+  const bool imm = xop2 != X86_IMUL;
+  if (cost_operand(s, imm) >= NoCost) {
+    return false;
+  }
+  Expr operand = reduce_operand(index, imm);
+  add(Stmt2{*func_, xop2, dst, operand});
+  return true;
+}
+
+bool Isel::select_store(onejit::Mem dst, Expr src) noexcept {
+  if (!is_gpr_kind(dst.kind()) || src.kind().bits() != dst.kind().bits() || !start()) {
+    return false;
+  }
+  // label src first: it is evaluated before dst
+  const uint32_t src_index = label(src, true);
+  const uint32_t dst_index = label(dst, false);
+  if (!good_ || src_index == 0 || dst_index == 0 || !fwd_used_once()) {
+    return false;
+  }
+  const State &s = state(src_index);
+  // x86_64 has no memory-to-memory mov
+  const bool imm = s.cost[NtImm] <= s.cost[NtReg];
+  if (state(dst_index).cost[NtMem] >= NoCost || (!imm && s.cost[NtReg] >= NoCost)) {
+    return false;
+  }
+  Expr operand = imm ? s.expr : reduce_reg(src_index, Var{});
+  add(Stmt2{*func_, X86_MOV, reduce_mem(dst_index), operand});
+  return true;
+}
+
+bool Isel::fwd_used_once() const noexcept {
+  for (uint32_t i = 0, n = fwd_.size(); i < n; i++) {
+    if (fwd_uses_[i] != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Mem Isel::select(onejit::Mem expr) noexcept {
+  if (!start()) {
+    return Mem{};
+  }
+  const uint32_t index = label(expr, false);
+  if (!good_ || index == 0 || state(index).cost[NtMem] >= NoCost) {
+    return Mem{};
+  }
+  return reduce_mem(index);
+}
+
+// ===============================  label  =====================================
+
+uint32_t Isel::label(Expr expr, bool addr32) noexcept {
+  const uint32_t fwd = expr.type() == VAR ? find_fwd(expr.is<Var>()) : fwd_.size();
+  if (fwd < fwd_.size()) {
+    // replace the forwarded Var with its definition, and compute it into such Var if needed.
+    // a Var read twice makes select() fail: do not label its definition twice
+    if (fwd_uses_[fwd]++ != 0) {
+      return 0;
+    }
+    const uint32_t index = label(fwd_[fwd].src(), addr32);
+    if (index != 0) {
+      state(index).target = expr.is<Var>();
+    }
+    return index;
+  } else if (!is_supported(expr)) {
+    return 0;
+  }
+  const uint32_t n = expr.type() == VAR || expr.type() == LABEL ? 0 : expr.children();
+  const uint32_t first_kid = kids_.size();
+  if (n > 0xff) {
+    return 0;
+  } else if (!kids_.resize(first_kid + n)) {
+    good_ = false;
+    return 0;
+  }
+  // 32-bit children of Mem cannot be folded into a 64-bit address
+  const bool kid_addr32 = addr32 && expr.type() != MEM;
+  for (uint32_t i = 0; i < n; i++) {
+    const uint32_t k = label(expr.child_is<Expr>(i), kid_addr32);
+    kids_.set(first_kid + i, k);
+  }
+  State s = state(0);
+  s.expr = expr;
+  s.kid = first_kid;
+
+  const Kind kind = expr.kind();
+  const bool addr = is_gpr_kind(kind) && //
+                    (kind.bits() == Bits64 || (addr32 && kind.bits() == Bits32));
+  switch (expr.type()) {
+  case CONST:
+  case LABEL:
+    label_leaf(s, addr);
+    break;
+  case MEM:
+    label_sum(s, NtMem, MemAddr);
+    break;
+  case TUPLE:
+    label_tuple(s, addr);
+    break;
+  case BINARY:
+    label_binary(s, addr);
+    break;
+  default:
+    break;
+  }
+  const uint32_t index = states_.size();
+  if (!states_.append(s)) {
+    good_ = false;
+    return 0;
+  }
+  label_reg(index, Var{});
+  State &r = state(index);
+  if (addr && r.cost[NtReg] < r.cost[NtAddr]) {
+    r.cost[NtAddr] = r.cost[NtReg];
+    r.rule[NtAddr] = AddrReg;
+    r.shape = Shape{0, 1, 0, 1, 0};
+  }
+  return index;
+}
+
+void Isel::label_leaf(State &s, bool addr) noexcept {
+  if (Const c = s.expr.is<Const>()) {
+    const Kind kind = c.kind();
+    const int64_t val = c.val().int64();
+    if (!is_gpr_kind(kind)) {
+      return;
+    }
+    // immediates are sign-extended to 64 bits
+    if (kind.bits() != Bits64 || fits_int32(val)) {
+      s.cost[NtImm] = 0;
+      s.rule[NtImm] = ImmConst;
+    }
+    if (addr && fits_int32(val)) {
+      s.cost[NtAddr] = 0;
+      s.rule[NtAddr] = AddrConst;
+      s.shape = Shape{val, 0, 0, 0, 0};
+    }
+  } else if (addr && s.expr.type() == LABEL) {
+    s.cost[NtAddr] = 0;
+    s.rule[NtAddr] = AddrLabel;
+    s.shape = Shape{0, 0, 0, 0, 1};
+  }
+}
+
+void Isel::label_tuple(State &s, bool addr) noexcept {
+  const Tuple tuple = s.expr.is<Tuple>();
+  if (!addr) {
+    return;
+  } else if (tuple.op() == ADD) {
+    label_sum(s, NtAddr, AddrSum);
+  } else if (tuple.op() == MUL && tuple.children() == 2) {
+    for (uint32_t i = 0; i < 2; i++) {
+      const State &x = state(kid(s, 1 - i));
+      const Const c = state(kid(s, i)).expr.is<Const>();
+      const int64_t val = c ? c.val().int64() : 0;
+      if (x.cost[NtReg] >= NoCost) {
+        continue;
+      } else if (val == 1 || val == 2 || val == 4 || val == 8) {
+        s.rule[NtAddr] = AddrScale;
+        s.shape = Shape{0, uint8_t(val == 1), uint8_t(val != 1), uint8_t(val), 0};
+      } else if (val == 3 || val == 5 || val == 9) {
+        s.rule[NtAddr] = AddrScale1;
+        s.shape = Shape{0, 1, 1, uint8_t(val - 1), 0};
+      } else {
+        continue;
+      }
+      s.cost[NtAddr] = x.cost[NtReg];
+      s.xkid = uint8_t(1 - i);
+      break;
+    }
+  }
+}
+
+void Isel::label_binary(State &s, bool addr) noexcept {
+  const Binary binary = s.expr.is<Binary>();
+  const State &x = state(kid(s, 0));
+  const Const c = state(kid(s, 1)).expr.is<Const>();
+  if (!addr || !c) {
+    return;
+  }
+  const int64_t val = c.val().int64();
+  if (binary.op() == SUB && fits_int32(val) && x.cost[NtAddr] < NoCost) {
+    Shape shape = x.shape;
+    shape.offset -= val;
+    if (shape.valid()) {
+      s.cost[NtAddr] = x.cost[NtAddr];
+      s.rule[NtAddr] = AddrSub;
+      s.shape = shape;
+    }
+  } else if (binary.op() == SHL && val >= 0 && val <= 3 && x.cost[NtReg] < NoCost) {
+    s.cost[NtAddr] = x.cost[NtReg];
+    s.rule[NtAddr] = AddrScale;
+    s.shape = Shape{0, uint8_t(val == 0), uint8_t(val != 0), uint8_t(1 << val), 0};
+    s.xkid = 0;
+  }
+}
+
+void Isel::label_sum(State &s, Nt nt, Rule rule) noexcept {
+  const uint32_t n = s.expr.children();
+  if (n == 0 || n > MaxSum) {
+    return;
+  }
+  const Shape reg = {0, 1, 0, 1, 0};
+  // try all combinations: each child is either an address or a base register
+  for (uint32_t mask = 0; mask < (uint32_t(1) << n); mask++) {
+    Shape shape = {};
+    uint32_t cost = 0;
+    for (uint32_t i = 0; i < n && cost < NoCost; i++) {
+      const State &k = state(kid(s, i));
+      if ((mask >> i) & 1) {
+        cost = add_cost(cost, k.cost[NtAddr]);
+        shape = shape + k.shape;
+      } else {
+        cost = add_cost(cost, k.cost[NtReg]);
+        shape = shape + reg;
+      }
+    }
+    if (cost < s.cost[nt] && shape.valid()) {
+      s.cost[nt] = cost;
+      s.rule[nt] = rule;
+      s.mask = uint8_t(mask);
+      if (nt == NtAddr) {
+        s.shape = shape;
+      }
+    }
+  }
+}
+
+void Isel::label_reg(uint32_t index, Var dst) noexcept {
+  State &s = state(index);
+  uint32_t cost = NoCost;
+  Rule rule = NoRule;
+  auto consider = [&](uint32_t c, Rule r) {
+    if (c < cost) {
+      cost = c;
+      rule = r;
+    }
+  };
+  if (is_gpr_kind(s.expr.kind())) {
+    switch (s.expr.type()) {
+    case VAR:
+      consider(0, RegVar);
+      break;
+    case CONST:
+    case LABEL:
+      consider(1, RegMov);
+      break;
+    case MEM:
+      consider(add_cost(s.cost[NtMem], 1), RegLoad);
+      break;
+    case UNARY:
+      if (same_bits(s)) {
+        consider(add_cost(cost_into(state(kid(s, 0)), dst), 1), RegUnary);
+      }
+      break;
+    case BINARY:
+    case TUPLE:
+      consider(label_alu(s, dst), RegAlu);
+      if (imm_kid(s) < 2) {
+        const State &x = state(kid(s, 1 - imm_kid(s)));
+        consider(add_cost(ImulCost, cost_operand(x, false)), RegImul3);
+      }
+      break;
+    default:
+      break;
+    }
+    // lea is worth it only if the address is not a single register
+    const Shape &sh = s.shape;
+    const Rule addr_rule = s.rule[NtAddr];
+    if (addr_rule != NoRule && addr_rule != AddrReg && sh.nbase + sh.nindex != 0 &&
+        (sh.nbase + sh.nindex != 1 || sh.nindex != 0 || sh.offset != 0 || sh.nlabel != 0)) {
+      consider(add_cost(s.cost[NtAddr], 1), RegLea);
+    }
+  }
+  s.cost[NtReg] = cost;
+  s.rule[NtReg] = rule;
+}
+
+uint32_t Isel::label_alu(State &s, Var dst) noexcept {
+  const OpStmt2 op = alu_op(s.expr);
+  const uint32_t n = s.expr.children();
+  if (n < 2 || (op == X86_IMUL && s.expr.kind().bits() == Bits8)) {
+    return NoCost;
+  } else if (op == X86_SHL || op == X86_SHR || op == X86_SAR) {
+    // shift by a variable number of bits requires %cl, not supported yet
+    const Const count = state(kid(s, 1)).expr.is<Const>();
+    const State &x = state(kid(s, 0));
+    if (!count || count.val().uint64() >= s.expr.kind().bitsize() ||
+        x.expr.kind().bits() != s.expr.kind().bits()) {
+      return NoCost;
+    }
+    s.first = 0;
+    return add_cost(cost_into(x, dst), 1);
+  } else if (!same_bits(s)) {
+    return NoCost;
+  }
+  const bool commutative = op != X86_SUB;
+  const bool imm = op != X86_IMUL;
+  const uint32_t inst_cost = op == X86_IMUL ? uint32_t(ImulCost) : 1;
+  uint32_t best = NoCost;
+  for (uint32_t first = 0; first < (commutative ? n : 1); first++) {
+    uint32_t cost = cost_into(state(kid(s, first)), dst);
+    for (uint32_t i = 0; i < n; i++) {
+      if (i != first) {
+        cost = add_cost(cost, add_cost(inst_cost, cost_operand(state(kid(s, i)), imm)));
+      }
+    }
+    if (cost < best) {
+      best = cost;
+      s.first = uint8_t(first);
+    }
+  }
+  return best;
+}
+
+bool Isel::same_bits(const State &s) const noexcept {
+  const Bits bits = s.expr.kind().bits();
+  for (uint32_t i = 0, n = s.expr.children(); i < n; i++) {
+    if (state(kid(s, i)).expr.kind().bits() != bits) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t Isel::imm_kid(const State &s) const noexcept {
+  if (Tuple tuple = s.expr.is<Tuple>()) {
+    if (tuple.op() == MUL && tuple.children() == 2 && s.expr.kind().bits() != Bits8 &&
+        same_bits(s)) {
+      for (uint32_t i = 2; i != 0; i--) {
+        if (state(kid(s, i - 1)).rule[NtImm] == ImmConst) {
+          return i - 1;
+        }
+      }
+    }
+  }
+  return 2;
+}
+
+uint32_t Isel::cost_into(const State &s, Var dst) const noexcept {
+  if (s.rule[NtReg] == RegVar) {
+    return is_var(s.expr, dst) ? 0 : 1;
+  }
+  return s.cost[NtReg];
+}
+
+uint32_t Isel::cost_operand(const State &s, bool imm) const noexcept {
+  return min2(min2(s.cost[NtReg], s.cost[NtMem]), imm ? s.cost[NtImm] : uint32_t(NoCost));
+}
+
+// ===============================  reduce  ====================================
+
+Var Isel::reduce_reg(uint32_t index, Var dst) noexcept {
+  const State &s = state(index);
+  if (s.rule[NtReg] == RegVar) {
+    Var var = s.expr.is<Var>();
+    if (!dst || is_var(var, dst)) {
+      return var;
+    }
+    add(Stmt2{*func_, X86_MOV, dst, var});
+    return dst;
+  }
+  if (!dst) {
+    dst = s.target ? s.target : Var{*func_, s.expr.kind()};
+  }
+  switch (s.rule[NtReg]) {
+  case RegMov:
+    add(Stmt2{*func_, X86_MOV, dst, s.expr});
+    break;
+  case RegLoad:
+    add(Stmt2{*func_, X86_MOV, dst, reduce_mem(index)});
+    break;
+  case RegLea: {
+    Address address;
+    reduce_addr(index, address);
+    normalize(address);
+    add(Stmt2{*func_, X86_LEA, dst, Mem{*func_, Ptr, address}});
+    break;
+  }
+  case RegAlu:
+    reduce_alu(index, dst);
+    break;
+  case RegImul3: {
+    const uint32_t k = imm_kid(s);
+    Expr src = reduce_operand(kid(s, 1 - k), false);
+    add(Stmt3{*func_, X86_IMUL3, dst, src, state(kid(s, k)).expr});
+    break;
+  }
+  case RegUnary:
+    reduce_reg(kid(s, 0), dst);
+    add(Stmt1{*func_, dst, Op1(s.expr.op()) == NEG1 ? X86_NEG : X86_NOT});
+    break;
+  default:
+    comp_->error(s.expr, "internal error: x64::Isel failed to compile expression");
+    break;
+  }
+  return dst;
+}
+
+void Isel::reduce_alu(uint32_t index, Var dst) noexcept {
+  const State &s = state(index);
+  const OpStmt2 op = alu_op(s.expr);
+  const bool imm = op != X86_IMUL;
+  const uint32_t n = s.expr.children();
+  Array<Expr> operands;
+  if (!operands.resize(n)) {
+    good_ = false;
+    comp_->out_of_memory(s.expr);
+    return;
+  }
+  // compute the other operands before writing dst: they may read it
+  bool hazard = false;
+  for (uint32_t i = 0; i < n; i++) {
+    if (i != s.first) {
+      Expr operand = reduce_operand(kid(s, i), imm);
+      operands.set(i, operand);
+      hazard = hazard || reads_var(operand, dst);
+    }
+  }
+  const Var result = hazard ? Var{*func_, s.expr.kind()} : dst;
+  reduce_reg(kid(s, s.first), result);
+  for (uint32_t i = 0; i < n; i++) {
+    if (i != s.first) {
+      add(Stmt2{*func_, op, result, operands[i]});
+    }
+  }
+  if (hazard) {
+    add(Stmt2{*func_, X86_MOV, dst, result});
+  }
+}
+
+Expr Isel::reduce_operand(uint32_t index, bool imm) noexcept {
+  const State &s = state(index);
+  if (imm && s.cost[NtImm] <= min2(s.cost[NtReg], s.cost[NtMem])) {
+    return s.expr;
+  } else if (s.cost[NtMem] < s.cost[NtReg]) {
+    return reduce_mem(index);
+  }
+  return reduce_reg(index, Var{});
+}
+
+Mem Isel::reduce_mem(uint32_t index) noexcept {
+  Address address;
+  reduce_sum(index, address);
+  normalize(address);
+  return Mem{*func_, state(index).expr.kind(), address};
+}
+
+void Isel::reduce_sum(uint32_t index, Address &address) noexcept {
+  const State &s = state(index);
+  for (uint32_t i = 0, n = s.expr.children(); i < n; i++) {
+    if ((s.mask >> i) & 1) {
+      reduce_addr(kid(s, i), address);
+    } else {
+      add_reg(address, reduce_reg(kid(s, i), Var{}), Scale1);
+    }
+  }
+}
+
+void Isel::reduce_addr(uint32_t index, Address &address) noexcept {
+  const State &s = state(index);
+  switch (s.rule[NtAddr]) {
+  case AddrReg:
+    add_reg(address, reduce_reg(index, Var{}), Scale1);
+    break;
+  case AddrConst:
+    address.offset = int32_t(uint32_t(address.offset) + uint32_t(s.shape.offset));
+    break;
+  case AddrLabel:
+    address.label = s.expr.is<Label>();
+    break;
+  case AddrSum:
+    reduce_sum(index, address);
+    break;
+  case AddrScale:
+    add_reg(address, reduce_reg(kid(s, s.xkid), Var{}), Scale(s.shape.scale));
+    break;
+  case AddrScale1: {
+    const Var reg = reduce_reg(kid(s, s.xkid), Var{});
+    address.base = address.index = reg;
+    address.scale = Scale(s.shape.scale);
+    break;
+  }
+  case AddrSub: {
+    const int64_t val = state(kid(s, 1)).expr.is<Const>().val().int64();
+    reduce_addr(kid(s, 0), address);
+    address.offset = int32_t(uint32_t(address.offset) - uint32_t(val));
+    break;
+  }
+  default:
+    comp_->error(s.expr, "internal error: x64::Isel failed to compile address");
+    break;
+  }
+}
+
+Isel &Isel::add(Node node) noexcept {
+  comp_->add(node);
+  return *this;
+}
+
+} // namespace x64
+} // namespace onejit
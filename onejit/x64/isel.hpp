@@ -0,0 +1,192 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * isel.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_X64_ISEL_HPP
+#define ONEJIT_X64_ISEL_HPP
+
+#include <onejit/ir/stmt2.hpp>
+#include <onejit/ir/var.hpp>
+#include <onejit/x64/fwd.hpp>
+#include <onestl/array.hpp>
+
+namespace onejit {
+namespace x64 {
+
+////////////////////////////////////////////////////////////////////////////////
+// cost-based instruction selection for integer expressions, in BURS style:
+// label() walks an expression tree bottom-up and computes, for each node,
+// the cheapest way to obtain it as each nonterminal (register, immediate,
+// memory operand or address). Then reduce() walks the tree top-down
+// and emits the chosen x86_64 instructions.
+//
+// it folds base + index * scale + offset into addresses, uses LEA
+// for three-operand additions and shift-and-add, folds loads into
+// 'op reg, [mem]' and uses immediate operands when they fit.
+//
+// usually not invoked directly - used by x64::Compiler
+class Isel {
+public:
+  // maximum number of definitions substituted by a single select()
+  enum : uint32_t { MaxFwd = 8 };
+
+  explicit Isel(Compiler &comp) noexcept;
+
+  // also substitute the Var written by each statement in 'fwd', which must have the form
+  // (= var expr), with expr: select(st) fails unless st, or the expressions substituted
+  // into it, read each such Var exactly once. fwd.size() must be <= MaxFwd
+  Isel(Compiler &comp, View<Assign> fwd) noexcept;
+
+  ~Isel() noexcept = default;
+
+  // select x86_64 instructions for st, which must assign an integer expression to a Var,
+  // or store it into a onejit::Mem.
+  /// @return false if st is not supported. In such case nothing is emitted
+  bool select(Assign st) noexcept;
+
+  // select the cheapest x86_64 address for memory access expr.
+  /// @return invalid Mem if expr is not supported. In such case nothing is emitted
+  Mem select(onejit::Mem expr) noexcept;
+
+private:
+  // nonterminals, i.e. the ways to obtain the value of an expression
+  enum Nt : uint8_t {
+    NtReg = 0,  // in a register
+    NtImm = 1,  // as immediate operand
+    NtMem = 2,  // as memory operand
+    NtAddr = 3, // as (part of) an address
+    NtN = 4,
+  };
+
+  enum Rule : uint8_t {
+    NoRule = 0,
+    RegVar,     // Var
+    RegMov,     // mov reg, Const or Label
+    RegLoad,    // mov reg, Mem
+    RegLea,     // lea reg, Addr
+    RegAlu,     // mov reg, first operand; then op reg, other operand for each other operand
+    RegImul3,   // imul reg, reg_or_mem, imm
+    RegUnary,   // mov reg, operand; neg or not reg
+    ImmConst,   // Const
+    MemAddr,    // onejit::Mem whose address is the sum of its children
+    AddrReg,    // base register
+    AddrConst,  // offset
+    AddrLabel,  // label
+    AddrSum,    // sum of children
+    AddrScale,  // index * scale
+    AddrScale1, // base + index * scale, with base == index
+    AddrSub,    // address - offset
+  };
+
+  // the registers, offset and label used by an address
+  struct Shape {
+    int64_t offset;
+    uint8_t nbase;  // number of unscaled registers
+    uint8_t nindex; // number of scaled registers
+    uint8_t scale;  // scale of scaled register
+    uint8_t nlabel; // number of labels
+
+    bool valid() const noexcept;
+    Shape operator+(const Shape &other) const noexcept;
+  };
+
+  struct State {
+    Expr expr;
+    Var target;     // if valid, compute NtReg into this Var
+    uint32_t kid;   // index in kids_ of first child State
+    uint32_t cost[NtN];
+    Rule rule[NtN];
+    uint8_t first;  // RegAlu: index of child copied first into the register
+    uint8_t xkid;   // AddrScale and AddrScale1: index of scaled child
+    uint8_t mask;   // AddrSum and MemAddr: bit i is set if i-th child is used as NtAddr
+    Shape shape;    // NtAddr shape
+  };
+
+  /// @return index in fwd_ of the statement writing var, or fwd_.size() if not found
+  uint32_t find_fwd(Var var) const noexcept;
+
+  // clear states_ and add the State returned by label() for unsupported expressions
+  /// @return false if out of memory
+  bool start() noexcept;
+
+  /// @return index of the State of expr. addr32 means 32-bit expressions can use NtAddr
+  uint32_t label(Expr expr, bool addr32) noexcept;
+
+  // compute NtImm, NtMem and NtAddr rules, except AddrReg
+  void label_leaf(State &s, bool addr) noexcept;
+  void label_tuple(State &s, bool addr) noexcept;
+  void label_binary(State &s, bool addr) noexcept;
+  // compute NtReg rules that compute into dst, which may be invalid i.e. any register
+  void label_reg(uint32_t index, Var dst) noexcept;
+  // find the cheapest sum of children as NtAddr, and store it as nonterminal nt
+  void label_sum(State &s, Nt nt, Rule rule) noexcept;
+  // compute the cost of RegAlu into dst, and store in s.first the best child to copy first
+  uint32_t label_alu(State &s, Var dst) noexcept;
+
+  // emit the x86_64 instruction for op-assignment st, whose source is states_[index]
+  /// @return false if not supported
+  bool select_op(Assign st, Var dst, uint32_t index) noexcept;
+  // emit the x86_64 instructions that store src into dst
+  /// @return false if not supported
+  bool select_store(onejit::Mem dst, Expr src) noexcept;
+
+  /// @return true if each Var written by fwd_ was substituted exactly once
+  bool fwd_used_once() const noexcept;
+
+  // return true if all children of State have the same size as State
+  bool same_bits(const State &s) const noexcept;
+  // return index of the immediate child of a multiplication usable by RegImul3, or 2 if none
+  uint32_t imm_kid(const State &s) const noexcept;
+
+  // cost of copying State into register dst
+  uint32_t cost_into(const State &s, Var dst) const noexcept;
+  // cost of using State as instruction source operand
+  uint32_t cost_operand(const State &s, bool imm) const noexcept;
+
+  // emit instructions that compute State into register dst, which may be invalid.
+  /// @return the register containing the result
+  Var reduce_reg(uint32_t index, Var dst) noexcept;
+  // emit instructions that compute State as source operand
+  Expr reduce_operand(uint32_t index, bool imm) noexcept;
+  Mem reduce_mem(uint32_t index) noexcept;
+  // add to address the sum of children of State
+  void reduce_sum(uint32_t index, Address &address) noexcept;
+  void reduce_addr(uint32_t index, Address &address) noexcept;
+  void reduce_alu(uint32_t index, Var dst) noexcept;
+
+  const State &state(uint32_t index) const noexcept {
+    return states_.data()[index];
+  }
+  State &state(uint32_t index) noexcept {
+    return states_.data()[index];
+  }
+  uint32_t kid(const State &s, uint32_t i) const noexcept {
+    return kids_.data()[s.kid + i];
+  }
+
+  Isel &add(Node node) noexcept;
+
+  Compiler *comp_;
+  Func *func_;
+  View<Assign> fwd_;
+  uint8_t fwd_uses_[MaxFwd];
+  Array<State> states_;
+  Array<uint32_t> kids_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace x64
+} // namespace onejit
+
+#endif // ONEJIT_X64_ISEL_HPP
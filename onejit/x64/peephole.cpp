@@ -0,0 +1,283 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * peephole.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
+#include <onejit/x64/compiler.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/peephole.hpp>
+#include <onejit/x64/reg.hpp>
+
+namespace onejit {
+namespace x64 {
+
+// maximum number of times run() rewrites the whole function
+static const uint32_t MaxRounds = 4;
+
+// rules are tried in this order: list longer sequences first
+const Peephole::Rule Peephole::rules[] = {
+    &Peephole::fold_load_op_store,
+    &Peephole::zero_with_xor,
+    &Peephole::add_to_inc,
+};
+
+Peephole::Peephole(Compiler &comp) noexcept
+    : comp_{&comp}, func_{comp.func()}, block_{}, out_{}, defs_{}, uses_{},
+      changed_{}, good_{true} {
+}
+
+bool Peephole::run() noexcept {
+  for (uint32_t round = 0; round < MaxRounds; round++) {
+    if (!comp_->compute_liveness()) {
+      return false;
+    }
+    BasicBlocks blocks = comp_->flowgraph_->view();
+    out_.clear();
+    changed_ = false;
+    for (block_ = 0; block_ < blocks.size(); block_++) {
+      Span<Node> nodes = blocks[block_];
+      for (size_t i = 0, n = nodes.size(); i < n;) {
+        Span<Node> in = nodes.span(i, n);
+        size_t done = 0;
+        for (const Rule rule : rules) {
+          if ((done = (this->*rule)(in)) != 0) {
+            break;
+          }
+        }
+        if (done == 0) {
+          add(in[0]);
+          done = 1;
+        } else {
+          changed_ = true;
+        }
+        i += done;
+      }
+    }
+    if (!good_) {
+      comp_->out_of_memory(Node{});
+      return false;
+    } else if (!changed_) {
+      break;
+    }
+    comp_->node_->swap(out_);
+  }
+  return true;
+}
+
+// ===============================  rules  =====================================
+
+// return true if node is a MOV
+static bool is_mov(Node node) noexcept {
+  return node.type() == STMT_2 && OpStmt2(node.op()) == X86_MOV;
+}
+
+// return true if kind is stored in a general purpose register
+static bool is_gpr(Kind kind) noexcept {
+  return !kind.is_float() && kind.nosimd() == kind;
+}
+
+// return true if op accepts a memory destination, which it reads and writes
+static bool is_read_modify_write(OpStmt1 op) noexcept {
+  return op == X86_DEC || op == X86_INC || op == X86_NEG || op == X86_NOT;
+}
+
+static bool is_read_modify_write(OpStmt2 op) noexcept {
+  switch (op) {
+  case X86_ADC:
+  case X86_ADD:
+  case X86_AND:
+  case X86_OR:
+  case X86_ROL:
+  case X86_ROR:
+  case X86_SAR:
+  case X86_SBB:
+  case X86_SHL:
+  case X86_SHR:
+  case X86_SUB:
+  case X86_XOR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+size_t Peephole::fold_load_op_store(Span<Node> in) noexcept {
+  if (in.size() < 3 || !is_mov(in[0]) || !is_mov(in[2])) {
+    return 0;
+  }
+  Var reg = in[0].child_is<Var>(0);
+  Mem mem = in[0].child_is<Mem>(1);
+  Mem store = in[2].child_is<Mem>(0);
+  if (!reg || !mem || !store || in[2].child_is<Var>(1) != reg || !store.deep_equal(mem) ||
+      uses_reg(mem, reg)) {
+    return 0;
+  }
+  Node op = in[1];
+  Node rmw;
+  if (op.type() == STMT_1 && is_read_modify_write(OpStmt1(op.op())) &&
+      op.child_is<Var>(0) == reg) {
+    rmw = Stmt1{*func_, mem, OpStmt1(op.op())};
+  } else if (op.type() == STMT_2 && is_read_modify_write(OpStmt2(op.op())) &&
+             op.child_is<Var>(0) == reg) {
+    // x86_64 instructions cannot have two memory operands
+    Expr src = op.child_is<Expr>(1);
+    if (src.type() == MEM || uses_reg(src, reg)) {
+      return 0;
+    }
+    rmw = Stmt2{*func_, OpStmt2(op.op()), mem, src};
+  }
+  if (!rmw || live_after(in, 2, reg)) {
+    return 0;
+  }
+  add(rmw);
+  return 3;
+}
+
+size_t Peephole::zero_with_xor(Span<Node> in) noexcept {
+  if (!is_mov(in[0])) {
+    return 0;
+  }
+  Var dst = in[0].child_is<Var>(0);
+  Const src = in[0].child_is<Const>(1);
+  if (!dst || !is_gpr(dst.kind()) || !src || !src.imm().is_zero() ||
+      dst.id().val() < Id::FIRST || flags_live_after(in, 0) != 0) {
+    return 0;
+  }
+  // 32-bit XOR also clears the high bits, and needs no REX.W prefix
+  Var dst32{Reg{Uint32, dst.id()}};
+  add(Stmt2{*func_, X86_XOR, dst32, dst32});
+  return 1;
+}
+
+size_t Peephole::add_to_inc(Span<Node> in) noexcept {
+  const OpStmt2 op = OpStmt2(in[0].op());
+  if (in[0].type() != STMT_2 || (op != X86_ADD && op != X86_SUB)) {
+    return 0;
+  }
+  Expr dst = in[0].child_is<Expr>(0);
+  Const src = in[0].child_is<Const>(1);
+  if (!src || !is_gpr(dst.kind())) {
+    return 0;
+  }
+  const int64_t val = src.val().int64();
+  if ((val != 1 && val != -1) || (flags_live_after(in, 0) & CF) != 0) {
+    // INC and DEC do not write CF: reading it later would stall on many CPUs
+    return 0;
+  }
+  add(Stmt1{*func_, dst, (op == X86_ADD) == (val == 1) ? X86_INC : X86_DEC});
+  return 1;
+}
+
+// ===============================  helpers  ===================================
+
+bool Peephole::same_reg(Expr a, Expr b) const noexcept {
+  Var va = a.is<Var>(), vb = b.is<Var>();
+  if (!va || !vb || !is_gpr(va.kind()) || !is_gpr(vb.kind())) {
+    return va && va == vb;
+  }
+  const uint32_t ia = va.id().val(), ib = vb.id().val();
+  if (ia == ib) {
+    return true;
+  } else if (ia < Id::FIRST || ib < Id::FIRST) {
+    // a register not allocated by reg::Allocator
+    return false;
+  }
+  View<reg::Color> colors = comp_->allocator_->get_colors();
+  return ia - Id::FIRST < colors.size() && ib - Id::FIRST < colors.size() &&
+         colors[ia - Id::FIRST] == colors[ib - Id::FIRST];
+}
+
+bool Peephole::uses_reg(Expr expr, Var var) const noexcept {
+  if (Var v = expr.is<Var>()) {
+    const uint32_t ia = v.id().val(), ib = var.id().val();
+    // reg::Allocator may assign any register except RSP and RBX
+    return same_reg(v, var) || (ia < Id::FIRST && ib >= Id::FIRST && ia != RSP && ia != RBX) ||
+           (ib < Id::FIRST && ia >= Id::FIRST && ib != RSP && ib != RBX);
+  } else if (expr.type() == LABEL) {
+    return false;
+  }
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    Expr child = expr.child_is<Expr>(i);
+    if (child && uses_reg(child, var)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Peephole::live_after(Span<Node> in, size_t i, Var var) noexcept {
+  const uint32_t id = var.id().val();
+  if (id < Id::FIRST) {
+    return true;
+  }
+  const reg::Reg reg = id - Id::FIRST;
+  for (size_t j = i + 1; j < in.size(); j++) {
+    defs_.clear();
+    uses_.clear();
+    Compiler::defs_uses(in[j], defs_, uses_);
+    for (reg::Reg use : uses_) {
+      if (use == reg) {
+        return true;
+      }
+    }
+    for (reg::Reg def : defs_) {
+      if (def == reg) {
+        return false;
+      }
+    }
+  }
+  return comp_->liveness_->live_out(block_, reg);
+}
+
+EflagsMask Peephole::flags_live_after(Span<Node> in, size_t i) const noexcept {
+  EflagsMask pending = Flags::all();
+  EflagsMask live = flags_read(in.span(i + 1, in.size()), pending);
+  if (pending == 0) {
+    return live;
+  }
+  // some eflags survive the current basic block: check the beginning of each successor
+  BasicBlocks blocks = comp_->flowgraph_->view();
+  Span<BasicBlock *> next = blocks[block_].next();
+  if (next.size() == 0) {
+    return live | pending;
+  }
+  for (BasicBlock *bb : next) {
+    EflagsMask still = pending;
+    live = live | flags_read(*bb, still);
+    // eflags not overwritten by successor are assumed to be read later
+    live = live | still;
+  }
+  return live;
+}
+
+EflagsMask Peephole::flags_read(Span<Node> nodes, EflagsMask &pending) noexcept {
+  EflagsMask live = EflagsMask(0);
+  for (size_t i = 0, n = nodes.size(); i < n && pending != 0; i++) {
+    live = live | (Flags::read(nodes[i]) & pending);
+    pending = pending & (pending ^ Flags::written(nodes[i]));
+  }
+  return live;
+}
+
+Peephole &Peephole::add(Node node) noexcept {
+  good_ = good_ && out_.append(node);
+  return *this;
+}
+
+} // namespace x64
+} // namespace onejit
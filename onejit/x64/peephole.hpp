@@ -0,0 +1,88 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * peephole.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_X64_PEEPHOLE_HPP
+#define ONEJIT_X64_PEEPHOLE_HPP
+
+#include <onejit/ir/var.hpp>
+#include <onejit/reg/fwd.hpp>
+#include <onejit/x64/flags.hpp>
+#include <onestl/array.hpp>
+
+namespace onejit {
+namespace x64 {
+
+////////////////////////////////////////////////////////////////////////////////
+// peephole optimizer, run after register allocation:
+// rewrites short sequences of x86_64 instructions inside each basic block
+// into cheaper ones.
+//
+// each rewrite is a method listed in the table Peephole::rules[]:
+// adding a new rewrite only requires writing the method and listing it there.
+//
+// usually not invoked directly - used by x64::Compiler
+class Peephole {
+public:
+  explicit Peephole(Compiler &comp) noexcept;
+
+  ~Peephole() noexcept = default;
+
+  // rewrite the instructions compiled by x64::Compiler,
+  // repeating until no rule matches or a few rounds are done
+  /// @return false on error
+  bool run() noexcept;
+
+private:
+  // a rule tries to rewrite the instructions in[0], in[1] ... of current basic block
+  // and, if they match, appends their replacement with add().
+  /// @return number of instructions replaced, or 0 if the rule does not match
+  typedef size_t (Peephole::*Rule)(Span<Node> in);
+
+  static const Rule rules[];
+
+  // mov r, mem; op r, x; mov mem, r => op mem, x if r is dead
+  size_t fold_load_op_store(Span<Node> in) noexcept;
+  // mov r, 0 => xor r, r if eflags are dead
+  size_t zero_with_xor(Span<Node> in) noexcept;
+  // add r, 1 => inc r and sub r, 1 => dec r if CF is dead, avoiding partial eflags stalls
+  size_t add_to_inc(Span<Node> in) noexcept;
+
+  // return true if a and b are the same register
+  bool same_reg(Expr a, Expr b) const noexcept;
+  // return true if expr reads the register of var
+  bool uses_reg(Expr expr, Var var) const noexcept;
+  // return true if var may be read after in[i]
+  bool live_after(Span<Node> in, size_t i, Var var) noexcept;
+  // return the eflags that may be read after in[i]
+  EflagsMask flags_live_after(Span<Node> in, size_t i) const noexcept;
+  // return the eflags, among 'pending', that nodes may read before overwriting them.
+  // remove from 'pending' the eflags overwritten by nodes
+  static EflagsMask flags_read(Span<Node> nodes, EflagsMask &pending) noexcept;
+
+  Peephole &add(Node node) noexcept;
+
+  Compiler *comp_;
+  Func *func_;
+  size_t block_;   // index of current basic block
+  Array<Node> out_;
+  Array<reg::Reg> defs_, uses_;
+  bool changed_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace x64
+} // namespace onejit
+
+#endif // ONEJIT_X64_PEEPHOLE_HPP
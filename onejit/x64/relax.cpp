@@ -0,0 +1,176 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * relax.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/assembler.hpp>
+#include <onejit/ir/label.hpp>
+#include <onejit/ir/stmt1.hpp>
+#include <onejit/ir/stmtn.hpp>
+#include <onejit/x64/asm.hpp>
+#include <onestl/array.hpp>
+
+namespace onejit {
+namespace x64 {
+
+enum : uint32_t { Rel8Size = 2 };
+
+// a jmp or jcc that may use rel8 encoding
+struct Jump {
+  uint32_t node;   // index of the jump in nodes
+  uint32_t target; // index of the destination Label in nodes
+  bool rel8;
+};
+
+// append to 'nodes' the contents of 'node', flattening nested Blocks
+/// @return false if out of memory
+static bool flatten(const Node &node, Array<Node> &nodes) noexcept {
+  if (node.type() == STMT_N && OpStmtN(node.op()) == BLOCK) {
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      if (!flatten(node.child(i), nodes)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return nodes.append(node);
+}
+
+/// @return destination Label if node is a jmp or jcc to a Label, otherwise invalid Label
+static Label relaxable_jump(const Node &node) noexcept {
+  if (node.type() == STMT_1) {
+    const OpStmt1 op = OpStmt1(node.op());
+    if (op >= X86_JA && op <= X86_JMP) {
+      return node.child(0).is<Label>();
+    }
+  }
+  return Label{};
+}
+
+// compute in 'offset' the byte offset of each node. offset[n] is the total size.
+// 'start' is the position of first node in assembled code, needed to compute
+// the NOP padding before aligned Labels. align[i] is the alignment of i-th node, or 0 if none
+static void compute_offsets(size_t start, const Array<uint32_t> &size,
+                            const Array<uint32_t> &align, const Array<Jump> &jumps,
+                            Array<uint32_t> &offset) noexcept {
+  uint32_t *data = offset.data();
+  const uint32_t *sizes = size.data();
+  const size_t n = size.size();
+  size_t j = 0;
+  uint32_t pos = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (const uint32_t a = align[i]) {
+      pos += uint32_t((a - (start + pos) % a) % a);
+    }
+    data[i] = pos;
+    if (j < jumps.size() && jumps[j].node == i) {
+      pos += jumps[j++].rel8 ? uint32_t(Rel8Size) : sizes[i];
+    } else {
+      pos += sizes[i];
+    }
+  }
+  data[n] = pos;
+}
+
+Assembler &Relax::emit(Assembler &dst, const StmtN &block) noexcept {
+  Array<Node> nodes;
+  if (!flatten(block, nodes)) {
+    return dst.out_of_memory(block);
+  }
+  const size_t n = nodes.size();
+
+  // find Labels defined in block, indexed by Label::index()
+  Array<uint32_t> label_node; // 1 + index of Label in nodes, or 0 if not found
+  for (size_t i = 0; i < n; i++) {
+    if (Label l = nodes[i].is<Label>()) {
+      if (l.index() >= label_node.size() && !label_node.resize(l.index() + 1)) {
+        return dst.out_of_memory(block);
+      }
+      label_node.set(l.index(), uint32_t(i + 1));
+    }
+  }
+
+  // find jumps to Labels defined in block. start optimistic: all of them use rel8
+  Array<Jump> jumps;
+  for (size_t i = 0; i < n; i++) {
+    if (Label l = relaxable_jump(nodes[i])) {
+      const uint32_t target = l.index() < label_node.size() ? label_node[l.index()] : 0;
+      if (target != 0 && nodes[target - 1] == l &&
+          !jumps.append(Jump{uint32_t(i), target - 1, true})) {
+        return dst.out_of_memory(block);
+      }
+    }
+  }
+  // compute the size of each node, with jumps in rel32 encoding and no alignment
+  Array<uint32_t> size, align, offset;
+  Assembler tmp;
+  bool relax = !jumps.empty();
+  if (relax && (!size.resize(n) || !align.resize(n) || !offset.resize(n + 1))) {
+    return dst.out_of_memory(block);
+  }
+  for (size_t i = 0; i < n && relax; i++) {
+    if (Label l = nodes[i].is<Label>()) {
+      const size_t a = dst.label_align(l);
+      align.set(i, a > 1 ? uint32_t(a) : 0);
+      continue;
+    }
+    tmp.clear();
+    tmp.x64(nodes[i]);
+    // on errors, let dst report them
+    relax = tmp && tmp.errors().size() == 0;
+    size.set(i, uint32_t(tmp.size()));
+  }
+  if (!relax) {
+    for (size_t i = 0; i < n && dst; i++) {
+      dst.x64(nodes[i]);
+    }
+    return dst;
+  }
+
+  // grow rel8 jumps whose destination is too far, until no jump changes.
+  // terminates because jumps only grow, and never shrink again
+  const size_t start = dst.size();
+  for (bool changed = true; changed;) {
+    changed = false;
+    compute_offsets(start, size, align, jumps, offset);
+    Jump *data = jumps.data();
+    for (size_t j = 0; j < jumps.size(); j++) {
+      if (data[j].rel8) {
+        const int64_t disp = int64_t(offset[data[j].target]) - (offset[data[j].node] + Rel8Size);
+        if (disp != int64_t(int8_t(disp))) {
+          data[j].rel8 = false;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0, j = 0; i < n && dst; i++) {
+    if (j < jumps.size() && jumps[j].node == i) {
+      const Jump jump = jumps[j++];
+      if (jump.rel8) {
+        const int64_t disp = int64_t(offset[jump.target]) - (offset[i] + Rel8Size);
+        Asm1::emit_rel8(dst, OpStmt1(nodes[i].op()), int8_t(disp));
+        continue;
+      }
+    }
+    dst.x64(nodes[i]);
+  }
+  if (dst && dst.size() - start != offset[n]) {
+    dst.error(block, "x64::Relax::emit: assembled size differs from computed size");
+  }
+  return dst;
+}
+
+} // namespace x64
+} // namespace onejit
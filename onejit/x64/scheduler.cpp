@@ -0,0 +1,545 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * scheduler.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
+#include <onejit/x64/compiler.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/scheduler.hpp>
+
+namespace onejit {
+namespace x64 {
+
+// maximum number of instructions in a region. Must be <= 64, the bits in Item::succ
+static const size_t MaxRegion = 64;
+
+// before register allocation, do not move instructions earlier
+// if that increases the number of live registers above this threshold
+static const int32_t MaxPressure = 12;
+
+// latency classes
+enum Lat : uint8_t {
+  LatAlu = 0,     // integer arithmetic, logic, shifts, moves between registers
+  LatImul = 1,    // integer multiplication
+  LatBitScan = 2, // bsf, bsr, lzcnt, popcnt
+  LatLoad = 3,    // added to the latency of each instruction that reads memory
+  LatFadd = 4,    // floating point min, max
+  LatFmul = 5,    // floating point multiplication
+  LatFdiv = 6,    // floating point division
+  LatCvt = 7,     // conversions between integer and floating point
+  LatVec = 8,     // moves and logic between xmm registers
+  LatN = 9,
+};
+
+// latency in cycles of each latency class, for each Uarch
+static const uint8_t latency_table[UarchN][LatN] = {
+    // Alu Imul BitScan Load Fadd Fmul Fdiv Cvt Vec
+    {1, 3, 3, 5, 4, 4, 14, 6, 1}, // UarchGeneric
+    {1, 3, 3, 5, 4, 4, 13, 6, 1}, // UarchSkylake
+    {1, 3, 3, 4, 3, 3, 13, 5, 1}, // UarchZen
+};
+
+// how an instruction accesses its first operand
+enum Access : uint8_t {
+  DstRead = 0,
+  DstWrite = 1,
+  DstReadWrite = 2,
+};
+
+// if node can be moved, store its latency class and how it accesses its first operand.
+/// @return false if node cannot be moved
+static bool classify(Node node, Lat &lat, Access &access) noexcept {
+  lat = LatAlu;
+  access = DstReadWrite;
+  switch (node.type()) {
+  case STMT_1: {
+    const OpStmt1 op = OpStmt1(node.op());
+    if (op >= X86_SETA && op <= X86_SETNE) {
+      access = DstWrite;
+      return true;
+    }
+    return op == X86_DEC || op == X86_INC || op == X86_NEG || op == X86_NOT;
+  }
+  case STMT_2: {
+    const OpStmt2 op = OpStmt2(node.op());
+    if (op >= X86_CMOVA && op <= X86_CMOVNE) {
+      return true;
+    }
+    switch (op) {
+    case X86_ADC:
+    case X86_ADD:
+    case X86_AND:
+    case X86_OR:
+    case X86_RCL:
+    case X86_RCR:
+    case X86_ROL:
+    case X86_ROR:
+    case X86_SAR:
+    case X86_SBB:
+    case X86_SHL:
+    case X86_SHR:
+    case X86_SUB:
+    case X86_XOR:
+      return true;
+    case X86_BT:
+    case X86_CMP:
+    case X86_TEST:
+      access = DstRead;
+      return true;
+    case X86_LEA:
+    case X86_MOV:
+    case X86_MOVSX:
+    case X86_MOVZX:
+      access = DstWrite;
+      return true;
+    case X86_IMUL:
+      lat = LatImul;
+      return true;
+    case X86_BSF:
+    case X86_BSR:
+    case X86_LZCNT:
+    case X86_POPCNT:
+      lat = LatBitScan;
+      access = DstWrite;
+      return true;
+    case X86_MAXPD:
+    case X86_MAXPS:
+    case X86_MAXSD:
+    case X86_MAXSS:
+    case X86_MINPD:
+    case X86_MINPS:
+    case X86_MINSD:
+    case X86_MINSS:
+      lat = LatFadd;
+      return true;
+    case X86_MULPD:
+    case X86_MULPS:
+      lat = LatFmul;
+      return true;
+    case X86_DIVSD:
+    case X86_DIVSS:
+      lat = LatFdiv;
+      return true;
+    case X86_CVTSD2SI:
+    case X86_CVTSD2SS:
+    case X86_CVTSI2SD:
+    case X86_CVTSI2SS:
+    case X86_CVTSS2SD:
+    case X86_CVTSS2SI:
+      lat = LatCvt;
+      access = DstWrite;
+      return true;
+    case X86_MOVAPD:
+    case X86_MOVAPS:
+    case X86_MOVD:
+    case X86_MOVDQA:
+    case X86_MOVDQU:
+    case X86_MOVQ:
+    case X86_MOVUPD:
+    case X86_MOVUPS:
+      lat = LatVec;
+      access = DstWrite;
+      return true;
+    case X86_PAND:
+    case X86_PANDN:
+    case X86_POR:
+    case X86_PXOR:
+      lat = LatVec;
+      return true;
+    default:
+      // including mul, div and idiv: they use rax and rdx implicitly
+      return false;
+    }
+  }
+  case STMT_3:
+    lat = LatImul;
+    access = DstWrite;
+    return OpStmt3(node.op()) == X86_IMUL3;
+  default:
+    return false;
+  }
+}
+
+// return the eflags that node may write, including the ones it may leave unchanged
+static EflagsMask flags_clobbered(Node node) noexcept {
+  if (node.type() == STMT_2) {
+    switch (OpStmt2(node.op())) {
+    case X86_RCL:
+    case X86_RCR:
+    case X86_ROL:
+    case X86_ROR:
+    case X86_SAR:
+    case X86_SHL:
+    case X86_SHR:
+      if (node.child_is<Expr>(1).type() != CONST) {
+        // shift by zero preserves all eflags
+        return Flags::all();
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return Flags::written(node);
+}
+
+// return true if var is a register not allocated by reg::Allocator
+static bool is_hw_reg(Var var) noexcept {
+  return var && var.id().val() < Id::FIRST;
+}
+
+Scheduler::Scheduler(Compiler &comp, bool after_regs, Uarch uarch) noexcept
+    : comp_{&comp}, out_{}, items_{}, keys_{}, regs_{}, defs_{}, uses_{}, pressure_{},
+      uarch_{uarch}, after_regs_{after_regs}, changed_{}, good_{true} {
+}
+
+bool Scheduler::run() noexcept {
+  if (!comp_->compute_liveness()) {
+    return false;
+  }
+  BasicBlocks blocks = comp_->flowgraph_->view();
+  for (size_t block = 0; block < blocks.size(); block++) {
+    schedule(blocks[block], block);
+  }
+  if (!good_) {
+    comp_->out_of_memory(Node{});
+    return false;
+  } else if (changed_) {
+    comp_->node_->swap(out_);
+  }
+  return true;
+}
+
+void Scheduler::schedule(Span<Node> nodes, size_t block) noexcept {
+  items_.clear();
+  keys_.clear();
+  for (size_t i = 0, n = nodes.size(); i < n; i++) {
+    Item item = {};
+    if (fill(item, nodes[i])) {
+      good_ = good_ && items_.append(item);
+      if (items_.size() == MaxRegion) {
+        flush(nodes, block, i + 1);
+      }
+    } else {
+      // node is a barrier: nothing can be moved across it.
+      // if it reads the eflags written by the last item, as a conditional jump
+      // after a cmp, keep them adjacent: the CPU fuses them into a single uop
+      size_t end = i;
+      const size_t last = items_.size() - 1;
+      if (!items_.empty() && (items_[last].flags_written & Flags::read(nodes[i])) != 0) {
+        keys_.truncate(items_[last].first);
+        items_.truncate(last);
+        end--;
+      }
+      flush(nodes, block, end);
+      for (; end <= i; end++) {
+        add(nodes[end]);
+      }
+    }
+  }
+  flush(nodes, block, nodes.size());
+}
+
+bool Scheduler::fill(Item &item, Node node) noexcept {
+  Lat lat;
+  Access access;
+  if (!classify(node, lat, access)) {
+    return false;
+  }
+  uint32_t latency = latency_table[uarch_][lat];
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    Expr expr = node.child_is<Expr>(i);
+    if (is_hw_reg(expr.is<Var>())) {
+      // for example the count of a shift, which must be in cl
+      return false;
+    }
+    Mem mem = expr.is<Mem>();
+    if (!mem) {
+      continue;
+    }
+    Var base = mem.child_is<Var>(2), index = mem.child_is<Var>(3);
+    if (is_hw_reg(index) || (is_hw_reg(base) && base.id().val() != RSP)) {
+      return false;
+    } else if (base && base.id().val() == RSP && !index && !mem.label()) {
+      // stack slot: RSP is not modified inside a region
+      item.slot = mem.offset();
+      item.slot_bytes = uint8_t(mem.kind().bitsize() / 8);
+    }
+    if (i != 0) {
+      // lea does not access memory
+      item.mem_read = node.type() != STMT_2 || OpStmt2(node.op()) != X86_LEA;
+    } else {
+      item.mem_read = access != DstWrite;
+      item.mem_write = access != DstRead;
+    }
+  }
+  if (item.mem_read) {
+    latency += latency_table[uarch_][LatLoad];
+  }
+  item.node = node;
+  item.latency = uint8_t(latency);
+  item.flags_read = Flags::read(node);
+  item.flags_written = flags_clobbered(node);
+
+  defs_.clear();
+  uses_.clear();
+  Compiler::defs_uses(node, defs_, uses_);
+  item.first = keys_.size();
+  add_keys(defs_);
+  item.middle = keys_.size();
+  add_keys(uses_);
+  item.end = keys_.size();
+  return true;
+}
+
+void Scheduler::add_keys(View<reg::Reg> regs) noexcept {
+  const uint32_t start = keys_.size();
+  for (reg::Reg reg : regs) {
+    const uint32_t k = key(reg);
+    bool found = false;
+    for (uint32_t i = start; i < keys_.size() && !found; i++) {
+      found = keys_[i] == k;
+    }
+    if (!found) {
+      good_ = good_ && keys_.append(k);
+    }
+  }
+}
+
+// return true if keys in ranges a and b have a common element
+static bool intersect(View<uint32_t> a, View<uint32_t> b) noexcept {
+  for (uint32_t x : a) {
+    for (uint32_t y : b) {
+      if (x == y) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void Scheduler::add_dependencies() noexcept {
+  const uint32_t n = items_.size();
+  Item *items = items_.data();
+  const uint32_t *keys = keys_.data();
+  for (uint32_t j = 0; j < n; j++) {
+    Item &b = items[j];
+    const View<uint32_t> b_defs{keys + b.first, b.middle - b.first};
+    const View<uint32_t> b_uses{keys + b.middle, b.end - b.middle};
+    for (uint32_t i = 0; i < j; i++) {
+      Item &a = items[i];
+      const View<uint32_t> a_defs{keys + a.first, a.middle - a.first};
+      const View<uint32_t> a_uses{keys + a.middle, a.end - a.middle};
+      // stack slots at different offsets cannot overlap
+      const bool disjoint = a.slot_bytes != 0 && b.slot_bytes != 0 &&
+                            (a.slot + a.slot_bytes <= b.slot || b.slot + b.slot_bytes <= a.slot);
+
+      const bool raw = intersect(a_defs, b_uses) || (a.flags_written & b.flags_read) != 0 ||
+                       (a.mem_write && b.mem_read && !disjoint);
+      const bool order = raw || intersect(a_uses, b_defs) || intersect(a_defs, b_defs) ||
+                         (a.flags_read & b.flags_written) != 0 ||
+                         (a.flags_written & b.flags_written) != 0 ||
+                         ((a.mem_read || a.mem_write) && b.mem_write && !disjoint);
+      if (order) {
+        a.succ |= uint64_t(1) << j;
+        b.npred++;
+      }
+      if (raw) {
+        a.raw |= uint64_t(1) << j;
+      }
+    }
+  }
+  for (uint32_t i = n; i != 0; i--) {
+    Item &a = items[i - 1];
+    uint32_t height = a.latency;
+    for (uint32_t j = i; j < n; j++) {
+      if (a.succ & (uint64_t(1) << j)) {
+        const uint32_t h = items[j].height + ((a.raw & (uint64_t(1) << j)) ? a.latency : 0);
+        height = h > height ? h : height;
+      }
+    }
+    a.height = height;
+  }
+}
+
+void Scheduler::fill_regs(Span<Node> nodes, size_t block, size_t end) noexcept {
+  regs_.clear();
+  pressure_ = 0;
+  if (!regs_.reserve(keys_.size())) {
+    good_ = false;
+    return;
+  }
+  const uint32_t *keys = keys_.data();
+  for (const Item &item : items_) {
+    for (uint32_t i = item.middle; i < item.end; i++) {
+      Key &r = regs_.data()[find_or_add(keys[i])];
+      r.users++;
+      // read before being written: live at region start
+      r.live = r.live || !r.written;
+    }
+    for (uint32_t i = item.first; i < item.middle; i++) {
+      regs_.data()[find_or_add(keys[i])].written = true;
+    }
+  }
+  for (size_t i = end; i < nodes.size(); i++) {
+    defs_.clear();
+    uses_.clear();
+    Compiler::defs_uses(nodes[i], defs_, uses_);
+    for (reg::Reg reg : uses_) {
+      const uint32_t index = find(key(reg));
+      if (index < regs_.size()) {
+        regs_.data()[index].live_after = true;
+      }
+    }
+  }
+  for (Key &r : regs_) {
+    r.live_after = r.live_after || comp_->liveness_->live_out(block, r.key);
+    pressure_ += r.live ? 1 : 0;
+  }
+}
+
+void Scheduler::flush(Span<Node> nodes, size_t block, size_t end) noexcept {
+  const uint32_t n = items_.size();
+  if (n > 1 && good_) {
+    add_dependencies();
+    if (!after_regs_) {
+      fill_regs(nodes, block, end);
+    }
+  }
+  Item *items = items_.data();
+  uint64_t done = 0;
+  uint32_t cycle = 0;
+  for (uint32_t step = 0; step < n && good_; step++) {
+    const uint32_t i = n > 1 ? pick(done, cycle) : 0;
+    const Item &a = items[i];
+    const uint32_t start = cycle > a.earliest ? cycle : a.earliest;
+    cycle = start + 1;
+    done |= uint64_t(1) << i;
+    for (uint32_t j = i + 1; j < n; j++) {
+      if (a.succ & (uint64_t(1) << j)) {
+        Item &b = items[j];
+        const uint32_t ready = start + ((a.raw & (uint64_t(1) << j)) ? a.latency : 0);
+        b.npred--;
+        b.earliest = ready > b.earliest ? ready : b.earliest;
+      }
+    }
+    if (!after_regs_ && n > 1) {
+      update_pressure(a);
+    }
+    changed_ = changed_ || i != step;
+    add(a.node);
+  }
+  items_.clear();
+  keys_.clear();
+}
+
+uint32_t Scheduler::pick(uint64_t done, uint32_t cycle) const noexcept {
+  const uint32_t n = items_.size();
+  const Item *items = items_.data();
+  uint32_t first = 0;
+  while (done & (uint64_t(1) << first)) {
+    first++;
+  }
+  // all items before 'first' are scheduled, thus it's ready
+  if (items[first].earliest <= cycle) {
+    return first;
+  }
+  uint32_t best = first;
+  for (uint32_t i = first + 1; i < n; i++) {
+    const Item &a = items[i];
+    if ((done & (uint64_t(1) << i)) || a.npred != 0 || a.earliest > cycle) {
+      continue;
+    } else if (!after_regs_ && pressure_ >= MaxPressure && pressure_delta(a) > 0) {
+      continue;
+    } else if (best == first || a.height > items[best].height) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+int32_t Scheduler::pressure_delta(const Item &item) const noexcept {
+  const uint32_t *keys = keys_.data();
+  int32_t delta = 0;
+  for (uint32_t i = item.first; i < item.middle; i++) {
+    delta += regs_[find(keys[i])].live ? 0 : 1;
+  }
+  for (uint32_t i = item.middle; i < item.end; i++) {
+    const Key &r = regs_[find(keys[i])];
+    delta -= r.live && r.users == 1 && !r.live_after ? 1 : 0;
+  }
+  return delta;
+}
+
+void Scheduler::update_pressure(const Item &item) noexcept {
+  const uint32_t *keys = keys_.data();
+  for (uint32_t i = item.middle; i < item.end; i++) {
+    Key &r = regs_.data()[find(keys[i])];
+    if (--r.users == 0 && !r.live_after && r.live) {
+      r.live = false;
+      pressure_--;
+    }
+  }
+  for (uint32_t i = item.first; i < item.middle; i++) {
+    Key &r = regs_.data()[find(keys[i])];
+    if (!r.live && (r.users != 0 || r.live_after)) {
+      r.live = true;
+      pressure_++;
+    }
+  }
+}
+
+uint32_t Scheduler::key(reg::Reg reg) const noexcept {
+  if (!after_regs_) {
+    return reg;
+  }
+  View<reg::Color> colors = comp_->allocator_->get_colors();
+  if (reg >= colors.size()) {
+    return reg | 0x80000000;
+  }
+  // each register class has its own colors
+  return uint32_t(colors[reg]) << 4 | comp_->allocator_->get_class(reg);
+}
+
+uint32_t Scheduler::find(uint32_t key) const noexcept {
+  const uint32_t n = regs_.size();
+  for (uint32_t i = 0; i < n; i++) {
+    if (regs_[i].key == key) {
+      return i;
+    }
+  }
+  return n;
+}
+
+uint32_t Scheduler::find_or_add(uint32_t key) noexcept {
+  const uint32_t i = find(key);
+  if (i == regs_.size()) {
+    // fill_regs() reserved enough capacity
+    regs_.append(Key{key, 0, false, false, false});
+  }
+  return i;
+}
+
+Scheduler &Scheduler::add(Node node) noexcept {
+  good_ = good_ && out_.append(node);
+  return *this;
+}
+
+} // namespace x64
+} // namespace onejit
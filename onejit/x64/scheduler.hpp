@@ -0,0 +1,140 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * scheduler.hpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_X64_SCHEDULER_HPP
+#define ONEJIT_X64_SCHEDULER_HPP
+
+#include <onejit/ir/node.hpp>
+#include <onejit/reg/fwd.hpp>
+#include <onejit/x64/flags.hpp>
+#include <onestl/array.hpp>
+
+namespace onejit {
+namespace x64 {
+
+// x86_64 microarchitectures with a latency table
+enum Uarch : uint8_t {
+  UarchGeneric = 0,
+  UarchSkylake = 1,
+  UarchZen = 2,
+  UarchN = 3,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// list scheduler: reorders the x86_64 instructions inside each basic block
+// so that the result of a long-latency instruction, as a load or an imul,
+// is not consumed immediately.
+//
+// instructions are kept in their original order unless the next one would stall:
+// in such case, the ready instruction with the longest latency path to the end
+// of its region is moved before it.
+//
+// labels, jumps, calls and instructions with implicit or hardware register operands
+// are never moved: they split each basic block into regions, scheduled independently.
+// an instruction writing the eflags read by the next jump, as cmp before jl, is not moved either.
+// dependencies are computed from registers, eflags and memory accesses.
+//
+// before register allocation, registers are the Vars themselves and instructions
+// are not moved earlier if that increases register pressure above a threshold.
+// after register allocation, Vars with the same color are the same register.
+//
+// usually not invoked directly - used by x64::Compiler
+class Scheduler {
+public:
+  Scheduler(Compiler &comp, bool after_regs, Uarch uarch = UarchGeneric) noexcept;
+
+  ~Scheduler() noexcept = default;
+
+  // reorder the instructions compiled by x64::Compiler
+  /// @return false on error
+  bool run() noexcept;
+
+private:
+  // an instruction of current region
+  struct Item {
+    Node node;
+    uint64_t succ;     // bit j is set if region item j must come after this one
+    uint64_t raw;      // bit j is set if region item j reads a result of this one
+    uint32_t first;    // index in keys_ of first register written by node
+    uint32_t middle;   // index in keys_ of first register read by node
+    uint32_t end;      // index in keys_ after last register read by node
+    uint32_t npred;    // number of unscheduled items that must come before this one
+    uint32_t earliest; // earliest cycle when node can start without stalling
+    uint32_t height;   // latency of longest dependency path from node to end of region
+    int32_t slot;      // offset from RSP of the stack slot accessed by node, if slot_bytes != 0
+    uint8_t slot_bytes;
+    uint8_t latency;
+    EflagsMask flags_read;
+    EflagsMask flags_written; // including the eflags that node may leave unchanged
+    bool mem_read;
+    bool mem_write;
+  };
+
+  // a register used by current region
+  struct Key {
+    uint32_t key;
+    uint32_t users;   // number of unscheduled items reading key
+    bool written;     // true if key is written by an item already visited
+    bool live;        // true if key currently contains a value that may be read
+    bool live_after;  // true if key may be read after current region
+  };
+
+  // schedule the instructions of basic block 'block'
+  void schedule(Span<Node> nodes, size_t block) noexcept;
+  // schedule items_, i.e. the region ending before nodes[end], and append them to out_
+  void flush(Span<Node> nodes, size_t block, size_t end) noexcept;
+
+  // fill item from node, and append to keys_ the registers it writes and reads.
+  /// @return false if node cannot be moved. In such case, keys_ is unchanged
+  bool fill(Item &item, Node node) noexcept;
+  void add_keys(View<reg::Reg> regs) noexcept;
+  // add to each item in items_ its dependencies from previous items
+  void add_dependencies() noexcept;
+  // fill regs_ with the registers used by region, and compute their initial liveness
+  void fill_regs(Span<Node> nodes, size_t block, size_t end) noexcept;
+
+  /// @return the index of next item to schedule
+  uint32_t pick(uint64_t done, uint32_t cycle) const noexcept;
+  /// @return the change in register pressure if item is scheduled now
+  int32_t pressure_delta(const Item &item) const noexcept;
+  // update register pressure after scheduling item
+  void update_pressure(const Item &item) noexcept;
+
+  /// @return the register or color identifying reg
+  uint32_t key(reg::Reg reg) const noexcept;
+  /// @return index in regs_ of key, or regs_.size() if not found
+  uint32_t find(uint32_t key) const noexcept;
+  /// @return index in regs_ of key, appending it if not found
+  uint32_t find_or_add(uint32_t key) noexcept;
+
+  Scheduler &add(Node node) noexcept;
+
+  Compiler *comp_;
+  Array<Node> out_;
+  Array<Item> items_;
+  Array<uint32_t> keys_; // registers written and read by each item
+  Array<Key> regs_;      // distinct registers used by current region
+  Array<reg::Reg> defs_, uses_;
+  int32_t pressure_;     // number of live registers in regs_
+  Uarch uarch_;
+  bool after_regs_;
+  bool changed_;
+  bool good_; // !good_ means out of memory
+};
+
+} // namespace x64
+} // namespace onejit
+
+#endif // ONEJIT_X64_SCHEDULER_HPP
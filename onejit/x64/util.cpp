@@ -14,6 +14,8 @@
  */
 
 #include <onejit/assembler.hpp>
+#include <onejit/bits.hpp>
+#include <onejit/ir/var.hpp>
 #include <onejit/x64/inst.hpp>
 #include <onejit/x64/mem.hpp>
 #include <onejit/x64/reg.hpp>
@@ -107,5 +109,83 @@ bool Util::validate_mem(Assembler &dst, Mem mem) {
   return ok;
 }
 
+// return true if reg is one of the 8-bit registers %spl %bpl %sil %dil,
+// which can only be used with a REX prefix
+static bool is_rex8(Reg reg) noexcept {
+  return reg && reg.kind().bits() == Bits8 && reg.reg_id() >= RSP && reg.reg_id() <= RDI;
+}
+
+static bool is_mandatory_prefix(uint8_t byte) noexcept {
+  return byte == 0x66 || byte == 0xf2 || byte == 0xf3;
+}
+
+Assembler &Util::emit_modrm(Assembler &dst, Bytes opcode, Bits size, Reg reg,
+                            const Node &rm) noexcept {
+  Mem mem = rm.is<Mem>();
+  Reg base, index;
+  Scale scale;
+  if (mem) {
+    if (!validate_mem(dst, mem)) {
+      return dst;
+    }
+    base = Reg{mem.base()};
+    index = Reg{mem.index()};
+    scale = mem.scale();
+    if (scale == Scale0 || !index) {
+      // either scale or index is not set. clear both.
+      index = Reg{};
+      scale = Scale0;
+    }
+    if (!base && !index) {
+      // use RSP as index, it is interpreted as zero
+      index = Reg{Uint64, RSP};
+      scale = Scale1;
+    }
+  } else {
+    base = Reg{rm.is<Var>().local()};
+  }
+  uint8_t buf[24] = {};
+  size_t len = 0;
+  if (size == Bits16) {
+    buf[len++] = 0x66;
+  }
+  size_t i = 0;
+  // mandatory prefix must precede REX byte
+  for (; i < opcode.size() && is_mandatory_prefix(opcode[i]); i++) {
+    buf[len++] = opcode[i];
+  }
+  uint8_t rex = rhi(reg) << 2 | rhi(index) << 1 | rhi(base);
+  if (size == Bits64) {
+    rex |= 0x48;
+  }
+  if (rex || is_rex8(reg) || (!mem && is_rex8(base))) {
+    buf[len++] = rex | 0x40;
+  }
+  for (; i < opcode.size(); i++) {
+    buf[len++] = opcode[i];
+  }
+  if (reg) {
+    buf[len] = rlo(reg) << 3;
+  } else {
+    // last opcode byte is the ModRM byte, containing the opcode extension
+    len--;
+  }
+  if (!mem) {
+    buf[len++] |= 0xc0 | rlo(base);
+    return dst.add(Bytes{buf, len});
+  }
+  const size_t offset_bytes = get_offset_minbytes(mem, base, index);
+  len = insert_modrm_sib(buf, len, offset_bytes, base, index, scale);
+  if (offset_bytes != 0) {
+    len = insert_offset_or_imm(buf, len, offset_bytes, mem.offset());
+  }
+  dst.add(Bytes{buf, len});
+  if (auto label = mem.label()) {
+    // label address is relative only if base register is RIP
+    dst.add_relocation(label, base.reg_id() == RIP);
+  }
+  return dst;
+}
+
 } // namespace x64
 } // namespace onejit
@@ -34,6 +34,17 @@ public:
   static bool validate_reg(Assembler &dst, Reg reg);
 
   static bool validate_mem(Assembler &dst, Mem mem);
+
+  // add to dst the operand-size prefix for 'size', the mandatory prefix contained in 'opcode'
+  // if any, the REX byte if needed, the rest of 'opcode', and the ModRM byte
+  // followed by SIB byte and displacement if 'rm' is a Mem.
+  //
+  // ModRM.reg field is set to 'reg' if valid, otherwise the last byte of 'opcode'
+  // is the ModRM byte containing the opcode extension.
+  // ModRM.rm field is set to 'rm', which must be a Var containing a Reg or a Mem.
+  // the caller must add the immediate, if any
+  static Assembler &emit_modrm(Assembler &dst, Bytes opcode, Bits size, Reg reg,
+                               const Node &rm) noexcept;
 };
 
 } // namespace x64
@@ -18,20 +18,38 @@
 
 namespace onestl {
 
+enum : uint64_t {
+  EdgeEmpty = ~uint64_t(0),
+  EdgeRemoved = ~uint64_t(0) - 1,
+};
+
+// canonical key of edge (a, b). requires a >= b
+static inline uint64_t edge_key(Graph::Node a, Graph::Node b) noexcept {
+  return uint64_t(a) << 32 | b;
+}
+
+static inline size_t edge_hash(uint64_t key) noexcept {
+  key *= 0x9e3779b97f4a7c15ull;
+  return size_t(key ^ key >> 32);
+}
+
 Graph::~Graph() noexcept {
 }
 
 bool Graph::reset(Size nodes) noexcept {
-  size_t newn = nodes;
-  size_t oldn = degree_.size();
-  if (degree_.resize(newn)) {
-    if (bits_.resize(newn * newn)) {
-      bits_.fill(false);
-      std::memset(degree_.data(), '\0', newn * sizeof(Degree));
-      return true;
-    }
-    degree_.resize(oldn);
+  size_t n = nodes; // not Size, "n * n" below could overflow
+  adj_.clear();
+  edges_.clear();
+  edges_used_ = 0;
+  if (degree_.resize(n) && lists_.resize(n) && bits_.resize(n <= DenseMaxSize ? n * n : 0)) {
+    bits_.fill(false);
+    std::memset(degree_.data(), '\0', n * sizeof(Degree));
+    std::memset(lists_.data(), '\0', n * sizeof(List));
+    return true;
   }
+  degree_.clear();
+  lists_.clear();
+  bits_.clear();
   return false;
 }
 
@@ -39,11 +57,16 @@ bool Graph::operator()(Node a, Node b) const noexcept {
   if (a < b) {
     mem::swap(a, b);
   }
-  const Size n = size();
+  const size_t n = size(); // not Size, "* n" below could overflow
   if (a >= n) {
     return false;
+  } else if (dense()) {
+    return bits_[a + b * n];
+  } else if (!edges_) {
+    return false;
   }
-  return bits_[a + b * n];
+  const uint64_t key = edge_key(a, b);
+  return edges_[edge_find(key)] == key;
 }
 
 void Graph::set(Node a, Node b, bool value) noexcept {
@@ -51,19 +74,44 @@ void Graph::set(Node a, Node b, bool value) noexcept {
     mem::swap(a, b);
   }
   const size_t n = size(); // not Size, "* n" below could overflow
-  if (a < n) {
-    size_t offset = a + b * n;
-    bool prev = bits_[offset];
-    if (Degree delta = Degree(value) - Degree(prev)) {
-      degree_.data()[a] += delta;
-      degree_.data()[b] += delta; // even if a == b
-      bits_.set(offset, value);
-      if (a != b) {
-        // set both a->b and b->a
-        bits_.set(b + a * n, value);
-      }
+  if (a >= n || (*this)(a, b) == value) {
+    return;
+  }
+  const uint64_t key = edge_key(a, b);
+  if (value) {
+    if (!list_add(a, b)) {
+      return;
+    } else if (a != b && !list_add(b, a)) {
+      list_remove(a, b);
+      return;
+    } else if (!dense() && !edge_add(key)) {
+      list_remove(a, b);
+      list_remove(b, a);
+      return;
     }
+  } else {
+    list_remove(a, b);
+    list_remove(b, a);
+    if (!dense()) {
+      edge_remove(key);
+    }
+  }
+  if (dense()) {
+    // set both a->b and b->a
+    bits_.set(a + b * n, value);
+    bits_.set(b + a * n, value);
+  }
+  Degree delta = value ? 1 : Degree(-1);
+  degree_.data()[a] += delta;
+  degree_.data()[b] += delta; // even if a == b
+}
+
+View<Graph::Node> Graph::neighbors(Node node) const noexcept {
+  if (node >= size()) {
+    return View<Node>{};
   }
+  const List &list = lists_[node];
+  return View<Node>{adj_.data() + list.start, list.size};
 }
 
 Graph::Node Graph::first_set(Node node, Node first_neighbor) const noexcept {
@@ -71,6 +119,14 @@ Graph::Node Graph::first_set(Node node, Node first_neighbor) const noexcept {
   if (first_neighbor >= n || degree(node) == 0) {
     // degree(node) == 0 also catches node >= n
     return NoPos;
+  } else if (!dense()) {
+    Node found = NoPos;
+    for (Node neighbor : neighbors(node)) {
+      if (neighbor >= first_neighbor && neighbor < found) {
+        found = neighbor;
+      }
+    }
+    return found;
   }
   size_t y_offset = node * n;
   size_t offset = bits_.find(true, y_offset + first_neighbor, y_offset + n);
@@ -82,24 +138,141 @@ Graph::Node Graph::first_set(Node node, Node first_neighbor) const noexcept {
 }
 
 void Graph::remove(Node node) noexcept {
-  Degree deg = degree(node);
-  Node other = Node(0);
-  while (deg && (other = first_set(node, other)) != NoPos) {
-    set(node, other, false);
-    --deg;
-    ++other;
+  const size_t n = size(); // not Size, "* n" below could overflow
+  if (node >= n) {
+    return;
+  }
+  for (Node other : neighbors(node)) {
+    if (other != node) {
+      list_remove(other, node);
+      degree_.data()[other]--;
+    }
+    if (dense()) {
+      bits_.set(node + other * n, false);
+      bits_.set(other + node * n, false);
+    } else {
+      edge_remove(node >= other ? edge_key(node, other) : edge_key(other, node));
+    }
   }
+  lists_.data()[node].size = 0;
+  degree_.data()[node] = 0;
 }
 
 bool Graph::dup(const Graph &other) noexcept {
   if (this == &other) {
     return true;
   }
-  if (!reset(other.size())) {
+  if (!degree_.dup(other.degree_) || !lists_.dup(other.lists_) || !adj_.dup(other.adj_) ||
+      !edges_.dup(other.edges_) || !bits_.resize(other.bits_.size())) {
+    reset(0);
+    return false;
+  }
+  bits_.copy(other.bits_); // noexcept
+  edges_used_ = other.edges_used_;
+  return true;
+}
+
+size_t Graph::memory() const noexcept {
+  return bits_.capacity() / 8 + degree_.capacity() * sizeof(Degree) +
+         lists_.capacity() * sizeof(List) + adj_.capacity() * sizeof(Node) +
+         edges_.capacity() * sizeof(uint64_t);
+}
+
+bool Graph::list_add(Node a, Node b) noexcept {
+  List &list = lists_.data()[a];
+  if (list.size == list.cap) {
+    // move the list to the end of adj_, doubling its capacity.
+    // the old space is not reused until next reset()
+    const size_t start = adj_.size();
+    const Size cap = list.cap ? list.cap * 2 : 4;
+    if (!adj_.resize(start + cap)) {
+      return false;
+    }
+    Node *data = adj_.data();
+    std::memmove(data + start, data + list.start, list.size * sizeof(Node));
+    list.start = start;
+    list.cap = cap;
+  }
+  adj_.data()[list.start + list.size++] = b;
+  return true;
+}
+
+void Graph::list_remove(Node a, Node b) noexcept {
+  List &list = lists_.data()[a];
+  Node *data = adj_.data() + list.start;
+  for (Size i = 0; i < list.size; i++) {
+    if (data[i] == b) {
+      data[i] = data[--list.size];
+      return;
+    }
+  }
+}
+
+size_t Graph::edge_find(uint64_t key) const noexcept {
+  const size_t mask = edges_.size() - 1;
+  size_t removed = size_t(-1);
+  for (size_t pos = edge_hash(key) & mask;; pos = (pos + 1) & mask) {
+    const uint64_t slot = edges_[pos];
+    if (slot == key) {
+      return pos;
+    } else if (slot == EdgeEmpty) {
+      return removed != size_t(-1) ? removed : pos;
+    } else if (slot == EdgeRemoved && removed == size_t(-1)) {
+      removed = pos;
+    }
+  }
+}
+
+bool Graph::edge_add(uint64_t key) noexcept {
+  // keep at least half of the slots empty
+  if ((edges_used_ + 1) * 2 > edges_.size()) {
+    size_t live = 0;
+    for (uint64_t slot : edges_) {
+      live += slot < EdgeRemoved;
+    }
+    size_t cap = edges_.size();
+    if (cap < 64) {
+      cap = 64;
+    } else if ((live + 1) * 4 > cap) {
+      cap *= 2;
+    }
+    if (!edge_rehash(cap)) {
+      return false;
+    }
+  }
+  const size_t pos = edge_find(key);
+  uint64_t &slot = edges_.data()[pos];
+  if (slot == EdgeEmpty) {
+    edges_used_++;
+  }
+  slot = key;
+  return true;
+}
+
+void Graph::edge_remove(uint64_t key) noexcept {
+  if (edges_) {
+    const size_t pos = edge_find(key);
+    if (edges_[pos] == key) {
+      edges_.data()[pos] = EdgeRemoved;
+    }
+  }
+}
+
+bool Graph::edge_rehash(size_t cap) noexcept {
+  Array<uint64_t> old;
+  old.swap(edges_);
+  if (!edges_.resize(cap)) {
+    edges_.swap(old);
     return false;
   }
-  bits_.copy(other.bits_);     // noexcept
-  degree_.copy(other.degree_); // noexcept
+  edges_.fill(EdgeEmpty);
+  edges_used_ = 0;
+  for (uint64_t key : old) {
+    if (key < EdgeRemoved) {
+      edges_.data()[edge_find(key)] = key;
+      edges_used_++;
+    }
+  }
   return true;
 }
 
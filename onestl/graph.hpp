@@ -21,7 +21,14 @@
 
 namespace onestl {
 
-/** undirected, dense graph */
+/**
+ * undirected graph.
+ *
+ * every node keeps the list of its neighbors, so iterating on them costs O(degree).
+ * Graphs with at most DenseMaxSize nodes also keep a bit matrix to check
+ * whether two nodes are connected; larger graphs use a hash set of edges instead,
+ * so that memory grows with the number of edges and not with size()^2.
+ */
 class Graph {
 
 public:
@@ -34,13 +41,16 @@ public:
     // be careful: Graph::NoPos is uint32_t(-1),
     // while BitSet::NoPos is size_t(-1)
     NoPos = graph::NoPos,
+    // graphs larger than this do not allocate a bit matrix
+    DenseMaxSize = 1024,
   };
 
-  constexpr Graph() noexcept : bits_(), degree_() {
+  constexpr Graph() noexcept
+      : bits_(), degree_(), lists_(), adj_(), edges_(), edges_used_(0) {
   }
 
-  explicit Graph(Size size) noexcept //
-      : bits_(size_t(size) * size), degree_(size) {
+  explicit Graph(Size size) noexcept : Graph() {
+    reset(size);
   }
 
   Graph(const Graph &other) = delete;
@@ -58,6 +68,11 @@ public:
     return degree_.size();
   }
 
+  /// @return true if Graph uses a bit matrix, false if it uses a hash set of edges
+  constexpr bool dense() const noexcept {
+    return size() <= DenseMaxSize;
+  }
+
   // resize Graph and remove all edges
   bool reset(Size size) noexcept;
 
@@ -66,15 +81,21 @@ public:
   bool operator()(Node a, Node b) const noexcept;
 
   // add or remove an edge betwen nodes a and b.
-  // does nothing if a or b are out of bounds
+  // does nothing if a or b are out of bounds, or if out of memory
   void set(Node a, Node b, bool value) noexcept;
 
   /// @return number of edges connected to specified node.
+  /// a self-connection counts as two edges.
   /// @return 0 if node is out of bounds.
   constexpr Degree degree(Node node) const noexcept {
     return degree_[node];
   }
 
+  /// @return the nodes connected to specified node, in unspecified order.
+  /// contains node itself if it is self-connected.
+  /// invalidated by any change to the graph.
+  View<Node> neighbors(Node node) const noexcept;
+
   // search among edges of specified node, and return first connected node >= first_neighbor.
   /// @return NoPos if node has no edges connecting to nodes >= first_neighbor
   Node first_set(Node node, Node first_neighbor = Node(0)) const noexcept;
@@ -87,14 +108,42 @@ public:
   /// @return false if out of memory.
   bool dup(const Graph &other) noexcept;
 
+  /// @return number of bytes allocated by this graph
+  size_t memory() const noexcept;
+
   void swap(Graph &other) noexcept {
     bits_.swap(other.bits_);
     degree_.swap(other.degree_);
+    lists_.swap(other.lists_);
+    adj_.swap(other.adj_);
+    edges_.swap(other.edges_);
+    mem::swap(edges_used_, other.edges_used_);
   }
 
 private:
-  BitSet bits_;
-  Array<Degree> degree_;
+  // position of a node's neighbors inside adj_
+  struct List {
+    size_t start;
+    Size size, cap;
+  };
+
+  // add b to the neighbors of a
+  bool list_add(Node a, Node b) noexcept;
+  // remove b from the neighbors of a
+  void list_remove(Node a, Node b) noexcept;
+
+  /// @return position of key inside edges_, or of the slot where it should be inserted
+  size_t edge_find(uint64_t key) const noexcept;
+  bool edge_add(uint64_t key) noexcept;
+  void edge_remove(uint64_t key) noexcept;
+  bool edge_rehash(size_t cap) noexcept;
+
+  BitSet bits_;           // only if dense()
+  Array<Degree> degree_;  // index is node
+  Array<List> lists_;     // index is node
+  Array<Node> adj_;       // neighbor lists
+  Array<uint64_t> edges_; // hash set of edges, only if !dense()
+  size_t edges_used_;     // number of non-empty slots in edges_, including removed ones
 };
 
 inline void swap(Graph &left, Graph &right) noexcept {
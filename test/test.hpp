@@ -29,6 +29,8 @@ public:
   ~Test();
 
   void run();
+  // opt-in benchmarks, enabled by the command line option --bench
+  void bench();
 
 private:
   FuncType ftype();
@@ -37,6 +39,7 @@ private:
   // called by run()
   void stl_bitset(); // test onestl::BitSet
   void stl_graph();  // test onestl::Graph
+  void stl_graph(Graph::Size size);
   void stl_scan();   // test onestl::Scan
   void arch();
   void kind();
@@ -47,6 +50,11 @@ private:
   void expr_tuple();
   void expr_mir();
   void expr_x64();
+  void asm2_x64();
+  void asm3_x64();
+  void relax_x64();
+  void align_x64();
+  void avx_x64();
   void eval_expr();
   void eval_expr_kind(Kind kind);
 
@@ -54,6 +62,7 @@ private:
 
   void func_fib();
   void func_fib_mir();
+  void func_flags();
   void func_loop();
   void func_loop_mir();
   void func_memchr();
@@ -64,15 +73,34 @@ private:
   void func_and_or();
   void func_tuple();
   void func_max();
+  void func_select();
+  void func_sum();
+  void func_isel();
+  void func_peephole();
+  void func_schedule();
 
   void optimize();
   void optimize_expr_kind(Kind kind);
   void optimize_assign_kind(Kind kind);
+  void optimize_reassociate_kind(Kind kind);
+  void codecache();
+  void linker();
+  void profile();
   void regallocator();
+  void regallocator_bench(); // called by bench()
+  void regallocator_coalesce();
+  void regallocator_spill();
+  void regallocator_classes();
+  void regallocator_calls();
+  void regallocator_remat();
+  void linear_scan();
+  void liveness();
+  void tier();
 
   Func &make_func_fib(Kind kind);
   Func &make_func_loop(Kind kind);
   Func &make_func_memchr(Kind kind);
+  Func &make_func_sum(Kind kind);
 
   void compile(Func &func, ArchId archid);
 
@@ -0,0 +1,94 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * test_codecache.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include "test.hpp"
+
+#include <onejit/codecache.hpp>
+#include <onestl/array.hpp>
+
+#include <cstring> // std::memcmp()
+
+namespace onejit {
+
+void Test::codecache() {
+  CodeCache cache;
+
+  // mov $42, %eax; ret
+  static const uint8_t ret42[] = {0xb8, 0x2a, 0x00, 0x00, 0x00, 0xc3};
+  void *addr = cache.add(Bytes{ret42, sizeof(ret42)});
+  TEST(addr != nullptr, ==, true);
+  TEST(size_t(addr) % 16, ==, 0);
+  TEST(cache.used_bytes(), ==, 16);
+  TEST(std::memcmp(addr, ret42, sizeof(ret42)), ==, 0);
+
+#if defined(__x86_64__) || defined(__i386__)
+  {
+    using JitFtype = uint32_t (*)();
+    JitFtype jit_func = JitFtype(addr);
+    TEST(jit_func(), ==, 42);
+  }
+#endif
+
+  Array<uint8_t> code;
+  TEST(code.resize(10000), ==, true);
+  for (size_t i = 0; i < code.size(); i++) {
+    code.set(i, uint8_t(i));
+  }
+
+  // many small functions
+  Array<void *> addrs;
+  for (size_t i = 0; i < 1000; i++) {
+    void *p = cache.add(Bytes{code.data(), i % 500 + 1});
+    TEST(p != nullptr, ==, true);
+    TEST(addrs.append(p), ==, true);
+  }
+  const size_t used = cache.used_bytes();
+  const size_t mapped = cache.mapped_bytes();
+
+  // released slots are reused by functions of the same size class
+  for (size_t i = 0; i < addrs.size(); i += 2) {
+    TEST(cache.remove(addrs[i]), ==, true);
+  }
+  TEST(cache.used_bytes() < used, ==, true);
+  for (size_t i = 0; i < addrs.size(); i += 2) {
+    void *p = cache.add(Bytes{code.data(), i % 500 + 1});
+    TEST(std::memcmp(p, code.data(), i % 500 + 1), ==, 0);
+    addrs.set(i, p);
+  }
+  TEST(cache.used_bytes(), ==, used);
+  TEST(cache.mapped_bytes(), ==, mapped);
+
+  // large functions receive their own mapping
+  void *large = cache.add(Bytes{code.data(), code.size()});
+  TEST(large != nullptr, ==, true);
+  TEST(std::memcmp(large, code.data(), code.size()), ==, 0);
+  TEST(cache.mapped_bytes() >= mapped + code.size(), ==, true);
+  TEST(cache.remove(large), ==, true);
+  TEST(cache.mapped_bytes(), ==, mapped);
+
+  // code must fit the reserved memory
+  void *small = cache.alloc(10);
+  TEST(cache.write(small, Bytes{code.data(), 16}), ==, true);
+  TEST(cache.write(small, Bytes{code.data(), 17}), ==, false);
+  TEST(cache.remove(small), ==, true);
+
+  // invalid addresses
+  TEST(cache.remove(nullptr), ==, false);
+  TEST(cache.remove(&cache), ==, false);
+  TEST(cache.remove(static_cast<uint8_t *>(addr) + 1), ==, false);
+  TEST(bool(cache), ==, true);
+}
+
+} // namespace onejit
@@ -68,20 +68,32 @@ void Test::func_fib() {
 
   expected = "(block\n\
     label_0\n\
+    (x86_push rbp)\n\
+    (x86_push r12)\n\
+    (x86_sub rsp 8)\n\
     (_set var1000_ul)\n\
     (x86_cmp var1000_ul 2)\n\
     (x86_jbe label_1)\n\
-    (= var1002_ul (- var1000_ul 1))\n\
+    (x86_lea var1002_ul (x86_mem_p -1 var1000_ul))\n\
     (x86_call_ label_0 (_set var1003_ul) var1002_ul)\n\
-    (= var1004_ul (- var1000_ul 2))\n\
+    (x86_lea var1004_ul (x86_mem_p -2 var1000_ul))\n\
     (x86_call_ label_0 (_set var1005_ul) var1004_ul)\n\
     (x86_lea var1001_ul (x86_mem_p var1003_ul var1005_ul 1))\n\
+    (x86_add rsp 8)\n\
+    (x86_pop r12)\n\
+    (x86_pop rbp)\n\
     (x86_ret var1001_ul)\n\
     (x86_jmp label_2)\n\
     label_1\n\
     (x86_mov var1001_ul 1)\n\
+    (x86_add rsp 8)\n\
+    (x86_pop r12)\n\
+    (x86_pop rbp)\n\
     (x86_ret var1001_ul)\n\
     label_2\n\
+    (x86_add rsp 8)\n\
+    (x86_pop r12)\n\
+    (x86_pop rbp)\n\
     (x86_ret var1001_ul))";
   compile(f, X64);
   TEST(to_string(f.get_compiled(X64)), ==, expected);
@@ -90,6 +102,9 @@ void Test::func_fib() {
     (bb_0\n\
         (nodes\n\
             label_0\n\
+            (x86_push rbp)\n\
+            (x86_push r12)\n\
+            (x86_sub rsp 8)\n\
             (_set var1000_ul)\n\
             (x86_cmp var1000_ul 2)\n\
             (x86_jbe label_1)\n\
@@ -99,11 +114,14 @@ void Test::func_fib() {
     (bb_1\n\
         (prev bb_0)\n\
         (nodes\n\
-            (= var1002_ul (- var1000_ul 1))\n\
+            (x86_lea var1002_ul (x86_mem_p -1 var1000_ul))\n\
             (x86_call_ label_0 (_set var1003_ul) var1002_ul)\n\
-            (= var1004_ul (- var1000_ul 2))\n\
+            (x86_lea var1004_ul (x86_mem_p -2 var1000_ul))\n\
             (x86_call_ label_0 (_set var1005_ul) var1004_ul)\n\
             (x86_lea var1001_ul (x86_mem_p var1003_ul var1005_ul 1))\n\
+            (x86_add rsp 8)\n\
+            (x86_pop r12)\n\
+            (x86_pop rbp)\n\
             (x86_ret var1001_ul)\n\
         )\n\
     )\n\
@@ -118,6 +136,9 @@ void Test::func_fib() {
         (nodes\n\
             label_1\n\
             (x86_mov var1001_ul 1)\n\
+            (x86_add rsp 8)\n\
+            (x86_pop r12)\n\
+            (x86_pop rbp)\n\
             (x86_ret var1001_ul)\n\
         )\n\
     )\n\
@@ -125,6 +146,9 @@ void Test::func_fib() {
         (prev bb_2)\n\
         (nodes\n\
             label_2\n\
+            (x86_add rsp 8)\n\
+            (x86_pop r12)\n\
+            (x86_pop rbp)\n\
             (x86_ret var1001_ul)\n\
         )\n\
     )\n\
@@ -179,8 +203,8 @@ void Test::func_loop() {
   expected = "(block\n\
     label_0\n\
     (_set var1000_ul)\n\
-    (x86_mov var1001_ul 0)\n\
-    (x86_mov var1002_ul 0)\n\
+    (x86_xor var1001_ui var1001_ui)\n\
+    (x86_xor var1002_ui var1002_ui)\n\
     (x86_jmp label_2)\n\
     label_1\n\
     (x86_add var1001_ul var1002_ul)\n\
@@ -198,8 +222,8 @@ void Test::func_loop() {
         (nodes\n\
             label_0\n\
             (_set var1000_ul)\n\
-            (x86_mov var1001_ul 0)\n\
-            (x86_mov var1002_ul 0)\n\
+            (x86_xor var1001_ui var1001_ui)\n\
+            (x86_xor var1002_ui var1002_ui)\n\
             (x86_jmp label_2)\n\
         )\n\
         (next bb_2)\n\
@@ -326,7 +350,7 @@ void Test::func_switch1() {
         (nodes\n\
             label_0\n\
             (_set var1000_ul)\n\
-            (x86_cmp var1000_ul 0)\n\
+            (x86_test var1000_ul var1000_ul)\n\
             (x86_jne label_2)\n\
         )\n\
         (next bb_1 bb_2)\n\
@@ -473,7 +497,7 @@ void Test::func_switch2() {
         (nodes\n\
             label_0\n\
             (_set var1000_ul)\n\
-            (x86_cmp var1000_ul 0)\n\
+            (x86_test var1000_ul var1000_ul)\n\
             (x86_jne label_2)\n\
         )\n\
         (next bb_1 bb_2)\n\
@@ -617,7 +641,7 @@ void Test::func_cond() {
         (nodes\n\
             label_0\n\
             (_set var1000_ul)\n\
-            (x86_cmp var1000_ul 0)\n\
+            (x86_test var1000_ul var1000_ul)\n\
             (x86_jne label_2)\n\
         )\n\
         (next bb_1 bb_2)\n\
@@ -839,6 +863,109 @@ void Test::func_max() {
   TEST(to_string(f.get_compiled(X64)), ==, expected);
 }
 
+void Test::func_select() {
+  Func &f = func.reset(&holder, Name{&holder, "fselect"},
+                       FuncType{&holder, {Int64, Int64}, {Int64}});
+  Var a = f.param(0);
+  Var b = f.param(1);
+  Var ret = f.result(0);
+  Var less{f, Bool};
+  Const hundred{f, int64_t(100)};
+
+  /**
+   * jit equivalent of C++ source code
+   *
+   * int64_t fselect(int64_t a, int64_t b) {
+   *   int64_t ret;
+   *   bool less;
+   *   if (a < b) {
+   *     less = true;
+   *   } else {
+   *     less = false;
+   *   }
+   *   if (less) {
+   *     ret = b - a;
+   *   } else {
+   *     ret = a - b;
+   *   }
+   *   if (ret > 100) {
+   *     ret = 100;
+   *   }
+   *   return ret;
+   * }
+   */
+
+  f.set_body( //
+      Block{f,
+            {If{f, Binary{f, LSS, a, b}, Assign{f, ASSIGN, less, TrueExpr},
+                Assign{f, ASSIGN, less, FalseExpr}},
+             If{f, less, Assign{f, ASSIGN, ret, Binary{f, SUB, b, a}},
+                Assign{f, ASSIGN, ret, Binary{f, SUB, a, b}}},
+             Cond{f, {Binary{f, GTR, ret, hundred}, Assign{f, ASSIGN, ret, hundred}}},
+             Return{f, ret}}});
+
+  Chars expected = "(block\n\
+    (if (< var1000_l var1001_l)\n\
+        (= var1003_e true)\n\
+        (= var1003_e false))\n\
+    (if var1003_e\n\
+        (= var1002_l (- var1001_l var1000_l))\n\
+        (= var1002_l (- var1000_l var1001_l)))\n\
+    (cond\n\
+        (> var1002_l 100)\n\
+        (= var1002_l 100))\n\
+    (return var1002_l))";
+  TEST(to_string(f.get_body()), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_l var1001_l)\n\
+    (= var1003_e (< var1000_l var1001_l))\n\
+    (= var1004_l (- var1001_l var1000_l))\n\
+    (= var1002_l (- var1000_l var1001_l))\n\
+    (asm_cmovne var1002_l var1004_l var1003_e false)\n\
+    (asm_cmovg var1002_l 100 var1002_l 100)\n\
+    (return var1002_l))";
+  compile(f, NOARCH);
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (mir_lt var1003_e var1000_l var1001_l)\n\
+    (mir_sub var1004_l var1001_l var1000_l)\n\
+    (mir_sub var1002_l var1000_l var1001_l)\n\
+    (mir_nes var1005_l var1003_e false)\n\
+    (mir_neg var1005_l var1005_l)\n\
+    (mir_xor var1006_l var1004_l var1002_l)\n\
+    (mir_and var1006_l var1006_l var1005_l)\n\
+    (mir_xor var1002_l var1002_l var1006_l)\n\
+    (mir_gt var1007_l var1002_l 100)\n\
+    (mir_neg var1007_l var1007_l)\n\
+    (mir_xor var1008_l 100 var1002_l)\n\
+    (mir_and var1008_l var1008_l var1007_l)\n\
+    (mir_xor var1002_l var1002_l var1008_l)\n\
+    (mir_ret var1002_l))";
+  compile(f, MIR);
+  TEST(to_string(f.get_compiled(MIR)), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_l var1001_l)\n\
+    (x86_cmp var1000_l var1001_l)\n\
+    (x86_setl var1003_e)\n\
+    (x86_mov var1004_l var1001_l)\n\
+    (x86_sub var1004_l var1000_l)\n\
+    (x86_sub var1000_l var1001_l)\n\
+    (x86_test var1003_e var1003_e)\n\
+    (x86_cmovne var1000_l var1004_l)\n\
+    (x86_mov var1005_l 100)\n\
+    (x86_cmp var1000_l 100)\n\
+    (x86_cmovg var1000_l var1005_l)\n\
+    (x86_ret var1000_l))";
+  compile(f, X64);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+}
+
 void Test::func_memchr() {
   Func &f = make_func_memchr(Uint64);
 
@@ -872,7 +999,7 @@ void Test::func_memchr() {
   expected = "(block\n\
     label_0\n\
     (_set var1000_p var1001_ul var1002_ub)\n\
-    (x86_mov var1004_ul 0)\n\
+    (x86_xor var1004_ui var1004_ui)\n\
     (x86_jmp label_2)\n\
     label_1\n\
     (x86_cmp var1002_ub (x86_mem_ub var1000_p var1004_ul 1))\n\
@@ -885,10 +1012,311 @@ void Test::func_memchr() {
     (x86_cmp var1004_ul var1001_ul)\n\
     (x86_jb label_1)\n\
     label_3\n\
-    (x86_mov var1003_p 0x0)\n\
+    (x86_xor var1003_ui var1003_ui)\n\
     (x86_ret var1003_p))";
   compile(f, X64);
   TEST(to_string(f.get_compiled(X64)), ==, expected);
 }
 
+void Test::func_sum() {
+  Func &f = make_func_sum(Uint64);
+
+  // strength reduction replaces addr[i] with a pointer incremented at each iteration,
+  // and linear function test replacement removes i from the loop
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul)\n\
+    (= var1002_ul 0)\n\
+    (= var1003_ul 0)\n\
+    (= var1006_ul (* var1003_ul 8))\n\
+    (= var1004_p (+ var1000_p var1006_ul))\n\
+    (= var1007_ul (* var1001_ul 8))\n\
+    (= var1005_p (+ var1000_p var1007_ul))\n\
+    (goto label_2)\n\
+    label_1\n\
+    (+= var1002_ul (mem_ul var1004_p))\n\
+    (+= var1004_p 8)\n\
+    label_2\n\
+    (asm_jb label_1 var1004_p var1005_p)\n\
+    label_3\n\
+    (return var1002_ul))";
+  compile(f, NOARCH);
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (mir_mov var1002_ul 0)\n\
+    (mir_mov var1003_ul 0)\n\
+    (mir_mul var1006_ul var1003_ul 8)\n\
+    (mir_add var1004_p var1000_p var1006_ul)\n\
+    (mir_mul var1007_ul var1001_ul 8)\n\
+    (mir_add var1005_p var1000_p var1007_ul)\n\
+    (mir_jmp label_2)\n\
+    label_1\n\
+    (mir_add var1002_ul var1002_ul (mir_mem_ul var1004_p))\n\
+    (mir_add var1004_p var1004_p 8)\n\
+    label_2\n\
+    (mir_ublt label_1 var1004_p var1005_p)\n\
+    label_3\n\
+    (mir_ret var1002_ul))";
+  compile(f, MIR);
+  TEST(to_string(f.get_compiled(MIR)), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul)\n\
+    (x86_xor var1002_ui var1002_ui)\n\
+    (x86_xor var1003_ui var1003_ui)\n\
+    (x86_lea var1004_p (x86_mem_p var1000_p var1003_ul 8))\n\
+    (x86_lea var1005_p (x86_mem_p var1000_p var1001_ul 8))\n\
+    (x86_jmp label_2)\n\
+    label_1\n\
+    (x86_add var1002_ul (x86_mem_ul var1004_p))\n\
+    (x86_add var1004_p 8)\n\
+    label_2\n\
+    (x86_cmp var1004_p var1005_p)\n\
+    (x86_jb label_1)\n\
+    label_3\n\
+    (x86_ret var1002_ul))";
+  compile(f, X64);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+}
+
+void Test::func_flags() {
+  Func &f = func.reset(&holder, Name{&holder, "flags"}, //
+                       FuncType{&holder, {Int64, Int64}, {Int64}});
+  Var a = f.param(0), b = f.param(1), ret = f.result(0);
+  Var less{f, Bool};
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, less, Binary{f, LSS, a, b}},
+             If{f, less, Assign{f, SUB_ASSIGN, a, b}},
+             Assign{f, AND_ASSIGN, a, b},
+             If{f, Binary{f, GTR, a, Zero(Int64)}, Assign{f, ASSIGN, a, b}},
+             Assign{f, ASSIGN, ret, a}, //
+             Return{f, ret}}});
+
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_l var1001_l)\n\
+    (= var1003_e (< var1000_l var1001_l))\n\
+    (asm_je label_1 var1003_e false)\n\
+    (-= var1000_l var1001_l)\n\
+    label_1\n\
+    (&= var1000_l var1001_l)\n\
+    (asm_cmovg var1000_l var1001_l var1000_l 0)\n\
+    (= var1002_l var1000_l)\n\
+    (return var1002_l))";
+  compile(f, NOARCH);
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // the boolean 'less' is not materialized: the comparison is fused with the jump.
+  // x86_and already sets eflags as (x86_test var1000_l var1000_l), which is removed
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_l var1001_l)\n\
+    (x86_cmp var1000_l var1001_l)\n\
+    (x86_jge label_1)\n\
+    (x86_sub var1000_l var1001_l)\n\
+    label_1\n\
+    (x86_and var1000_l var1001_l)\n\
+    (x86_cmovg var1000_l var1001_l)\n\
+    (x86_ret var1000_l))";
+  compile(f, X64);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+  holder.clear();
+}
+
+void Test::func_isel() {
+  Func &f = func.reset(&holder, Name{&holder, "isel"}, //
+                       FuncType{&holder, {Ptr, Uint64, Uint64}, {Uint64}});
+  Var p = f.param(0), i = f.param(1), y = f.param(2);
+  Var x{f, Uint64}, z{f, Uint64}, w{f, Uint64};
+  Const eight{f, Imm{uint64_t(8)}}, three{f, Imm{uint64_t(3)}}, off{f, Imm{uint64_t(16)}};
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, x,
+                    Tuple{f, Uint64, ADD, {y, Tuple{f, Uint64, MUL, {i, eight}}, off}}},
+             Assign{f, ASSIGN, z, Tuple{f, Uint64, ADD, {x, Mem{f, Uint64, {p, i}}}}},
+             Assign{f, ASSIGN, w, Tuple{f, Uint64, MUL, {z, three}}}, //
+             Return{f, w}}});
+
+  // the chain of single-use temporaries is substituted into a single expression:
+  // the address computation and the load are folded into lea and add,
+  // the multiplication by 3 into lea with base == index
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul var1002_ul)\n\
+    (x86_lea var1005_ul (x86_mem_p 16 var1002_ul var1001_ul 8))\n\
+    (x86_add var1005_ul (x86_mem_ul var1000_p var1001_ul 1))\n\
+    (x86_lea var1003_ul (x86_mem_p var1005_ul var1005_ul 2))\n\
+    (x86_ret var1003_ul))";
+  compile(f, X64);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  Func &g = func.reset(&holder, Name{&holder, "isel_store"}, //
+                       FuncType{&holder, {Ptr, Uint64}, {Uint64}});
+  Var q = g.param(0), j = g.param(1), a{g, Ptr}, v{g, Uint64};
+  g.set_body( //
+      Block{g,
+            {Assign{g, ASSIGN, a, Tuple{g, Ptr, ADD, {q, Tuple{g, Uint64, MUL, {j, eight}}}}},
+             Assign{g, ASSIGN, v, Tuple{g, Uint64, ADD, {j, three}}},
+             Assign{g, ASSIGN, Mem{g, Uint64, {a, off}}, v}, //
+             Return{g, j}}});
+
+  // single-use temporaries are also substituted into the address and the source of a store
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul)\n\
+    (x86_lea var1004_ul (x86_mem_p 3 var1001_ul))\n\
+    (x86_mov (x86_mem_ul 16 var1000_p var1001_ul 8) var1004_ul)\n\
+    (x86_ret var1001_ul))";
+  compile(g, X64);
+  TEST(to_string(g.get_compiled(X64)), ==, expected);
+  holder.clear();
+}
+
+void Test::func_peephole() {
+  Func &f = func.reset(&holder, Name{&holder, "peephole"}, //
+                       FuncType{&holder, {Ptr, Uint64}, {Uint64}});
+  Var p = f.param(0), a = f.param(1), ret = f.result(0);
+  Mem m{f, Uint64, {p}};
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ADD_ASSIGN, m, a},                                     //
+             Assign{f, ADD_ASSIGN, a, One(f, Uint64)},                        //
+             Assign{f, ASSIGN, ret, Tuple{f, Uint64, AND, {a, Zero(Uint64)}}}, //
+             Return{f, ret}}});
+
+  // the memory update is selected as a single add, then the peephole optimizer
+  // replaces add 1 with inc and mov 0 with xor, since eflags are dead afterwards
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul)\n\
+    (x86_add (x86_mem_ul var1000_p) var1001_ul)\n\
+    (x86_inc var1001_ul)\n\
+    (x86_xor var1002_ui var1002_ui)\n\
+    (x86_ret var1002_ul))";
+  compile(f, X64);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // 20 Vars live at the same time, each incremented in place: the spilled ones are
+  // loaded, incremented and stored back, and the peephole optimizer folds the three
+  // instructions into a single add to the stack slot
+  enum : uint16_t { nvar = 20 };
+  Func &g = func.reset(&holder, Name{&holder, "peephole_spill"}, //
+                       FuncType{&holder, {Uint64}, {Uint64}});
+  Var b = g.param(0), r = g.result(0);
+  Array<Node> body;
+  Var v[nvar];
+  for (uint16_t i = 0; i < nvar; i++) {
+    v[i] = Var{g, Uint64};
+    body.append(Assign{g, ASSIGN, v[i], Binary{g, SUB, b, Const{Uint64, i}}});
+  }
+  for (uint16_t i = 0; i < nvar; i++) {
+    body.append(Assign{g, ADD_ASSIGN, v[i], b});
+  }
+  body.append(Assign{g, ASSIGN, r, v[0]});
+  for (uint16_t i = 1; i < nvar; i++) {
+    body.append(Assign{g, ADD_ASSIGN, r, v[i]});
+  }
+  body.append(Return{g, r});
+  g.set_body(Block{g, body});
+
+  for (Opt flags : {OptAll, Opt(OptAll & ~OptPeephole)}) {
+    comp.compile_arch(g, X64, flags);
+    TEST(comp.errors().size(), ==, 0);
+    Node node = g.get_compiled(X64);
+    uint32_t folded = 0;
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      Node child = node.child(i);
+      folded += child.type() == STMT_2 && OpStmt2(child.op()) == X86_ADD &&
+                child.child_is<Expr>(0).type() != VAR;
+    }
+    // 8 Vars are spilled: without peephole, each add is a load, an add and a store.
+    // the 5 callee-saved registers are also pushed and popped
+    TEST(folded, ==, (flags == OptAll ? 8u : 0u));
+    TEST(node.children(), ==, (flags == OptAll ? 88u : 104u));
+    g.set_compiled(X64, Node{});
+  }
+  holder.clear();
+}
+
+void Test::func_schedule() {
+  Func &f = func.reset(&holder, Name{&holder, "schedule"}, //
+                       FuncType{&holder, {Ptr, Uint64}, {Uint64}});
+  Var p = f.param(0), a = f.param(1), ret = f.result(0);
+  Var x{f, Uint64}, y{f, Uint64};
+  Const eight{f, Imm{uint64_t(8)}};
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, x, Mem{f, Uint64, {p}}},            //
+             Assign{f, XOR_ASSIGN, x, a},                          //
+             Assign{f, ASSIGN, y, Mem{f, Uint64, {p, eight}}},     //
+             Assign{f, XOR_ASSIGN, y, a},                          //
+             Assign{f, ASSIGN, ret, Tuple{f, Uint64, XOR, {x, y}}}, //
+             Return{f, ret}}});
+
+  // the second load is moved before the first xor, which would wait for the first load
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul)\n\
+    (x86_mov var1002_ul (x86_mem_ul var1000_p))\n\
+    (x86_mov var1004_ul (x86_mem_ul 8 var1000_p))\n\
+    (x86_xor var1002_ul var1001_ul)\n\
+    (x86_xor var1004_ul var1001_ul)\n\
+    (x86_xor var1002_ul var1004_ul)\n\
+    (x86_ret var1002_ul))";
+  compile(f, X64);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // without OptSchedule, instructions are emitted in source order
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul)\n\
+    (x86_mov var1002_ul (x86_mem_ul var1000_p))\n\
+    (x86_xor var1002_ul var1001_ul)\n\
+    (x86_mov var1004_ul (x86_mem_ul 8 var1000_p))\n\
+    (x86_xor var1004_ul var1001_ul)\n\
+    (x86_xor var1002_ul var1004_ul)\n\
+    (x86_ret var1002_ul))";
+  f.set_compiled(X64, Node{});
+  comp.compile_arch(f, X64, OptAll & ~OptSchedule);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  Func &g = func.reset(&holder, Name{&holder, "schedule_jump"}, //
+                       FuncType{&holder, {Ptr, Int64, Int64}, {Int64}});
+  Var q = g.param(0), b = g.param(1), c = g.param(2), u{g, Uint64}, v{g, Uint64};
+  eight = Const{g, Imm{uint64_t(8)}};
+  g.set_body( //
+      Block{g,
+            {Assign{g, ASSIGN, u, Mem{g, Uint64, {q}}},                      //
+             Assign{g, ASSIGN, v, Tuple{g, Uint64, ADD, {u, eight}}},       //
+             If{g, Binary{g, LSS, b, c},                                     //
+                Assign{g, ASSIGN, Mem{g, Uint64, {q, eight}}, v}},           //
+             Assign{g, ASSIGN, Mem{g, Uint64, {q}}, u},                      //
+             Return{g, b}}});
+
+  // the lea waits for the load, but the cmp is not moved before it:
+  // the cmp must stay adjacent to the conditional jump that reads its eflags
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_l var1002_l)\n\
+    (x86_mov var1004_ul (x86_mem_ul var1000_p))\n\
+    (x86_lea var1005_ul (x86_mem_p 8 var1004_ul))\n\
+    (x86_cmp var1001_l var1002_l)\n\
+    (x86_jge label_1)\n\
+    (x86_mov (x86_mem_ul 8 var1000_p) var1005_ul)\n\
+    label_1\n\
+    (x86_mov (x86_mem_ul var1000_p) var1004_ul)\n\
+    (x86_ret var1001_l))";
+  compile(g, X64);
+  TEST(to_string(g.get_compiled(X64)), ==, expected);
+  holder.clear();
+}
+
 } // namespace onejit
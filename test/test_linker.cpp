@@ -0,0 +1,224 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * test_linker.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include "test.hpp"
+
+#include <onejit/assembler.hpp>
+#include <onejit/codecache.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/linker.hpp>
+#include <onejit/x64.hpp>
+
+namespace onejit {
+
+void Test::linker() {
+  using JitFtype = uint32_t (*)();
+  CodeCache cache;
+  Linker linker{cache};
+  Var eax{x64::Reg{Uint32, x64::RAX}};
+
+  // return a Block containing: mov $val, %eax; ret
+  auto make_ret_const = [&](Func &f, int16_t val) {
+    return Block{f, {f.address(), Stmt2{f, X86_MOV, eax, Const{Uint32, val}}, Return{f, X86_RET}}};
+  };
+
+  // return a Block containing: call callee; add $val, %eax; ret
+  auto make_call_add = [&](Func &f, const Func &callee, int16_t val) {
+    return Block{f,
+                 {f.address(), Stmt1{f, callee.address(), X86_CALL},
+                  Stmt2{f, X86_ADD, eax, Const{Uint32, val}}, Return{f, X86_RET}}};
+  };
+
+  // intra-function forward and backward jumps
+  {
+    Func &f = func.reset(&holder, Name{&holder, "linker"}, FuncType{&holder, {}, {}});
+    Label back{f}, fwd{f}, skip{f};
+    Block block{f,
+                {f.address(), Stmt2{f, X86_MOV, eax, Const{Uint32, int16_t(10)}}, //
+                 Stmt1{f, fwd, X86_JMP},                                           //
+                 back, Stmt2{f, X86_ADD, eax, Const{Uint32, int16_t(5)}},          //
+                 Stmt1{f, skip, X86_JMP},                                          //
+                 fwd, Stmt2{f, X86_ADD, eax, Const{Uint32, int16_t(100)}},         //
+                 Stmt1{f, back, X86_JMP},                                          //
+                 Stmt2{f, X86_MOV, eax, Const{Uint32, int16_t(99)}},               //
+                 skip, Return{f, X86_RET}}};
+
+    Assembler assembler;
+    assembler.x64(block);
+    TEST(assembler.errors().size(), ==, 0);
+    // all jumps are near enough to use rel8 encoding, and need no relocation
+    TEST(assembler.relocations().size(), ==, 0);
+    TEST(assembler.labels().size(), ==, 4);
+    TEST(f.address().address(), ==, 0);
+
+    void *addr = linker.link(assembler);
+    TEST(addr != nullptr, ==, true);
+    TEST(linker.pending(), ==, 0);
+    TEST(linker.errors().size(), ==, 0);
+    TEST(f.address().address(), ==, uint64_t(size_t(addr)));
+    TEST(skip.address(), ==, f.address().address() + assembler.labels()[3].pos);
+
+#if defined(__x86_64__)
+    TEST(JitFtype(addr)(), ==, 115);
+#endif
+    holder.clear();
+  }
+
+  // call between functions, with forward reference
+  {
+    Func caller{&holder, Name{&holder, "caller"}, FuncType{&holder, {}, {}}};
+    Func callee{&holder, Name{&holder, "callee"}, FuncType{&holder, {}, {}}};
+    Assembler asm_caller, asm_callee;
+    asm_caller.x64(make_call_add(caller, callee, 1));
+    asm_callee.x64(make_ret_const(callee, 41));
+
+    void *addr_caller = linker.link(asm_caller);
+    TEST(addr_caller != nullptr, ==, true);
+    TEST(linker.pending(), ==, 1);
+
+    void *addr_callee = linker.link(asm_callee);
+    TEST(addr_callee != nullptr, ==, true);
+    TEST(linker.pending(), ==, 0);
+    TEST(linker.errors().size(), ==, 0);
+    TEST(callee.address().address(), ==, uint64_t(size_t(addr_callee)));
+
+#if defined(__x86_64__)
+    TEST(JitFtype(addr_caller)(), ==, 42);
+#endif
+    holder.clear();
+  }
+
+  // module: callees are placed right after their first caller
+  {
+    Func unrelated{&holder, Name{&holder, "unrelated"}, FuncType{&holder, {}, {}}};
+    Func caller{&holder, Name{&holder, "caller"}, FuncType{&holder, {}, {}}};
+    Func callee{&holder, Name{&holder, "callee"}, FuncType{&holder, {}, {}}};
+    Assembler asm_unrelated, asm_caller, asm_callee;
+    asm_unrelated.x64(make_ret_const(unrelated, 7));
+    asm_caller.x64(make_call_add(caller, callee, 2));
+    asm_callee.x64(make_ret_const(callee, 3));
+
+    const Assembler *assemblers[] = {&asm_caller, &asm_unrelated, &asm_callee};
+    void *addr = linker.link(View<const Assembler *>{assemblers, 3});
+    TEST(addr != nullptr, ==, true);
+    TEST(linker.pending(), ==, 0);
+    TEST(linker.errors().size(), ==, 0);
+
+    const uint64_t base = uint64_t(size_t(addr));
+    const uint64_t caller_end = base + asm_caller.size();
+    TEST(caller.address().address(), ==, base);
+    TEST(callee.address().address(), ==, (caller_end + 15) & ~uint64_t(15));
+    TEST(unrelated.address().address() > callee.address().address(), ==, true);
+
+#if defined(__x86_64__)
+    TEST(JitFtype(size_t(caller.address().address()))(), ==, 5);
+    TEST(JitFtype(size_t(unrelated.address().address()))(), ==, 7);
+#endif
+    holder.clear();
+  }
+
+  // configurable function alignment
+  {
+    Func aligned{&holder, Name{&holder, "aligned"}, FuncType{&holder, {}, {}}};
+    Assembler assembler;
+    assembler.x64(make_ret_const(aligned, 9));
+
+    linker.configure_align(64);
+    TEST(linker.func_align(), ==, 64);
+    for (size_t i = 0; i < 4; i++) {
+      void *addr = linker.link(assembler);
+      TEST(size_t(addr) % 64, ==, 0);
+#if defined(__x86_64__)
+      TEST(JitFtype(addr)(), ==, 9);
+#endif
+    }
+    linker.configure_align(24);
+    TEST(linker.func_align(), ==, 64);
+    TEST(linker.errors().size(), ==, 1);
+    holder.clear();
+  }
+
+  // compiled code preserves the callee-saved registers it uses
+  {
+    Func &f = make_func_fib(Uint64);
+    compile(f, X64);
+    Node compiled = f.get_compiled(X64);
+    // compiled code still contains Vars: keep its prologue and epilogue,
+    // and replace its body with instructions that overwrite each saved register
+    Array<Node> nodes;
+    nodes.append(f.address());
+    uint32_t i = 1, n = compiled.children(), pushes = 0;
+    for (; i < n; i++) {
+      Node node = compiled.child(i);
+      if (node.type() == STMT_1 && OpStmt1(node.op()) == X86_PUSH) {
+        pushes++;
+      } else if (node.type() != STMT_2 || OpStmt2(node.op()) != X86_SUB) {
+        break;
+      }
+      nodes.append(node);
+    }
+    for (uint32_t j = 1; j <= pushes; j++) {
+      nodes.append(Stmt2{f, X86_MOV, compiled.child(j).child_is<Expr>(0),
+                         Const{Uint64, int16_t(0)}});
+    }
+    // the epilogue is the sequence before the first ret
+    uint32_t ret = i;
+    while (ret < n && (compiled.child(ret).type() != STMT_N ||
+                       OpStmtN(compiled.child(ret).op()) != X86_RET)) {
+      ret++;
+    }
+    uint32_t epilogue = ret;
+    for (Node node; epilogue > i; epilogue--) {
+      node = compiled.child(epilogue - 1);
+      if (!(node.type() == STMT_1 && OpStmt1(node.op()) == X86_POP) &&
+          !(node.type() == STMT_2 && OpStmt2(node.op()) == X86_ADD)) {
+        break;
+      }
+    }
+    for (uint32_t j = epilogue; j < ret; j++) {
+      nodes.append(compiled.child(j));
+    }
+    nodes.append(Return{f, X86_RET});
+    // fib keeps Vars in RBP and R12 across its recursive calls
+    TEST(pushes, ==, 2);
+    TEST(ret - epilogue, ==, 3); // add rsp 8; pop r12; pop rbp
+
+    // caller keeps 42 in R12 across the call
+    Func caller{&holder, Name{&holder, "caller"}, FuncType{&holder, {}, {}}};
+    Var r12{x64::Reg{Uint64, x64::R12}}, rax{x64::Reg{Uint64, x64::RAX}};
+    Block block{caller,
+                {caller.address(), Stmt1{caller, r12, X86_PUSH},
+                 Stmt2{caller, X86_MOV, r12, Const{Uint64, int16_t(42)}},
+                 Stmt1{caller, f.address(), X86_CALL}, Stmt2{caller, X86_MOV, rax, r12},
+                 Stmt1{caller, r12, X86_POP}, Return{caller, X86_RET}}};
+
+    Assembler asm_caller, asm_callee;
+    asm_caller.x64(block);
+    asm_callee.x64(Block{f, Nodes{nodes.data(), nodes.size()}});
+    TEST(asm_caller.errors().size(), ==, 0);
+    TEST(asm_callee.errors().size(), ==, 0);
+
+    const Assembler *assemblers[] = {&asm_caller, &asm_callee};
+    void *addr = linker.link(View<const Assembler *>{assemblers, 2});
+    TEST(addr != nullptr, ==, true);
+    TEST(linker.pending(), ==, 0);
+#if defined(__x86_64__)
+    TEST(JitFtype(addr)(), ==, 42);
+#endif
+    holder.clear();
+  }
+}
+
+} // namespace onejit
@@ -18,7 +18,8 @@
 #include <onejit/assembler.hpp>
 #include <onejit/codeparser.hpp>
 
-#include <cstdio> // stdout
+#include <cstdio>  // stdout
+#include <cstring> // strcmp()
 #include <time.h> // clock_gettime()
 
 #ifdef __unix__
@@ -56,22 +57,44 @@ void Test::run() {
   expr_tuple();
   expr_mir();
   expr_x64();
+  asm2_x64();
+  asm3_x64();
+  relax_x64();
+  align_x64();
+  avx_x64();
   eval_expr();
 
   stmt_if();
 
   optimize();
+  codecache();
+  linker();
+  profile();
   regallocator();
+  regallocator_coalesce();
+  regallocator_spill();
+  regallocator_classes();
+  regallocator_calls();
+  regallocator_remat();
+  linear_scan();
+  liveness();
+  tier();
 
   func_and_or();
   func_cond();
   func_fib();
   func_fib_mir();
+  func_flags();
+  func_isel();
+  func_peephole();
+  func_schedule();
   func_loop();
   func_loop_mir();
   func_max();
   func_memchr();
   func_memchr_mir();
+  func_select();
+  func_sum();
   func_switch1();
   func_switch2();
   func_tuple();
@@ -79,6 +102,10 @@ void Test::run() {
   Fmt{stdout} << testcount() << " tests passed\n";
 }
 
+void Test::bench() {
+  regallocator_bench();
+}
+
 void Test::compile(Func &f, ArchId archid) {
   // implies comp.compile(f, OptAll);
   comp.compile_arch(f, archid, OptAll);
@@ -133,10 +160,11 @@ double Test::get_cpu_clock() {
 } // namespace onejit
 
 int main(int argc, char *argv[]) {
-  (void)argc;
-  (void)argv;
-
-  onejit::Test{}.run();
+  onejit::Test test;
+  test.run();
+  if (argc > 1 && !std::strcmp(argv[1], "--bench")) {
+    test.bench();
+  }
 
   return 0;
 }
@@ -123,4 +123,40 @@ Func &Test::make_func_memchr(Kind kind) {
   return f;
 }
 
+Func &Test::make_func_sum(Kind kind) {
+  Func &f = func.reset(&holder, Name{&holder, "sum"}, //
+                       FuncType{&holder, {Ptr, Uint64}, {kind}});
+  Var addr = f.param(0);
+  Var len = f.param(1);
+  Var total = f.result(0);
+  Var i{f, Uint64};
+  Const size{f, Imm{uint64_t(kind.bitsize() / 8)}};
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * T sum(const T* addr, uint64_t len) {
+   *   T total = 0;
+   *   for (uint64_t i = 0; i < len; i++) {
+   *     total += addr[i];
+   *   }
+   *   return total;
+   * }
+   */
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, total, Zero(kind)},
+             For{
+                 f,                                   //
+                 Assign{f, ASSIGN, i, Zero(Uint64)},  // init
+                 Binary{f, LSS, i, len},              // test
+                 Inc{f, i},                           // post
+                 Assign{f, ADD_ASSIGN, total,         // body
+                        Mem{f, kind, {addr, Tuple{f, Uint64, MUL, {i, size}}}}},
+             },
+             Return{f, total}}});
+  return f;
+}
+
 } // namespace onejit
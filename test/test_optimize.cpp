@@ -28,6 +28,7 @@ void Test::optimize() {
                     Float32, Float64}) {
     optimize_expr_kind(kind);
     optimize_assign_kind(kind);
+    optimize_reassociate_kind(kind);
   }
 }
 
@@ -216,4 +217,33 @@ void Test::optimize_assign_kind(Kind kind) {
   }
 }
 
+void Test::optimize_reassociate_kind(Kind kind) {
+  Func &f = func;
+
+  Const one = One(f, kind);
+  Var a{f, kind}, b{f, kind}, c{f, kind}, d{f, kind}, i{f, kind};
+
+  // optimize() on a+b+c+d+1 should return a balanced tree
+  Expr expr = Tuple{f, kind, ADD, {a, b, one, c, d}};
+  Node optimized = opt.optimize(f, expr);
+  String expected;
+  Fmt{&expected} << "(+ (+ (+ " << a << " 1) " << b << ") (+ " << c << ' ' << d << "))";
+  TEST(to_string(optimized), ==, expected);
+
+  if (kind.is_float()) {
+    // floating point + is not associative without OptFastMath
+    optimized = opt.optimize(f, expr, OptAll & ~OptFastMath);
+    TEST(optimized, ==, expr);
+  }
+
+  // inside a loop, optimize() on i+a+b should group the loop-invariant a+b
+  Assign assign{f, ASSIGN, d, Tuple{f, kind, ADD, {i, a, b}}};
+  For loop{f, VoidExpr, Binary{f, LSS, i, c}, Inc{f, i}, assign};
+  optimized = opt.optimize(f, loop);
+  expected.clear();
+  Fmt{&expected} << "(for void (< " << i << ' ' << c << ") (++ " << i << ")\n    (= " << d
+                 << " (+ (+ " << a << ' ' << b << ") " << i << ")))";
+  TEST(to_string(optimized), ==, expected);
+}
+
 } // namespace onejit
@@ -0,0 +1,141 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * test_profile.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include "test.hpp"
+
+#include <onejit/assembler.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/profile.hpp>
+
+namespace onejit {
+
+static size_t count_aligned_labels(Func &f, const Assembler &assembler) {
+  size_t n = 0;
+  for (Label l : f.labels()) {
+    n += assembler.label_align(l) != 1;
+  }
+  return n;
+}
+
+// uses only the public API of Compiler, although Test is a friend of it
+static void align_loops(Compiler &comp, Func &f, Assembler &assembler) {
+  assembler.clear();
+  comp.align_loops(f, assembler);
+}
+
+void Test::profile() {
+  Profile prof;
+  Func &f = make_func_memchr(Uint64);
+
+  comp.configure_profile(&prof, ProfileCollect).compile(f);
+  TEST(comp.errors().size(), ==, 0);
+  TEST(prof.counts().size(), ==, Profile::key_at(5));
+  TEST(prof.empty(), ==, true);
+
+  const uint64_t *counts = prof.counts().data();
+  String expected;
+  Fmt{&expected} << "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul var1002_ub)\n\
+    (++ (mem_ul 0x"
+                 << Hex{counts + Profile::key_at(0)} << "))\n\
+    (= var1004_ul 0)\n\
+    (goto label_2)\n\
+    label_1\n\
+    (++ (mem_ul 0x"
+                 << Hex{counts + Profile::key_at(1)} << "))\n\
+    (asm_jne label_4 var1002_ub (mem_ub var1000_p var1004_ul))\n\
+    (++ (mem_ul 0x"
+                 << Hex{counts + Profile::key_after(4)} << "))\n\
+    (= var1003_p (+ var1004_ul var1000_p))\n\
+    (return var1003_p)\n\
+    label_4\n\
+    (++ (mem_ul 0x"
+                 << Hex{counts + Profile::key_at(4)} << "))\n\
+    (++ var1004_ul)\n\
+    label_2\n\
+    (++ (mem_ul 0x"
+                 << Hex{counts + Profile::key_at(2)} << "))\n\
+    (asm_jb label_1 var1004_ul var1001_ul)\n\
+    label_3\n\
+    (++ (mem_ul 0x"
+                 << Hex{counts + Profile::key_at(3)} << "))\n\
+    (= var1003_p 0x0)\n\
+    (return var1003_p))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // simulate executions where the searched byte is never found
+  Span<uint64_t> mut_counts{prof.counts_.data(), prof.counts_.size()};
+  for (size_t i = 0; i < mut_counts.size(); i++) {
+    mut_counts.set(i, 10);
+  }
+  mut_counts.set(Profile::key_after(4), 0);
+  TEST(prof.empty(), ==, false);
+  TEST(prof.entry(), ==, 10);
+
+  // the block returning the found byte is moved to the end
+  f.clear_compiled();
+  comp.configure_profile(&prof, ProfileUse).compile(f);
+  TEST(comp.errors().size(), ==, 0);
+
+  Chars expected_use = "(block\n\
+    label_0\n\
+    (_set var1000_p var1001_ul var1002_ub)\n\
+    (= var1004_ul 0)\n\
+    (goto label_2)\n\
+    label_1\n\
+    (asm_je label_5 var1002_ub (mem_ub var1000_p var1004_ul))\n\
+    label_4\n\
+    (++ var1004_ul)\n\
+    label_2\n\
+    (asm_jb label_1 var1004_ul var1001_ul)\n\
+    label_3\n\
+    (= var1003_p 0x0)\n\
+    (return var1003_p)\n\
+    label_5\n\
+    (= var1003_p (+ var1004_ul var1000_p))\n\
+    (return var1003_p))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected_use);
+
+  // block frequencies guide register allocation
+  Array<float> freq;
+  comp.profile_freq(freq);
+  TEST(freq.size(), ==, 2 * f.labels().size());
+  TEST(freq[0], ==, 1.0f);
+  // recompiling creates the same labels
+  TEST(freq[2 * 4], ==, 1.0f);
+  TEST(freq[2 * 4 + 1], ==, 0.0f);
+  // label_5 was created by block layout and has no counter
+  TEST(freq[2 * 5], ==, -1.0f);
+
+  f.clear_compiled();
+  compile(f, X64);
+
+  // the loop runs once per invocation: too cold to be aligned
+  Assembler assembler;
+  align_loops(comp, f, assembler);
+  TEST(assembler.errors().size(), ==, 0);
+  TEST(count_aligned_labels(f, assembler), ==, 0);
+
+  // without a Profile, the innermost loop is aligned
+  comp.configure_profile(nullptr, ProfileNone).profile_freq(freq);
+  TEST(freq.size(), ==, 0);
+  align_loops(comp, f, assembler);
+  TEST(assembler.errors().size(), ==, 0);
+  TEST(count_aligned_labels(f, assembler), ==, 1);
+}
+
+} // namespace onejit
@@ -15,7 +15,13 @@
 
 #include "test.hpp"
 
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
 #include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
+#include <onejit/x64/compiler.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
 
 #include <cstdio>
 
@@ -99,4 +105,563 @@ void Test::regallocator() {
   TEST(result, ==, expected);
 }
 
+void Test::regallocator_coalesce() {
+  enum : size_t { nreg = 5 };
+  Allocator allocator{nreg};
+  Graph &graph = allocator.graph();
+  graph.set(Reg(0), Reg(2), true);
+  graph.set(Reg(1), Reg(2), true);
+  graph.set(Reg(2), Reg(3), true);
+  graph.set(Reg(3), Reg(4), true);
+  allocator.add_move(Reg(1), Reg(0)); // coalesced
+  allocator.add_move(Reg(3), Reg(2)); // not coalesced: 2 and 3 interfere
+  allocator.add_move(Reg(4), Reg(0)); // coalesced
+  String result;
+  run_allocator(result, allocator, Color(3));
+  Chars expected = "2 2 1 0 2 ";
+  TEST(result, ==, expected);
+  // coalescing merged register 4 into register 0
+  TEST(graph(0, 3), ==, true);
+  TEST(graph.degree(4), ==, 0);
+
+  // the move var1002_ul <- var1000_ul is removed, because both Vars receive the same color
+  Func &f = func.reset(&holder, Name{&holder, "add"}, //
+                       FuncType{&holder, {Uint64, Uint64}, {Uint64}});
+  Var a = f.param(0), b = f.param(1), r = f.result(0);
+  f.set_body(Block{f,
+                   {Assign{f, ASSIGN, r, a}, //
+                    Assign{f, ADD_ASSIGN, r, b}, Return{f, r}}});
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul)\n\
+    (x86_add var1000_ul var1001_ul)\n\
+    (x86_ret var1000_ul))";
+  // try both graph coloring and linear scan
+  for (Opt flags : {OptAll, Opt(OptAll & ~OptRegColoring)}) {
+    comp.compile_arch(f, X64, flags);
+    TEST(comp.errors().size(), ==, 0);
+    TEST(to_string(f.get_compiled(X64)), ==, expected);
+    f.set_compiled(X64, Node{});
+  }
+}
+
+// collect into 'vars' the Vars contained in node
+static void collect_vars(Node node, Array<Var> &vars) {
+  if (Var var = node.is<Var>()) {
+    vars.append(var);
+  } else if (node.type() != LABEL) {
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      collect_vars(node.child(i), vars);
+    }
+  }
+}
+
+// collect into 'offsets' the offset of each stack slot, i.e. x64::Mem relative to RSP,
+// contained in node
+static void collect_offsets(Node node, Array<int32_t> &offsets) {
+  if (x64::Mem mem = node.is<x64::Mem>()) {
+    if (x64::Reg{mem.base()}.reg_id() == x64::RSP) {
+      offsets.append(mem.offset());
+    }
+  } else if (node.type() != LABEL) {
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      collect_offsets(node.child(i), offsets);
+    }
+  }
+}
+
+// append to 'across' the Vars in block 'node' that are live across its only call,
+// i.e. read after the call before being written. 'result' is written by the call
+static void collect_across_call(Node node, Var result, Array<Var> &across) {
+  Array<Var> written;
+  written.append(result);
+  bool after = false;
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    Node child = node.child(i);
+    if (!after || child.type() != STMT_2) {
+      after = after || child.op() == X86_CALL_;
+      continue;
+    }
+    for (uint32_t j = 0; j < 2; j++) {
+      Var var = child.child_is<Expr>(j).is<Var>();
+      if (!var || var.id().val() < Id::FIRST) {
+        // skip RSP
+        continue;
+      }
+      bool found = false;
+      for (Var w : written) {
+        found = found || w == var;
+      }
+      // x86_mov does not read its destination
+      if (!found && (j != 0 || OpStmt2(child.op()) != X86_MOV)) {
+        across.append(var);
+      }
+      if (j == 0) {
+        written.append(var);
+      }
+    }
+  }
+}
+
+// return true if id is a register preserved by function calls in all x86_64 ABIs,
+// except go1 which preserves none
+static bool is_callee_saved(x64::RegId id) {
+  return id == x64::RBP || (id >= x64::R12 && id <= x64::R15);
+}
+
+void Test::regallocator_spill() {
+  enum : size_t { nreg = 4 };
+  Allocator allocator{nreg};
+  Graph &graph = allocator.graph();
+  // all registers interfere: with 3 colors, one of them must be spilled
+  for (Reg r1 = 0; r1 < nreg; r1++) {
+    for (Reg r2 = 0; r2 < r1; r2++) {
+      graph.set(r1, r2, true);
+    }
+  }
+  String result;
+  run_allocator(result, allocator, Color(3));
+  Chars expected = "3 2 1 0 ";
+  TEST(result, ==, expected);
+
+  // register 1 is used less often than the others: spill it instead
+  Array<float> &weights = allocator.weights();
+  weights.resize(nreg);
+  weights.fill(10.0f);
+  weights.set(1, 2.0f);
+  run_allocator(result, allocator, Color(3));
+  expected = "2 3 1 0 ";
+  TEST(result, ==, expected);
+
+  // basic blocks: 0 = entry, 1 = loop body, 2 = loop test, 3 = return
+  Func &f = make_func_loop(Uint64);
+  compile(f, X64);
+  View<uint32_t> loop_depth = comp.flowgraph_.loop_depth();
+  TEST(loop_depth.size(), ==, 4);
+  TEST(loop_depth[0], ==, 0);
+  TEST(loop_depth[1], ==, 1);
+  TEST(loop_depth[2], ==, 1);
+  TEST(loop_depth[3], ==, 0);
+
+  // sum of 20 Vars, all live at the same time: some must be spilled to the stack
+  enum : uint16_t { nvar = 20 };
+  Func &g = func.reset(&holder, Name{&holder, "spill"}, FuncType{&holder, {Uint64}, {Uint64}});
+  Var a = g.param(0), r = g.result(0);
+  Array<Node> body;
+  Var v[nvar];
+  for (uint16_t i = 0; i < nvar; i++) {
+    v[i] = Var{g, Uint64};
+    body.append(Assign{g, ASSIGN, v[i], Binary{g, SUB, a, Const{Uint64, i}}});
+  }
+  body.append(Assign{g, ASSIGN, r, v[0]});
+  for (uint16_t i = 1; i < nvar; i++) {
+    body.append(Assign{g, ADD_ASSIGN, r, v[i]});
+  }
+  body.append(Return{g, r});
+  g.set_body(Block{g, body});
+
+  // try both graph coloring and linear scan
+  for (Opt flags : {OptAll, Opt(OptAll & ~OptRegColoring)}) {
+    comp.compile_arch(g, X64, flags);
+    TEST(comp.errors().size(), ==, 0);
+
+    Node node = g.get_compiled(X64);
+    // 7 Vars are spilled at the same time: each needs its own 8-byte stack slot.
+    // the function is a leaf and its frame is small: stack slots are in the red zone below RSP.
+    // the 5 callee-saved registers are pushed first, thus RSP is 0 (mod 16)
+    // and the frame grows from 56 to 64 bytes to keep RSP - frame aligned to 16 bytes
+    for (uint32_t i = 0; i < 5; i++) {
+      TEST(node.child(i + 1).op(), ==, X86_PUSH);
+    }
+    TEST(node.child(6).op(), !=, X86_SUB);
+    Array<int32_t> offsets;
+    collect_offsets(node, offsets);
+    TEST(offsets.size(), ==, 14); // 7 stores and 7 loads
+    uint64_t used = 0;
+    for (int32_t offset : offsets) {
+      TEST(offset, >=, -64);
+      TEST(offset, <, -8);
+      TEST(offset % 8, ==, 0);
+      used |= uint64_t(1) << (offset + 64) / 8;
+    }
+    TEST(used, ==, 0x7f);
+
+    // all Vars still present in compiled code received a register
+    Array<Var> vars;
+    collect_vars(node, vars);
+    View<Color> colors = comp.allocator_.get_colors();
+    for (Var var : vars) {
+      if (var.id().val() >= Id::FIRST) {
+        TEST(colors[var.id().val() - Id::FIRST], <, 14);
+      }
+    }
+    g.set_compiled(X64, Node{});
+  }
+}
+
+void Test::regallocator_classes() {
+  enum : size_t { nreg = 4 };
+  Allocator allocator{nreg};
+  Graph &graph = allocator.graph();
+  // all registers interfere: with a single class and 2 colors, two of them must be spilled
+  for (Reg r1 = 0; r1 < nreg; r1++) {
+    for (Reg r2 = 0; r2 < r1; r2++) {
+      graph.set(r1, r2, true);
+    }
+  }
+  String result;
+  run_allocator(result, allocator, Color(2));
+  Chars expected = "3 2 1 0 ";
+  TEST(result, ==, expected);
+
+  // registers 2 and 3 are in a different class, with its own 2 colors: nothing is spilled
+  const Color num_colors[] = {2, 2};
+  allocator.set_class(2, 1);
+  allocator.set_class(3, 1);
+  allocator.allocate_regs(View<Color>{num_colors, 2});
+  to_string(result, allocator.get_colors());
+  expected = "1 0 1 0 ";
+  TEST(result, ==, expected);
+
+  // same with linear scan
+  Array<Interval> &intervals = allocator.intervals();
+  intervals.resize(nreg);
+  intervals.fill(Interval{0, 10});
+  allocator.linear_scan(View<Color>{num_colors, 2});
+  to_string(result, allocator.get_colors());
+  expected = "0 1 0 1 ";
+  TEST(result, ==, expected);
+
+  // reset() puts all registers back in class 0
+  allocator.reset(nreg);
+  TEST(allocator.get_class(3), ==, 0);
+}
+
+void Test::regallocator_calls() {
+  enum : size_t { nreg = 3 };
+  Allocator allocator{nreg};
+  Graph &graph = allocator.graph();
+  graph.set(Reg(0), Reg(1), true);
+  graph.set(Reg(1), Reg(2), true);
+  // register 0 is live across a call that clobbers colors 0 and 1
+  allocator.forbid_colors(0, 0x3);
+  String result;
+  run_allocator(result, allocator, Color(3));
+  Chars expected = "2 1 0 ";
+  TEST(result, ==, expected);
+
+  Array<Interval> &intervals = allocator.intervals();
+  intervals.resize(nreg);
+  intervals.fill(Interval{0, 10});
+  allocator.linear_scan(Color(3));
+  to_string(result, allocator.get_colors());
+  expected = "2 0 1 ";
+  TEST(result, ==, expected);
+
+  // 8 Vars are live across a call, more than the registers preserved by the call
+  Func &f = func.reset(&holder, Name{&holder, "calls"}, FuncType{&holder, {Uint64}, {Uint64}});
+  Var a = f.param(0), r = f.result(0);
+  enum : uint16_t { nvar = 8 };
+  Array<Node> body;
+  Var v[nvar];
+  for (uint16_t i = 0; i < nvar; i++) {
+    v[i] = Var{f, Uint64};
+    body.append(Assign{f, ASSIGN, v[i], Binary{f, SUB, a, Const{Uint64, i}}});
+  }
+  body.append(Assign{f, ASSIGN, r, Call{f, f.fheader(), {v[0]}}});
+  for (uint16_t i = 0; i < nvar; i++) {
+    body.append(Assign{f, ADD_ASSIGN, r, v[i]});
+  }
+  body.append(Return{f, r});
+  f.set_body(Block{f, body});
+
+  // with graph coloring, 5 Vars stay in the registers preserved by the call,
+  // and the other 3 are saved to the stack only around the call.
+  // such registers are preserved for our caller too: they are pushed and popped,
+  // and the frame is 32 bytes to keep RSP aligned to 16 bytes at the call
+  expected = "(block\n\
+    label_0\n\
+    (x86_push rbp)\n\
+    (x86_push r12)\n\
+    (x86_push r13)\n\
+    (x86_push r14)\n\
+    (x86_push r15)\n\
+    (x86_sub rsp 32)\n\
+    (_set var1000_ul)\n\
+    (x86_mov var1002_ul var1000_ul)\n\
+    (x86_lea var1003_ul (x86_mem_p -1 var1000_ul))\n\
+    (x86_lea var1004_ul (x86_mem_p -2 var1000_ul))\n\
+    (x86_lea var1005_ul (x86_mem_p -3 var1000_ul))\n\
+    (x86_lea var1006_ul (x86_mem_p -4 var1000_ul))\n\
+    (x86_lea var1007_ul (x86_mem_p -5 var1000_ul))\n\
+    (x86_lea var1008_ul (x86_mem_p -6 var1000_ul))\n\
+    (x86_lea var1009_ul (x86_mem_p -7 var1000_ul))\n\
+    (x86_mov (x86_mem_ul rsp) var1002_ul)\n\
+    (x86_mov (x86_mem_ul 8 rsp) var1003_ul)\n\
+    (x86_mov (x86_mem_ul 16 rsp) var1004_ul)\n\
+    (x86_call_ label_0 (_set var1001_ul) var1002_ul)\n\
+    (x86_mov var1002_ul (x86_mem_ul rsp))\n\
+    (x86_mov var1003_ul (x86_mem_ul 8 rsp))\n\
+    (x86_mov var1004_ul (x86_mem_ul 16 rsp))\n\
+    (x86_add var1001_ul var1002_ul)\n\
+    (x86_add var1001_ul var1003_ul)\n\
+    (x86_add var1001_ul var1004_ul)\n\
+    (x86_add var1001_ul var1005_ul)\n\
+    (x86_add var1001_ul var1006_ul)\n\
+    (x86_add var1001_ul var1007_ul)\n\
+    (x86_add var1001_ul var1008_ul)\n\
+    (x86_add var1001_ul var1009_ul)\n\
+    (x86_add rsp 32)\n\
+    (x86_pop r15)\n\
+    (x86_pop r14)\n\
+    (x86_pop r13)\n\
+    (x86_pop r12)\n\
+    (x86_pop rbp)\n\
+    (x86_ret var1001_ul))";
+  comp.compile_arch(f, X64, OptAll);
+  TEST(comp.errors().size(), ==, 0);
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // try both graph coloring and linear scan:
+  // linear scan does not coalesce, and the copies around the call remain
+  for (Opt flags : {OptAll, Opt(OptAll & ~OptRegColoring)}) {
+    f.set_compiled(X64, Node{});
+    comp.compile_arch(f, X64, flags);
+    TEST(comp.errors().size(), ==, 0);
+
+    // the 5 Vars live across the call are in the registers preserved by the call,
+    // the other 3 were saved to the stack
+    Array<Var> across;
+    collect_across_call(f.get_compiled(X64), r, across);
+    TEST(across.size(), ==, 5);
+    View<Color> colors = comp.allocator_.get_colors();
+    for (Var var : across) {
+      const x64::RegId id = x64::color_reg(var.kind(), colors[var.id().val() - Id::FIRST]);
+      TEST(is_callee_saved(id), ==, true);
+    }
+  }
+
+  // a Float64 Var live across a call is saved to the stack with movsd,
+  // because no XMM register is preserved by the call
+  Func &g = func.reset(&holder, Name{&holder, "xmm_calls"}, //
+                       FuncType{&holder, {Float64}, {Float64}});
+  Var x = g.param(0), y{g, Float64};
+  g.set_body(Block{g,
+                   {Assign{g, ASSIGN, y, Call{g, g.fheader(), {x}}}, //
+                    Return{g, x}}});
+  expected = "(block\n\
+    label_0\n\
+    (x86_sub rsp 8)\n\
+    (_set var1000_df)\n\
+    (x86_movsd (x86_mem_df rsp) var1000_df)\n\
+    (x86_call_ label_0 (_set var1002_df) var1000_df)\n\
+    (x86_movsd var1000_df (x86_mem_df rsp))\n\
+    (x86_add rsp 8)\n\
+    (x86_ret var1000_df))";
+  comp.compile_arch(g, X64, OptAll);
+  TEST(comp.errors().size(), ==, 0);
+  TEST(to_string(g.get_compiled(X64)), ==, expected);
+
+  // Windows preserves XMM6...XMM15 across calls: x stays in one of them,
+  // which the prologue saves in the stack frame and the epilogue restores
+  expected = "(block\n\
+    label_0\n\
+    (x86_sub rsp 24)\n\
+    (x86_movdqu (x86_mem_ul rsp) xmm6)\n\
+    (_set var1000_df)\n\
+    (x86_call_ label_0 (_set var1002_df) var1000_df)\n\
+    (x86_movaps var1001_df var1000_df)\n\
+    (x86_movdqu xmm6 (x86_mem_ul rsp))\n\
+    (x86_add rsp 24)\n\
+    (x86_ret var1001_df))";
+  g.set_compiled(X64, Node{});
+  comp.configure(comp.check(), Abi_x64_windows).compile_arch(g, X64, OptAll);
+  comp.configure(comp.check());
+  TEST(comp.errors().size(), ==, 0);
+  TEST(to_string(g.get_compiled(X64)), ==, expected);
+
+  // copying an XMM register to another uses movaps, not mov
+  Func &k = func.reset(&holder, Name{&holder, "xmm_swap"}, //
+                       FuncType{&holder, {Float64, Float64}, {Float64, Float64}});
+  Var k0 = k.param(0), k1 = k.param(1), t{k, Float64};
+  k.set_body(Block{k,
+                   {Assign{k, ASSIGN, t, k0}, Assign{k, ASSIGN, k0, k1}, //
+                    Assign{k, ASSIGN, k1, t}, Return{k, RETURN, {k0, k1}}}});
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_df var1001_df)\n\
+    (x86_movaps var1004_df var1000_df)\n\
+    (x86_movaps var1000_df var1001_df)\n\
+    (x86_movaps var1001_df var1004_df)\n\
+    (x86_ret var1000_df var1001_df))";
+  comp.compile_arch(k, X64, OptAll);
+  TEST(comp.errors().size(), ==, 0);
+  TEST(to_string(k.get_compiled(X64)), ==, expected);
+
+  // a 16-byte Var and an 8-byte Var live across a call share the stack frame:
+  // the 16-byte slot comes first, at RSP aligned to 16 bytes.
+  // the 8-byte slot is free during the second call, and is widened to 16 bytes
+  // at RSP + 16 for the copy of the 16-byte Var saved there
+  const Kind Float64x2 = Float64.simdn(2);
+  Func &h = func.reset(&holder, Name{&holder, "simd_calls"}, //
+                       FuncType{&holder, {Float64x2, Float64}, {Float64x2}});
+  Var p = h.param(0), d = h.param(1), w{h, Float64x2};
+  h.set_body(Block{h,
+                   {Assign{h, ASSIGN, w, Call{h, h.fheader(), {p, d}}}, //
+                    Assign{h, ASSIGN, w, Call{h, h.fheader(), {p, d}}}, //
+                    Return{h, p}}});
+  expected = "(block\n\
+    label_0\n\
+    (x86_sub rsp 40)\n\
+    (_set var1000_df var1001_df)\n\
+    (x86_movdqu (x86_mem_df rsp) var1000_df)\n\
+    (x86_movsd (x86_mem_df 16 rsp) var1001_df)\n\
+    (x86_call_ label_0 (_set var1003_df) var1000_df var1001_df)\n\
+    (x86_movdqu var1000_df (x86_mem_df rsp))\n\
+    (x86_movsd var1001_df (x86_mem_df 16 rsp))\n\
+    (x86_movdqu (x86_mem_df 16 rsp) var1000_df)\n\
+    (x86_call_ label_0 (_set var1003_df) var1000_df var1001_df)\n\
+    (x86_movdqu var1000_df (x86_mem_df 16 rsp))\n\
+    (x86_add rsp 40)\n\
+    (x86_ret var1000_df))";
+  comp.compile_arch(h, X64, OptAll);
+  TEST(comp.errors().size(), ==, 0);
+  TEST(to_string(h.get_compiled(X64)), ==, expected);
+}
+
+void Test::regallocator_remat() {
+  // sum of 20 Vars holding constants, all live at the same time:
+  // the spilled ones are recomputed before each read instead of stored and reloaded
+  enum : uint16_t { nvar = 20 };
+  Func &f = func.reset(&holder, Name{&holder, "remat"}, FuncType{&holder, {Uint64}, {Uint64}});
+  Var a = f.param(0), r = f.result(0);
+  Array<Node> body;
+  Var v[nvar];
+  for (uint16_t i = 0; i < nvar; i++) {
+    v[i] = Var{f, Uint64};
+    body.append(Assign{f, ASSIGN, v[i], Const{Uint64, uint16_t(i + 100)}});
+  }
+  body.append(Assign{f, ASSIGN, r, a});
+  for (uint16_t i = 0; i < nvar; i++) {
+    body.append(Assign{f, ADD_ASSIGN, r, v[i]});
+  }
+  body.append(Return{f, r});
+  f.set_body(Block{f, body});
+
+  // try both graph coloring and linear scan
+  for (Opt flags : {OptAll, Opt(OptAll & ~OptRegColoring)}) {
+    comp.compile_arch(f, X64, flags);
+    TEST(comp.errors().size(), ==, 0);
+
+    Node node = f.get_compiled(X64);
+    // no stack slots and no stack frame
+    Array<int32_t> offsets;
+    collect_offsets(node, offsets);
+    TEST(offsets.size(), ==, 0);
+    TEST(node.child(1).op(), !=, X86_SUB);
+
+    // each constant is loaded exactly once: the definitions of spilled Vars are removed
+    size_t loads = 0;
+    for (uint32_t i = 0, n = node.children(); i < n; i++) {
+      Node child = node.child(i);
+      if (child.type() == STMT_2 && OpStmt2(child.op()) == X86_MOV &&
+          child.child(1).type() == CONST) {
+        loads++;
+      }
+    }
+    TEST(loads, ==, nvar);
+    f.set_compiled(X64, Node{});
+  }
+}
+
+void Test::linear_scan() {
+  enum : size_t { nreg = 6 };
+  Allocator allocator{nreg};
+  Array<Interval> &intervals = allocator.intervals();
+  intervals.resize(nreg);
+  intervals.set(0, Interval{0, 10});
+  intervals.set(1, Interval{1, 3});
+  intervals.set(2, Interval{2, 8});
+  intervals.set(3, Interval{4, 6});
+  intervals.set(4, Interval{7, 9});
+  intervals.set(5, Interval{0, 0}); // never live
+
+  String result;
+  allocator.linear_scan(Color(3));
+  to_string(result, allocator.get_colors());
+  Chars expected = "0 1 2 1 1 0 ";
+  TEST(result, ==, expected);
+
+  // with two colors, register 0 lives longest and is spilled when register 2 starts
+  allocator.linear_scan(Color(2));
+  to_string(result, allocator.get_colors());
+  expected = "2 1 0 1 1 0 ";
+  TEST(result, ==, expected);
+
+  // compile without OptRegColoring, i.e. with linear scan
+  Func &f = make_func_loop(Uint64);
+  comp.compile_arch(f, X64, Opt(OptAll & ~OptRegColoring));
+  TEST(comp.errors().size(), ==, 0);
+
+  // registers: 0 = n, 1 = total, 2 = i
+  View<Interval> live = comp.allocator_.intervals();
+  TEST(live.size(), ==, 3);
+  for (Reg r1 = 0; r1 < 3; r1++) {
+    TEST(live[r1].start, <, live[r1].end);
+    for (Reg r2 = 0; r2 < r1; r2++) {
+      // all registers are live together inside the loop
+      TEST(live[r1].start, <, live[r2].end);
+      TEST(live[r2].start, <, live[r1].end);
+    }
+  }
+  to_string(result, comp.allocator_.get_colors());
+  expected = "0 1 2 ";
+  TEST(result, ==, expected);
+}
+
+void Test::liveness() {
+  Func &f = make_func_loop(Uint64);
+  compile(f, X64);
+
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (x86_xor var1001_ui var1001_ui)\n\
+    (x86_xor var1002_ui var1002_ui)\n\
+    (x86_jmp label_2)\n\
+    label_1\n\
+    (x86_add var1001_ul var1002_ul)\n\
+    (x86_inc var1002_ul)\n\
+    label_2\n\
+    (x86_cmp var1002_ul var1000_ul)\n\
+    (x86_jb label_1)\n\
+    label_3\n\
+    (x86_ret var1001_ul))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // registers: 0 = n, 1 = total, 2 = i
+  // basic blocks: 0 = entry, 1 = loop body, 2 = loop test, 3 = return
+  const Liveness &live = comp.liveness_;
+  TEST(live.size(), ==, 3);
+  TEST(live.live_in(0, 0), ==, false); // written by (_set)
+  TEST(live.live_out(0, 0), ==, true);
+  TEST(live.live_out(0, 1), ==, true);
+  TEST(live.live_out(0, 2), ==, true);
+  // liveness must propagate across the backward jump
+  TEST(live.live_in(1, 0), ==, true);
+  TEST(live.live_out(2, 0), ==, true);
+  TEST(live.live_out(2, 1), ==, true);
+  TEST(live.live_out(2, 2), ==, true);
+  TEST(live.live_in(3, 0), ==, false);
+  TEST(live.live_in(3, 1), ==, true);
+  TEST(live.live_in(3, 2), ==, false);
+  TEST(live.live_out(3, 1), ==, false);
+
+  // all registers are live together inside the loop
+  const Graph &graph = comp.allocator_.graph();
+  TEST(graph(0, 1), ==, true);
+  TEST(graph(0, 2), ==, true);
+  TEST(graph(1, 2), ==, true);
+}
+
 } // namespace onejit
@@ -0,0 +1,123 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * test_regallocator_bench.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include "test.hpp"
+
+#include <onejit/reg/allocator.hpp>
+
+#include <cstdio>
+
+namespace onejit {
+
+using namespace ::onejit::reg;
+
+enum : Color { bench_colors = 14 };
+
+static uint32_t next_random(uint32_t &seed) {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+// return the number of interfering registers that received the same color
+static Size count_conflicts(const Graph &graph, View<Color> colors) {
+  Size conflicts = 0;
+  for (Reg r1 = 0, n = graph.size(); r1 < n; r1++) {
+    for (Reg r2 : graph.neighbors(r1)) {
+      conflicts += r2 != r1 && colors[r1] == colors[r2];
+    }
+  }
+  return conflicts;
+}
+
+// return the number of registers that received a color >= bench_colors
+static Size count_spills(View<Color> colors) {
+  Size spills = 0;
+  for (Color color : colors) {
+    spills += color >= bench_colors;
+  }
+  return spills;
+}
+
+// interference graph shaped like the ones produced by straight-line code:
+// each register is live for a short interval, and interferes
+// with all registers whose interval overlaps its own
+static void make_interval_graph(Allocator &allocator, Size num_regs) {
+  Graph &graph = allocator.graph();
+  Array<Interval> &intervals = allocator.intervals();
+  intervals.resize(num_regs);
+  uint32_t seed = 1;
+  for (Reg r1 = 0; r1 < num_regs; r1++) {
+    Reg end = r1 + 1 + next_random(seed) % 24;
+    for (Reg r2 = r1 + 1; r2 < end && r2 < num_regs; r2++) {
+      graph.set(r1, r2, true);
+    }
+    // intervals overlap exactly when the corresponding registers interfere
+    intervals.set(r1, Interval{r1, end});
+  }
+}
+
+// random sparse interference graph: each register interferes with 10 random others,
+// thus many registers have degree >= bench_colors and Chaitin must pick some to spill
+static void make_random_graph(Allocator &allocator, Size num_regs) {
+  Graph &graph = allocator.graph();
+  uint32_t seed = 1;
+  for (Reg r1 = 0; r1 < num_regs; r1++) {
+    for (int i = 0; i < 10; i++) {
+      Reg r2 = (next_random(seed) << 15 ^ next_random(seed)) % num_regs;
+      graph.set(r1, r2, r1 != r2);
+    }
+  }
+}
+
+// measure time and memory of register allocation against the number of registers
+void Test::regallocator_bench() {
+  const Chars shape_name[] = {"interval", "random"};
+  Fmt fmt{stdout};
+  for (int shape = 0; shape < 2; shape++) {
+    for (Size num_regs = 1024; num_regs <= 65536; num_regs *= 4) {
+      Allocator allocator{num_regs};
+      Graph &graph = allocator.graph();
+
+      double start = get_cpu_clock();
+      if (shape == 0) {
+        make_interval_graph(allocator, num_regs);
+      } else {
+        make_random_graph(allocator, num_regs);
+      }
+      double mid = get_cpu_clock();
+      TEST(allocator.allocate_regs(bench_colors), ==, true);
+      double end = get_cpu_clock();
+      TEST(count_conflicts(graph, allocator.get_colors()), ==, 0);
+
+      fmt << "  reg::Allocator " << shape_name[shape] << " graph, "
+          << num_regs << " registers\tgraph took " << (mid - start) << " seconds, coloring took "
+          << (end - mid) << " seconds, " << count_spills(allocator.get_colors())
+          << " spills, graph uses " << graph.memory() << " bytes\n";
+
+      if (shape == 0) {
+        start = get_cpu_clock();
+        allocator.linear_scan(bench_colors);
+        end = get_cpu_clock();
+        TEST(count_conflicts(graph, allocator.get_colors()), ==, 0);
+
+        fmt << "  reg::Allocator interval graph, " << num_regs << " registers\tlinear scan took "
+            << (end - start) << " seconds, " << count_spills(allocator.get_colors())
+            << " spills\n";
+      }
+    }
+  }
+}
+
+} // namespace onejit
@@ -54,8 +54,16 @@ void Test::stl_bitset() {
 }
 
 void Test::stl_graph() {
+  stl_graph(14);
+  // large enough to use a hash set of edges instead of a bit matrix
+  stl_graph(Graph::DenseMaxSize + 14);
+}
+
+// only the first 14 nodes are connected
+void Test::stl_graph(Graph::Size size) {
   Graph::Node a, b, n = 14;
-  Graph g{n};
+  Graph g{size};
+  TEST(g.dense(), ==, size <= Graph::DenseMaxSize);
   for (a = 0; a < n; a++) {
     TEST(g.degree(a), ==, 0);
     for (b = 0; b < n; b++) {
@@ -87,6 +95,11 @@ void Test::stl_graph() {
       }
     }
   }
+  for (a = 0; a < n; a++) {
+    // a is connected to all nodes, including itself
+    TEST(g.neighbors(a).size(), ==, n);
+    TEST(g.degree(a), ==, n + 1);
+  }
 
   for (a = 0; a < n; a++) {
     for (b = 0; b <= a; b++) {
@@ -0,0 +1,106 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * test_tier.cpp
+ *
+ *  Created on Oct 19, 2026
+ *      Author Massimiliano Ghilardi
+ */
+
+#include "test.hpp"
+
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/tier.hpp>
+
+namespace onejit {
+
+// fake backend: does not generate executable code,
+// returns a different address at each invocation
+static void *fake_backend(void *ctx, Func & /*func*/) {
+  static char entries[8];
+  size_t &n = *static_cast<size_t *>(ctx);
+  return n < sizeof(entries) ? &entries[n++] : nullptr;
+}
+
+void Test::tier() {
+  size_t n_backend = 0;
+  Tiered tiered{NOARCH, fake_backend, &n_backend, TierPolicy{3, 1000}};
+  Func &f = make_func_loop(Uint64);
+
+  TieredFunc *tfunc = tiered.add(f);
+  TEST(tfunc != nullptr, ==, true);
+  TEST(tiered.errors().size(), ==, 0);
+  TEST(tfunc->tier(), ==, 0);
+  TEST(n_backend, ==, 1);
+  void *entry0 = tfunc->entry();
+
+  const TierCounters &counters = tfunc->counters();
+  String expected;
+  Fmt{&expected} << "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (++ (mem_ul 0x"
+                 << Hex{&counters.calls} << "))\n\
+    (= var1001_ul 0)\n\
+    (= var1002_ul 0)\n\
+    (goto label_2)\n\
+    label_1\n\
+    (++ (mem_ul 0x"
+                 << Hex{&counters.backedges} << "))\n\
+    (+= var1001_ul var1002_ul)\n\
+    (++ var1002_ul)\n\
+    label_2\n\
+    (asm_jb label_1 var1002_ul var1000_ul)\n\
+    label_3\n\
+    (return var1001_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // simulate calls to baseline tier
+  TierCounters &mut_counters = const_cast<TierCounters &>(counters);
+  mut_counters.calls += 2;
+  TEST(tiered.poll(), ==, 0);
+  TEST(tfunc->entry() == entry0, ==, true);
+
+  mut_counters.calls++;
+  TEST(tiered.poll(), ==, 1);
+  TEST(tiered.errors().size(), ==, 0);
+  TEST(tfunc->tier(), ==, 1);
+  TEST(tfunc->entry() != entry0, ==, true);
+  TEST(n_backend, ==, 2);
+
+  // optimizing tier has no counters
+  Chars expected_opt = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (= var1001_ul 0)\n\
+    (= var1002_ul 0)\n\
+    (goto label_2)\n\
+    label_1\n\
+    (+= var1001_ul var1002_ul)\n\
+    (++ var1002_ul)\n\
+    label_2\n\
+    (asm_jb label_1 var1002_ul var1000_ul)\n\
+    label_3\n\
+    (return var1001_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected_opt);
+  // recompiling does not accumulate labels
+  TEST(f.labels().size(), ==, 4);
+
+  // already promoted
+  mut_counters.backedges += 1000;
+  TEST(tiered.poll(), ==, 0);
+
+  // callers load the entry point from its slot
+  expected.clear();
+  Fmt{&expected} << "(mem_p 0x" << Hex{tfunc->entry_slot()} << ')';
+  TEST(to_string(tfunc->call_address(f)), ==, expected);
+}
+
+} // namespace onejit
@@ -16,6 +16,7 @@
 #include "test.hpp"
 
 #include <onejit/assembler.hpp>
+#include <onejit/flowgraph.hpp>
 #include <onejit/ir.hpp>
 #include <onejit/x64.hpp>
 
@@ -185,4 +186,366 @@ void Test::expr_x64() {
   holder.clear();
 }
 
+void Test::asm2_x64() {
+  Func &f = func.reset(&holder, Name{&holder, "asm2_x64"}, FuncType{&holder, {}, {}});
+
+  Assembler assembler;
+
+  const OpStmt2 alu_ops[] = {X86_ADC, X86_ADD, X86_AND, X86_CMP, X86_MOV,
+                             X86_OR,  X86_SBB, X86_SUB, X86_XOR};
+
+  // reg, reg and reg, imm
+  for (OpStmt2 op : alu_ops) {
+    for (Kind kind : {Uint8, Uint16, Uint32, Uint64}) {
+      for (x64::RegId i = x64::RAX; i <= x64::R15; i = i + 1) {
+        x64::Reg dst{kind, i};
+        for (x64::RegId j : {x64::RCX, x64::RDI, x64::R9}) {
+          x64::Reg src{kind, j};
+          Stmt2 st{f, op, Var{dst}, Var{src}};
+          test_asm_disasm_x64(st, assembler);
+        }
+        for (int16_t val : {1, 0x7f}) {
+          Stmt2 st{f, op, Var{dst}, Const{kind, val}};
+          test_asm_disasm_x64(st, assembler);
+        }
+      }
+    }
+  }
+
+  // reg, mem and mem, reg
+  for (OpStmt2 op : alu_ops) {
+    for (Kind kind : {Uint8, Uint16, Uint32, Uint64}) {
+      for (x64::RegId i = x64::RAX; i <= x64::R15; i = i + 1) {
+        x64::Reg reg{kind, i}, base{Uint64, i}, index{Uint64, x64::R9};
+        for (int32_t offset : {0x7f, 0x77665544}) {
+          x64::Mem mem{f, kind, x64::Address{offset, Var{base}}};
+
+          Stmt2 st{f, op, Var{reg}, mem};
+          test_asm_disasm_x64(st, assembler);
+
+          x64::Mem mem2{f, kind, x64::Address{offset, Var{base}, Var{index}, x64::Scale4}};
+          st = Stmt2{f, op, mem2, Var{reg}};
+          test_asm_disasm_x64(st, assembler);
+        }
+      }
+    }
+  }
+
+  holder.clear();
+
+  struct {
+    Stmt2 st;
+    Chars expected;
+  } tests[] = {
+      {Stmt2{f, X86_ADD, Var{x64::Reg{Uint64, x64::RAX}},
+             x64::Mem{f, Uint64,
+                      x64::Address{0x12345, Var{x64::Reg{Uint64, x64::R13}},
+                                   Var{x64::Reg{Uint64, x64::R9}}, x64::Scale4}}},
+       "\x4b\x03\x84\x8d\x45\x23\x01\x00"}, // add 0x12345(%r13,%r9,4),%rax
+      {Stmt2{f, X86_SUB, Var{x64::Reg{Uint64, x64::RSP}}, Const{Uint64, int16_t(0x1234)}},
+       "\x48\x81\xec\x34\x12\x00\x00"}, // sub $0x1234,%rsp
+      {Stmt2{f, X86_CMP, Var{x64::Reg{Uint64, x64::R13}}, Const{Int64, int16_t(-3)}},
+       "\x49\x83\xfd\xfd"}, // cmp $-3,%r13
+      {Stmt2{f, X86_MOV, Var{x64::Reg{Uint64, x64::R15}}, Const{f, uint64_t(0x1122334455667788)}},
+       "\x49\xbf\x88\x77\x66\x55\x44\x33\x22\x11"}, // movabs $0x1122334455667788,%r15
+      {Stmt2{f, X86_MOV, Var{x64::Reg{Int64, x64::R15}}, Const{Int64, int16_t(-3)}},
+       "\x49\xc7\xc7\xfd\xff\xff\xff"}, // mov $-3,%r15
+      {Stmt2{f, X86_MUL, Var{x64::Reg{Uint64, x64::RAX}}, Var{x64::Reg{Uint64, x64::R9}}},
+       "\x49\xf7\xe1"}, // mul %r9
+      {Stmt2{f, X86_SHL, Var{x64::Reg{Uint32, x64::R12}}, Var{x64::Reg{Uint8, x64::RCX}}},
+       "\x41\xd3\xe4"}, // shl %cl,%r12d
+      {Stmt2{f, X86_SHR, Var{x64::Reg{Uint16, x64::RSI}}, Const{Uint8, int16_t(1)}},
+       "\x66\xd1\xee"}, // shr %si
+      {Stmt2{f, X86_MOVZX, Var{x64::Reg{Uint64, x64::RBX}}, Var{x64::Reg{Uint16, x64::R11}}},
+       "\x49\x0f\xb7\xdb"}, // movzx %r11w,%rbx
+      {Stmt2{f, X86_MOVQ, Var{x64::Reg{Float64, x64::XMM9}}, Var{x64::Reg{Uint64, x64::R10}}},
+       "\x66\x4d\x0f\x6e\xca"}, // movq %r10,%xmm9
+      {Stmt2{f, X86_MOVSD, Var{x64::Reg{Float64, x64::XMM9}},
+             x64::Mem{f, Float64, x64::Address{0x12, Var{x64::Reg{Uint64, x64::R12}}}}},
+       "\xf2\x45\x0f\x10\x4c\x24\x12"}, // movsd 0x12(%r12),%xmm9
+  };
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    assembler.clear();
+    assembler.x64(tests[i].st);
+    TEST(assembler, ==, tests[i].expected);
+  }
+
+  holder.clear();
+}
+
+void Test::asm3_x64() {
+  Func &f = func.reset(&holder, Name{&holder, "asm3_x64"}, FuncType{&holder, {}, {}});
+
+  Assembler assembler;
+
+  struct {
+    Stmt3 st;
+    Chars expected;
+  } tests[] = {
+      {Stmt3{f, X86_IMUL3, Var{x64::Reg{Uint64, x64::R9}}, Var{x64::Reg{Uint64, x64::RCX}},
+             Const{Uint64, int16_t(0x1234)}},
+       "\x4c\x69\xc9\x34\x12\x00\x00"}, // imul $0x1234,%rcx,%r9
+      {Stmt3{f, X86_IMUL3, Var{x64::Reg{Uint16, x64::R9}}, Var{x64::Reg{Uint16, x64::RCX}},
+             Const{Uint8, int16_t(3)}},
+       "\x66\x44\x6b\xc9\x03"}, // imul $3,%cx,%r9w
+      {Stmt3{f, X86_SHLD,
+             x64::Mem{f, Uint16, x64::Address{0x12, Var{x64::Reg{Uint64, x64::R12}}}},
+             Var{x64::Reg{Uint16, x64::RAX}}, Const{Uint8, int16_t(3)}},
+       "\x66\x41\x0f\xa4\x44\x24\x12\x03"}, // shld $3,%ax,0x12(%r12)
+      {Stmt3{f, X86_EXTRACTPS, Var{x64::Reg{Uint32, x64::R9}},
+             Var{x64::Reg{Float32, x64::XMM10}}, Const{Uint8, int16_t(3)}},
+       "\x66\x45\x0f\x3a\x17\xd1\x03"}, // extractps $3,%xmm10,%r9d
+      {Stmt3{f, X86_PINSR, Var{x64::Reg{Float32, x64::XMM2}}, Var{x64::Reg{Uint16, x64::R9}},
+             Const{Uint8, int16_t(3)}},
+       "\x66\x41\x0f\xc4\xd1\x03"}, // pinsrw $3,%r9d,%xmm2
+  };
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    assembler.clear();
+    assembler.x64(tests[i].st);
+    TEST(assembler, ==, tests[i].expected);
+  }
+
+  holder.clear();
+}
+
+void Test::relax_x64() {
+  Func &f = func.reset(&holder, Name{&holder, "relax_x64"}, FuncType{&holder, {}, {}});
+  Var eax{x64::Reg{Uint32, x64::RAX}}, ecx{x64::Reg{Uint32, x64::RCX}};
+  Stmt2 add{f, X86_ADD, eax, ecx}; // 2 bytes
+  Assembler assembler;
+  Array<Node> nodes;
+
+  // near jumps use rel8 encoding
+  {
+    Label back{f}, fwd{f};
+    Block block{f,
+                {back, Stmt1{f, fwd, X86_JE}, add, Stmt1{f, back, X86_JMP}, //
+                 fwd, Return{f, X86_RET}}};
+    assembler.x64(block);
+    Chars expected = "\x74\x04\x01\xc8\xeb\xfa\xc3"; // je +4; add; jmp -6; ret
+    TEST(assembler, ==, expected);
+    TEST(assembler.relocations().size(), ==, 0);
+  }
+
+  // backward jumps: -128 fits rel8, -130 does not
+  for (size_t n : {63, 64}) {
+    Label back{f};
+    nodes.clear();
+    nodes.append(back);
+    for (size_t i = 0; i < n; i++) {
+      nodes.append(add);
+    }
+    nodes.append(Stmt1{f, back, X86_JNE});
+    assembler.clear();
+    assembler.x64(Block{f, Nodes{nodes.data(), nodes.size()}});
+    TEST(assembler.errors().size(), ==, 0);
+    const Bytes bytes = assembler.bytes();
+    if (n == 63) {
+      TEST(bytes.size(), ==, 2 * n + 2);
+      TEST(bytes[2 * n], ==, 0x75);
+      TEST(bytes[2 * n + 1], ==, 0x80);
+      TEST(assembler.relocations().size(), ==, 0);
+    } else {
+      TEST(bytes.size(), ==, 2 * n + 6);
+      TEST(bytes[2 * n], ==, 0x0f);
+      TEST(bytes[2 * n + 1], ==, 0x85);
+      TEST(assembler.relocations().size(), ==, 1);
+    }
+  }
+
+  // growing an inner jump pushes an outer jump out of rel8 range
+  {
+    Label outer{f}, inner{f};
+    nodes.clear();
+    nodes.append(Stmt1{f, outer, X86_JMP});
+    for (size_t i = 0; i < 62; i++) {
+      nodes.append(add);
+    }
+    nodes.append(Stmt1{f, inner, X86_JMP});
+    nodes.append(outer);
+    for (size_t i = 0; i < 100; i++) {
+      nodes.append(add);
+    }
+    nodes.append(inner);
+    assembler.clear();
+    assembler.x64(Block{f, Nodes{nodes.data(), nodes.size()}});
+    TEST(assembler.errors().size(), ==, 0);
+    const Bytes bytes = assembler.bytes();
+    TEST(bytes.size(), ==, 5 + 62 * 2 + 5 + 100 * 2);
+    TEST(bytes[0], ==, 0xe9);
+    TEST(bytes[5 + 62 * 2], ==, 0xe9);
+    TEST(assembler.relocations().size(), ==, 2);
+  }
+
+  holder.clear();
+}
+
+void Test::align_x64() {
+  Func &f = func.reset(&holder, Name{&holder, "align_x64"}, FuncType{&holder, {}, {}});
+  Var eax{x64::Reg{Uint32, x64::RAX}}, ecx{x64::Reg{Uint32, x64::RCX}};
+  Stmt2 add{f, X86_ADD, eax, ecx}; // 2 bytes
+  Assembler assembler;
+  Array<Node> nodes;
+
+  // NOP padding of every length up to 64 bytes
+  for (size_t n = 0; n <= 64; n++) {
+    Label l{f};
+    assembler.clear();
+    assembler.align_label(l, 64);
+    for (size_t i = 0; i < n; i++) {
+      assembler.x64(Stmt0{X86_NOP});
+    }
+    assembler.x64(l);
+    TEST(assembler.errors().size(), ==, 0);
+    TEST(assembler.size(), ==, (n + 63) & ~size_t(63));
+    TEST(assembler.labels()[0].pos, ==, assembler.size());
+  }
+
+  {
+    Label l{f};
+    assembler.clear();
+    assembler.align_label(l, 16);
+    assembler.x64(add).x64(l);
+    // add; nopw 0x0(%rax,%rax,1); nopl 0x0(%rax,%rax,1)
+    Chars expected = "\x01\xc8\x66\x0f\x1f\x84\x00\x00\x00\x00\x00\x0f\x1f\x44\x00\x00";
+    TEST(assembler, ==, expected);
+
+    assembler.align_label(l, 48);
+    TEST(assembler.errors().size(), ==, 1);
+  }
+
+  // loop headers found by FlowGraph are aligned, and jumps to them account for padding
+  {
+    Label loop{f};
+    nodes.clear();
+    for (Node node : {Node{add}, Node{loop}, Node{add}, Node{Stmt1{f, loop, X86_JNE}},
+                      Node{Return{f, X86_RET}}}) {
+      nodes.append(node);
+    }
+    FlowGraph flowgraph;
+    Array<Error> errors;
+    TEST(flowgraph.build(Span<Node>{nodes.data(), nodes.size()}, errors), ==, true);
+    TEST(flowgraph.loop_headers().size(), ==, 1);
+
+    assembler.clear();
+    assembler.align_loops(flowgraph, 32);
+    TEST(assembler.label_align(loop), ==, 32);
+    assembler.x64(Block{f, Nodes{nodes.data(), nodes.size()}});
+    TEST(assembler.errors().size(), ==, 0);
+    TEST(assembler.labels()[0].pos, ==, 32);
+
+    const Bytes bytes = assembler.bytes();
+    TEST(bytes.size(), ==, 37);
+    TEST(bytes[34], ==, 0x75); // jne -4
+    TEST(bytes[35], ==, 0xfc);
+    TEST(bytes[36], ==, 0xc3); // ret
+  }
+
+  holder.clear();
+}
+
+void Test::avx_x64() {
+  Func &f = func.reset(&holder, Name{&holder, "avx_x64"}, FuncType{&holder, {}, {}});
+  const Kind ps4 = Float32.simdn(4), ps8 = Float32.simdn(8), ps16 = Float32.simdn(16);
+  const Kind pd4 = Float64.simdn(4), pd8 = Float64.simdn(8);
+  auto xmm = [](Kind kind, x64::RegId id) { return Var{x64::Reg{kind, id}}; };
+  auto mem = [&](Kind kind, int32_t offset, x64::RegId base) {
+    return x64::Mem{f, kind, x64::Address{offset, Var{x64::Reg{Uint64, base}}}};
+  };
+  Assembler assembler;
+
+  struct {
+    Node st;
+    Chars expected;
+  } tests[] = {
+      {Stmt3{f, X86_VADDPS, xmm(ps8, x64::XMM0), xmm(ps8, x64::XMM1), xmm(ps8, x64::XMM2)},
+       "\xc5\xf4\x58\xc2"}, // vaddps %ymm2,%ymm1,%ymm0
+      {Stmt3{f, X86_VADDPD, xmm(pd8, x64::XMM3), xmm(pd8, x64::XMM4), xmm(pd8, x64::XMM5)},
+       "\x62\xf1\xdd\x48\x58\xdd"}, // vaddpd %zmm5,%zmm4,%zmm3
+      {Stmt3{f, X86_VPADDD, xmm(Int32.simdn(4), x64::XMM17), xmm(Int32.simdn(4), x64::XMM1),
+             xmm(Int32.simdn(4), x64::XMM20)},
+       "\x62\xa1\x75\x08\xfe\xcc"}, // vpaddd %xmm20,%xmm1,%xmm17
+      {Stmt3{f, X86_VMULPS, xmm(ps16, x64::XMM1), xmm(ps16, x64::XMM2), mem(ps16, 0x80, x64::RAX)},
+       "\x62\xf1\x6c\x48\x59\x48\x02"}, // vmulps 0x80(%rax),%zmm2,%zmm1
+      {Stmt3{f, X86_VMULPS, xmm(ps8, x64::XMM1), xmm(ps8, x64::XMM2), mem(ps8, 0x80, x64::R9)},
+       "\xc4\xc1\x6c\x59\x89\x80\x00\x00\x00"}, // vmulps 0x80(%r9),%ymm2,%ymm1
+      {Stmt3{f, X86_VPXOR, xmm(Int64.simdn(8), x64::XMM1), xmm(Int64.simdn(8), x64::XMM2),
+             xmm(Int64.simdn(8), x64::XMM3)},
+       "\x62\xf1\xed\x48\xef\xcb"}, // vpxorq %zmm3,%zmm2,%zmm1
+      {Stmt3{f, X86_VPXOR, xmm(Uint8.simdn(64), x64::XMM1), xmm(Uint8.simdn(64), x64::XMM2),
+             xmm(Uint8.simdn(64), x64::XMM3)},
+       "\x62\xf1\x6d\x48\xef\xcb"}, // vpxord %zmm3,%zmm2,%zmm1
+      {Stmt3{f, X86_VPXOR, xmm(Uint8.simdn(32), x64::XMM1), xmm(Uint8.simdn(32), x64::XMM2),
+             xmm(Uint8.simdn(32), x64::XMM11)},
+       "\xc4\xc1\x6d\xef\xcb"}, // vpxor %ymm11,%ymm2,%ymm1
+      {Stmt3{f, X86_VPCMPGTQ, xmm(Int64.simdn(2), x64::XMM1), xmm(Int64.simdn(2), x64::XMM2),
+             xmm(Int64.simdn(2), x64::XMM3)},
+       "\xc4\xe2\x69\x37\xcb"}, // vpcmpgtq %xmm3,%xmm2,%xmm1
+      {Stmt3{f, X86_VPMULLD, xmm(Int32.simdn(8), x64::XMM8), xmm(Int32.simdn(8), x64::XMM2),
+             xmm(Int32.simdn(8), x64::XMM9)},
+       "\xc4\x42\x6d\x40\xc1"}, // vpmulld %ymm9,%ymm2,%ymm8
+      {Stmt3{f, X86_VSUBPD, xmm(pd4, x64::XMM15), xmm(pd4, x64::XMM14),
+             x64::Mem{f, pd4, x64::Address{0x1000}}},
+       "\xc5\x0d\x5c\x3c\x25\x00\x10\x00\x00"}, // vsubpd 0x1000,%ymm14,%ymm15
+      {Stmt2{f, X86_VMOVDQU, xmm(Uint16.simdn(32), x64::XMM7), mem(Uint16.simdn(32), 0, x64::RSI)},
+       "\x62\xf1\xff\x48\x6f\x3e"}, // vmovdqu16 (%rsi),%zmm7
+      {Stmt2{f, X86_VMOVDQU,
+             x64::Mem{f, Uint8.simdn(32),
+                      x64::Address{0x20, Var{x64::Reg{Uint64, x64::RDI}},
+                                   Var{x64::Reg{Uint64, x64::RCX}}, x64::Scale8}},
+             xmm(Uint8.simdn(32), x64::XMM7)},
+       "\xc5\xfe\x7f\x7c\xcf\x20"}, // vmovdqu %ymm7,0x20(%rdi,%rcx,8)
+      {Stmt2{f, X86_VMOVUPS, mem(ps16, 0x44, x64::RSP), xmm(ps16, x64::XMM30)},
+       "\x62\x61\x7c\x48\x11\xb4\x24\x44\x00\x00\x00"}, // vmovups %zmm30,0x44(%rsp)
+      {Stmt2{f, X86_VMOVAPS, xmm(ps4, x64::XMM8), xmm(ps4, x64::XMM9)},
+       "\xc4\x41\x78\x28\xc1"}, // vmovaps %xmm9,%xmm8
+      {Stmt2{f, X86_VMOVDQA, xmm(Int64.simdn(8), x64::XMM0), mem(Int64.simdn(8), 0x40, x64::RBP)},
+       "\x62\xf1\xfd\x48\x6f\x45\x01"}, // vmovdqa64 0x40(%rbp),%zmm0
+      {Stmt2{f, X86_VBROADCASTSS, xmm(ps8, x64::XMM3), mem(Float32, 8, x64::RDI)},
+       "\xc4\xe2\x7d\x18\x5f\x08"}, // vbroadcastss 0x8(%rdi),%ymm3
+      {Stmt2{f, X86_VBROADCASTSS, xmm(ps16, x64::XMM3), mem(Float32, 8, x64::RDI)},
+       "\x62\xf2\x7d\x48\x18\x5f\x02"}, // vbroadcastss 0x8(%rdi),%zmm3
+      {Stmt2{f, X86_VPBROADCASTQ, xmm(Int64.simdn(8), x64::XMM2), xmm(Int64, x64::XMM1)},
+       "\x62\xf2\xfd\x48\x59\xd1"}, // vpbroadcastq %xmm1,%zmm2
+      {Stmt2{f, X86_VPBROADCASTB, xmm(Uint8.simdn(16), x64::XMM5), mem(Uint8, 3, x64::RIP)},
+       "\xc4\xe2\x79\x78\x2d\x03\x00\x00\x00"}, // vpbroadcastb 0x3(%rip),%xmm5
+      {Stmt4{f, X86_VCMPPS, xmm(ps8, x64::XMM0), xmm(ps8, x64::XMM1), xmm(ps8, x64::XMM2),
+             Const{Uint8, int16_t(1)}},
+       "\xc5\xf4\xc2\xc2\x01"}, // vcmpltps %ymm2,%ymm1,%ymm0
+  };
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    assembler.clear();
+    assembler.x64(tests[i].st);
+    TEST(assembler.errors().size(), ==, 0);
+    TEST(assembler, ==, tests[i].expected);
+  }
+
+  // unsupported combinations
+  Node errors[] = {
+      // compares write a mask register with EVEX encoding, which is not supported
+      Stmt3{f, X86_VPCMPEQD, xmm(Int32.simdn(16), x64::XMM0), xmm(Int32.simdn(16), x64::XMM1),
+            xmm(Int32.simdn(16), x64::XMM2)},
+      Stmt4{f, X86_VCMPPD, xmm(Float64.simdn(2), x64::XMM16), xmm(Float64.simdn(2), x64::XMM1),
+            xmm(Float64.simdn(2), x64::XMM2), Const{Uint8, int16_t(0)}},
+      // vbroadcastsd requires %ymm or %zmm destination
+      Stmt2{f, X86_VBROADCASTSD, xmm(Float64.simdn(2), x64::XMM0), xmm(Float64, x64::XMM1)},
+      // arguments with different width
+      Stmt3{f, X86_VADDPS, xmm(ps8, x64::XMM0), xmm(ps4, x64::XMM1), xmm(ps8, x64::XMM2)},
+      Stmt3{f, X86_VADDPS, xmm(ps8, x64::XMM0), xmm(ps8, x64::XMM1), mem(ps16, 0, x64::RAX)},
+      // no store form
+      Stmt2{f, X86_VPBROADCASTD, mem(Int32.simdn(4), 0, x64::RAX), xmm(Int32, x64::XMM1)},
+  };
+  for (size_t i = 0; i < sizeof(errors) / sizeof(errors[0]); i++) {
+    assembler.clear();
+    assembler.x64(errors[i]);
+    TEST(assembler.errors().size(), ==, 1);
+    TEST(assembler.size(), ==, 0);
+  }
+
+  holder.clear();
+}
+
 } // namespace onejit